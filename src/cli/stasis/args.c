@@ -8,12 +8,23 @@ struct option long_options[] = {
     {"config", required_argument, 0, 'c'},
     {"cpu-limit", required_argument, 0, 'l'},
     {"pool-status-interval", required_argument, 0, OPT_POOL_STATUS_INTERVAL},
+    {"fetch-jobs", required_argument, 0, OPT_FETCH_JOBS},
+    {"copy-jobs", required_argument, 0, OPT_COPY_JOBS},
+    {"delete-jobs", required_argument, 0, OPT_DELETE_JOBS},
+    {"scan-jobs", required_argument, 0, OPT_SCAN_JOBS},
+    {"git-cache-dir", required_argument, 0, OPT_GIT_CACHE_DIR},
+    {"git-cache-max", required_argument, 0, OPT_GIT_CACHE_MAX},
+    {"git-clone-mode", required_argument, 0, OPT_GIT_CLONE_MODE},
+    {"index-cache-dir", required_argument, 0, OPT_INDEX_CACHE_DIR},
+    {"index-cache-ttl", required_argument, 0, OPT_INDEX_CACHE_TTL},
+    {"index-cache-stale", no_argument, 0, OPT_INDEX_CACHE_STALE},
     {"python", required_argument, 0, 'p'},
     {"verbose", no_argument, 0, 'v'},
     {"unbuffered", no_argument, 0, 'U'},
     {"update-base", no_argument, 0, OPT_ALWAYS_UPDATE_BASE},
     {"fail-fast", no_argument, 0, OPT_FAIL_FAST},
     {"task-timeout", required_argument, 0, OPT_TASK_TIMEOUT},
+    {"keep-task-logs", no_argument, 0, OPT_KEEP_TASK_LOGS},
     {"overwrite", no_argument, 0, OPT_OVERWRITE},
     {"wheel-builder", required_argument, 0, OPT_WHEEL_BUILDER},
     {"wheel-builder-manylinux-image", required_argument, 0, OPT_WHEEL_BUILDER_MANYLINUX_IMAGE},
@@ -25,6 +36,8 @@ struct option long_options[] = {
     {"no-parallel", no_argument, 0, OPT_NO_PARALLEL},
     {"no-task-logging", no_argument, 0, OPT_NO_TASK_LOGGING},
     {"no-rewrite", no_argument, 0, OPT_NO_REWRITE_SPEC_STAGE_2},
+    {"no-git-cache", no_argument, 0, OPT_NO_GIT_CACHE},
+    {"no-index-cache", no_argument, 0, OPT_NO_INDEX_CACHE},
     {0, 0, 0, 0},
 };
 
@@ -35,12 +48,23 @@ const char *long_options_help[] = {
     "Read configuration file",
     "Number of processes to spawn concurrently (default: cpus - 1)",
     "Report task status every n seconds (default: 30)",
+    "Number of repositories to clone concurrently (default: 4)",
+    "Number of files to copy concurrently (default: 4)",
+    "Number of processes removing a directory (default: 4)",
+    "Number of wheel files to read concurrently (default: 4)",
+    "Git mirror cache directory (default: ~/.stasis/git-cache)",
+    "Git mirror cache size limit in MiB (default: 10240, 0: off)",
+    "Clone mode without a git cache (full, blobless, shallow)",
+    "Package index cache directory (default: ~/.stasis/index-cache)",
+    "Revalidate cached index data after n seconds (default: 3600)",
+    "Use expired index data when the package index fails",
     "Override version of Python in configuration",
     "Increase output verbosity",
     "Disable line buffering",
     "Update conda installation prior to STASIS environment creation",
     "On error, immediately terminate all tasks",
     "Terminate task after timeout is reached (#s, #m, #h)",
+    "Keep compressed task logs in the results directory",
     "Overwrite an existing release",
     "Wheel building backend (build, cibuildwheel, manylinux)",
     "Manylinux image name",
@@ -50,8 +74,10 @@ const char *long_options_help[] = {
     "Do not upload artifacts to Artifactory (dry-run)",
     "Do not execute test scripts",
     "Do not execute tests in parallel",
-    "Do not log task output (write to stdout)",
+    "Do not capture task output (write to stdout)",
     "Do not rewrite paths and URLs in output files",
+    "Do not clone repositories through the git mirror cache",
+    "Do not cache package index lookups",
     NULL,
 };
 
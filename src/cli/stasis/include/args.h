@@ -21,6 +21,19 @@
 #define OPT_TASK_TIMEOUT 1013
 #define OPT_WHEEL_BUILDER 1014
 #define OPT_WHEEL_BUILDER_MANYLINUX_IMAGE 1015
+#define OPT_KEEP_TASK_LOGS 1016
+#define OPT_FETCH_JOBS 1017
+#define OPT_NO_GIT_CACHE 1018
+#define OPT_GIT_CACHE_DIR 1019
+#define OPT_GIT_CACHE_MAX 1020
+#define OPT_GIT_CLONE_MODE 1021
+#define OPT_NO_INDEX_CACHE 1022
+#define OPT_INDEX_CACHE_DIR 1023
+#define OPT_INDEX_CACHE_TTL 1024
+#define OPT_INDEX_CACHE_STALE 1025
+#define OPT_COPY_JOBS 1026
+#define OPT_DELETE_JOBS 1027
+#define OPT_SCAN_JOBS 1028
 
 extern struct option long_options[];
 void usage(char *progname);
@@ -4,6 +4,7 @@
 #include <limits.h>
 #include "core.h"
 #include "delivery.h"
+#include "gitcache.h"
 
 // local includes
 #include "args.h"
@@ -342,6 +343,16 @@ static void show_overview(struct Delivery *ctx) {
     }
 }
 
+static void fetch_sources(struct Delivery *ctx) {
+    // Clone all test block repositories up front. The test and wheel build phases share the checkouts.
+    if (ctx->tests && ctx->tests->num_used) {
+        msg(STASIS_MSG_L1, "Fetching source repositories\n");
+        if (delivery_fetch_sources(ctx)) {
+            COE_CHECK_ABORT(true, "Unable to fetch source repositories");
+        }
+    }
+}
+
 static void run_tests(struct Delivery *ctx) {
     // Execute configuration-defined tests
     if (globals.enable_testing) {
@@ -379,6 +390,10 @@ static void build_wheel_packages(struct Delivery *ctx) {
         if (!((ctx->conda.wheels_packages = delivery_build_wheels(ctx)))) {
             exit(1);
         }
+        msg(STASIS_MSG_L3, "Verifying wheel contents\n");
+        if (delivery_verify_wheel_artifacts(ctx)) {
+            exit(1);
+        }
         if (delivery_index_wheel_artifacts(ctx)) {
             exit(1);
         }
@@ -592,6 +607,75 @@ int main(int argc, char *argv[]) {
                     exit(1);
                 }
                 break;
+            case OPT_FETCH_JOBS:
+                globals.fetch_jobs = strtol(optarg, NULL, 10);
+                if (globals.fetch_jobs < 1) {
+                    globals.fetch_jobs = 1;
+                }
+                break;
+            case OPT_COPY_JOBS:
+                globals.copy_jobs = strtol(optarg, NULL, 10);
+                if (globals.copy_jobs < 1) {
+                    globals.copy_jobs = 1;
+                }
+                break;
+            case OPT_DELETE_JOBS:
+                globals.delete_jobs = strtol(optarg, NULL, 10);
+                if (globals.delete_jobs < 1) {
+                    globals.delete_jobs = 1;
+                }
+                break;
+            case OPT_SCAN_JOBS:
+                globals.scan_jobs = strtol(optarg, NULL, 10);
+                if (globals.scan_jobs < 1) {
+                    globals.scan_jobs = 1;
+                }
+                break;
+            case OPT_GIT_CACHE_DIR:
+                guard_free(globals.git_cache_dir);
+                globals.git_cache_dir = expandpath(optarg);
+                if (!globals.git_cache_dir) {
+                    fprintf(stderr, "Invalid git cache directory: %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            case OPT_GIT_CACHE_MAX:
+                globals.git_cache_max_size = strtoul(optarg, NULL, 10);
+                break;
+            case OPT_GIT_CLONE_MODE:
+                globals.git_clone_mode = git_clone_mode_from_str(optarg);
+                if (globals.git_clone_mode < 0) {
+                    fprintf(stderr, "Invalid clone mode: %s\n", optarg);
+                    fprintf(stderr, "Use 'full', 'blobless', or 'shallow'\n");
+                    exit(1);
+                }
+                break;
+            case OPT_NO_GIT_CACHE:
+                globals.enable_git_cache = false;
+                break;
+            case OPT_INDEX_CACHE_DIR:
+                guard_free(globals.index_cache_dir);
+                globals.index_cache_dir = expandpath(optarg);
+                if (!globals.index_cache_dir) {
+                    fprintf(stderr, "Invalid index cache directory: %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            case OPT_INDEX_CACHE_TTL:
+                globals.index_cache_ttl = strtol(optarg, NULL, 10);
+                if (globals.index_cache_ttl < 0) {
+                    globals.index_cache_ttl = 0;
+                }
+                break;
+            case OPT_INDEX_CACHE_STALE:
+                globals.index_cache_stale = true;
+                break;
+            case OPT_NO_INDEX_CACHE:
+                globals.enable_index_cache = false;
+                break;
+            case OPT_KEEP_TASK_LOGS:
+                globals.enable_task_log_archive = true;
+                break;
             case OPT_POOL_STATUS_INTERVAL:
                 globals.pool_status_interval = (int) strtol(optarg, NULL, 10);
                 if (globals.pool_status_interval < 1) {
@@ -661,6 +745,13 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    if (globals.enable_git_cache && !globals.git_cache_dir) {
+        globals.git_cache_dir = expandpath("~/.stasis/git-cache");
+    }
+    if (globals.enable_index_cache && !globals.index_cache_dir) {
+        globals.index_cache_dir = expandpath("~/.stasis/index-cache");
+    }
+
     if (!delivery_input) {
         fprintf(stderr, "error: a DELIVERY_FILE is required\n");
         usage(path_basename(argv[0]));
@@ -720,6 +811,7 @@ int main(int argc, char *argv[]) {
     configure_deferred_packages(&ctx);
 
     show_overview(&ctx);
+    fetch_sources(&ctx);
     run_tests(&ctx);
     build_conda_recipes(&ctx);
     build_wheel_packages(&ctx);
@@ -727,7 +819,11 @@ int main(int argc, char *argv[]) {
     transfer_artifacts(&ctx);
 
     msg(STASIS_MSG_L1, "Cleaning up\n");
+    if (rmtree_wait()) {
+        msg(STASIS_MSG_WARN | STASIS_MSG_L2, "Some directories could not be removed\n");
+    }
     delivery_free(&ctx);
+    wheelinfo_cache_clear();
     globals_free();
     tpl_free();
 
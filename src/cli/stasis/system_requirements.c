@@ -22,7 +22,6 @@ void check_system_env_requirements() {
 
 void check_system_requirements(struct Delivery *ctx) {
     const char *tools_required[] = {
-        "rsync",
         NULL,
     };
 
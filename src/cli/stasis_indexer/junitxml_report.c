@@ -40,8 +40,8 @@ static int write_report_output(struct Delivery *ctx, FILE *destfp, const char *x
 
         char short_name[PATH_MAX] = {0};
         strncpy(short_name, bname, sizeof(short_name) - 1);
-        replace_text(short_name, short_name_pattern, "", 0);
-        replace_text(short_name, "results-", "", 0);
+        replace_text_n(short_name, sizeof(short_name), short_name_pattern, "", 0);
+        replace_text_n(short_name, sizeof(short_name), "results-", "", 0);
         guard_free(short_name_pattern);
 
         fprintf(destfp, "|%s ([log](%s.md)) ([xml](%s.xml))|%0.4f|%d|%d|%d|%d|%d|\n",
@@ -8,10 +8,15 @@
 #include "delivery.h"
 
 int indexer_combine_rootdirs(const char *dest, char **rootdirs, const size_t rootdirs_total) {
-    char cmd[PATH_MAX] = {0};
     char destdir_bare[PATH_MAX] = {0};
     char destdir_with_output[PATH_MAX] = {0};
     char *destdir = destdir_bare;
+    char **srcdirs = calloc(rootdirs_total + 1, sizeof(*srcdirs));
+    size_t srcdirs_total = 0;
+
+    if (!srcdirs) {
+        return -1;
+    }
 
     strncpy(destdir_bare, dest, sizeof(destdir_bare) - 1);
     strncpy(destdir_with_output, dest, sizeof(destdir_with_output) - 1);
@@ -21,7 +26,6 @@ int indexer_combine_rootdirs(const char *dest, char **rootdirs, const size_t roo
         destdir = destdir_with_output;
     }
 
-    snprintf(cmd, sizeof(cmd), "rsync -ah%s --delete --exclude 'tools/' --exclude 'tmp/' --exclude 'build/' ", globals.verbose ? "v" : "q");
     for (size_t i = 0; i < rootdirs_total; i++) {
         char srcdir_bare[PATH_MAX] = {0};
         char srcdir_with_output[PATH_MAX] = {0};
@@ -38,18 +42,27 @@ int indexer_combine_rootdirs(const char *dest, char **rootdirs, const size_t roo
         if (!access(srcdir_with_output, F_OK)) {
             srcdir = srcdir_with_output;
         }
-        snprintf(cmd + strlen(cmd), sizeof(cmd) - strlen(cmd), "'%s'/ ", srcdir);
+        srcdirs[srcdirs_total++] = strdup(srcdir);
     }
-    snprintf(cmd + strlen(cmd), sizeof(cmd) - strlen(cmd), " %s/", destdir);
 
-    if (globals.verbose) {
-        puts(cmd);
-    }
+    struct TreeSyncOptions opts = {
+        .jobs = globals.copy_jobs,
+        .delete = true,
+        .verbose = globals.verbose,
+        .exclude = strlist_init(),
+    };
+    struct TreeSyncStats stats = {0};
+    strlist_append(&opts.exclude, "tools/");
+    strlist_append(&opts.exclude, "tmp/");
+    strlist_append(&opts.exclude, "build/");
 
-    if (system(cmd)) {
-        return -1;
+    const int status = tree_sync(srcdirs, destdir, &opts, &stats);
+    if (globals.verbose) {
+        tree_sync_show_summary(&stats);
     }
-    return 0;
+    guard_strlist_free(&opts.exclude);
+    guard_array_n_free(srcdirs, srcdirs_total);
+    return status ? -1 : 0;
 }
 
 int indexer_wheels(struct Delivery *ctx) {
@@ -415,23 +428,30 @@ int main(const int argc, char *argv[]) {
     }
 
     msg(STASIS_MSG_L1, "Copying indexed delivery to '%s'\n", destdir);
-    char cmd[PATH_MAX] = {0};
-    snprintf(cmd, sizeof(cmd), "rsync -ah%s --delete --exclude 'tmp/' --exclude 'tools/' '%s/' '%s/'", globals.verbose ? "v" : "q", workdir, destdir);
+    struct TreeSyncOptions sync_opts = {
+        .jobs = globals.copy_jobs,
+        .delete = true,
+        .verbose = globals.verbose,
+        .exclude = strlist_init(),
+    };
+    struct TreeSyncStats sync_stats = {0};
+    strlist_append(&sync_opts.exclude, "tmp/");
+    strlist_append(&sync_opts.exclude, "tools/");
+
+    const int sync_status = tree_sync((char *[]) {workdir, NULL}, destdir, &sync_opts, &sync_stats);
+    guard_strlist_free(&sync_opts.exclude);
     guard_free(destdir);
 
-    if (globals.verbose) {
-        puts(cmd);
-    }
-
-    if (system(cmd)) {
+    if (sync_status) {
         SYSERROR("%s", "Copy operation failed");
         rmtree(workdir);
         exit(1);
     }
+    tree_sync_show_summary(&sync_stats);
 
     msg(STASIS_MSG_L1, "Removing work directory: %s\n", workdir);
-    if (rmtree(workdir)) {
-        SYSERROR("Failed to remove work directory: %s", strerror(errno));
+    if (rmtree_parallel(workdir, globals.delete_jobs, NULL)) {
+        SYSERROR("Failed to remove work directory: %s", workdir);
     }
 
     guard_free(destdir);
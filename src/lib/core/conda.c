@@ -3,6 +3,8 @@
 //
 
 #include "conda.h"
+#include "multiprocessing.h"
+#include "indexcache.h"
 
 int micromamba(const struct MicromambaInfo *info, char *command, ...) {
     struct utsname sys;
@@ -144,20 +146,113 @@ const char *pkg_index_provides_strerror(int code) {
     return PKG_ERROR_STR[code];
 }
 
+/**
+ * Generate the package manager command used by pkg_index_provides()
+ *
+ * @param mode PKG_USE_PIP or PKG_USE_CONDA
+ * @param index a file system path or url pointing to a simple index or conda channel
+ * @param spec a package specification
+ * @param cmd destination buffer
+ * @param maxlen size of destination buffer
+ * @return 0 on success
+ * @return PKG_INDEX_PROVIDES_E_INTERNAL_MODE_UNKNOWN on error
+ */
+static int pkg_index_provides_cmd(int mode, const char *index, const char *spec, char *cmd, size_t maxlen) {
+    char spec_local[255] = {0};
+
+    // Normalize the local spec string
+    strncpy(spec_local, spec, sizeof(spec_local) - 1);
+    tolower_s(spec_local);
+    lstrip(spec_local);
+    strip(spec_local);
+
+    memset(cmd, 0, maxlen);
+    if (mode == PKG_USE_PIP) {
+        // Do an installation in dry-run mode to see if the package exists in the given index.
+        // The --force argument ignores local installation and cache, and actually polls the remote index(es)
+        strncpy(cmd, "python -m pip install --force --dry-run --no-cache --no-deps ", maxlen - 1);
+        if (index) {
+            snprintf(cmd + strlen(cmd), maxlen - strlen(cmd), "--index-url='%s' ", index);
+        }
+        snprintf(cmd + strlen(cmd), maxlen - strlen(cmd), "'%s' ", spec_local);
+    } else if (mode == PKG_USE_CONDA) {
+        strncpy(cmd, "mamba search ", maxlen - 1);
+        if (index) {
+            snprintf(cmd + strlen(cmd), maxlen - strlen(cmd), "--channel '%s' ", index);
+        }
+        snprintf(cmd + strlen(cmd), maxlen - strlen(cmd), "'%s' ", spec_local);
+    } else {
+        return PKG_INDEX_PROVIDES_E_INTERNAL_MODE_UNKNOWN;
+    }
+    return 0;
+}
+
+/**
+ * Convert a package manager's exit status to a pkg_index_provides() result
+ *
+ * @param status exit code
+ * @param signaled signal received by the package manager (0 if none)
+ * @return PKG_FOUND, PKG_NOT_FOUND, or PKG_INDEX_PROVIDES_E_MANAGER_{ERROR}
+ */
+static int pkg_index_provides_result(int status, int signaled) {
+    if (signaled) {
+        // This gets its own return value because if the external program
+        // received a signal, even its status is zero, it's not reliable
+        return PKG_INDEX_PROVIDES_E_MANAGER_SIGNALED;
+    }
+
+    if (status > 1) {
+        // Pip and conda both return 2 on argument parsing errors
+        return PKG_INDEX_PROVIDES_E_MANAGER_RUNTIME;
+    } else if (status == 1) {
+        // Pip and conda both return 1 when a package is not found.
+        // Unfortunately this applies to botched version specs, too.
+        return PKG_NOT_FOUND;
+    }
+    return PKG_FOUND;
+}
+
+/**
+ * Record a package manager's answer in the index cache
+ *
+ * When the package manager failed, a stale answer is returned instead (if allowed)
+ *
+ * @param mode PKG_USE_PIP or PKG_USE_CONDA
+ * @param index a file system path or url pointing to a simple index or conda channel
+ * @param spec a package specification
+ * @param result pkg_index_provides() result
+ * @return pkg_index_provides() result
+ */
+static int pkg_index_provides_cache_update(int mode, const char *index, const char *spec, int result) {
+    if (PKG_INDEX_PROVIDES_FAILED(result)) {
+        int cached = 0;
+        if (!index_cache_lookup_stale(mode, index, spec, &cached)) {
+            fprintf(stderr, "Using stale package index result for '%s': %s\n", spec, pkg_index_provides_strerror(result));
+            return cached;
+        }
+        return result;
+    }
+    index_cache_store(mode, index, spec, result);
+    return result;
+}
+
 int pkg_index_provides(int mode, const char *index, const char *spec) {
     char cmd[PATH_MAX] = {0};
-    char spec_local[255] = {0};
+    int result = 0;
 
     if (isempty((char *) spec)) {
         // NULL or zero-length; no package spec means there's nothing to do.
         return PKG_NOT_FOUND;
     }
 
-    // Normalize the local spec string
-    strncpy(spec_local, spec, sizeof(spec_local) - 1);
-    tolower_s(spec_local);
-    lstrip(spec_local);
-    strip(spec_local);
+    if (!index_cache_lookup(mode, index, spec, &result)) {
+        return result;
+    }
+
+    const int cmd_status = pkg_index_provides_cmd(mode, index, spec, cmd, sizeof(cmd));
+    if (cmd_status) {
+        return cmd_status;
+    }
 
     char logfile[] = "/tmp/STASIS-package_exists.XXXXXX";
     int logfd = mkstemp(logfile);
@@ -172,24 +267,6 @@ int pkg_index_provides(int mode, const char *index, const char *spec) {
     proc.redirect_stderr = 1;
     strncpy(proc.f_stdout, logfile, sizeof(proc.f_stdout) - 1);
 
-    if (mode == PKG_USE_PIP) {
-        // Do an installation in dry-run mode to see if the package exists in the given index.
-        // The --force argument ignores local installation and cache, and actually polls the remote index(es)
-        strncpy(cmd, "python -m pip install --force --dry-run --no-cache --no-deps ", sizeof(cmd) - 1);
-        if (index) {
-            snprintf(cmd + strlen(cmd), sizeof(cmd) - strlen(cmd), "--index-url='%s' ", index);
-        }
-        snprintf(cmd + strlen(cmd), sizeof(cmd) - strlen(cmd), "'%s' ", spec_local);
-    } else if (mode == PKG_USE_CONDA) {
-        strncpy(cmd, "mamba search ", sizeof(cmd) - 1);
-        if (index) {
-            snprintf(cmd + strlen(cmd), sizeof(cmd) - strlen(cmd), "--channel '%s' ", index);
-        }
-        snprintf(cmd + strlen(cmd), sizeof(cmd) - strlen(cmd), "'%s' ", spec_local);
-    } else {
-        return PKG_INDEX_PROVIDES_E_INTERNAL_MODE_UNKNOWN;
-    }
-
     // Print errors only when shell() itself throws one
     // If some day we want to see the errors thrown by pip too, use this
     // condition instead:  (status != 0)
@@ -213,23 +290,95 @@ int pkg_index_provides(int mode, const char *index, const char *spec) {
     remove(logfile);
 
     if (WTERMSIG(proc.returncode)) {
-        // This gets its own return value because if the external program
-        // received a signal, even its status is zero, it's not reliable
-        return PKG_INDEX_PROVIDES_E_MANAGER_SIGNALED;
+        result = pkg_index_provides_result(0, WTERMSIG(proc.returncode));
+    } else if (status < 0) {
+        result = PKG_INDEX_PROVIDES_E_MANAGER_EXEC;
+    } else {
+        result = pkg_index_provides_result(WEXITSTATUS(proc.returncode), 0);
+    }
+    return pkg_index_provides_cache_update(mode, index, spec, result);
+}
+
+int pkg_index_provides_many(int mode, const char *index, struct StrList *specs, int *result, size_t jobs) {
+    const size_t num_specs = strlist_count(specs);
+    if (!num_specs) {
+        return 0;
     }
 
-    if (status < 0) {
-        return PKG_INDEX_PROVIDES_E_MANAGER_EXEC;
-    } else if (WEXITSTATUS(proc.returncode) > 1) {
-        // Pip and conda both return 2 on argument parsing errors
-        return PKG_INDEX_PROVIDES_E_MANAGER_RUNTIME;
-    } else if (WEXITSTATUS(proc.returncode) == 1) {
-        // Pip and conda both return 1 when a package is not found.
-        // Unfortunately this applies to botched version specs, too.
-        return PKG_NOT_FOUND;
-    } else {
-        return PKG_FOUND;
+    struct MultiProcessingPool *pool = mp_pool_init("index", globals.tmpdir ? globals.tmpdir : "/tmp");
+    if (!pool) {
+        SYSERROR("%s", "Unable to initialize package index pool");
+        return -1;
+    }
+    pool->status_interval = globals.pool_status_interval;
+
+    struct MultiProcessingTask **task = calloc(num_specs, sizeof(*task));
+    if (!task) {
+        SYSERROR("Unable to allocate %zu package index tasks", num_specs);
+        mp_pool_free(&pool);
+        return -1;
     }
+
+    // One package manager process per spec. They spend most of their time waiting on the index.
+    for (size_t i = 0; i < num_specs; i++) {
+        char cmd[PATH_MAX] = {0};
+        char *spec = strlist_item(specs, i);
+
+        result[i] = PKG_NOT_FOUND;
+        if (isempty(spec)) {
+            // NULL or zero-length; no package spec means there's nothing to do.
+            continue;
+        }
+
+        if (!index_cache_lookup(mode, index, spec, &result[i])) {
+            continue;
+        }
+
+        const int cmd_status = pkg_index_provides_cmd(mode, index, spec, cmd, sizeof(cmd));
+        if (cmd_status) {
+            result[i] = cmd_status;
+            continue;
+        }
+        // Only the exit status matters
+        strncat(cmd, ">/dev/null 2>&1", sizeof(cmd) - strlen(cmd) - 1);
+
+        task[i] = mp_pool_task(pool, spec, NULL, cmd);
+        if (!task[i]) {
+            result[i] = PKG_INDEX_PROVIDES_E_MANAGER_EXEC;
+        }
+    }
+
+    if (pool->num_used) {
+        // A non-zero return value is expected here. Packages that do not exist are "failed" tasks.
+        if (mp_pool_join(pool, jobs, 0) < 0) {
+            SYSERROR("%s", "Package index pool encountered an error");
+            // Tasks that are still running were never reaped. Their status is meaningless.
+            for (size_t i = 0; i < num_specs; i++) {
+                if (task[i] && task[i]->pid != MP_POOL_PID_UNUSED) {
+                    result[i] = PKG_INDEX_PROVIDES_E_MANAGER_EXEC;
+                    task[i] = NULL;
+                }
+            }
+            mp_pool_kill(pool, SIGKILL);
+        }
+    }
+
+    for (size_t i = 0; i < num_specs; i++) {
+        if (!task[i]) {
+            continue;
+        }
+        if (task[i]->status == MP_POOL_TASK_STATUS_INITIAL && task[i]->pid == MP_POOL_PID_UNUSED) {
+            // never executed
+            result[i] = PKG_INDEX_PROVIDES_E_MANAGER_EXEC;
+        } else {
+            result[i] = pkg_index_provides_result(task[i]->status, task[i]->signaled_by);
+        }
+        result[i] = pkg_index_provides_cache_update(mode, index, strlist_item(specs, i), result[i]);
+    }
+
+    guard_free(task);
+    mp_pool_free(&pool);
+    return 0;
 }
 
 int conda_exec(const char *args) {
@@ -1,4 +1,162 @@
 #include "copy.h"
+#if defined(STASIS_OS_LINUX)
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#endif
+
+/**
+ * Copy data between regular files, in the kernel if possible
+ *
+ * Tries a reflink (FICLONE), then copy_file_range(), then sendfile(). Each
+ * method continues from the file offsets left by the one before it. The
+ * buffered loop is used for whatever remains.
+ *
+ * @param in source file descriptor (at offset 0)
+ * @param out destination file descriptor (empty, at offset 0)
+ * @param size number of bytes to copy
+ * @return number of bytes copied, or -1 on error
+ */
+static ssize_t copy_fd(int in, int out, off_t size) {
+    off_t done = 0;
+    ssize_t bytes;
+
+#if defined(STASIS_OS_LINUX)
+#if defined(FICLONE)
+    // Shares extents on copy-on-write file systems (btrfs, xfs, ...). No data is moved.
+    if (ioctl(out, FICLONE, in) == 0) {
+        SYSDEBUG("%s", "Cloned (reflink)");
+        return size;
+    }
+#endif
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+    while (done < size && (bytes = copy_file_range(in, NULL, out, NULL, (size_t) (size - done), 0)) > 0) {
+        done += bytes;
+    }
+    if (done == size) {
+        SYSDEBUG("%s", "Copied (copy_file_range)");
+        return done;
+    }
+#endif
+    while (done < size && (bytes = sendfile(out, in, NULL, (size_t) (size - done))) > 0) {
+        done += bytes;
+    }
+    if (done == size) {
+        SYSDEBUG("%s", "Copied (sendfile)");
+        return done;
+    }
+#endif
+
+    const size_t buf_size = STASIS_BUFSIZ * 16;
+    char *buf = malloc(buf_size);
+    if (!buf) {
+        return -1;
+    }
+    while ((bytes = read(in, buf, buf_size)) != 0) {
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            guard_free(buf);
+            return -1;
+        }
+        for (ssize_t off = 0; off < bytes;) {
+            const ssize_t written = write(out, buf + off, (size_t) (bytes - off));
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                guard_free(buf);
+                return -1;
+            }
+            off += written;
+        }
+        done += bytes;
+    }
+    guard_free(buf);
+    SYSDEBUG("%s", "Copied (read/write)");
+    return done;
+}
+
+/**
+ * Copy a regular file
+ */
+static int copy_regular(const char *src, const char *dest, const struct stat *src_stat, unsigned int op) {
+    char tempfile[PATH_MAX] = {0};
+    const char *target = dest;
+    int out;
+
+    SYSDEBUG("%s", "Opening source file for reading");
+    const int in = open(src, O_RDONLY);
+    if (in < 0) {
+        perror(src);
+        return -1;
+    }
+
+    SYSDEBUG("%s", "Opening destination file for writing");
+    if (op & CT_ATOMIC) {
+        // Readers of dest see either the old file or the complete copy
+        if (snprintf(tempfile, sizeof(tempfile), "%s.XXXXXX", dest) >= (int) sizeof(tempfile)) {
+            errno = ENAMETOOLONG;
+            perror(dest);
+            close(in);
+            return -1;
+        }
+        out = mkstemp(tempfile);
+        target = tempfile;
+    } else {
+        out = open(dest, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    }
+    if (out < 0) {
+        perror(target);
+        close(in);
+        return -1;
+    }
+
+    int status = 0;
+    const ssize_t bytes_written = copy_fd(in, out, src_stat->st_size);
+    close(in);
+    if (bytes_written < 0) {
+        perror(target);
+        status = -1;
+    } else if (bytes_written != src_stat->st_size) {
+        fprintf(stderr, "%s: SHORT WRITE (expected %zu bytes, but wrote %zu bytes)\n", target, (size_t) src_stat->st_size, (size_t) bytes_written);
+        status = -1;
+    }
+
+    if (!status) {
+        if (op & CT_OWNER && fchown(out, src_stat->st_uid, src_stat->st_gid) < 0) {
+            perror(target);
+        }
+        if (op & CT_PERM && fchmod(out, src_stat->st_mode) < 0) {
+            perror(target);
+        } else if (op & CT_ATOMIC && !(op & CT_PERM)) {
+            // mkstemp() creates files readable only by the owner. Use the same mode as open() would.
+            const mode_t mask = umask(0);
+            umask(mask);
+            fchmod(out, 0666 & ~mask);
+        }
+        if (op & CT_FSYNC && fsync(out) < 0) {
+            perror(target);
+            status = -1;
+        }
+    }
+    if (close(out) < 0) {
+        perror(target);
+        status = -1;
+    }
+
+    if (op & CT_ATOMIC) {
+        if (!status && rename(tempfile, dest) < 0) {
+            perror(dest);
+            status = -1;
+        }
+        if (status) {
+            unlink(tempfile);
+        }
+    }
+    return status;
+}
 
 int copy2(const char *src, const char *dest, unsigned int op) {
     struct stat src_stat, dnamest;
@@ -9,10 +167,6 @@ int copy2(const char *src, const char *dest, unsigned int op) {
         return -1;
     }
 
-    if (access(dest, F_OK) == 0) {
-        unlink(dest);
-    }
-
     char dname[1024] = {0};
     strncpy(dname, dest, sizeof(dname) - 1);
 
@@ -24,6 +178,11 @@ int copy2(const char *src, const char *dest, unsigned int op) {
     SYSDEBUG("Stat destination file: %s", dname);
     stat(dname, &dnamest);
 
+    const int hard_link = !(op & CT_NO_HARDLINK) && S_ISREG(src_stat.st_mode) && src_stat.st_nlink > 2 && src_stat.st_dev == dnamest.st_dev;
+    if (!(op & CT_ATOMIC && S_ISREG(src_stat.st_mode) && !hard_link) && access(dest, F_OK) == 0) {
+        unlink(dest);
+    }
+
     if (S_ISLNK(src_stat.st_mode)) {
         char lpath[1024] = {0};
         if (readlink(src, lpath, sizeof(lpath)) < 0) {
@@ -34,7 +193,7 @@ int copy2(const char *src, const char *dest, unsigned int op) {
             // silent
             return -1;
         }
-    } else if (S_ISREG(src_stat.st_mode) && src_stat.st_nlink > 2 && src_stat.st_dev == dnamest.st_dev) {
+    } else if (hard_link) {
         if (link(src, dest) < 0) {
             perror(src);
             return -1;
@@ -45,41 +204,9 @@ int copy2(const char *src, const char *dest, unsigned int op) {
             return -1;
         }
     } else if (S_ISREG(src_stat.st_mode)) {
-        char buf[STASIS_BUFSIZ] = {0};
-        size_t bytes_read;
-        SYSDEBUG("%s", "Opening source file for reading");
-        FILE *fp1 = fopen(src, "rb");
-        if (!fp1) {
-            perror(src);
-            return -1;
-        }
-
-        SYSDEBUG("%s", "Opening destination file for writing");
-        FILE *fp2 = fopen(dest, "w+b");
-        if (!fp2) {
-            perror(dest);
-            return -1;
-        }
-
-        size_t bytes_written = 0;
-        while ((bytes_read = fread(buf, sizeof(char), sizeof(buf), fp1)) != 0) {
-            bytes_written += fwrite(buf, sizeof(char), bytes_read, fp2);
-        }
-        fclose(fp1);
-        fclose(fp2);
-
-        if (bytes_written != (size_t) src_stat.st_size) {
-            fprintf(stderr, "%s: SHORT WRITE (expected %zu bytes, but wrote %zu bytes)\n", dest, src_stat.st_size, bytes_written);
+        if (copy_regular(src, dest, &src_stat, op)) {
             return -1;
         }
-
-        if (op & CT_OWNER && chown(dest, src_stat.st_uid, src_stat.st_gid) < 0) {
-            perror(dest);
-        }
-
-        if (op & CT_PERM && chmod(dest, src_stat.st_mode) < 0) {
-            perror(dest);
-        }
     } else {
         errno = EOPNOTSUPP;
         return -1;
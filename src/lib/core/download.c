@@ -2,6 +2,9 @@
 // Created by jhunk on 10/5/23.
 //
 
+#include <ctype.h>
+#include <errno.h>
+#include <strings.h>
 #include "download.h"
 #include "core.h"
 
@@ -95,4 +98,120 @@ long download(char *url, const char *filename, char **errmsg) {
     curl_easy_cleanup(c);
     curl_global_cleanup();
     return http_code;
-}
\ No newline at end of file
+}
+
+static size_t download_header_reader(char *buffer, size_t size, size_t nitems, void *userdata) {
+    struct DownloadValidator *validator = userdata;
+    const size_t len = size * nitems;
+    struct {
+        const char *name;
+        char *dest;
+        size_t maxlen;
+    } fields[] = {
+        {"etag:", validator->etag, sizeof(validator->etag)},
+        {"last-modified:", validator->last_modified, sizeof(validator->last_modified)},
+    };
+
+    for (size_t i = 0; i < sizeof(fields) / sizeof(*fields); i++) {
+        const size_t name_len = strlen(fields[i].name);
+        if (len <= name_len || strncasecmp(buffer, fields[i].name, name_len) != 0) {
+            continue;
+        }
+        const char *value = buffer + name_len;
+        size_t value_len = len - name_len;
+        while (value_len && isspace((unsigned char) *value)) {
+            value++;
+            value_len--;
+        }
+        while (value_len && isspace((unsigned char) value[value_len - 1])) {
+            value_len--;
+        }
+        snprintf(fields[i].dest, fields[i].maxlen, "%.*s", (int) value_len, value);
+    }
+    return len;
+}
+
+long download_revalidate(const char *url, const char *filename, struct DownloadValidator *validator, char **errmsg) {
+    long http_code = -1;
+    char user_agent[20];
+    char tempfile[PATH_MAX];
+    char header[sizeof(validator->last_modified) + 32];
+    struct curl_slist *headers = NULL;
+    struct DownloadValidator received = {0};
+
+    snprintf(user_agent, sizeof(user_agent), "stasis/%s", VERSION);
+    // The response is written next to the destination so it can be renamed into place
+    snprintf(tempfile, sizeof(tempfile), "%s.partial", filename);
+
+    long timeout = 30L;
+    const char *timeout_str = getenv("STASIS_DOWNLOAD_TIMEOUT");
+    if (timeout_str) {
+        timeout = strtol(timeout_str, NULL, 10);
+        if (timeout <= 0L) {
+            timeout = 1L;
+        }
+    }
+
+    if (*validator->etag) {
+        snprintf(header, sizeof(header), "If-None-Match: %s", validator->etag);
+        headers = curl_slist_append(headers, header);
+    }
+    if (*validator->last_modified) {
+        snprintf(header, sizeof(header), "If-Modified-Since: %s", validator->last_modified);
+        headers = curl_slist_append(headers, header);
+    }
+
+    FILE *fp = fopen(tempfile, "wb");
+    if (!fp) {
+        curl_slist_free_all(headers);
+        return -1;
+    }
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    CURL *c = curl_easy_init();
+    curl_easy_setopt(c, CURLOPT_URL, url);
+    curl_easy_setopt(c, CURLOPT_WRITEFUNCTION, download_writer);
+    curl_easy_setopt(c, CURLOPT_WRITEDATA, fp);
+    curl_easy_setopt(c, CURLOPT_HEADERFUNCTION, download_header_reader);
+    curl_easy_setopt(c, CURLOPT_HEADERDATA, &received);
+    curl_easy_setopt(c, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(c, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(c, CURLOPT_USERAGENT, user_agent);
+    curl_easy_setopt(c, CURLOPT_CONNECTTIMEOUT, timeout);
+
+    SYSDEBUG("curl_easy_perform(): \n\turl=%s\n\tfilename=%s\n\tetag=%s\n\tlast-modified=%s",
+             url, filename, validator->etag, validator->last_modified);
+    CURLcode curl_code = curl_easy_perform(c);
+    SYSDEBUG("curl status code: %d", curl_code);
+    fclose(fp);
+
+    if (curl_code != CURLE_OK) {
+        const size_t errmsg_maxlen = 256;
+        if (!*errmsg) {
+            *errmsg = calloc(errmsg_maxlen, sizeof(char));
+        }
+        if (*errmsg) {
+            snprintf(*errmsg, errmsg_maxlen, "%s", curl_easy_strerror(curl_code));
+        }
+    } else {
+        curl_easy_getinfo(c, CURLINFO_RESPONSE_CODE, &http_code);
+        SYSDEBUG("HTTP code: %li", http_code);
+    }
+
+    if (http_code == 200) {
+        if (rename(tempfile, filename)) {
+            SYSERROR("Unable to rename %s to %s: %s", tempfile, filename, strerror(errno));
+            remove(tempfile);
+            http_code = -1;
+        } else {
+            *validator = received;
+        }
+    } else {
+        remove(tempfile);
+    }
+
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(c);
+    curl_global_cleanup();
+    return http_code;
+}
@@ -7,6 +7,136 @@
 
 //extern char **__environ;
 
+static size_t runtime_hash(const char *key, size_t len) {
+    // FNV-1a
+    size_t hash = (size_t) 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char) key[i];
+        hash *= (size_t) 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Find the hash table slot of a key
+ * @return slot holding the key's record position, or the empty slot where it belongs
+ */
+static size_t runtime_slot(const RuntimeEnv *env, const char *key, size_t len) {
+    const size_t mask = env->table_size - 1;
+    size_t slot = runtime_hash(key, len) & mask;
+    while (env->table[slot] >= 0) {
+        const size_t pos = (size_t) env->table[slot];
+        if (env->key_len[pos] == len && !strncmp(env->data[pos], key, len)) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Add a record to the hash table
+ *
+ * The first record of a duplicated key wins, like getenv()
+ */
+static void runtime_index(RuntimeEnv *env, size_t pos) {
+    const size_t slot = runtime_slot(env, env->data[pos], env->key_len[pos]);
+    if (env->table[slot] < 0) {
+        env->table[slot] = (ssize_t) pos;
+    }
+}
+
+static int runtime_table_resize(RuntimeEnv *env, size_t table_size) {
+    ssize_t *table = malloc(table_size * sizeof(*table));
+    if (!table) {
+        return -1;
+    }
+    for (size_t i = 0; i < table_size; i++) {
+        table[i] = -1;
+    }
+    guard_free(env->table);
+    env->table = table;
+    env->table_size = table_size;
+    for (size_t pos = 0; pos < env->num_inuse; pos++) {
+        runtime_index(env, pos);
+    }
+    return 0;
+}
+
+/**
+ * Make room for `count` records (plus the terminator)
+ * @return 0 on success, -1 on error
+ */
+static int runtime_reserve(RuntimeEnv *env, size_t count) {
+    if (count + 1 > env->num_alloc) {
+        size_t num_alloc = env->num_alloc ? env->num_alloc : 16;
+        while (count + 1 > num_alloc) {
+            num_alloc *= 2;
+        }
+        char **data = realloc(env->data, num_alloc * sizeof(*data));
+        if (!data) {
+            return -1;
+        }
+        env->data = data;
+        size_t *key_len = realloc(env->key_len, num_alloc * sizeof(*key_len));
+        if (!key_len) {
+            return -1;
+        }
+        env->key_len = key_len;
+        bool *changed = realloc(env->changed, num_alloc * sizeof(*changed));
+        if (!changed) {
+            return -1;
+        }
+        env->changed = changed;
+        memset(&env->data[env->num_inuse], 0, (num_alloc - env->num_inuse) * sizeof(*env->data));
+        env->num_alloc = num_alloc;
+    }
+
+    // Keep the load factor at or below 50%
+    if (count * 2 > env->table_size) {
+        size_t table_size = env->table_size ? env->table_size : 64;
+        while (count * 2 > table_size) {
+            table_size *= 2;
+        }
+        if (runtime_table_resize(env, table_size)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Append a `KEY=VALUE` record
+ * @param record string to take ownership of
+ * @return position of record, or -1 on error
+ */
+static ssize_t runtime_append_owned(RuntimeEnv *env, char *record) {
+    if (runtime_reserve(env, env->num_inuse + 1)) {
+        return -1;
+    }
+    const size_t pos = env->num_inuse++;
+    env->data[pos] = record;
+    env->data[env->num_inuse] = NULL;
+    env->key_len[pos] = strcspn(record, "=");
+    env->changed[pos] = false;
+    runtime_index(env, pos);
+    return (ssize_t) pos;
+}
+
+/**
+ * Get a pointer to the value of a record
+ * @return value, or NULL if `key` is not present
+ */
+static const char *runtime_value(RuntimeEnv *env, const char *key) {
+    const ssize_t pos = runtime_contains(env, key);
+    if (pos < 0) {
+        return NULL;
+    }
+    const char *record = env->data[pos];
+    const size_t len = env->key_len[pos];
+    return record[len] == '=' ? &record[len + 1] : &record[len];
+}
+
 /**
  * Print a shell-specific listing of environment variables to `stdout`
  *
@@ -91,32 +221,24 @@ void runtime_export(RuntimeEnv *env, char **keys) {
         }
     }
 
-    for (size_t i = 0; i < strlist_count(env); i++) {
+    for (size_t i = 0; i < env->num_inuse; i++) {
         char output[STASIS_BUFSIZ] = {0};
-        char **pair = split(strlist_item(env, i), "=", 0);
-        char *key = pair[0];
-        char *value = NULL;
-
-        // We split a potentially large string by "=" so:
-        // Recombine elements pair[1..N] into a single string by "="
-        if (pair[1] != NULL) {
-            value = join(&pair[1], "=");
-        }
+        const char *record = env->data[i];
+        const int key_len = (int) env->key_len[i];
+        const char *value = record[key_len] == '=' ? &record[key_len + 1] : "";
 
         if (keys != NULL) {
             for (size_t j = 0; keys[j] != NULL; j++) {
-                if (strcmp(keys[j], key) == 0) {
-                    snprintf(output, sizeof(output), "%s %s=\"%s\"", export_command, key, value ? value : "");
+                if (strlen(keys[j]) == (size_t) key_len && strncmp(keys[j], record, key_len) == 0) {
+                    snprintf(output, sizeof(output), "%s %.*s=\"%s\"", export_command, key_len, record, value);
                     puts(output);
                 }
             }
         }
         else {
-            snprintf(output, sizeof(output), "%s %s=\"%s\"", export_command, key, value ? value : "");
+            snprintf(output, sizeof(output), "%s %.*s=\"%s\"", export_command, key_len, record, value);
             puts(output);
         }
-        guard_free(value);
-        guard_array_free(pair);
     }
 }
 
@@ -142,13 +264,24 @@ void runtime_export(RuntimeEnv *env, char **keys) {
  * @return `RuntimeEnv` structure
  */
 RuntimeEnv *runtime_copy(char **env) {
-    RuntimeEnv *rt = NULL;
     size_t env_count;
     for (env_count = 0; env[env_count] != NULL; env_count++) {}
 
-    rt = strlist_init();
+    RuntimeEnv *rt = calloc(1, sizeof(*rt));
+    if (!rt) {
+        return NULL;
+    }
+    if (runtime_reserve(rt, env_count)) {
+        runtime_free(rt);
+        return NULL;
+    }
     for (size_t i = 0; i < env_count; i++) {
-        strlist_append(&rt, env[i]);
+        char *record = strdup(env[i]);
+        if (!record || runtime_append_owned(rt, record) < 0) {
+            guard_free(record);
+            runtime_free(rt);
+            return NULL;
+        }
     }
     return rt;
 }
@@ -201,20 +334,10 @@ int runtime_replace(RuntimeEnv **dest, char **src) {
  * @return  -1=no, positive_value=yes
  */
 ssize_t runtime_contains(RuntimeEnv *env, const char *key) {
-    ssize_t result = -1;
-    for (ssize_t i = 0; i < (ssize_t) strlist_count(env); i++) {
-        char **pair = split(strlist_item(env, i), "=", 0);
-        if (pair == NULL) {
-            break;
-        }
-        if (strcmp(pair[0], key) == 0) {
-            result = i;
-            guard_array_free(pair);
-            break;
-        }
-        guard_array_free(pair);
+    if (!env || !key || !env->table_size) {
+        return -1;
     }
-    return result;
+    return env->table[runtime_slot(env, key, strlen(key))];
 }
 
 /**
@@ -240,21 +363,11 @@ ssize_t runtime_contains(RuntimeEnv *env, const char *key) {
  * @return success=string, failure=`NULL`
  */
 char *runtime_get(RuntimeEnv *env, const char *key) {
-    char *result = NULL;
-    ssize_t key_offset = runtime_contains(env, key);
-    if (key_offset != -1) {
-        char **pair = split(strlist_item(env, key_offset), "=", 0);
-        if (!pair) {
-            return NULL;
-        }
-        result = join(&pair[1], "=");
-        if (!result) {
-            guard_array_free(pair);
-            return NULL;
-        }
-        guard_array_free(pair);
+    const char *value = runtime_value(env, key);
+    if (!value) {
+        return NULL;
     }
-    return result;
+    return strdup(value);
 }
 
 /**
@@ -323,7 +436,7 @@ char *runtime_expand_var(RuntimeEnv *env, char *input) {
             if (input[i+1] == '{') {
                 i++;
             }
-            char *tmp = NULL;
+            const char *tmp = NULL;
             i++;
 
             // Construct environment variable name from input
@@ -339,12 +452,9 @@ char *runtime_expand_var(RuntimeEnv *env, char *input) {
             }
 
             if (env) {
-                tmp = runtime_get(env, var);
+                tmp = runtime_value(env, var);
             } else {
-                const char *v = getenv(var);
-                if (v) {
-                    tmp = strdup(v);
-                }
+                tmp = getenv(var);
             }
             if (tmp == NULL) {
                 // This mimics shell behavior in general.
@@ -355,8 +465,7 @@ char *runtime_expand_var(RuntimeEnv *env, char *input) {
                 continue;
             }
             // Append expanded environment variable to output
-            strncat(expanded, tmp, STASIS_BUFSIZ - 1);
-            guard_free(tmp);
+            strncat(expanded, tmp, STASIS_BUFSIZ - strlen(expanded) - 1);
         }
 
         // Nothing to do so append input to output
@@ -406,16 +515,10 @@ char *runtime_expand_var(RuntimeEnv *env, char *input) {
  * @param _value New environment variable value
  */
 void runtime_set(RuntimeEnv *env, const char *_key, char *_value) {
-    const char *sep = "=";
     if (_key == NULL) {
         return;
     }
     const ssize_t key_offset = runtime_contains(env, _key);
-    char *key = strdup(_key);
-    if (!key) {
-        SYSERROR("%s", "unable to allocate memory for key");
-        exit(1);
-    }
     char *value = runtime_expand_var(env, _value);
     if (!value) {
         SYSERROR("%s", "unable to allocate memory for value");
@@ -423,20 +526,61 @@ void runtime_set(RuntimeEnv *env, const char *_key, char *_value) {
     }
 
     lstrip(value);
-    char *now = join((char *[]) {key, value, NULL}, sep);
+    const size_t key_len = strlen(_key);
+    const size_t value_len = strlen(value);
+    char *now = malloc(key_len + value_len + 2);
     if (!now) {
-        SYSERROR("%s", "unable to allocate memory for join");
+        SYSERROR("%s", "unable to allocate memory for record");
         exit(1);
     }
+    memcpy(now, _key, key_len);
+    now[key_len] = '=';
+    memcpy(&now[key_len + 1], value, value_len + 1);
+    guard_free(value);
 
-    if (key_offset < 0) {
-        strlist_append(&env, now);
+    ssize_t pos = key_offset;
+    if (pos < 0) {
+        pos = runtime_append_owned(env, now);
+        if (pos < 0) {
+            SYSERROR("%s", "unable to allocate memory for runtime record");
+            exit(1);
+        }
     } else {
-        strlist_set(&env, key_offset, now);
+        guard_free(env->data[pos]);
+        env->data[pos] = now;
+    }
+    env->changed[pos] = true;
+}
+
+/**
+ * Push one record to the global `environ` array
+ */
+static void runtime_apply_record(RuntimeEnv *env, size_t pos) {
+    const char *record = env->data[pos];
+    const size_t len = env->key_len[pos];
+    const char *value = record[len] == '=' ? &record[len + 1] : "";
+    char key_local[255];
+    char *key = key_local;
+
+    if (len >= sizeof(key_local)) {
+        key = strndup(record, len);
+        if (!key) {
+            SYSERROR("%s", "unable to allocate memory for runtime_apply");
+            return;
+        }
+    } else {
+        memcpy(key_local, record, len);
+        key_local[len] = '\0';
+    }
+
+    // Values that are already set are left alone
+    const char *current = getenv(key);
+    if (!current || strcmp(current, value) != 0) {
+        setenv(key, value, 1);
+    }
+    if (key != key_local) {
+        guard_free(key);
     }
-    guard_free(now);
-    guard_free(key);
-    guard_free(value);
 }
 
 /**
@@ -444,14 +588,32 @@ void runtime_set(RuntimeEnv *env, const char *_key, char *_value) {
  * @param env `RuntimeEnv` structure
  */
 void runtime_apply(RuntimeEnv *env) {
-    for (size_t i = 0; i < strlist_count(env); i++) {
-        char **pair = split(strlist_item(env, i), "=", 1);
-        if (!pair) {
-            SYSERROR("%s", "unable to allocate memory for runtime_apply");
-            return;
+    if (!env) {
+        return;
+    }
+    for (size_t i = 0; i < env->num_inuse; i++) {
+        runtime_apply_record(env, i);
+        env->changed[i] = false;
+    }
+}
+
+/**
+ * Update the global `environ` array with the records modified by `runtime_set()`
+ *
+ * Records that were copied into `env` and never modified are skipped. Use this
+ * when `env` was copied from the global `environ` array.
+ *
+ * @param env `RuntimeEnv` structure
+ */
+void runtime_apply_changed(RuntimeEnv *env) {
+    if (!env) {
+        return;
+    }
+    for (size_t i = 0; i < env->num_inuse; i++) {
+        if (env->changed[i]) {
+            runtime_apply_record(env, i);
+            env->changed[i] = false;
         }
-        setenv(pair[0], pair[1], 1);
-        guard_array_free(pair);
     }
 }
 
@@ -463,5 +625,12 @@ void runtime_free(RuntimeEnv *env) {
     if (env == NULL) {
         return;
     }
-    strlist_free(&env);
+    for (size_t i = 0; i < env->num_inuse; i++) {
+        guard_free(env->data[i]);
+    }
+    guard_free(env->data);
+    guard_free(env->key_len);
+    guard_free(env->changed);
+    guard_free(env->table);
+    guard_free(env);
 }
@@ -0,0 +1,274 @@
+#include <ctype.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include "gitcache.h"
+
+static struct GitCacheStats git_cache_counters = {0};
+
+const struct GitCacheStats *git_cache_stats() {
+    return &git_cache_counters;
+}
+
+int git_clone_mode_from_str(const char *mode) {
+    if (!mode) {
+        return -1;
+    }
+    if (!strcmp(mode, "full")) {
+        return GIT_CLONE_MODE_FULL;
+    }
+    if (!strcmp(mode, "blobless")) {
+        return GIT_CLONE_MODE_BLOBLESS;
+    }
+    if (!strcmp(mode, "shallow")) {
+        return GIT_CLONE_MODE_SHALLOW;
+    }
+    return -1;
+}
+
+static uint64_t git_cache_hash(const char *data, size_t len) {
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char) data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+int git_cache_mirror_path(const char *root, const char *url, char *result, size_t maxlen) {
+    if (!root || !*root || !url || !*url) {
+        return -1;
+    }
+
+    size_t len = strlen(url);
+    while (len > 1 && url[len - 1] == '/') {
+        len--;
+    }
+    if (len > 4 && !strncmp(url + len - 4, ".git", 4)) {
+        len -= 4;
+    }
+
+    // Name the mirror after the repository so the cache is easy to inspect
+    const char *base = url + len;
+    while (base > url && base[-1] != '/' && base[-1] != ':') {
+        base--;
+    }
+    char name[100] = {0};
+    snprintf(name, sizeof(name), "%.*s", (int) (url + len - base), base);
+    for (char *ch = name; *ch; ch++) {
+        if (!isalnum((unsigned char) *ch) && !strchr("._-", *ch)) {
+            *ch = '_';
+        }
+    }
+
+    const int result_len = snprintf(result, maxlen, "%s/%s-%016llx.git", root, name, (unsigned long long) git_cache_hash(url, len));
+    if (result_len < 0 || (size_t) result_len >= maxlen) {
+        return -1;
+    }
+    return 0;
+}
+
+char *git_clone_script(const char *git, const char *url, const char *destdir, const char *gitref) {
+    char *script = NULL;
+    char mirror[PATH_MAX] = {0};
+    int script_len;
+
+    int use_cache = globals.enable_git_cache && globals.git_cache_dir && *globals.git_cache_dir;
+    if (use_cache) {
+        if (mkdirs(globals.git_cache_dir, 0755) || git_cache_mirror_path(globals.git_cache_dir, url, mirror, sizeof(mirror))) {
+            SYSDEBUG("git cache is unavailable: %s", globals.git_cache_dir);
+            use_cache = 0;
+        }
+    }
+
+    if (use_cache) {
+        // The mirror is created under a temporary name so a concurrent clone never sees a partial mirror.
+        // Failing to update an existing mirror is not fatal. "fetch --all" brings the checkout up to date.
+        // Submodules are initialized after origin points to the upstream URL so relative submodule URLs resolve.
+        // The outcome is written last, so only a successful clone is counted (see git_cache_record()).
+        script_len = asprintf(&script,
+                              "set -e\n"
+                              "mirror=\"%s\"\n"
+                              "outcome=hit\n"
+                              "if [ ! -d \"$mirror\" ]; then\n"
+                              "    %s clone --mirror \"%s\" \"$mirror.$$\"\n"
+                              "    if [ -d \"$mirror\" ]; then rm -rf \"$mirror.$$\"; else mv \"$mirror.$$\" \"$mirror\"; outcome=miss; fi\n"
+                              "else\n"
+                              "    %s --git-dir=\"$mirror\" fetch --prune origin || echo \"warning: unable to update $mirror\" >&2\n"
+                              "fi\n"
+                              "touch \"$mirror/" GIT_CACHE_LAST_USED "\" || :\n"
+                              "%s clone -c advice.detachedHead=false \"$mirror\" \"%s\"\n"
+                              "cd \"%s\"\n"
+                              "%s remote set-url origin \"%s\"\n"
+                              "%s submodule update --init --recursive\n"
+                              "echo \"$outcome\" > \".git/" GIT_CACHE_OUTCOME "\"\n",
+                              mirror,
+                              git, url,
+                              git,
+                              git, destdir,
+                              destdir,
+                              git, url,
+                              git);
+    } else if (globals.git_clone_mode == GIT_CLONE_MODE_SHALLOW) {
+        char branch[PATH_MAX] = {0};
+        if (gitref && *gitref) {
+            // --branch accepts tags and branches. Fall back to a full clone for anything else (i.e. a commit)
+            snprintf(branch, sizeof(branch), "--branch \"%s\"", gitref);
+        }
+        // "git describe" needs a tag in the history. Keep deepening the clone until one is found.
+        script_len = asprintf(&script,
+                              "set -e\n"
+                              "%s clone -c advice.detachedHead=false --recursive --depth 1 %s \"%s\" \"%s\" \\\n"
+                              "    || %s clone -c advice.detachedHead=false --recursive \"%s\" \"%s\"\n"
+                              "cd \"%s\"\n"
+                              "while [ -f \"$(%s rev-parse --git-dir)/shallow\" ] \\\n"
+                              "    && ! %s describe --first-parent --tags >/dev/null 2>&1; do\n"
+                              "    %s fetch --deepen=100 --tags || break\n"
+                              "done\n",
+                              git, branch, url, destdir,
+                              git, url, destdir,
+                              destdir,
+                              git,
+                              git,
+                              git);
+    } else {
+        script_len = asprintf(&script,
+                              "%s clone -c advice.detachedHead=false --recursive %s \"%s\" \"%s\"\n",
+                              git,
+                              globals.git_clone_mode == GIT_CLONE_MODE_BLOBLESS ? "--filter=blob:none" : "",
+                              url, destdir);
+    }
+
+    if (script_len < 0) {
+        return NULL;
+    }
+    return script;
+}
+
+int git_cache_record(const char *destdir) {
+    char marker[PATH_MAX] = {0};
+    char outcome[16] = {0};
+    int result = -1;
+
+    snprintf(marker, sizeof(marker), "%s/.git/%s", destdir, GIT_CACHE_OUTCOME);
+    FILE *fp = fopen(marker, "r");
+    if (!fp) {
+        return -1;
+    }
+    if (fgets(outcome, sizeof(outcome), fp)) {
+        strip(outcome);
+        if (!strcmp(outcome, "hit")) {
+            git_cache_counters.hits++;
+            result = 1;
+        } else if (!strcmp(outcome, "miss")) {
+            git_cache_counters.misses++;
+            result = 0;
+        }
+    }
+    fclose(fp);
+    remove(marker);
+    return result;
+}
+
+struct GitCacheEntry {
+    char path[PATH_MAX];
+    time_t used;
+    size_t size;
+};
+
+static size_t git_cache_du_total;
+
+static int git_cache_du_callback(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void) path;
+    (void) flag;
+    (void) ftw;
+    git_cache_du_total += (size_t) st->st_blocks * 512;
+    return 0;
+}
+
+static size_t git_cache_du(const char *path) {
+    git_cache_du_total = 0;
+    if (nftw(path, git_cache_du_callback, 16, FTW_PHYS) < 0) {
+        return 0;
+    }
+    return git_cache_du_total;
+}
+
+static int git_cache_entry_cmp(const void *a, const void *b) {
+    const struct GitCacheEntry *left = a;
+    const struct GitCacheEntry *right = b;
+    if (left->used < right->used) {
+        return -1;
+    }
+    if (left->used > right->used) {
+        return 1;
+    }
+    return 0;
+}
+
+int git_cache_evict(const char *root, size_t max_bytes) {
+    struct GitCacheEntry *entry = NULL;
+    size_t num_entries = 0;
+    size_t total = 0;
+    int evicted = 0;
+
+    if (!max_bytes) {
+        return 0;
+    }
+
+    DIR *dp = opendir(root);
+    if (!dp) {
+        return -1;
+    }
+
+    struct dirent *rec;
+    while ((rec = readdir(dp)) != NULL) {
+        const size_t name_len = strlen(rec->d_name);
+        if (rec->d_name[0] == '.' || name_len < 4 || strcmp(rec->d_name + name_len - 4, ".git") != 0) {
+            continue;
+        }
+
+        struct GitCacheEntry *tmp = realloc(entry, (num_entries + 1) * sizeof(*entry));
+        if (!tmp) {
+            SYSERROR("Unable to allocate git cache entry: %s", strerror(errno));
+            guard_free(entry);
+            closedir(dp);
+            return -1;
+        }
+        entry = tmp;
+
+        struct GitCacheEntry *item = &entry[num_entries];
+        memset(item, 0, sizeof(*item));
+        snprintf(item->path, sizeof(item->path), "%s/%s", root, rec->d_name);
+
+        // Prefer the time the mirror was last used over the time it was last modified
+        char marker[PATH_MAX + sizeof(GIT_CACHE_LAST_USED) + 1];
+        struct stat st;
+        snprintf(marker, sizeof(marker), "%s/%s", item->path, GIT_CACHE_LAST_USED);
+        if (!stat(marker, &st) || !stat(item->path, &st)) {
+            item->used = st.st_mtime;
+        }
+        item->size = git_cache_du(item->path);
+        total += item->size;
+        num_entries++;
+    }
+    closedir(dp);
+
+    if (num_entries) {
+        qsort(entry, num_entries, sizeof(*entry), git_cache_entry_cmp);
+    }
+
+    for (size_t i = 0; i < num_entries && total > max_bytes; i++) {
+        SYSDEBUG("Evicting git mirror: %s", entry[i].path);
+        if (rmtree(entry[i].path)) {
+            fprintf(stderr, "Unable to remove git mirror: %s\n", entry[i].path);
+            continue;
+        }
+        total -= entry[i].size;
+        git_cache_counters.evictions++;
+        evicted++;
+    }
+
+    guard_free(entry);
+    return evicted;
+}
@@ -42,13 +42,28 @@ struct STASIS_GLOBAL globals = {
         .enable_rewrite_spec_stage_2 = true, ///< Leave template stings in output files
         .enable_parallel = true, ///< Toggle testing in parallel
         .enable_task_logging = true, ///< Toggle logging for multiprocess tasks
+        .enable_task_log_archive = false, ///< Toggle keeping compressed logs for multiprocess tasks
         .parallel_fail_fast = false, ///< Kill ALL multiprocessing tasks immediately on error
         .pool_status_interval = 30, ///< Report "Task is running"
+        .fetch_jobs = 4, ///< Clone n repositories at the same time
+        .copy_jobs = 4, ///< Copy n files at the same time
+        .delete_jobs = 4, ///< Remove directory trees with n processes
+        .scan_jobs = 4, ///< Read n wheel files at the same time
+        .enable_git_cache = true, ///< Toggle git mirror cache
+        .git_cache_dir = NULL, ///< Path to git mirror cache
+        .git_cache_max_size = 10240, ///< Git mirror cache size limit (MiB)
+        .git_clone_mode = 0, ///< Full clones (GIT_CLONE_MODE_FULL)
+        .enable_index_cache = true, ///< Toggle package index metadata cache
+        .index_cache_dir = NULL, ///< Path to package index metadata cache
+        .index_cache_ttl = 3600, ///< Revalidate cached index metadata after n seconds
+        .index_cache_stale = false, ///< Do not use expired index metadata on error
         .task_timeout = 0, ///< Time in seconds before task is terminated
 };
 
 void globals_free() {
     guard_free(globals.tmpdir);
+    guard_free(globals.git_cache_dir);
+    guard_free(globals.index_cache_dir);
     guard_free(globals.sysconfdir);
     guard_free(globals.conda_install_prefix);
     guard_strlist_free(&globals.conda_packages);
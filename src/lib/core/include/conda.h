@@ -7,6 +7,7 @@
 #include <sys/utsname.h>
 #include "core.h"
 #include "download.h"
+#include "strlist.h"
 
 #define CONDA_INSTALL_PREFIX "conda"
 #define PYPI_INDEX_DEFAULT "https://pypi.org/simple"
@@ -203,6 +204,8 @@ int conda_index(const char *path);
 /**
  * Determine whether a package index contains a package
  *
+ * Answers are cached when `globals.enable_index_cache` is set (see index_cache_lookup())
+ *
  * ```c
  * int result = pkg_index_provides(USE_PIP, NULL, "numpy>1.26");
  * if (PKG_INDEX_PROVIDES_FAILED(result)) {
@@ -227,6 +230,41 @@ int conda_index(const char *path);
 int pkg_index_provides(int mode, const char *index, const char *spec);
 const char *pkg_index_provides_strerror(int code);
 
+/**
+ * Determine whether a package index contains each package in a list
+ *
+ * The same as calling pkg_index_provides() for every spec, except that up to
+ * `jobs` package manager processes query the index at the same time.
+ * If the pool fails, queries that did not finish are killed, and their
+ * result is PKG_INDEX_PROVIDES_E_MANAGER_EXEC (never cached).
+ *
+ * ```c
+ * struct StrList *specs = strlist_init();
+ * strlist_append(&specs, "numpy>1.26");
+ * strlist_append(&specs, "doesnotexist");
+ * int result[2];
+ * if (pkg_index_provides_many(PKG_USE_PIP, NULL, specs, result, 4)) {
+ *     // handle error
+ * }
+ * for (size_t i = 0; i < strlist_count(specs); i++) {
+ *     if (PKG_INDEX_PROVIDES_FAILED(result[i])) {
+ *         fprintf(stderr, "failed: %s\n", pkg_index_provides_strerror(result[i]));
+ *     } else if (result[i] == PKG_NOT_FOUND) {
+ *         // package does not exist upstream
+ *     }
+ * }
+ * ```
+ *
+ * @param mode PKG_USE_PIP or PKG_USE_CONDA
+ * @param index a file system path or url pointing to a simple index or conda channel
+ * @param specs list of package specifications
+ * @param result array (`strlist_count(specs)` records) receiving a pkg_index_provides() result for each spec
+ * @param jobs number of queries to run at once
+ * @return 0 on success
+ * @return -1 on error
+ */
+int pkg_index_provides_many(int mode, const char *index, struct StrList *specs, int *result, size_t jobs);
+
 char *conda_get_active_environment();
 
 int conda_env_exists(const char *root, const char *name);
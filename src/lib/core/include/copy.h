@@ -7,16 +7,27 @@
 #include <string.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include "core.h"
 
 #define CT_OWNER 1 << 1
 #define CT_PERM 1 << 2
+#define CT_FSYNC 1 << 3
+#define CT_ATOMIC 1 << 4
+#define CT_NO_HARDLINK 1 << 5
 
 /**
  * Copy a single file
  *
+ * Regular files are copied in the kernel when possible. The copy is a reflink
+ * on file systems that support it, and uses copy_file_range() or sendfile()
+ * otherwise. Other systems fall back to a buffered read/write loop.
+ *
+ * A regular file with more than two links is hard linked to `dest` instead of
+ * copied when both are on the same device, unless CT_NO_HARDLINK is set.
+ *
  * ```c
  * if (copy2("/source/path/example.txt", "/destination/path/example.txt", CT_PERM | CT_OWNER)) {
  *     fprintf(stderr, "Unable to copy file\n");
@@ -29,6 +40,9 @@
  * @param dest destination file path
  * @param op CT_OWNER (preserve ownership)
  * @param op CT_PERM (preserve permission bits)
+ * @param op CT_FSYNC (flush data to disk before returning)
+ * @param op CT_ATOMIC (write to a temporary file next to `dest`, then rename it)
+ * @param op CT_NO_HARDLINK (always write an independent copy of a regular file)
  * @return 0 on success, -1 on error
  */
 int copy2(const char *src, const char *dest, unsigned op);
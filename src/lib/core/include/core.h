@@ -44,8 +44,21 @@ struct STASIS_GLOBAL {
     bool enable_overwrite; //!< Enable release file clobbering
     bool enable_rewrite_spec_stage_2; //!< Enable automatic @STR@ replacement in output files
     bool enable_parallel; //!< Enable testing in parallel
-    bool enable_task_logging; //!< Enable logging task output to a file
+    bool enable_task_logging; //!< Enable capturing task output (prefixed with the task name)
+    bool enable_task_log_archive; //!< Keep compressed task output in the results directory
     long cpu_limit; //!< Limit parallel processing to n cores (default: max - 1)
+    long fetch_jobs; //!< Number of repositories to clone at the same time
+    long copy_jobs; //!< Number of files to copy at the same time (see tree_sync())
+    long delete_jobs; //!< Number of processes removing a directory tree (see rmtree_parallel())
+    long scan_jobs; //!< Number of wheel files to read at the same time (see wheel_catalog_build())
+    bool enable_git_cache; //!< Clone repositories through a local mirror cache
+    char *git_cache_dir; //!< Path to git mirror cache
+    size_t git_cache_max_size; //!< Evict least recently used mirrors when the cache exceeds n MiB (0: unlimited)
+    int git_clone_mode; //!< Clone strategy used when the git cache is disabled (GIT_CLONE_MODE_*)
+    bool enable_index_cache; //!< Cache package index metadata and lookup results
+    char *index_cache_dir; //!< Path to package index metadata cache
+    long index_cache_ttl; //!< Trust cached index metadata for n seconds before revalidating it
+    bool index_cache_stale; //!< Use expired index metadata when the index cannot be reached
     long parallel_fail_fast; //!< Fail immediately on error
     int pool_status_interval; //!< Report "Task is running" every n seconds
     struct StrList *conda_packages; //!< Conda packages to install after initial activation
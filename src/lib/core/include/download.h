@@ -6,7 +6,36 @@
 #include <string.h>
 #include <curl/curl.h>
 
+struct DownloadValidator {
+    char etag[255]; ///< Value of the last ETag response header
+    char last_modified[255]; ///< Value of the last Last-Modified response header
+};
+
 size_t download_writer(void *fp, size_t size, size_t nmemb, void *stream);
 long download(char *url, const char *filename, char **errmsg);
 
+/**
+ * Download a file unless the copy on disk is still current
+ *
+ * The request carries If-None-Match/If-Modified-Since headers built from
+ * `validator`. When the server answers 200 the response replaces `filename`
+ * and `validator` is updated. Any other response leaves both untouched.
+ *
+ * ```c
+ * struct DownloadValidator validator = {0};
+ * long code = download_revalidate("https://pypi.org/simple/numpy/", "numpy.html", &validator, &errmsg);
+ * // code == 200, numpy.html written
+ * code = download_revalidate("https://pypi.org/simple/numpy/", "numpy.html", &validator, &errmsg);
+ * // code == 304, numpy.html is current
+ * ```
+ *
+ * @param url location of file
+ * @param filename destination path
+ * @param validator cache validators from the previous response (updated on 200)
+ * @param errmsg pointer to error message (caller must free)
+ * @return HTTP status code
+ * @return -1 on error
+ */
+long download_revalidate(const char *url, const char *filename, struct DownloadValidator *validator, char **errmsg);
+
 #endif //STASIS_DOWNLOAD_H
@@ -6,10 +6,25 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <dirent.h>
-#include "environment.h"
+#include <sys/types.h>
 
-typedef struct StrList RuntimeEnv;
+/*! \struct RuntimeEnv
+ *  \brief Environment variables with a hashed key index
+ *
+ *  `data` is a NULL terminated array of `KEY=VALUE` records, usable wherever an `environ`
+ *  style array is expected. The remaining members are maintained by the runtime_* functions.
+ */
+typedef struct RuntimeEnv {
+    size_t num_alloc;   ///< Number of records allocated
+    size_t num_inuse;   ///< Number of records in use
+    char **data;        ///< `KEY=VALUE` records
+    size_t *key_len;    ///< Length of each record's key
+    bool *changed;      ///< Records modified by runtime_set() since the last runtime_apply_changed()
+    size_t table_size;  ///< Number of slots in table (power of two)
+    ssize_t *table;     ///< Open-addressed hash table of record positions (-1 = empty)
+} RuntimeEnv;
 
 ssize_t runtime_contains(RuntimeEnv *env, const char *key);
 RuntimeEnv *runtime_copy(char **env);
@@ -19,5 +34,6 @@ void runtime_set(RuntimeEnv *env, const char *_key, char *_value);
 char *runtime_expand_var(RuntimeEnv *env, char *input);
 void runtime_export(RuntimeEnv *env, char **keys);
 void runtime_apply(RuntimeEnv *env);
+void runtime_apply_changed(RuntimeEnv *env);
 void runtime_free(RuntimeEnv *env);
 #endif //STASIS_ENVIRONMENT_H
@@ -0,0 +1,106 @@
+//! @file gitcache.h
+#ifndef STASIS_GITCACHE_H
+#define STASIS_GITCACHE_H
+
+#include <stdint.h>
+#include "core.h"
+#include "utils.h"
+
+//! Clone full repository history (default)
+#define GIT_CLONE_MODE_FULL 0
+//! Clone commits and trees, fetch file contents on demand (--filter=blob:none)
+#define GIT_CLONE_MODE_BLOBLESS 1
+//! Clone truncated history, deepened until "git describe" finds a tag
+#define GIT_CLONE_MODE_SHALLOW 2
+
+//! File inside a mirror updated every time the mirror is used (LRU eviction)
+#define GIT_CACHE_LAST_USED "stasis-last-used"
+//! File inside a checkout's git directory recording whether its mirror was created ("miss") or reused ("hit")
+#define GIT_CACHE_OUTCOME "stasis-cache-outcome"
+
+struct GitCacheStats {
+    size_t hits; ///< Clones served by an existing mirror
+    size_t misses; ///< Clones that had to create a mirror
+    size_t evictions; ///< Mirrors removed to keep the cache below its size limit
+};
+
+/**
+ * Get git mirror cache counters
+ * @return pointer to GitCacheStats
+ */
+const struct GitCacheStats *git_cache_stats();
+
+/**
+ * Convert a clone mode name to a GIT_CLONE_MODE_* value
+ * @param mode "full", "blobless", or "shallow"
+ * @return GIT_CLONE_MODE_FULL, GIT_CLONE_MODE_BLOBLESS, GIT_CLONE_MODE_SHALLOW
+ * @return -1 if mode is not recognized
+ */
+int git_clone_mode_from_str(const char *mode);
+
+/**
+ * Determine the path of a repository's mirror in the cache
+ *
+ * URLs that only differ by a trailing "/" or ".git" share a mirror.
+ *
+ * ```c
+ * char mirror[PATH_MAX] = {0};
+ * if (!git_cache_mirror_path("/home/user/.stasis/git-cache", "https://github.com/org/repo", mirror, sizeof(mirror))) {
+ *     // mirror == "/home/user/.stasis/git-cache/repo-0123456789abcdef.git"
+ * }
+ * ```
+ *
+ * @param root path to git cache
+ * @param url URL (or file system path) of repository
+ * @param result destination buffer
+ * @param maxlen size of destination buffer
+ * @return 0 on success, -1 on error
+ */
+int git_cache_mirror_path(const char *root, const char *url, char *result, size_t maxlen);
+
+/**
+ * Generate a shell script that clones a repository into `destdir`
+ *
+ * When `globals.enable_git_cache` is set the repository's mirror is created
+ * (or incrementally updated) under `globals.git_cache_dir`, and `destdir` is
+ * cloned from the mirror with its origin pointing back to `url`. Otherwise
+ * `globals.git_clone_mode` selects a full, blobless or shallow clone of `url`.
+ *
+ * The script does not check out `gitref` unless a shallow clone requires it.
+ * When the cache is used, the script records whether it created the mirror.
+ * Pass `destdir` to git_cache_record() after the script succeeds to count it.
+ *
+ * @param git path to git program
+ * @param url URL (or file system path) of repository
+ * @param destdir destination directory (must not exist)
+ * @param gitref commit/branch/tag to be checked out (may be NULL)
+ * @return pointer to script (caller must free)
+ * @return NULL on error
+ */
+char *git_clone_script(const char *git, const char *url, const char *destdir, const char *gitref);
+
+/**
+ * Count the outcome of a clone made by a git_clone_script() script
+ *
+ * The outcome is recorded by the script itself, so it is accurate when
+ * several scripts are generated before any of them runs. The record is
+ * removed after it is counted.
+ *
+ * @param destdir path to checkout
+ * @return 1 if the mirror was reused (hit)
+ * @return 0 if the mirror was created (miss)
+ * @return -1 if the checkout was not cloned through the cache
+ */
+int git_cache_record(const char *destdir);
+
+/**
+ * Remove least recently used mirrors until the cache is no larger than `max_bytes`
+ *
+ * @param root path to git cache
+ * @param max_bytes size limit (0 disables eviction)
+ * @return number of mirrors removed
+ * @return -1 on error
+ */
+int git_cache_evict(const char *root, size_t max_bytes);
+
+#endif //STASIS_GITCACHE_H
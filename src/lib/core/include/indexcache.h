@@ -0,0 +1,101 @@
+//! @file indexcache.h
+#ifndef STASIS_INDEXCACHE_H
+#define STASIS_INDEXCACHE_H
+
+#include <time.h>
+#include "core.h"
+#include "download.h"
+#include "strlist.h"
+
+struct IndexCacheEntry {
+    char path[PATH_MAX]; ///< Path to metadata file
+    char page[PATH_MAX]; ///< Path to cached index page
+    char url[PATH_MAX]; ///< Location of index page (empty when the index cannot be revalidated)
+    struct DownloadValidator validator; ///< ETag/Last-Modified of cached index page
+    time_t checked; ///< Time the index page was last fetched or revalidated
+    long http_code; ///< Status of the last successful fetch (200 or 404)
+    struct StrList *results; ///< Lookup results ("<result> <time> <spec>")
+};
+
+struct IndexCacheStats {
+    size_t hits; ///< Lookups answered by the cache
+    size_t misses; ///< Lookups the package manager had to answer
+    size_t revalidated; ///< Index pages confirmed to be unchanged (HTTP 304)
+    size_t stale; ///< Lookups answered by expired metadata because the index failed
+};
+
+/**
+ * Get package index cache counters
+ * @return pointer to IndexCacheStats
+ */
+const struct IndexCacheStats *index_cache_stats();
+
+/**
+ * Extract the normalized (PEP 503) project name from a package spec
+ *
+ * Same as pkgname_normalize().
+ *
+ * ```c
+ * char name[255] = {0};
+ * index_cache_package_name("Foo.Bar_baz[extra]>=1.0", name, sizeof(name));
+ * // name == "foo-bar-baz"
+ * ```
+ *
+ * @param spec package spec
+ * @param result destination buffer
+ * @param maxlen size of destination buffer
+ * @return 0 on success
+ * @return -1 if the spec has no name, or the name does not fit in `result`
+ */
+int index_cache_package_name(const char *spec, char *result, size_t maxlen);
+
+/**
+ * Answer a pkg_index_provides() query from the cache
+ *
+ * Results are kept per package manager, index and target environment (the
+ * active interpreter and platform for pip, the platform for conda), and
+ * expire after `globals.index_cache_ttl` seconds.
+ *
+ * Entries for HTTP(S) simple indexes are revalidated with a conditional
+ * request once they are older than `globals.index_cache_ttl`. When the index
+ * page changes, its results are discarded. A missing project (HTTP 404) is
+ * answered by the index page alone.
+ *
+ * When the index cannot be reached and `globals.index_cache_stale` is set,
+ * expired metadata is used instead.
+ *
+ * @param mode PKG_USE_PIP or PKG_USE_CONDA
+ * @param index a file system path or url pointing to a simple index or conda channel (may be NULL)
+ * @param spec a package specification
+ * @param result receives PKG_FOUND or PKG_NOT_FOUND
+ * @return 0 if the cache answered the query
+ * @return -1 if the package manager must be consulted
+ */
+int index_cache_lookup(int mode, const char *index, const char *spec, int *result);
+
+/**
+ * Answer a pkg_index_provides() query from the cache regardless of age
+ *
+ * Used after the package manager fails. Does nothing unless `globals.index_cache_stale` is set.
+ *
+ * @param mode PKG_USE_PIP or PKG_USE_CONDA
+ * @param index a file system path or url pointing to a simple index or conda channel (may be NULL)
+ * @param spec a package specification
+ * @param result receives PKG_FOUND or PKG_NOT_FOUND
+ * @return 0 if the cache answered the query
+ * @return -1 if no result is cached
+ */
+int index_cache_lookup_stale(int mode, const char *index, const char *spec, int *result);
+
+/**
+ * Record the package manager's answer to a pkg_index_provides() query
+ *
+ * @param mode PKG_USE_PIP or PKG_USE_CONDA
+ * @param index a file system path or url pointing to a simple index or conda channel (may be NULL)
+ * @param spec a package specification
+ * @param result PKG_FOUND or PKG_NOT_FOUND
+ * @return 0 on success, -1 on error
+ */
+int index_cache_store(int mode, const char *index, const char *spec, int result);
+
+#endif //STASIS_INDEXCACHE_H
@@ -65,15 +65,33 @@ struct INIData {
     char *key;                       ///< INI variable name
     char *value;                     ///< INI variable value
     unsigned type_hint;
+    struct Template *tpl;            ///< Compiled value (created by the first INI_READ_RENDER)
 };
 
+/*! \struct INIIndex
+ * \brief A hash table mapping names to INISection or INIData records
+ */
+struct INIIndex {
+    size_t num_used;                 ///< Total records
+    size_t num_alloc;                ///< Total slots (power of two)
+    const char **key;                ///< Record names (owned by the records)
+    void **value;                    ///< Pointers to INISection or INIData records
+};
+
+/*! \struct INIArena
+ * \brief Block storage for records, keys and values read by ini_open()
+ */
+struct INIArena;
+
 /*! \struct INISection
  * \brief A structure to describe an INI section
  */
 struct INISection {
     size_t data_count;               ///< Total INIData records
+    size_t data_alloc;               ///< Total INIData slots
     char *key;                       ///< INI section name
     struct INIData **data;           ///< Array of INIData records
+    struct INIIndex *index;          ///< Hash index of INIData records (NULL: linear search)
 };
 
 /*! \struct INIFILE
@@ -81,7 +99,10 @@ struct INISection {
  */
 struct INIFILE {
     size_t section_count;            ///< Total INISection records
+    size_t section_alloc;            ///< Total INISection slots
     struct INISection **section;     ///< Array of INISection records
+    struct INIIndex *index;          ///< Hash index of INISection records (NULL: linear search)
+    struct INIArena *arena;          ///< Storage released all at once by ini_free() (NULL: every record is allocated separately)
 };
 
 /**
@@ -100,11 +121,37 @@ struct INIFILE {
  * }
  * ~~~
  *
+ * The file is mapped into memory and read in one pass. Lines and values
+ * have no length limit. Records, keys and values are stored in a few large
+ * blocks owned by the INIFILE, and ini_free() releases them all at once.
+ *
  * @param filename path to INI file
  * @return pointer to INIFILE
  */
 struct INIFILE *ini_open(const char *filename);
 
+/**
+ * Index sections and keys by name
+ *
+ * Exact lookups (ini_section_search() with INI_SEARCH_EXACT, ini_has_key(),
+ * ini_getval(), ...) become O(1). The index is kept up to date by
+ * ini_section_create() and ini_data_append(). ini_setval() only replaces
+ * values, so it never invalidates the index. ini_open() indexes every file it reads.
+ *
+ * When several sections (or keys) share a name, the first one is used,
+ * the same as a linear search.
+ *
+ * @param ini pointer to INIFILE
+ * @return 0 on success, -1 on error (lookups fall back to linear search)
+ */
+int ini_index_build(struct INIFILE *ini);
+
+/**
+ * Remove section and key indexes. Lookups fall back to linear search.
+ * @param ini pointer to INIFILE
+ */
+void ini_index_free(struct INIFILE *ini);
+
 /**
  *
  * @param ini
@@ -141,6 +188,17 @@ int ini_has_key(struct INIFILE *ini, const char *section, const char *key);
  */
 int ini_setval(struct INIFILE **ini, unsigned type, char *section_name, char *key, char *value);
 
+/**
+ * Add a key to a section, or append `value` to an existing key's value
+ * @param ini pointer to INIFILE
+ * @param section_name name of an existing section
+ * @param key name of key
+ * @param value text to store
+ * @param hint INIVAL_TYPE_STR or INIVAL_TYPE_STR_ARRAY
+ * @return 0 on success, non-zero on error
+ */
+int ini_data_append(struct INIFILE **ini, char *section_name, char *key, char *value, unsigned int hint);
+
 /**
  * Retrieve all data records in an INI section
  *
@@ -29,33 +29,48 @@ struct MultiProcessingTask {
     char *cmd; ///< Shell command(s) to be executed
     size_t cmd_len; ///< Length of command string (for mmap/munmap)
     char working_dir[PATH_MAX]; ///< Path to directory `cmd` should be executed in
-    char log_file[PATH_MAX]; ///< Full path to stdout/stderr log file
+    char log_file[PATH_MAX]; ///< Full path to the compressed stdout/stderr log file (see MultiProcessingPool::log_keep)
     char parent_script[PATH_MAX]; ///< Path to temporary script executing the task
+    struct MultiProcessingTask *depends_on; ///< Task (in the same pool) that must succeed before this task starts, or NULL
+    char group[255]; ///< Tasks sharing a non-empty group name never run at the same time
     struct MultiProcessingTimer time_data; ///< Wall-time counters
     struct MultiProcessingTimer interval_data; ///< Progress report counters
 };
 
 struct MultiProcessingPool {
-    struct MultiProcessingTask *task; ///< Array of tasks to execute
+    struct MultiProcessingTask **task; ///< Array of tasks to execute
     size_t num_used; ///< Number of tasks populated in the task array
-    size_t num_alloc; ///< Number of tasks allocated by the task array
+    size_t num_alloc; ///< Number of tasks allocated by the task array (grows by MP_POOL_TASK_CHUNK)
     char ident[255]; ///< Identity of task pool
     char log_root[PATH_MAX]; ///< Base directory to store stderr/stdout log files
+    bool log_keep; ///< Keep a compressed copy of each task's output in log_root
     int status_interval; ///< Report a pooled task is "running" every n seconds
+    size_t jobs; ///< Number of tasks allowed to run at once by mp_pool_join()
+    double busy; ///< Sum of task wall-time recorded by mp_pool_join() (seconds)
+    double utilization; ///< Percentage of available core time spent executing tasks
+    struct MultiProcessingTimer time_data; ///< Wall-time counters
     struct Semaphore semaphore;
 };
 
 /// A multiprocessing task's initial state (i.e. "FAIL")
 #define MP_POOL_TASK_STATUS_INITIAL (-1)
 
-/// Maximum number of multiprocessing tasks STASIS can execute
-#define MP_POOL_TASK_MAX 1000
+/// A multiprocessing task was not executed because its dependency failed (i.e. "SKIP")
+#define MP_POOL_TASK_STATUS_SKIPPED (-2)
+
+/// Number of task records mapped at a time. A pool grows by this amount when it runs out of records.
+#define MP_POOL_TASK_CHUNK 16
 
 /// Value signifies a process is unused or finished executing
 #define MP_POOL_PID_UNUSED 0
 
+/// Maximum number of pools that may be joined at the same time
+#define MP_POOL_WAKEUP_MAX 64
+
 /// Option flags for mp_pool_join()
 #define MP_POOL_FAIL_FAST 1 << 1
+/// Poll tasks at a fixed interval instead of waking up on SIGCHLD
+#define MP_POOL_POLL_FIXED 1 << 2
 
 /**
  * Create a multiprocessing pool
@@ -114,15 +129,37 @@ struct MultiProcessingTask *mp_pool_task(struct MultiProcessingPool *pool, const
 /**
  * Execute all tasks in a pool
  *
+ * Up to `jobs` tasks run at once. The next queued task starts as soon as
+ * any running task finishes. When all tasks are finished the pool's core
+ * utilization (`pool->utilization`) is reported.
+ *
+ * A task waits for its `depends_on` task to succeed before it starts. When
+ * the dependency fails the task is not executed and its status is set to
+ * MP_POOL_TASK_STATUS_SKIPPED. Tasks with the same `group` name are never
+ * executed at the same time.
+ *
+ * The pool sleeps until a child process changes state (SIGCHLD), or a task
+ * reaches its timeout or status interval. Use MP_POOL_POLL_FIXED to poll
+ * every 100ms instead.
+ *
  * @param pool a pointer to MultiProcessingPool
  * @param jobs the number of processes to spawn at once (for serial execution use `1`)
- * @param flags option to be OR'd (MP_POOL_FAIL_FAST)
+ * @param flags option to be OR'd (MP_POOL_FAIL_FAST, MP_POOL_POLL_FIXED)
  * @return 0 on success
- * @return >0 on failure
+ * @return >0 on failure (the number of failed and skipped tasks)
  * @return <0 on error
  */
 int mp_pool_join(struct MultiProcessingPool *pool, size_t jobs, size_t flags);
 
+/**
+ * Send a signal to every running task in a pool, and wait for them to exit
+ *
+ * @param pool a pointer to MultiProcessingPool
+ * @param signum signal to send (i.e. SIGTERM)
+ * @return 0 on success, -1 on error
+ */
+int mp_pool_kill(struct MultiProcessingPool *pool, int signum);
+
 /**
  * Show summary of pool tasks
  *
@@ -138,4 +175,53 @@ void mp_pool_show_summary(struct MultiProcessingPool *pool);
 void mp_pool_free(struct MultiProcessingPool **pool);
 
 
+/**
+ * Allocate memory shared with child processes created by fork()
+ *
+ * @param size number of bytes to allocate (zero-initialized)
+ * @return pointer to shared memory
+ * @return NULL on error
+ */
+void *mp_shared_alloc(size_t size);
+
+/**
+ * Release memory allocated by mp_shared_alloc()
+ *
+ * @param ptr pointer to shared memory
+ * @param size number of bytes passed to mp_shared_alloc()
+ */
+void mp_shared_free(void *ptr, size_t size);
+
+/**
+ * Call a function once for each index in [0, count) using up to `jobs` processes
+ *
+ * Indexes are handed out one at a time, so a slow call never holds up work
+ * queued behind it. Each worker is a fork() of the caller. Changes made by
+ * `fn` are only visible to the parent when they are written to memory
+ * allocated by mp_shared_alloc().
+ *
+ * When `jobs` is less than 2, or there is only one index, every call runs in
+ * the calling process.
+ *
+ * ```c
+ * int work(size_t index, void *arg) {
+ *     char **paths = arg;
+ *     return remove(paths[index]);
+ * }
+ *
+ * if (mp_parallel_for(count, 4, work, paths)) {
+ *     // handle failure
+ * }
+ * ```
+ *
+ * @param count number of indexes
+ * @param jobs maximum number of worker processes
+ * @param fn function to call (returns zero on success)
+ * @param arg passed to `fn`
+ * @return 0 on success
+ * @return >0 the number of calls that failed
+ * @return <0 on error (a worker could not be started, or was terminated)
+ */
+ssize_t mp_parallel_for(size_t count, size_t jobs, int (*fn)(size_t index, void *arg), void *arg);
+
 #endif //STASIS_MULTIPROCESSING_H
@@ -0,0 +1,107 @@
+//! @file pkgname.h
+#ifndef STASIS_PKGNAME_H
+#define STASIS_PKGNAME_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*! \struct PackageNames
+ * \brief Interned package names
+ *
+ * Every distinct (normalized) name is stored once and identified by its
+ * position in `name`. IDs are stable for the life of the pool.
+ */
+struct PackageNames {
+    size_t num_used;                 ///< Total names
+    size_t num_alloc;                ///< Total name slots
+    char **name;                     ///< Normalized names, indexed by ID
+    size_t table_size;               ///< Total hash table slots (power of two)
+    ssize_t *table;                  ///< Hash table of IDs (-1: empty slot)
+};
+
+/**
+ * Find where the project name ends in a package spec
+ *
+ * ```c
+ * const char *spec = "numpy>=1.26";
+ * const char *end = pkgname_end(spec);
+ * // end == ">=1.26"
+ * if (!*pkgname_end("numpy")) {
+ *     // the spec is a bare name
+ * }
+ * ```
+ *
+ * @param spec package spec
+ * @return pointer to the first character after the name (leading whitespace is skipped)
+ */
+const char *pkgname_end(const char *spec);
+
+/**
+ * Extract the normalized (PEP 503) project name from a package spec
+ *
+ * The name is lowercased and runs of "-", "_" and "." become a single "-".
+ * Extras, environment markers, version specs and URLs are discarded.
+ *
+ * ```c
+ * char name[255] = {0};
+ * pkgname_normalize("Foo.Bar_baz[extra]>=1.0", name, sizeof(name));
+ * // name == "foo-bar-baz"
+ * ```
+ *
+ * @param spec package spec
+ * @param result destination buffer
+ * @param maxlen size of destination buffer
+ * @return 0 on success
+ * @return -1 if the spec has no name, or the name does not fit in `result`
+ */
+int pkgname_normalize(const char *spec, char *result, size_t maxlen);
+
+/**
+ * Create an empty pool of package names
+ * @return pointer to PackageNames, or NULL on error
+ */
+struct PackageNames *pkgname_init();
+
+/**
+ * Free a pool of package names
+ * @param names pointer to PackageNames
+ */
+void pkgname_free(struct PackageNames **names);
+
+/**
+ * Add a package to the pool
+ *
+ * ```c
+ * struct PackageNames *names = pkgname_init();
+ * ssize_t a = pkgname_intern(names, "NumPy>=1.26");
+ * ssize_t b = pkgname_intern(names, "numpy==2.0");
+ * // a == b
+ * // pkgname_str(names, a) == "numpy"
+ * pkgname_free(&names);
+ * ```
+ *
+ * @param names pointer to PackageNames
+ * @param spec package spec (the name is normalized with pkgname_normalize())
+ * @return ID of the package's name
+ * @return -1 on error
+ */
+ssize_t pkgname_intern(struct PackageNames *names, const char *spec);
+
+/**
+ * Find a package in the pool
+ * @param names pointer to PackageNames
+ * @param spec package spec (the name is normalized with pkgname_normalize())
+ * @return ID of the package's name
+ * @return -1 if the package is not in the pool
+ */
+ssize_t pkgname_lookup(const struct PackageNames *names, const char *spec);
+
+/**
+ * Get a normalized package name by ID
+ * @param names pointer to PackageNames
+ * @param id ID returned by pkgname_intern()
+ * @return normalized name, or NULL if `id` is out of range
+ */
+const char *pkgname_str(const struct PackageNames *names, ssize_t id);
+
+#endif //STASIS_PKGNAME_H
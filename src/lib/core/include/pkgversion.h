@@ -0,0 +1,43 @@
+//! @file pkgversion.h
+#ifndef STASIS_PKGVERSION_H
+#define STASIS_PKGVERSION_H
+
+#include <stddef.h>
+
+/**
+ * Compare Python package versions (PEP 440)
+ *
+ * Epoch, release, pre-release (a, b, rc), post-release, development release
+ * and local version segments are ordered as pip orders them:
+ * `1.0.dev1 < 1.0a1 < 1.0b1 < 1.0rc1 < 1.0 < 1.0+local < 1.0.post1`.
+ * Alternate spellings ("1.0-alpha.1", "1.0-1", "v1.0") are accepted.
+ *
+ * Strings that are not valid versions (e.g. wheel build tags such as "1abc")
+ * are compared by runs of digits instead.
+ *
+ * ```c
+ * if (pkgversion_cmp("1.0rc1", "1.0") < 0) {
+ *     // the release candidate is older
+ * }
+ * ```
+ *
+ * @param a version
+ * @param b version
+ * @return <0 if `a` is older than `b`, 0 if they are equal, >0 if `a` is newer
+ */
+int pkgversion_cmp(const char *a, const char *b);
+
+/**
+ * Compare Python package versions that are not NUL terminated
+ *
+ * Same as pkgversion_cmp().
+ *
+ * @param a version
+ * @param len_a length of `a`
+ * @param b version
+ * @param len_b length of `b`
+ * @return <0 if `a` is older than `b`, 0 if they are equal, >0 if `a` is newer
+ */
+int pkgversion_cmp_len(const char *a, size_t len_a, const char *b, size_t len_b);
+
+#endif //STASIS_PKGVERSION_H
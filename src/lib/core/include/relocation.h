@@ -15,10 +15,62 @@
 #include <linux/limits.h>
 #endif
 #include <unistd.h>
+#include <sys/types.h>
 
 #define REPLACE_TRUNCATE_AFTER_MATCH 1
 
+struct ReplaceRule {
+    const char *target; ///< String to find (must not be empty)
+    const char *replacement; ///< String written in its place
+    unsigned flags; ///< REPLACE_TRUNCATE_AFTER_MATCH
+};
+
+int replace_text_n(char *buf, size_t bufsize, const char *target, const char *replacement, unsigned flags);
 int replace_text(char *original, const char *target, const char *replacement, unsigned flags);
 int file_replace_text(const char* filename, const char* target, const char* replacement, unsigned flags);
 
+/**
+ * Apply several replacement rules to a buffer in a single pass
+ *
+ * All targets are matched at once. Matches never overlap, and replacements
+ * are not scanned again. When targets overlap, the match that ends first
+ * wins (the longest one, if several end at the same byte).
+ *
+ * ~~~{.c}
+ * const struct ReplaceRule rules[] = {
+ *     {.target = "@NAME@", .replacement = "stasis"},
+ *     {.target = "version:", .replacement = "version: 1.0", .flags = REPLACE_TRUNCATE_AFTER_MATCH},
+ * };
+ * char *result = NULL;
+ * size_t result_len = 0;
+ * if (replace_text_batch(data, strlen(data), rules, 2, &result, &result_len) > 0) {
+ *     // use result
+ *     free(result);
+ * }
+ * ~~~
+ *
+ * @param data input (need not be NUL terminated)
+ * @param len length of input
+ * @param rules array of ReplaceRule
+ * @param count number of rules
+ * @param result receives the modified data (NUL terminated, caller must free). Set to NULL when nothing was replaced.
+ * @param result_len receives the length of result (may be NULL)
+ * @return number of replacements made, or -1 on error
+ */
+ssize_t replace_text_batch(const char *data, size_t len, const struct ReplaceRule *rules, size_t count, char **result, size_t *result_len);
+
+/**
+ * Apply several replacement rules to a file in a single pass
+ *
+ * The file is read once. If anything was replaced, the result is written to a
+ * temporary file in the same directory, then renamed over the original. The
+ * file's permissions are preserved. Lines are not limited in length.
+ *
+ * @param filename path to file
+ * @param rules array of ReplaceRule
+ * @param count number of rules
+ * @return 0 on success, -1 on error
+ */
+int file_replace_text_batch(const char *filename, const struct ReplaceRule *rules, size_t count);
+
 #endif //STASIS_RELOCATION_H
@@ -0,0 +1,78 @@
+//! @file sha256.h
+#ifndef STASIS_SHA256_H
+#define STASIS_SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE 32 ///< Size of a digest in bytes
+#define SHA256_HEX_SIZE (SHA256_DIGEST_SIZE * 2 + 1) ///< Size of a hexadecimal digest string, including the terminator
+#define SHA256_BASE64_SIZE 44 ///< Size of an unpadded base64 digest string, including the terminator
+
+struct SHA256 {
+    uint32_t state[8]; ///< Intermediate hash value
+    uint64_t length; ///< Total bytes consumed
+    unsigned char block[64]; ///< Partial input block
+    size_t used; ///< Bytes in `block`
+};
+
+/**
+ * Start a new SHA-256 digest
+ *
+ * ```c
+ * struct SHA256 ctx;
+ * unsigned char digest[SHA256_DIGEST_SIZE];
+ * char hex[SHA256_HEX_SIZE];
+ *
+ * sha256_init(&ctx);
+ * sha256_update(&ctx, "abc", 3);
+ * sha256_final(&ctx, digest);
+ * sha256_hex(digest, hex);
+ * // hex == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"
+ * ```
+ *
+ * @param ctx pointer to SHA256
+ */
+void sha256_init(struct SHA256 *ctx);
+
+/**
+ * Add data to a digest
+ * @param ctx pointer to SHA256
+ * @param data input data
+ * @param len length of `data`
+ */
+void sha256_update(struct SHA256 *ctx, const void *data, size_t len);
+
+/**
+ * Finish a digest
+ * @param ctx pointer to SHA256 (must be initialized again before reuse)
+ * @param digest receives the digest
+ */
+void sha256_final(struct SHA256 *ctx, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+/**
+ * Compute the digest of a file
+ * @param filename path to file
+ * @param digest receives the digest
+ * @return 0 on success, -1 on error (errno is set)
+ */
+int sha256_file(const char *filename, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+/**
+ * Convert a digest to lowercase hexadecimal
+ * @param digest a digest
+ * @param result receives the NUL terminated string
+ */
+void sha256_hex(const unsigned char digest[SHA256_DIGEST_SIZE], char result[SHA256_HEX_SIZE]);
+
+/**
+ * Convert a digest to URL-safe base64 without padding
+ *
+ * This is the encoding used by the `RECORD` file of a wheel (PEP 376, PEP 427)
+ *
+ * @param digest a digest
+ * @param result receives the NUL terminated string
+ */
+void sha256_base64(const unsigned char digest[SHA256_DIGEST_SIZE], char result[SHA256_BASE64_SIZE]);
+
+#endif //STASIS_SHA256_H
@@ -43,7 +43,9 @@ void strlist_sort(struct StrList *pStrList, unsigned int mode);
 int strlist_contains(struct StrList *pStrList, const char *value, size_t *index_of);
 int strlist_append_file(struct StrList *pStrList, char *path, ReaderFn *readerFn);
 void strlist_append_strlist(struct StrList *pStrList1, struct StrList *pStrList2);
+int strlist_reserve(struct StrList *pStrList, size_t count);
 void strlist_append(struct StrList **pStrList, char *str);
+void strlist_append_owned(struct StrList **pStrList, char *str);
 void strlist_append_array(struct StrList *pStrList, char **arr);
 void strlist_append_tokenize(struct StrList *pStrList, char *str, char *delim);
 void strlist_append_tokenize_raw(struct StrList *pStrList, char *str, char *delim);
@@ -40,6 +40,74 @@ char *tpl_render(char *str);
  */
 int tpl_render_to_file(char *str, const char *filename);
 
+#define TPL_TOKEN_TEXT 0 ///< Literal text
+#define TPL_TOKEN_VAR 1 ///< {{ key }}
+#define TPL_TOKEN_ENV 2 ///< {{ env:NAME }}
+#define TPL_TOKEN_FUNC 3 ///< {{ func:NAME(a, ...) }}
+
+struct TemplateToken {
+    int type; ///< TPL_TOKEN_*
+    char *data; ///< Literal text, key, environment variable name, or function name
+    size_t len; ///< Length of data
+    char **argv; ///< Function arguments (TPL_TOKEN_FUNC only)
+    int argc; ///< Number of function arguments
+    size_t offset; ///< Position of the token in the source text
+};
+
+struct Template {
+    struct TemplateToken *token; ///< Array of tokens
+    size_t num_used; ///< Number of tokens
+    size_t num_alloc; ///< Number of tokens allocated
+    size_t text_len; ///< Total length of literal text
+};
+
+/**
+ * Parse text into a reusable template
+ *
+ * Keys and functions are resolved when the template is rendered, so values
+ * registered after compilation are honored.
+ *
+ * ```c
+ * struct Template *tpl = tpl_compile("{{ meta.name }}-{{ meta.version }}");
+ * if (!tpl) {
+ *     // syntax error
+ * }
+ * for (size_t i = 0; i < 10; i++) {
+ *     char *result = tpl_render_compiled(tpl);
+ *     // ...
+ *     guard_free(result);
+ * }
+ * tpl_compiled_free(&tpl);
+ * ```
+ *
+ * @param str the text to parse
+ * @return pointer to Template (use tpl_compiled_free())
+ * @return NULL on error
+ */
+struct Template *tpl_compile(const char *str);
+
+/**
+ * Render a compiled template
+ * @param tpl pointer to Template
+ * @return rendered text, or NULL.
+ * The caller is responsible for free()ing memory allocated by this function
+ */
+char *tpl_render_compiled(const struct Template *tpl);
+
+/**
+ * Write tpl_render_compiled() output to a file
+ * @param tpl pointer to Template
+ * @param filename the output file name
+ * @return 0 on success, <0 on error
+ */
+int tpl_render_compiled_to_file(const struct Template *tpl, const char *filename);
+
+/**
+ * Free a compiled template
+ * @param tpl pointer to Template
+ */
+void tpl_compiled_free(struct Template **tpl);
+
 typedef int tplfunc(void *frame, void *data_out);
 
 struct tplfunc_frame {
@@ -0,0 +1,94 @@
+//! @file treesync.h
+#ifndef STASIS_TREESYNC_H
+#define STASIS_TREESYNC_H
+
+#include "core.h"
+#include "strlist.h"
+
+struct TreeSyncOptions {
+    size_t jobs; ///< Number of processes copying files (0 or 1: copy serially)
+    bool strict; ///< Compare file contents instead of size and modification time
+    bool delete; ///< Remove destination entries that do not exist in any source
+    bool verbose; ///< Print the relative path of each copied and deleted entry
+    struct StrList *include; ///< Only copy files matching these patterns (NULL or empty: copy all files)
+    struct StrList *exclude; ///< Never copy, descend into, or delete entries matching these patterns
+};
+
+struct TreeSyncStats {
+    size_t files; ///< Files, symbolic links, and special files found in the sources
+    size_t copied; ///< Entries written to the destination
+    size_t skipped; ///< Entries already up to date
+    size_t deleted; ///< Entries removed from the destination
+    size_t dirs; ///< Directories created in the destination
+    size_t bytes; ///< Bytes of file data copied
+    double duration; ///< Wall-time in seconds
+};
+
+/**
+ * Synchronize the contents of one or more directories with a destination
+ *
+ * Like `rsync -a src1/ src2/ dest/`. The contents of each source directory
+ * are merged into `dest`. When more than one source provides the same path,
+ * the first source wins. `dest` is created when it does not exist.
+ *
+ * A file is copied when its size or modification time (seconds) differs from
+ * the destination file. With `opts->strict` the contents are compared
+ * instead. Files are copied with copy2(). Permissions and modification times
+ * are preserved (ownership too, when running as root).
+ *
+ * Patterns are shell wildcards (see fnmatch(3)):
+ *
+ * - `name` matches the final component of a path at any depth
+ * - `dir/name` matches a path relative to the root of the source
+ * - a trailing `/` (`build/`) only matches directories
+ *
+ * Excluded directories are never descended into, and excluded entries in
+ * `dest` are never deleted. Include patterns only apply to files. Directories
+ * are always created.
+ *
+ * ```c
+ * struct TreeSyncOptions opts = {.jobs = 4, .delete = true};
+ * struct TreeSyncStats stats = {0};
+ * opts.exclude = strlist_init();
+ * strlist_append(&opts.exclude, "tmp/");
+ *
+ * if (tree_sync((char *[]) {"/source/a", "/source/b", NULL}, "/destination", &opts, &stats)) {
+ *     fprintf(stderr, "Unable to synchronize directories\n");
+ * }
+ * tree_sync_show_summary(&stats);
+ * guard_strlist_free(&opts.exclude);
+ * ```
+ *
+ * @param srcs NULL terminated array of source directories
+ * @param dest destination directory
+ * @param opts pointer to TreeSyncOptions (NULL: defaults)
+ * @param stats pointer to TreeSyncStats to populate (may be NULL)
+ * @return 0 on success
+ * @return -1 on error
+ */
+int tree_sync(char **srcs, const char *dest, const struct TreeSyncOptions *opts, struct TreeSyncStats *stats);
+
+/**
+ * Copy files into a directory
+ *
+ * Like `rsync -a file1 file2 dest/`. Each file is written to
+ * `dest/basename(file)`, under the same rules as tree_sync().
+ * Directories named in `files` are copied recursively.
+ *
+ * @param files NULL terminated array of paths
+ * @param dest destination directory
+ * @param opts pointer to TreeSyncOptions (NULL: defaults)
+ * @param stats pointer to TreeSyncStats to populate (may be NULL)
+ * @return 0 on success
+ * @return -1 on error
+ */
+int tree_sync_files(char **files, const char *dest, const struct TreeSyncOptions *opts, struct TreeSyncStats *stats);
+
+/**
+ * Report the number of files copied, and the transfer rate
+ *
+ * @param stats pointer to TreeSyncStats
+ */
+void tree_sync_show_summary(const struct TreeSyncStats *stats);
+
+#endif //STASIS_TREESYNC_H
@@ -88,6 +88,9 @@ char *expandpath(const char *_path);
 /**
  * Remove a directory tree recursively
  *
+ * Symbolic links are removed, never followed. Entries that cannot be removed
+ * are reported on stderr.
+ *
  * ```c
  * mkdirs("a/b/c");
  * rmtree("a");
@@ -99,7 +102,101 @@ char *expandpath(const char *_path);
  */
 int rmtree(char *_path);
 
+/**
+ * Remove a directory tree using up to `jobs` processes
+ *
+ * Entries are removed relative to open directory descriptors
+ * (openat/unlinkat), so neither the length of a path nor a symbolic link
+ * can lead outside of the tree. The top levels of the tree are emptied first,
+ * and the subdirectories found there are handed to the next free worker.
+ *
+ * ```c
+ * struct StrList *failed = NULL;
+ * if (rmtree_parallel("build", 8, &failed)) {
+ *     for (size_t i = 0; i < strlist_count(failed); i++) {
+ *         fprintf(stderr, "Not removed: %s\n", strlist_item(failed, i));
+ *     }
+ * }
+ * guard_strlist_free(&failed);
+ * ```
+ *
+ * @param path directory to remove
+ * @param jobs maximum number of worker processes (0 or 1: remove serially)
+ * @param failed receives the paths that could not be removed (may be NULL, caller must free)
+ * @return 0 on success, -1 on error
+ */
+int rmtree_parallel(const char *path, size_t jobs, struct StrList **failed);
+
+/**
+ * Move a directory tree out of the way and remove it in the background
+ *
+ * `path` is renamed to a hidden sibling (`.name.stasis-rm-PID-N`), so it can
+ * be re-created as soon as this function returns. A child process removes the
+ * renamed tree with rmtree_parallel(). The tree is removed in the foreground
+ * when it cannot be renamed.
+ *
+ * @param path directory to remove
+ * @param jobs maximum number of worker processes used by the child
+ * @return 0 on success, -1 on error
+ */
+int rmtree_background(const char *path, size_t jobs);
+
+/**
+ * Wait for removals started by rmtree_background() to finish
+ *
+ * @return number of background removals that failed
+ */
+int rmtree_wait();
+
+/**
+ * Line visitor used by file_foreach_line()
+ *
+ * @param line line number (starting at 0)
+ * @param data start of line. Not NUL terminated. Includes the line ending, if any.
+ * @param len length of line
+ * @param arg user data passed to file_foreach_line()
+ * @return 0 to continue, <0 to stop
+ */
+typedef int (LineFn)(size_t line, const char *data, size_t len, void *arg);
 
+/**
+ * Visit each line of a file in a single pass
+ *
+ * Regular files are memory mapped and `data` points directly into the
+ * mapping. Pipes, devices and stdin (`filename` is "-") are read line by
+ * line into a reusable buffer. Lines are not limited in length. `data` is
+ * only valid until `fn` returns.
+ *
+ * ```c
+ * static int count_comments(size_t line, const char *data, size_t len, void *arg) {
+ *     if (len && *data == '#') {
+ *         (*(size_t *) arg)++;
+ *     }
+ *     return 0;
+ * }
+ *
+ * size_t comments = 0;
+ * file_foreach_line("setup.cfg", count_comments, &comments);
+ * ```
+ *
+ * @param filename path to file, or "-" to read stdin
+ * @param fn function to call for each line
+ * @param arg user data passed to `fn`
+ * @return 0 on success (including when `fn` stops early), -1 on error (errno is set)
+ */
+int file_foreach_line(const char *filename, LineFn *fn, void *arg);
+
+/**
+ * Read lines from a file into an array
+ *
+ * @param filename path to file, or "-" to read stdin
+ * @param start number of lines to skip
+ * @param limit maximum number of lines to return (0 = no limit)
+ * @param readerFn filter function (may be NULL). Receives a modifiable copy of each line,
+ * and returns 0 to keep it, >0 to skip it, or <0 to stop reading.
+ * @return NULL terminated array of lines, including their line endings (caller must free)
+ * @return NULL if the file cannot be read or is empty
+ */
 char **file_readlines(const char *filename, size_t start, size_t limit, ReaderFn *readerFn);
 
 /**
@@ -160,6 +257,7 @@ int touch(const char *filename);
  * @param destdir destination directory
  * @param gitref commit/branch/tag of checkout (NULL will use HEAD of default branch for repo)
  * @return exit code from "git"
+ * @see git_clone_script
  */
 int git_clone(struct Process *proc, char *url, char *destdir, char *gitref);
 
@@ -176,6 +176,21 @@ struct WheelValue {
     void *data;
 };
 
+enum {
+    WHEEL_ARCHIVE_WHEEL=0,
+    WHEEL_ARCHIVE_METADATA,
+    WHEEL_ARCHIVE_TOP_LEVEL,
+    WHEEL_ARCHIVE_RECORD,
+    WHEEL_ARCHIVE_ENTRY_POINTS,
+    WHEEL_ARCHIVE_ZIP_SAFE,
+    WHEEL_ARCHIVE_END_ENUM, // NOP
+};
+
+struct WheelArchive {
+    zip_t *zip; ///< Open wheel file
+    zip_int64_t member[WHEEL_ARCHIVE_END_ENUM]; ///< Archive index of each `*.dist-info/` file (-1: not present)
+};
+
 enum {
     WHEEL_PACKAGE_E_SUCCESS=0,
     WHEEL_PACKAGE_E_FILENAME=-1,
@@ -246,6 +261,58 @@ const char *wheel_get_key_by_id(int from, ssize_t id);
  */
 int wheel_get_file_contents(const char *wheelfile, const char *filename, char **contents);
 
+/**
+ * Open a Python wheel file for reading
+ *
+ * The archive's central directory is read once. The location of each
+ * `*.dist-info/` file listed by the `WHEEL_ARCHIVE_` enum is recorded, so
+ * subsequent reads do not search the archive.
+ *
+ * ```c
+ * struct WheelArchive *archive = wheel_archive_open("example-1.0.0-py3-none-any.whl");
+ * char *data = NULL;
+ * if (archive && !wheel_archive_read(archive, WHEEL_ARCHIVE_METADATA, &data)) {
+ *     puts(data);
+ *     guard_free(data);
+ * }
+ * wheel_archive_close(&archive);
+ * ```
+ *
+ * @param filename path to Python wheel file
+ * @return pointer to `WheelArchive`, or NULL on error
+ */
+struct WheelArchive *wheel_archive_open(const char *filename);
+
+/**
+ * Read a `*.dist-info/` file from an open wheel
+ * @param archive pointer to `WheelArchive`
+ * @param member `WHEEL_ARCHIVE_METADATA`, `WHEEL_ARCHIVE_RECORD` (see wheel.h)
+ * @param contents pointer to store file contents (NULL when not present)
+ * @return 0 on success, 1 if the file is not present, -1 on error
+ */
+int wheel_archive_read(struct WheelArchive *archive, int member, char **contents);
+
+/**
+ * Close a wheel opened by wheel_archive_open()
+ * @param archive pointer to `WheelArchive` (set to NULL)
+ */
+void wheel_archive_close(struct WheelArchive **archive);
+
+/**
+ * Check the contents of a Python wheel file against its `RECORD`
+ *
+ * Each member of the archive is streamed through SHA-256 and compared with
+ * the digest and size listed in `RECORD`. Members missing from `RECORD`,
+ * and `RECORD` entries missing from the archive, are also reported (on
+ * stderr).
+ *
+ * @param filename path to Python wheel file
+ * @return 0 if every member matches
+ * @return >0 the number of members that do not match
+ * @return -1 if the wheel or its `RECORD` cannot be read
+ */
+ssize_t wheel_verify_records(const char *filename);
+
 /**
  * Display the values of a `Wheel` structure in human readable format
  *
@@ -0,0 +1,97 @@
+//! @file wheelcatalog.h
+#ifndef STASIS_WHEELCATALOG_H
+#define STASIS_WHEELCATALOG_H
+
+#include "core.h"
+#include "strlist.h"
+
+#define WHEEL_CATALOG_FILENAME "catalog.txt" ///< Written to the root of a wheel artifact directory
+
+struct WheelCatalogEntry {
+    char *path; ///< Path to wheel file, relative to the scanned directory
+    size_t size; ///< Size of wheel file in bytes
+    time_t mtime; ///< Modification time of wheel file
+    char *sha256; ///< SHA-256 digest of wheel file (hexadecimal)
+    char *metadata_sha256; ///< SHA-256 digest of the wheel's `METADATA` file (hexadecimal)
+    char *name; ///< Normalized project name (PEP 503)
+    char *version; ///< Project version
+    char *requires_python; ///< Supported Python versions (NULL: any)
+    struct StrList *tag; ///< Compatibility tags (`WHEEL` Tag)
+    struct StrList *requires_dist; ///< Dependencies, including extras (`METADATA` Requires-Dist)
+};
+
+struct WheelCatalog {
+    size_t num_used; ///< Total entries
+    size_t num_alloc; ///< Total entry slots
+    struct WheelCatalogEntry *entry; ///< Entries sorted by name, then version
+};
+
+/**
+ * Record the metadata of every wheel file below a directory
+ *
+ * The `WHEEL` and `METADATA` headers of each wheel are read through a
+ * `WheelArchive`, by up to `jobs` processes at the same time. The result is
+ * written to `filename` as text:
+ *
+ * ```
+ * wheel mypkg/mypkg-1.0.0-py3-none-any.whl
+ * size 4096
+ * mtime 1700000000
+ * sha256 9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08
+ * metadata_sha256 60303ae22b998861bce3b28f33eec1be758a213c86c93c076dbe9f558c11c752
+ * name mypkg
+ * version 1.0.0
+ * requires_python >=3.10
+ * tag py3-none-any
+ * requires_dist numpy>=1.26
+ * ```
+ *
+ * When `filename` already exists, the entries of wheels with the same size
+ * and modification time are reused instead of reading (and hashing) the
+ * wheel again.
+ * Wheels that cannot be read are left out of the catalog.
+ *
+ * @param root directory containing wheel files
+ * @param filename path to catalog
+ * @param jobs maximum number of processes reading wheels
+ * @return 0 on success
+ * @return >0 the number of wheels that could not be read
+ * @return -1 on error
+ */
+ssize_t wheel_catalog_build(const char *root, const char *filename, size_t jobs);
+
+/**
+ * Read a catalog written by wheel_catalog_build()
+ *
+ * ```c
+ * struct WheelCatalog *catalog = wheel_catalog_load("wheels/" WHEEL_CATALOG_FILENAME);
+ * size_t count = 0;
+ * const struct WheelCatalogEntry *versions = wheel_catalog_find(catalog, "NumPy", &count);
+ * for (size_t i = 0; i < count; i++) {
+ *     printf("%s %s\n", versions[i].name, versions[i].version);
+ * }
+ * wheel_catalog_free(&catalog);
+ * ```
+ *
+ * @param filename path to catalog
+ * @return pointer to WheelCatalog, or NULL on error
+ */
+struct WheelCatalog *wheel_catalog_load(const char *filename);
+
+/**
+ * Find every wheel of a project
+ *
+ * @param catalog pointer to WheelCatalog
+ * @param name project name, or package spec (normalized with pkgname_normalize())
+ * @param count receives the number of entries found
+ * @return pointer to the first entry (oldest version first), or NULL if the project is not present
+ */
+const struct WheelCatalogEntry *wheel_catalog_find(const struct WheelCatalog *catalog, const char *name, size_t *count);
+
+/**
+ * Free a WheelCatalog
+ * @param catalog pointer to WheelCatalog (set to NULL)
+ */
+void wheel_catalog_free(struct WheelCatalog **catalog);
+
+#endif //STASIS_WHEELCATALOG_H
@@ -0,0 +1,36 @@
+//! @file wheelindex.h
+#ifndef STASIS_WHEELINDEX_H
+#define STASIS_WHEELINDEX_H
+
+#include "wheelcatalog.h"
+
+#define WHEEL_INDEX_API_VERSION "1.1" ///< PEP 691 API version of generated pages
+
+/**
+ * Generate a static "simple" package index for a directory of wheel files
+ *
+ * The directory is cataloged with wheel_catalog_build() (so wheel digests
+ * are only computed for new or modified files), then:
+ *
+ * - `root/index.html` and `root/index.json` list every project (PEP 503, PEP 691)
+ * - `root/{name}/index.html` and `root/{name}/index.json` list the wheels of
+ *   a project. `{name}` is the normalized project name. Links carry a
+ *   `#sha256=` fragment, `data-requires-python` and `data-core-metadata`.
+ * - `{wheel}.metadata` holds a copy of each wheel's `METADATA` file (PEP 658)
+ *
+ * Wheels may be stored anywhere below `root`. Project pages link to them
+ * with relative URLs.
+ *
+ * ```shell
+ * pip install --index-url file:///path/to/root mypkg
+ * ```
+ *
+ * @param root directory containing wheel files
+ * @param jobs maximum number of processes reading wheels
+ * @return 0 on success
+ * @return >0 the number of wheels that could not be read (and were not indexed)
+ * @return -1 on error
+ */
+ssize_t wheel_index_build(const char *root, size_t jobs);
+
+#endif //STASIS_WHEELINDEX_H
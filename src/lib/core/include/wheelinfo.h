@@ -20,17 +20,89 @@ struct WheelInfo {
     char *file_name; ///< Name of package on-disk
 };
 
+struct WheelNameToken {
+    const char *data; ///< Start of token (not NUL terminated)
+    size_t len; ///< Length of token (0: not present)
+};
+
+struct WheelName {
+    struct WheelNameToken distribution; ///< Package name
+    struct WheelNameToken version; ///< Package version
+    struct WheelNameToken build_tag; ///< Package build tag (optional)
+    struct WheelNameToken python_tag; ///< Package Python tag (pyXY)
+    struct WheelNameToken abi_tag; ///< Package ABI tag (cpXY, abiX, none)
+    struct WheelNameToken platform_tag; ///< Package platform tag (linux_x86_64, any)
+};
+
 /**
- * Extract metadata from a Python Wheel file name
+ * Split a Python Wheel file name into its components
+ *
+ * Nothing is allocated. Each token points into `filename`.
+ *
+ * ```c
+ * struct WheelName name;
+ * if (!wheelinfo_tokenize("example-1.0.0-py3-none-any.whl", &name)) {
+ *     printf("%.*s\n", (int) name.version.len, name.version.data);
+ * }
+ * ```
+ *
+ * @param filename name of wheel file (`{distribution}-{version}(-{build tag})?-{python tag}-{abi tag}-{platform tag}.whl`)
+ * @param result receives the tokens
+ * @return 0 on success
+ * @return -1 if `filename` is not a wheel file name
+ */
+int wheelinfo_tokenize(const char *filename, struct WheelName *result);
+
+/**
+ * Find the best wheel file for a package
+ *
+ * Wheel file names are read from `basepath/name` once, and read again only
+ * after the directory is modified. Each candidate is scored by:
+ *
+ * 1. the number of patterns found in the file name
+ * 2. a pattern found in the Python tag, then the ABI tag, then the platform tag
+ * 3. the highest version, then the highest build tag
  *
  * @param basepath directory containing a wheel file
- * @param name of wheel file
+ * @param name of package (compared to the wheel's distribution name, as in PEP 503)
  * @param to_match a NULL terminated array of patterns (i.e. platform, arch, version, etc)
  * @param match_mode WHEEL_MATCH_EXACT
  * @param match_mode WHEEL_MATCH ANY
  * @return pointer to populated Wheel on success
- * @return NULL on error
+ * @return NULL on error, or if no wheel matches
  */
 struct WheelInfo *wheelinfo_get(const char *basepath, const char *name, char *to_match[], unsigned match_mode);
+
+struct WheelCatalog;
+
+/**
+ * Find the best wheel file for a package in a wheel catalog
+ *
+ * Candidates are scored like wheelinfo_get(), but come from the catalog
+ * instead of a directory listing.
+ *
+ * ```c
+ * struct WheelCatalog *catalog = wheel_catalog_load("wheels/" WHEEL_CATALOG_FILENAME);
+ * struct WheelInfo *wheel = wheelinfo_get_cataloged(catalog, "wheels", "mypkg", (char *[]) {"py3", NULL}, WHEEL_MATCH_ANY);
+ * // wheel->path_name == "/absolute/path/to/wheels/mypkg"
+ * wheelinfo_free(&wheel);
+ * wheel_catalog_free(&catalog);
+ * ```
+ *
+ * @param catalog pointer to WheelCatalog
+ * @param basepath directory described by the catalog
+ * @param name of package (compared as in PEP 503)
+ * @param to_match a NULL terminated array of patterns (i.e. platform, arch, version, etc)
+ * @param match_mode WHEEL_MATCH_EXACT
+ * @param match_mode WHEEL_MATCH ANY
+ * @return pointer to populated Wheel on success
+ * @return NULL on error, or if no wheel matches
+ */
+struct WheelInfo *wheelinfo_get_cataloged(const struct WheelCatalog *catalog, const char *basepath, const char *name, char *to_match[], unsigned match_mode);
 void wheelinfo_free(struct WheelInfo **wheel);
+
+/**
+ * Forget directory listings read by wheelinfo_get()
+ */
+void wheelinfo_cache_clear();
 #endif //STASIS_WHEEL_H
@@ -0,0 +1,395 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include "indexcache.h"
+#include "conda.h"
+#include "pkgname.h"
+#include "system.h"
+#include "utils.h"
+
+static struct IndexCacheStats index_cache_counters = {0};
+
+const struct IndexCacheStats *index_cache_stats() {
+    return &index_cache_counters;
+}
+
+int index_cache_package_name(const char *spec, char *result, size_t maxlen) {
+    return pkgname_normalize(spec, result, maxlen);
+}
+
+/**
+ * Describe the environment a package manager answers for
+ *
+ * pip's answer depends on the interpreter it runs under (`data-requires-python`,
+ * wheel tags), so its target is the active interpreter's cache tag and
+ * platform, e.g. `cpython-311-linux-x86_64`. The interpreter is queried again
+ * whenever PATH changes (i.e. a different environment is activated). conda's
+ * answer only depends on the platform.
+ *
+ * @param mode PKG_USE_PIP or PKG_USE_CONDA
+ * @param result destination buffer
+ * @param maxlen size of destination buffer
+ * @return 0 on success, -1 if the target cannot be determined
+ */
+static int index_cache_target(int mode, char *result, size_t maxlen) {
+    static uint64_t pip_target_path = 0;
+    static char pip_target[255] = {0};
+
+    if (mode == PKG_USE_CONDA) {
+        struct utsname sys;
+        if (uname(&sys) < 0) {
+            return -1;
+        }
+        snprintf(result, maxlen, "%s-%s", sys.sysname, sys.machine);
+    } else {
+        // FNV-1a of PATH. Zero means the interpreter has not been queried yet.
+        uint64_t path_hash = 0xcbf29ce484222325ULL;
+        for (const char *ch = getenv("PATH") ? getenv("PATH") : ""; *ch; ch++) {
+            path_hash ^= (unsigned char) *ch;
+            path_hash *= 0x100000001b3ULL;
+        }
+        if (pip_target_path != path_hash) {
+            int status = 0;
+            char *output = shell_output("python -c 'import sys, sysconfig; print(sys.implementation.cache_tag + \"-\" + sysconfig.get_platform())' 2>/dev/null", &status);
+            memset(pip_target, 0, sizeof(pip_target));
+            if (output && !status) {
+                strncpy(pip_target, output, sizeof(pip_target) - 1);
+                strip(pip_target);
+            }
+            guard_free(output);
+            pip_target_path = path_hash;
+        }
+        if (!*pip_target) {
+            return -1;
+        }
+        strncpy(result, pip_target, maxlen - 1);
+        result[maxlen - 1] = '\0';
+    }
+
+    tolower_s(result);
+    for (char *ch = result; *ch; ch++) {
+        if (!isalnum((unsigned char) *ch) && !strchr(".-", *ch)) {
+            *ch = '-';
+        }
+    }
+    return 0;
+}
+
+/**
+ * Populate an IndexCacheEntry's paths for a package
+ *
+ * Metadata is grouped by package manager, index and target (see index_cache_target()):
+ * `{index_cache_dir}/{pip|conda}-{sanitized index}/{target}/{name}.{meta|html}`
+ */
+static int index_cache_entry_init(struct IndexCacheEntry *entry, int mode, const char *index, const char *spec) {
+    char name[255] = {0};
+    char index_key[200] = {0};
+    char target[200] = {0};
+
+    memset(entry, 0, sizeof(*entry));
+    if (!globals.enable_index_cache || isempty(globals.index_cache_dir)) {
+        return -1;
+    }
+    if (index_cache_package_name(spec, name, sizeof(name))) {
+        return -1;
+    }
+    if (index_cache_target(mode, target, sizeof(target))) {
+        SYSDEBUG("%s", "index cache is unavailable: unable to determine the target environment");
+        return -1;
+    }
+
+    snprintf(index_key, sizeof(index_key), "%s-%s", mode == PKG_USE_CONDA ? "conda" : "pip", index && *index ? index : "default");
+    for (char *ch = index_key; *ch; ch++) {
+        if (!isalnum((unsigned char) *ch) && !strchr(".-", *ch)) {
+            *ch = '_';
+        }
+    }
+
+    snprintf(entry->path, sizeof(entry->path), "%s/%s/%s/%s.meta", globals.index_cache_dir, index_key, target, name);
+    snprintf(entry->page, sizeof(entry->page), "%s/%s/%s/%s.html", globals.index_cache_dir, index_key, target, name);
+
+    // Only simple index pages served over HTTP(S) can be revalidated
+    if (mode == PKG_USE_PIP && index && (startswith(index, "http://") || startswith(index, "https://"))) {
+        const char *sep = endswith(index, "/") ? "" : "/";
+        snprintf(entry->url, sizeof(entry->url), "%s%s%s/", index, sep, name);
+    }
+
+    entry->results = strlist_init();
+    if (!entry->results) {
+        return -1;
+    }
+    return 0;
+}
+
+static void index_cache_entry_free(struct IndexCacheEntry *entry) {
+    guard_strlist_free(&entry->results);
+}
+
+static void index_cache_entry_load(struct IndexCacheEntry *entry) {
+    char line[PATH_MAX + 32];
+
+    FILE *fp = fopen(entry->path, "r");
+    if (!fp) {
+        return;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *value = strchr(line, ' ');
+        if (!value) {
+            continue;
+        }
+        *value++ = '\0';
+
+        if (!strcmp(line, "etag")) {
+            strncpy(entry->validator.etag, value, sizeof(entry->validator.etag) - 1);
+        } else if (!strcmp(line, "last_modified")) {
+            strncpy(entry->validator.last_modified, value, sizeof(entry->validator.last_modified) - 1);
+        } else if (!strcmp(line, "checked")) {
+            entry->checked = (time_t) strtoll(value, NULL, 10);
+        } else if (!strcmp(line, "http_code")) {
+            entry->http_code = strtol(value, NULL, 10);
+        } else if (!strcmp(line, "result")) {
+            strlist_append(&entry->results, value);
+        }
+    }
+    fclose(fp);
+}
+
+static int index_cache_entry_save(const struct IndexCacheEntry *entry) {
+    char tempfile[PATH_MAX + 10];
+    char *dir = path_dirname(strdup(entry->path));
+
+    if (!dir || mkdirs(dir, 0755)) {
+        SYSDEBUG("index cache is unavailable: %s", dir ? dir : entry->path);
+        guard_free(dir);
+        return -1;
+    }
+    guard_free(dir);
+
+    // Concurrent readers never see a partial file
+    snprintf(tempfile, sizeof(tempfile), "%s.%d", entry->path, (int) getpid());
+    FILE *fp = fopen(tempfile, "w");
+    if (!fp) {
+        return -1;
+    }
+    fprintf(fp, "url %s\n", entry->url);
+    if (*entry->validator.etag) {
+        fprintf(fp, "etag %s\n", entry->validator.etag);
+    }
+    if (*entry->validator.last_modified) {
+        fprintf(fp, "last_modified %s\n", entry->validator.last_modified);
+    }
+    fprintf(fp, "checked %lld\n", (long long) entry->checked);
+    fprintf(fp, "http_code %ld\n", entry->http_code);
+    for (size_t i = 0; i < strlist_count(entry->results); i++) {
+        fprintf(fp, "result %s\n", strlist_item(entry->results, i));
+    }
+    if (fclose(fp) || rename(tempfile, entry->path)) {
+        remove(tempfile);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Normalize a spec the same way pkg_index_provides() does
+ */
+static void index_cache_spec(const char *spec, char *result, size_t maxlen) {
+    memset(result, 0, maxlen);
+    strncpy(result, spec, maxlen - 1);
+    tolower_s(result);
+    lstrip(result);
+    strip(result);
+}
+
+/**
+ * Find a cached result
+ * @param entry pointer to IndexCacheEntry
+ * @param spec normalized spec
+ * @param ttl maximum age of result in seconds (negative: any age)
+ * @param index_of receives the position of the result in entry->results (may be NULL)
+ * @return PKG_FOUND, PKG_NOT_FOUND, or -1 if not cached (or expired)
+ */
+static int index_cache_entry_result(const struct IndexCacheEntry *entry, const char *spec, long ttl, ssize_t *index_of) {
+    if (index_of) {
+        *index_of = -1;
+    }
+
+    for (size_t i = 0; i < strlist_count(entry->results); i++) {
+        const char *item = strlist_item(entry->results, i);
+        int result = 0;
+        long long when = 0;
+        int consumed = 0;
+
+        if (sscanf(item, "%d %lld %n", &result, &when, &consumed) != 2 || strcmp(item + consumed, spec) != 0) {
+            continue;
+        }
+        if (index_of) {
+            *index_of = (ssize_t) i;
+        }
+        if (ttl >= 0 && time(NULL) - (time_t) when >= ttl) {
+            return -1;
+        }
+        return result;
+    }
+    return -1;
+}
+
+/**
+ * Answer a query using only the index page
+ *
+ * Only a missing project can be answered this way. Whether a listed file is
+ * installable (`data-requires-python`, `data-yanked`, wheel tags) is left to
+ * the package manager.
+ *
+ * @return PKG_NOT_FOUND, or -1 if the page is not enough
+ */
+static int index_cache_entry_page(const struct IndexCacheEntry *entry) {
+    if (*entry->url && entry->http_code == 404) {
+        // The project does not exist. No version of it can be found.
+        return PKG_NOT_FOUND;
+    }
+    return -1;
+}
+
+/**
+ * Bring an expired entry up to date
+ * @return 0 if the entry is usable
+ * @return 1 if the entry is usable, but the index could not be reached (stale)
+ * @return -1 if the entry is not usable
+ */
+static int index_cache_entry_revalidate(struct IndexCacheEntry *entry) {
+    char *errmsg = NULL;
+    const time_t now = time(NULL);
+
+    if (entry->checked && now - entry->checked < globals.index_cache_ttl) {
+        return 0;
+    }
+    if (!*entry->url) {
+        // Results expire individually
+        return 0;
+    }
+
+    char *dir = path_dirname(strdup(entry->page));
+    if (!dir || mkdirs(dir, 0755)) {
+        guard_free(dir);
+        return -1;
+    }
+    guard_free(dir);
+
+    // Without a cached page there is nothing to validate against
+    if (access(entry->page, F_OK)) {
+        memset(&entry->validator, 0, sizeof(entry->validator));
+    }
+
+    const long http_code = download_revalidate(entry->url, entry->page, &entry->validator, &errmsg);
+    if (http_code == 304) {
+        index_cache_counters.revalidated++;
+    } else if (http_code == 200 || http_code == 404) {
+        // The index changed. Previous answers are no longer reliable.
+        guard_strlist_free(&entry->results);
+        entry->results = strlist_init();
+        entry->http_code = http_code;
+        if (http_code == 404) {
+            memset(&entry->validator, 0, sizeof(entry->validator));
+            remove(entry->page);
+        }
+    } else {
+        SYSDEBUG("Unable to revalidate %s (HTTP %ld): %s", entry->url, http_code, errmsg ? errmsg : "");
+        guard_free(errmsg);
+        if (globals.index_cache_stale && entry->checked) {
+            fprintf(stderr, "Using stale package index metadata: %s\n", entry->url);
+            index_cache_counters.stale++;
+            return 1;
+        }
+        return -1;
+    }
+    guard_free(errmsg);
+
+    entry->checked = now;
+    return index_cache_entry_save(entry);
+}
+
+int index_cache_lookup(int mode, const char *index, const char *spec, int *result) {
+    struct IndexCacheEntry entry;
+    char spec_local[255];
+
+    if (index_cache_entry_init(&entry, mode, index, spec)) {
+        return -1;
+    }
+    index_cache_entry_load(&entry);
+    index_cache_spec(spec, spec_local, sizeof(spec_local));
+
+    int cached = -1;
+    const int usable = index_cache_entry_revalidate(&entry);
+    if (usable >= 0) {
+        cached = index_cache_entry_page(&entry);
+        if (cached < 0) {
+            // Results expire on their own, and earlier if the index page changes
+            cached = index_cache_entry_result(&entry, spec_local, usable ? -1 : globals.index_cache_ttl, NULL);
+        }
+    }
+    index_cache_entry_free(&entry);
+
+    if (cached < 0) {
+        index_cache_counters.misses++;
+        return -1;
+    }
+    index_cache_counters.hits++;
+    *result = cached;
+    return 0;
+}
+
+int index_cache_lookup_stale(int mode, const char *index, const char *spec, int *result) {
+    struct IndexCacheEntry entry;
+    char spec_local[255];
+
+    if (!globals.index_cache_stale || index_cache_entry_init(&entry, mode, index, spec)) {
+        return -1;
+    }
+    index_cache_entry_load(&entry);
+    index_cache_spec(spec, spec_local, sizeof(spec_local));
+
+    int cached = index_cache_entry_page(&entry);
+    if (cached < 0) {
+        cached = index_cache_entry_result(&entry, spec_local, -1, NULL);
+    }
+    index_cache_entry_free(&entry);
+
+    if (cached < 0) {
+        return -1;
+    }
+    index_cache_counters.stale++;
+    *result = cached;
+    return 0;
+}
+
+int index_cache_store(int mode, const char *index, const char *spec, int result) {
+    struct IndexCacheEntry entry;
+    char spec_local[255];
+    ssize_t index_of = -1;
+
+    if (result != PKG_FOUND && result != PKG_NOT_FOUND) {
+        // Errors are never cached
+        return -1;
+    }
+    if (index_cache_entry_init(&entry, mode, index, spec)) {
+        return -1;
+    }
+    index_cache_entry_load(&entry);
+    index_cache_spec(spec, spec_local, sizeof(spec_local));
+
+    index_cache_entry_result(&entry, spec_local, -1, &index_of);
+    if (index_of >= 0) {
+        strlist_remove(entry.results, (size_t) index_of);
+    }
+    strlist_appendf(&entry.results, "%d %lld %s", result, (long long) time(NULL), spec_local);
+    if (!entry.checked) {
+        entry.checked = time(NULL);
+    }
+
+    const int status = index_cache_entry_save(&entry);
+    index_cache_entry_free(&entry);
+    return status;
+}
@@ -2,9 +2,238 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "core.h"
 #include "ini.h"
 
+#define INI_ARENA_BLOCK_MIN (64 * 1024)
+
+struct INIArenaBlock {
+    struct INIArenaBlock *next;      ///< Previously filled block
+    size_t size;                     ///< Usable bytes
+    size_t used;                     ///< Bytes handed out
+    char data[];
+};
+
+struct INIArena {
+    struct INIArenaBlock *block;     ///< Current block (head of list)
+    char *last;                      ///< Most recent allocation (may be extended in place)
+};
+
+static struct INIArena *ini_arena_init(size_t size_hint) {
+    struct INIArena *arena = calloc(1, sizeof(*arena));
+    if (!arena) {
+        return NULL;
+    }
+    const size_t size = size_hint > INI_ARENA_BLOCK_MIN ? size_hint : INI_ARENA_BLOCK_MIN;
+    arena->block = malloc(sizeof(*arena->block) + size);
+    if (!arena->block) {
+        guard_free(arena);
+        return NULL;
+    }
+    arena->block->next = NULL;
+    arena->block->size = size;
+    arena->block->used = 0;
+    return arena;
+}
+
+static void ini_arena_free(struct INIArena **arena) {
+    if (!*arena) {
+        return;
+    }
+    for (struct INIArenaBlock *block = (*arena)->block; block != NULL;) {
+        struct INIArenaBlock *next = block->next;
+        guard_free(block);
+        block = next;
+    }
+    guard_free(*arena);
+}
+
+static void *ini_arena_alloc(struct INIArena *arena, size_t size) {
+    // Keep every allocation suitably aligned for INISection and INIData records
+    const size_t align = sizeof(void *) * 2;
+    size_t offset = (arena->block->used + align - 1) & ~(align - 1);
+
+    if (offset + size > arena->block->size) {
+        const size_t block_size = size > INI_ARENA_BLOCK_MIN ? size : INI_ARENA_BLOCK_MIN;
+        struct INIArenaBlock *block = malloc(sizeof(*block) + block_size);
+        if (!block) {
+            return NULL;
+        }
+        block->next = arena->block;
+        block->size = block_size;
+        block->used = 0;
+        arena->block = block;
+        offset = 0;
+    }
+    arena->block->used = offset + size;
+    arena->last = arena->block->data + offset;
+    return arena->last;
+}
+
+static char *ini_arena_strdup(struct INIArena *arena, const char *s) {
+    const size_t len = strlen(s);
+    char *result = ini_arena_alloc(arena, len + 1);
+    if (result) {
+        memcpy(result, s, len + 1);
+    }
+    return result;
+}
+
+static int ini_arena_owns(const struct INIArena *arena, const void *ptr) {
+    if (!arena || !ptr) {
+        return 0;
+    }
+    for (const struct INIArenaBlock *block = arena->block; block != NULL; block = block->next) {
+        if ((const char *) ptr >= block->data && (const char *) ptr < block->data + block->size) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Append a string to an arena string
+ *
+ * Multi-line values are appended one line at a time. The value being read
+ * is always the most recent allocation, so it grows in place.
+ *
+ * @return pointer to the combined string (may differ from `s`), or NULL on error
+ */
+static char *ini_arena_strcat(struct INIArena *arena, char *s, const char *append) {
+    const size_t len = strlen(s);
+    const size_t append_len = strlen(append);
+
+    if (s == arena->last && (size_t) (s - arena->block->data) + len + append_len + 1 <= arena->block->size) {
+        arena->block->used = (size_t) (s - arena->block->data) + len + append_len + 1;
+    } else {
+        char *result = ini_arena_alloc(arena, len + append_len + 1);
+        if (!result) {
+            return NULL;
+        }
+        memcpy(result, s, len);
+        s = result;
+    }
+    memcpy(s + len, append, append_len + 1);
+    return s;
+}
+
+static size_t ini_index_hash(const char *key) {
+    // FNV-1a
+    size_t hash = (size_t) 14695981039346656037ULL;
+    for (const char *ch = key; *ch; ch++) {
+        hash ^= (unsigned char) *ch;
+        hash *= (size_t) 1099511628211ULL;
+    }
+    return hash;
+}
+
+static struct INIIndex *ini_index_init(size_t count) {
+    struct INIIndex *index = calloc(1, sizeof(*index));
+    if (!index) {
+        return NULL;
+    }
+    // Keep the table at most half full
+    index->num_alloc = 16;
+    while (index->num_alloc < count * 2) {
+        index->num_alloc *= 2;
+    }
+    index->key = calloc(index->num_alloc, sizeof(*index->key));
+    index->value = calloc(index->num_alloc, sizeof(*index->value));
+    if (!index->key || !index->value) {
+        guard_free(index->key);
+        guard_free(index->value);
+        guard_free(index);
+        return NULL;
+    }
+    return index;
+}
+
+static void ini_index_destroy(struct INIIndex **index) {
+    if (!*index) {
+        return;
+    }
+    guard_free((*index)->key);
+    guard_free((*index)->value);
+    guard_free(*index);
+}
+
+static void *ini_index_get(const struct INIIndex *index, const char *key) {
+    const size_t mask = index->num_alloc - 1;
+    for (size_t slot = ini_index_hash(key) & mask; index->key[slot]; slot = (slot + 1) & mask) {
+        if (!strcmp(index->key[slot], key)) {
+            return index->value[slot];
+        }
+    }
+    return NULL;
+}
+
+static int ini_index_insert(struct INIIndex **index, const char *key, void *value) {
+    if (!*index || !key) {
+        return -1;
+    }
+
+    if (((*index)->num_used + 1) * 2 > (*index)->num_alloc) {
+        struct INIIndex *bigger = ini_index_init((*index)->num_used + 1);
+        if (!bigger) {
+            // Lookups still work. They will only get slower.
+            return -1;
+        }
+        for (size_t i = 0; i < (*index)->num_alloc; i++) {
+            if ((*index)->key[i]) {
+                ini_index_insert(&bigger, (*index)->key[i], (*index)->value[i]);
+            }
+        }
+        ini_index_destroy(index);
+        *index = bigger;
+    }
+
+    const size_t mask = (*index)->num_alloc - 1;
+    size_t slot = ini_index_hash(key) & mask;
+    for (; (*index)->key[slot]; slot = (slot + 1) & mask) {
+        if (!strcmp((*index)->key[slot], key)) {
+            // The first record with this name wins
+            return 0;
+        }
+    }
+    (*index)->key[slot] = key;
+    (*index)->value[slot] = value;
+    (*index)->num_used++;
+    return 0;
+}
+
+void ini_index_free(struct INIFILE *ini) {
+    for (size_t i = 0; i < ini->section_count; i++) {
+        ini_index_destroy(&ini->section[i]->index);
+    }
+    ini_index_destroy(&ini->index);
+}
+
+int ini_index_build(struct INIFILE *ini) {
+    ini_index_free(ini);
+
+    ini->index = ini_index_init(ini->section_count);
+    if (!ini->index) {
+        return -1;
+    }
+    for (size_t i = 0; i < ini->section_count; i++) {
+        struct INISection *section = ini->section[i];
+        ini_index_insert(&ini->index, section->key, section);
+
+        section->index = ini_index_init(section->data_count);
+        if (!section->index) {
+            ini_index_free(ini);
+            return -1;
+        }
+        for (size_t k = 0; k < section->data_count; k++) {
+            ini_index_insert(&section->index, section->data[k]->key, section->data[k]);
+        }
+    }
+    return 0;
+}
+
 struct INIFILE *ini_init() {
     struct INIFILE *ini = calloc(1, sizeof(*ini));
     ini->section_count = 0;
@@ -13,10 +242,14 @@ struct INIFILE *ini_init() {
 
 void ini_section_init(struct INIFILE **ini) {
     (*ini)->section = calloc((*ini)->section_count + 1, sizeof(**(*ini)->section));
+    (*ini)->section_alloc = (*ini)->section ? (*ini)->section_count + 1 : 0;
 }
 
 struct INISection *ini_section_search(struct INIFILE **ini, unsigned mode, const char *value) {
     struct INISection *result = NULL;
+    if (mode == INI_SEARCH_EXACT && (*ini)->index) {
+        return ini_index_get((*ini)->index, value);
+    }
     for (size_t i = 0; i < (*ini)->section_count; i++) {
         if ((*ini)->section[i]->key != NULL) {
             if (mode == INI_SEARCH_EXACT) {
@@ -57,6 +290,9 @@ int ini_has_key(struct INIFILE *ini, const char *section_name, const char *key)
     if (!section) {
         return 0;
     }
+    if (section->index) {
+        return ini_index_get(section->index, key) != NULL;
+    }
     for (size_t i = 0; i < section->data_count; i++) {
         const struct INIData *data = section->data[i];
         if (data && data->key) {
@@ -75,6 +311,9 @@ struct INIData *ini_data_get(struct INIFILE *ini, char *section_name, char *key)
     if (!section) {
         return NULL;
     }
+    if (section->index) {
+        return ini_index_get(section->index, key);
+    }
 
     for (size_t i = 0; i < section->data_count; i++) {
         if (section->data[i]->key != NULL) {
@@ -113,8 +352,8 @@ struct INIData *ini_getall(struct INIFILE *ini, char *section_name) {
 
 int ini_getval(struct INIFILE *ini, char *section_name, char *key, int type, int flags, union INIVal *result) {
     char *token = NULL;
-    char tbuf[STASIS_BUFSIZ];
-    char *tbufp = tbuf;
+    char *tbuf = NULL;
+    char *tbufp = NULL;
     struct INIData *data = ini_data_get(ini, section_name, key);
     if (!data) {
         result->as_char_p = NULL;
@@ -123,7 +362,11 @@ int ini_getval(struct INIFILE *ini, char *section_name, char *key, int type, int
 
     char *data_copy = strdup(data->value);
     if (flags == INI_READ_RENDER) {
-        char *render = tpl_render(data_copy);
+        // Values are parsed once, no matter how many times they are read
+        if (!data->tpl) {
+            data->tpl = tpl_compile(data->value);
+        }
+        char *render = tpl_render_compiled(data->tpl);
         if (render && strcmp(render, data_copy) != 0) {
             guard_free(data_copy);
             data_copy = render;
@@ -177,19 +420,24 @@ int ini_getval(struct INIFILE *ini, char *section_name, char *key, int type, int
             }
             break;
         case INIVAL_TYPE_STR_ARRAY:
-            strncpy(tbufp, data_copy, sizeof(tbuf) - 1);
-            guard_free(data_copy);
-            data_copy = calloc(STASIS_BUFSIZ, sizeof(*data_copy));
+            // Removing blank lines never makes the value longer
+            tbuf = data_copy;
+            tbufp = tbuf;
+            data_copy = calloc(strlen(tbuf) + 2, sizeof(*data_copy));
             if (!data_copy) {
+                guard_free(tbuf);
                 return -1;
             }
-            while ((token = strsep(&tbufp, "\n")) != NULL) {
+            for (size_t len = 0; (token = strsep(&tbufp, "\n")) != NULL;) {
                 //lstrip(token);
                 if (!isempty(token)) {
-                    strncat(data_copy, token, BUFSIZ - strlen(data_copy) - 1);
-                    strncat(data_copy, "\n", BUFSIZ - strlen(data_copy) - 1);
+                    const size_t token_len = strlen(token);
+                    memcpy(data_copy + len, token, token_len);
+                    len += token_len;
+                    data_copy[len++] = '\n';
                 }
             }
+            guard_free(tbuf);
             strip(data_copy);
             result->as_char_p = strdup(data_copy);
             break;
@@ -315,33 +563,61 @@ int ini_data_append(struct INIFILE **ini, char *section_name, char *key, char *v
         return 1;
     }
 
-    struct INIData **tmp = realloc(section->data, (section->data_count + 1) * sizeof(**section->data));
-    if (tmp == NULL) {
-        return 1;
-    } else {
+    if (section->data_count + 1 > section->data_alloc) {
+        const size_t data_alloc = section->data_alloc ? section->data_alloc * 2 : 16;
+        struct INIData **tmp = realloc(section->data, data_alloc * sizeof(**section->data));
+        if (tmp == NULL) {
+            return 1;
+        }
         section->data = tmp;
+        section->data_alloc = data_alloc;
     }
+    struct INIArena *arena = (*ini)->arena;
     if (!ini_data_get((*ini), section_name, key)) {
         struct INIData **data = section->data;
-        data[section->data_count] = calloc(1, sizeof(*data[0]));
+        if (arena) {
+            data[section->data_count] = ini_arena_alloc(arena, sizeof(*data[0]));
+            if (data[section->data_count]) {
+                memset(data[section->data_count], 0, sizeof(*data[0]));
+            }
+        } else {
+            data[section->data_count] = calloc(1, sizeof(*data[0]));
+        }
         if (!data[section->data_count]) {
             SYSERROR("Unable to allocate %zu bytes for section data", sizeof(*data[0]));
             return -1;
         }
         data[section->data_count]->type_hint = hint;
-        data[section->data_count]->key = key ? strdup(key) : strdup("");
+        if (arena) {
+            data[section->data_count]->key = ini_arena_strdup(arena, key ? key : "");
+        } else {
+            data[section->data_count]->key = key ? strdup(key) : strdup("");
+        }
         if (!data[section->data_count]->key) {
             SYSERROR("Unable to allocate data key%s", "");
             return -1;
         }
-        data[section->data_count]->value = strdup(value);
+        data[section->data_count]->value = arena ? ini_arena_strdup(arena, value) : strdup(value);
         if (!data[section->data_count]->value) {
             SYSERROR("Unable to allocate data value%s", "");
             return -1;
         }
+        if (section->index) {
+            ini_index_insert(&section->index, data[section->data_count]->key, data[section->data_count]);
+        }
         section->data_count++;
     } else {
         struct INIData *data = ini_data_get(*ini, section_name, key);
+        if (ini_arena_owns(arena, data->value)) {
+            char *value_tmp = ini_arena_strcat(arena, data->value, value);
+            if (!value_tmp) {
+                SYSERROR("Unable to increase data->value size to %zu bytes", strlen(data->value) + strlen(value) + 1);
+                return -1;
+            }
+            data->value = value_tmp;
+            tpl_compiled_free(&data->tpl);
+            return 0;
+        }
         size_t value_len_old = strlen(data->value);
         size_t value_len = strlen(value);
         size_t value_len_new = value_len_old + value_len;
@@ -354,6 +630,7 @@ int ini_data_append(struct INIFILE **ini, char *section_name, char *key, char *v
             data->value = value_tmp;
         }
         strncat(data->value, value, value_len_new - strlen(data->value));
+        tpl_compiled_free(&data->tpl);
     }
     return 0;
 }
@@ -373,7 +650,12 @@ int ini_setval(struct INIFILE **ini, unsigned type, char *section_name, char *ke
         } else {
             struct INIData *data = ini_data_get(*ini, section_name, key);
             if (data) {
+                if (ini_arena_owns((*ini)->arena, data->value)) {
+                    // Released by ini_free()
+                    data->value = NULL;
+                }
                 guard_free(data->value);
+                tpl_compiled_free(&data->tpl);
                 data->value = strdup(value);
                 if (!data->value) {
                     // allocation failed
@@ -389,23 +671,39 @@ int ini_setval(struct INIFILE **ini, unsigned type, char *section_name, char *ke
 }
 
 int ini_section_create(struct INIFILE **ini, char *key) {
-    struct INISection **tmp = realloc((*ini)->section, ((*ini)->section_count + 1) * sizeof(**(*ini)->section));
-    if (tmp == NULL) {
-        return 1;
-    } else {
+    if ((*ini)->section_count + 1 > (*ini)->section_alloc) {
+        const size_t section_alloc = (*ini)->section_alloc ? (*ini)->section_alloc * 2 : 16;
+        struct INISection **tmp = realloc((*ini)->section, section_alloc * sizeof(**(*ini)->section));
+        if (tmp == NULL) {
+            return 1;
+        }
         (*ini)->section = tmp;
+        (*ini)->section_alloc = section_alloc;
     }
 
-    (*ini)->section[(*ini)->section_count] = calloc(1, sizeof(*(*ini)->section[0]));
+    struct INIArena *arena = (*ini)->arena;
+    if (arena) {
+        (*ini)->section[(*ini)->section_count] = ini_arena_alloc(arena, sizeof(*(*ini)->section[0]));
+        if ((*ini)->section[(*ini)->section_count]) {
+            memset((*ini)->section[(*ini)->section_count], 0, sizeof(*(*ini)->section[0]));
+        }
+    } else {
+        (*ini)->section[(*ini)->section_count] = calloc(1, sizeof(*(*ini)->section[0]));
+    }
     if (!(*ini)->section[(*ini)->section_count]) {
         return -1;
     }
 
-    (*ini)->section[(*ini)->section_count]->key = strdup(key);
+    (*ini)->section[(*ini)->section_count]->key = arena ? ini_arena_strdup(arena, key) : strdup(key);
     if (!(*ini)->section[(*ini)->section_count]->key) {
         return -1;
     }
 
+    if ((*ini)->index) {
+        struct INISection *section = (*ini)->section[(*ini)->section_count];
+        section->index = ini_index_init(0);
+        ini_index_insert(&(*ini)->index, section->key, section);
+    }
     (*ini)->section_count++;
     return 0;
 }
@@ -421,13 +719,14 @@ int ini_write(struct INIFILE *ini, FILE **stream, unsigned mode) {
 
         for (size_t y = 0; y < ini->section[x]->data_count; y++) {
             struct INIData *data = section->data[y];
-            char outvalue[STASIS_BUFSIZ];
             char *key = data->key;
             char *value = data->value;
             unsigned *hint = &data->type_hint;
-            memset(outvalue, 0, sizeof(outvalue));
 
             if (key && value) {
+                // Large enough for the value plus the indentation and line separators added below
+                size_t outvalue_size = STASIS_BUFSIZ;
+                char *outvalue = NULL;
                 int err = 0;
                 char *xvalue = NULL;
                 if (*hint == INIVAL_TYPE_STR_ARRAY) {
@@ -438,6 +737,16 @@ int ini_write(struct INIFILE *ini, FILE **stream, unsigned mode) {
                     value = xvalue;
                 }
                 char **parts = split(value, LINE_SEP, 0);
+                for (size_t p = 0; parts && parts[p] != NULL; p++) {
+                    outvalue_size += strlen(parts[p]) + strlen("    " LINE_SEP);
+                }
+                outvalue = calloc(outvalue_size, sizeof(*outvalue));
+                if (!outvalue) {
+                    SYSERROR("Unable to allocate %zu bytes for value of %s", outvalue_size, key);
+                    guard_array_free(parts);
+                    guard_free(value);
+                    return -1;
+                }
                 for (size_t p = 0; parts && parts[p] != NULL; p++) {
                     char *render = NULL;
                     if (mode == INI_WRITE_PRESERVE) {
@@ -448,18 +757,37 @@ int ini_write(struct INIFILE *ini, FILE **stream, unsigned mode) {
 
                     if (!render) {
                         SYSERROR("%s", "rendered string value can never be NULL!\n");
+                        guard_array_free(parts);
+                        guard_free(outvalue);
+                        guard_free(value);
                         return -1;
                     }
+                    if (mode == INI_WRITE_PRESERVE && strlen(render) > strlen(parts[p])) {
+                        // Rendered text may be longer than the template
+                        const size_t used = strlen(outvalue);
+                        char *tmp = realloc(outvalue, outvalue_size + strlen(render));
+                        if (!tmp) {
+                            SYSERROR("Unable to allocate %zu bytes for value of %s", outvalue_size + strlen(render), key);
+                            guard_array_free(parts);
+                            guard_free(render);
+                            guard_free(outvalue);
+                            guard_free(value);
+                            return -1;
+                        }
+                        outvalue = tmp;
+                        memset(outvalue + used, 0, outvalue_size + strlen(render) - used);
+                        outvalue_size += strlen(render);
+                    }
 
                     if (*hint == INIVAL_TYPE_STR_ARRAY) {
                         int leading_space = isspace(*render);
                         if (leading_space) {
-                            snprintf(outvalue + strlen(outvalue), sizeof(outvalue) - strlen(outvalue), "%s" LINE_SEP, render);
+                            snprintf(outvalue + strlen(outvalue), outvalue_size - strlen(outvalue), "%s" LINE_SEP, render);
                         } else {
-                            snprintf(outvalue + strlen(outvalue), sizeof(outvalue) - strlen(outvalue), "    %s" LINE_SEP, render);
+                            snprintf(outvalue + strlen(outvalue), outvalue_size - strlen(outvalue), "    %s" LINE_SEP, render);
                         }
                     } else {
-                        snprintf(outvalue + strlen(outvalue), sizeof(outvalue) - strlen(outvalue), "%s", render);
+                        snprintf(outvalue + strlen(outvalue), outvalue_size - strlen(outvalue), "%s", render);
                     }
                     if (mode == INI_WRITE_PRESERVE) {
                         guard_free(render);
@@ -467,8 +795,9 @@ int ini_write(struct INIFILE *ini, FILE **stream, unsigned mode) {
                 }
                 guard_array_free(parts);
                 strip(outvalue);
-                strncat(outvalue, LINE_SEP, sizeof(outvalue) - strlen(outvalue) - 1);
+                strncat(outvalue, LINE_SEP, outvalue_size - strlen(outvalue) - 1);
                 fprintf(*stream, "%s = %s%s", ini->section[x]->data[y]->key, *hint == INIVAL_TYPE_STR_ARRAY ? LINE_SEP : "", outvalue);
+                guard_free(outvalue);
                 guard_free(value);
             } else {
                 fprintf(*stream, "%s = %s", ini->section[x]->data[y]->key, ini->section[x]->data[y]->value);
@@ -488,71 +817,196 @@ char *unquote(char *s) {
     return s;
 }
 
+/**
+ * Free memory unless it belongs to the arena
+ */
+static void ini_release(const struct INIArena *arena, void *ptr) {
+    if (!ini_arena_owns(arena, ptr)) {
+        guard_free(ptr);
+    }
+}
+
 void ini_free(struct INIFILE **ini) {
+    struct INIArena *arena = (*ini)->arena;
+    ini_index_free(*ini);
     for (size_t section = 0; section < (*ini)->section_count; section++) {
         SYSDEBUG("freeing section: %s", (*ini)->section[section]->key);
         for (size_t data = 0; data < (*ini)->section[section]->data_count; data++) {
             if ((*ini)->section[section]->data[data]) {
                 SYSDEBUG("freeing data key: %s", (*ini)->section[section]->data[data]->key);
-                guard_free((*ini)->section[section]->data[data]->key);
+                ini_release(arena, (*ini)->section[section]->data[data]->key);
                 SYSDEBUG("freeing data value: %s", (*ini)->section[section]->data[data]->value);
-                guard_free((*ini)->section[section]->data[data]->value);
-                guard_free((*ini)->section[section]->data[data]);
+                ini_release(arena, (*ini)->section[section]->data[data]->value);
+                tpl_compiled_free(&(*ini)->section[section]->data[data]->tpl);
+                ini_release(arena, (*ini)->section[section]->data[data]);
             }
         }
         guard_free((*ini)->section[section]->data);
-        guard_free((*ini)->section[section]->key);
-        guard_free((*ini)->section[section]);
+        ini_release(arena, (*ini)->section[section]->key);
+        ini_release(arena, (*ini)->section[section]);
     }
     guard_free((*ini)->section);
+    ini_arena_free(&(*ini)->arena);
     guard_free((*ini));
 }
 
+/**
+ * Map a file into memory
+ *
+ * Files that cannot be mapped (pipes, special files) are read into a heap buffer instead.
+ *
+ * @param filename path to file
+ * @param size receives the length of the file
+ * @param mapped receives 1 if the result must be released with munmap(), or 0 for free()
+ * @return pointer to the contents of the file, or NULL on error
+ */
+static char *ini_map_file(const char *filename, size_t *size, int *mapped) {
+    struct stat st;
+    char *data = NULL;
+
+    *size = 0;
+    *mapped = 0;
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            *size = (size_t) st.st_size;
+            *mapped = 1;
+            close(fd);
+            return data;
+        }
+        data = NULL;
+    }
+
+    size_t alloc = 0;
+    for (;;) {
+        if (*size + BUFSIZ > alloc) {
+            alloc = alloc ? alloc * 2 : BUFSIZ * 2;
+            char *tmp = realloc(data, alloc);
+            if (!tmp) {
+                guard_free(data);
+                close(fd);
+                return NULL;
+            }
+            data = tmp;
+        }
+        const ssize_t bytes = read(fd, data + *size, alloc - *size);
+        if (bytes < 0) {
+            guard_free(data);
+            close(fd);
+            return NULL;
+        }
+        if (bytes == 0) {
+            break;
+        }
+        *size += (size_t) bytes;
+    }
+    close(fd);
+    return data;
+}
+
+static void ini_unmap_file(char *data, size_t size, int mapped) {
+    if (mapped) {
+        munmap(data, size);
+    } else {
+        guard_free(data);
+    }
+}
+
+/**
+ * Copy the next line of a buffer, including its line terminator (same as fgets())
+ * @return pointer to line, or NULL at the end of the buffer
+ */
+static char *ini_read_line(char *line, const char *data, size_t size, size_t *pos) {
+    if (*pos >= size) {
+        return NULL;
+    }
+    const char *begin = data + *pos;
+    const char *end = memchr(begin, '\n', size - *pos);
+    const size_t len = end ? (size_t) (end - begin) + 1 : size - *pos;
+    memcpy(line, begin, len);
+    line[len] = '\0';
+    *pos += len;
+    return line;
+}
+
 struct INIFILE *ini_open(const char *filename) {
-    char line[STASIS_BUFSIZ] = {0};
-    char current_section[STASIS_BUFSIZ] = {0};
     char reading_value = 0;
+    size_t data_size = 0;
+    int data_mapped = 0;
+
+    // Open the configuration file for reading
+    char *data = ini_map_file(filename, &data_size, &data_mapped);
+    if (!data) {
+        return NULL;
+    }
 
     struct INIFILE *ini = ini_init();
     if (ini == NULL) {
+        ini_unmap_file(data, data_size, data_mapped);
         return NULL;
     }
 
+    // Everything read from the file is stored in the arena. A block the size
+    // of the file usually holds all of it.
+    ini->arena = ini_arena_init(data_size * 2);
     ini_section_init(&ini);
-
-    // Create an implicit section. [default] does not need to be present in the INI config
-    ini_section_create(&ini, "default");
-    strncpy(current_section, "default", sizeof(current_section) - 1);
-
-    // Open the configuration file for reading
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
+    ini_index_build(ini);
+
+    // Scratch buffers are as large as the longest line. Nothing is truncated.
+    size_t bufsize = 1;
+    for (size_t pos = 0; pos < data_size;) {
+        const char *end = memchr(data + pos, '\n', data_size - pos);
+        const size_t len = end ? (size_t) (end - (data + pos)) + 1 : data_size - pos;
+        if (len + 1 > bufsize) {
+            bufsize = len + 1;
+        }
+        pos += len;
+    }
+    if (bufsize < sizeof("default")) {
+        bufsize = sizeof("default");
+    }
+    char *line = calloc(bufsize, sizeof(*line));
+    char *current_section = calloc(bufsize, sizeof(*current_section));
+    char *inikey[2] = {calloc(bufsize, sizeof(*inikey[0])), calloc(bufsize, sizeof(*inikey[1]))};
+    char *value = calloc(bufsize, sizeof(*value));
+    if (!line || !current_section || !inikey[0] || !inikey[1] || !value) {
+        SYSERROR("Unable to allocate %zu bytes for INI parser", bufsize);
+        guard_free(line);
+        guard_free(current_section);
+        guard_free(inikey[0]);
+        guard_free(inikey[1]);
+        guard_free(value);
         ini_free(&ini);
-        ini = NULL;
+        ini_unmap_file(data, data_size, data_mapped);
         return NULL;
     }
 
+    // Create an implicit section. [default] does not need to be present in the INI config
+    ini_section_create(&ini, "default");
+    strncpy(current_section, "default", bufsize - 1);
+
     unsigned hint = 0;
     int multiline_data = 0;
     int no_data = 0;
-    char inikey[2][255];
     char *key = inikey[0];
     char *key_last = inikey[1];
-    char value[STASIS_BUFSIZ] = {0};
-
-    memset(inikey, 0, sizeof(inikey));
+    size_t pos = 0;
 
     // Read file
-    for (size_t i = 0; fgets(line, sizeof(line), fp) != NULL; i++) {
+    for (size_t i = 0; ini_read_line(line, data, data_size, &pos) != NULL; i++) {
         if (no_data && multiline_data) {
             if (!isempty(line)) {
                 no_data = 0;
             } else {
                 multiline_data = 0;
             }
-            memset(value, 0, sizeof(value));
+            memset(value, 0, bufsize);
         } else {
-            memset(key, 0, sizeof(inikey[0]));
+            memset(key, 0, bufsize);
         }
         // Find pointer to first comment character
         char *comment = strpbrk(line, ";#");
@@ -576,12 +1030,13 @@ struct INIFILE *ini_open(const char *filename) {
         // Test for section header: [string]
         if (startswith(line, "[")) {
             // The previous key is irrelevant now
-            memset(key_last, 0, sizeof(inikey[1]));
+            memset(key_last, 0, bufsize);
 
             char *section_name = substring_between(line, "[]");
             if (!section_name) {
                 fprintf(stderr, "error: invalid section syntax, line %zu: '%s'\n", i + 1, line);
-                return NULL;
+                ini_free(&ini);
+                break;
             }
 
             // Ignore default section because we already have an implicit one
@@ -595,10 +1050,9 @@ struct INIFILE *ini_open(const char *filename) {
             ini_section_create(&ini, section_name);
 
             // Record the name of the section. This is used until another section is found.
-            memset(current_section, 0, sizeof(current_section));
-            strncpy(current_section, section_name, sizeof(current_section) - 1);
+            memset(current_section, 0, bufsize);
+            strncpy(current_section, section_name, bufsize - 1);
             guard_free(section_name);
-            memset(line, 0, sizeof(line));
             continue;
         }
 
@@ -616,17 +1070,17 @@ struct INIFILE *ini_open(const char *filename) {
 
         if (operator) {
             size_t key_len = operator - line;
-            memset(key, 0, sizeof(inikey[0]));
+            memset(key, 0, bufsize);
             strncpy(key, line, key_len);
             lstrip(key);
             strip(key);
-            memset(key_last, 0, sizeof(inikey[1]));
-            strncpy(key_last, key, sizeof(inikey[1]) - 1);
+            memset(key_last, 0, bufsize);
+            strncpy(key_last, key, bufsize - 1);
             reading_value = 1;
             if (strlen(operator) > 1) {
-                strncpy(value, &operator[1], sizeof(value) - 1);
+                strncpy(value, &operator[1], bufsize - 1);
             } else {
-                strncpy(value, "", sizeof(value) - 1);
+                strncpy(value, "", bufsize - 1);
             }
             if (isempty(value)) {
                 //printf("%s is probably long raw data\n", key);
@@ -640,10 +1094,9 @@ struct INIFILE *ini_open(const char *filename) {
             }
             strip(value);
         } else {
-            strncpy(key, key_last, sizeof(inikey[0]) - 1);
-            strncpy(value, line, sizeof(value) - 1);
+            strncpy(key, key_last, bufsize - 1);
+            strncpy(value, line, bufsize - 1);
         }
-        memset(line, 0, sizeof(line));
 
         // Store key value pair in section's data array
         if (strlen(key)) {
@@ -659,7 +1112,12 @@ struct INIFILE *ini_open(const char *filename) {
             reading_value = 1;
         }
     }
-    fclose(fp);
 
+    guard_free(line);
+    guard_free(current_section);
+    guard_free(inikey[0]);
+    guard_free(inikey[1]);
+    guard_free(value);
+    ini_unmap_file(data, data_size, data_mapped);
     return ini;
-}
\ No newline at end of file
+}
@@ -1,9 +1,100 @@
 #include "core.h"
 #include "multiprocessing.h"
+#include <poll.h>
+#include <zlib.h>
 
 /// The sum of all tasks started by mp_task()
 size_t mp_global_task_count = 0;
 
+/// Write end of each joining pool's self-pipe (stored as fd + 1, so zero means unused)
+static int mp_wakeup_fds[MP_POOL_WAKEUP_MAX] = {0};
+/// Number of pools waiting on SIGCHLD
+static int mp_wakeup_users = 0;
+/// SIGCHLD disposition prior to the first waiting pool
+static struct sigaction mp_sigchld_prev;
+
+/// Parent-side state of a running task
+struct MultiProcessingSlot {
+    struct MultiProcessingTask *task; ///< Task occupying the slot (NULL when free)
+    int output_fd; ///< Read end of the task's stdout/stderr pipe (-1 when closed)
+    char *line; ///< Output waiting for a line feed
+    size_t line_len; ///< Length of line
+    size_t line_alloc; ///< Bytes allocated for line
+    gzFile log; ///< Compressed copy of the task's output (NULL when disabled)
+};
+
+static void mp_sigchld_handler(int signum) {
+    (void) signum;
+    const int saved_errno = errno;
+    for (size_t i = 0; i < MP_POOL_WAKEUP_MAX; i++) {
+        const int fd = mp_wakeup_fds[i] - 1;
+        if (fd >= 0) {
+            // A full pipe means a wakeup is already pending
+            const ssize_t ignored = write(fd, "", 1);
+            (void) ignored;
+        }
+    }
+    errno = saved_errno;
+}
+
+/**
+ * Create a self-pipe that becomes readable when any child process changes state
+ *
+ * @param wakeup pipe file descriptors
+ * @return 0 on success
+ * @return -1 on error
+ */
+static int mp_wakeup_init(int wakeup[2]) {
+    if (pipe(wakeup) < 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < 2; i++) {
+        // Tasks must not inherit the pipe, and the signal handler must never block
+        fcntl(wakeup[i], F_SETFD, FD_CLOEXEC);
+        fcntl(wakeup[i], F_SETFL, fcntl(wakeup[i], F_GETFL) | O_NONBLOCK);
+    }
+
+    int registered = 0;
+    for (size_t i = 0; i < MP_POOL_WAKEUP_MAX; i++) {
+        if (__sync_bool_compare_and_swap(&mp_wakeup_fds[i], 0, wakeup[1] + 1)) {
+            registered = 1;
+            break;
+        }
+    }
+    if (!registered) {
+        close(wakeup[0]);
+        close(wakeup[1]);
+        return -1;
+    }
+
+    if (__sync_fetch_and_add(&mp_wakeup_users, 1) == 0) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = mp_sigchld_handler;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        if (sigaction(SIGCHLD, &sa, &mp_sigchld_prev) < 0) {
+            perror("sigaction");
+        }
+    }
+    return 0;
+}
+
+static void mp_wakeup_free(int wakeup[2]) {
+    for (size_t i = 0; i < MP_POOL_WAKEUP_MAX; i++) {
+        if (__sync_bool_compare_and_swap(&mp_wakeup_fds[i], wakeup[1] + 1, 0)) {
+            break;
+        }
+    }
+    if (__sync_sub_and_fetch(&mp_wakeup_users, 1) == 0) {
+        if (sigaction(SIGCHLD, &mp_sigchld_prev, NULL) < 0) {
+            perror("sigaction");
+        }
+    }
+    close(wakeup[0]);
+    close(wakeup[1]);
+}
+
 static double get_duration(const struct timespec stop, const struct timespec start) {
     const struct timespec result = timespec_sub(stop, start);
     return timespec_to_double(result);
@@ -54,11 +145,63 @@ static void update_task_elapsed(struct MultiProcessingTask *task) {
     task->time_data.duration = get_task_duration(task);
 }
 
+static void update_pool_elapsed(struct MultiProcessingPool *pool) {
+    // Record the pool stop time
+    if (clock_gettime(CLOCK_REALTIME, &pool->time_data.t_stop) < 0) {
+        perror("clock_gettime");
+        exit(1);
+    }
+    pool->time_data.duration = get_duration(pool->time_data.t_stop, pool->time_data.t_start);
+
+    // Utilization is the fraction of available core time spent executing tasks
+    pool->utilization = 0.0;
+    if (pool->jobs && pool->time_data.duration > 0.0) {
+        pool->utilization = (pool->busy / (pool->time_data.duration * (double) pool->jobs)) * 100;
+    }
+}
+
+/**
+ * Map another block of MP_POOL_TASK_CHUNK tasks
+ *
+ * Tasks are shared with children, so each block is a shared mapping. Blocks
+ * are never moved, so pointers returned by mp_pool_task() remain valid until
+ * mp_pool_free() is called.
+ *
+ * @param pool a pointer to MultiProcessingPool
+ * @return 0 on success
+ * @return -1 on error
+ */
+static int mp_pool_grow(struct MultiProcessingPool *pool) {
+    const size_t num_alloc_new = pool->num_alloc + MP_POOL_TASK_CHUNK;
+    struct MultiProcessingTask **tmp = realloc(pool->task, num_alloc_new * sizeof(*pool->task));
+    if (!tmp) {
+        SYSERROR("Unable to allocate %zu task records", num_alloc_new);
+        return -1;
+    }
+    pool->task = tmp;
+
+    struct MultiProcessingTask *chunk = mmap(NULL, MP_POOL_TASK_CHUNK * sizeof(*chunk), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (chunk == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
+    SYSDEBUG("Increasing size of task array: %zu -> %zu", pool->num_alloc, num_alloc_new);
+    for (size_t i = 0; i < MP_POOL_TASK_CHUNK; i++) {
+        pool->task[pool->num_alloc + i] = &chunk[i];
+    }
+    pool->num_alloc = num_alloc_new;
+    return 0;
+}
+
 static struct MultiProcessingTask *mp_pool_next_available(struct MultiProcessingPool *pool) {
-    return &pool->task[pool->num_used];
+    if (pool->num_used == pool->num_alloc && mp_pool_grow(pool)) {
+        return NULL;
+    }
+    return pool->task[pool->num_used];
 }
 
-int child(struct MultiProcessingPool *pool, struct MultiProcessingTask *task) {
+int child(struct MultiProcessingPool *pool, struct MultiProcessingTask *task, int output_fd) {
     (void) pool;
     FILE *fp_log = NULL;
 
@@ -68,22 +211,24 @@ int child(struct MultiProcessingPool *pool, struct MultiProcessingTask *task) {
         exit(1);
     }
 
-    // Redirect stdout and stderr to the log file
+    // Redirect stdout and stderr to the parent (or the log file)
     fflush(stdout);
     fflush(stderr);
 
-    // Set log file name
-    if (globals.enable_task_logging) {
-        const char *log_file_fmt = "task-%zu-%d.log";
-        const int log_file_len = snprintf(NULL, 0, log_file_fmt, mp_global_task_count, task->parent_pid);
-        snprintf(task->log_file + strlen(task->log_file), sizeof(task->log_file) - log_file_len, log_file_fmt, mp_global_task_count, task->parent_pid);
-    }
-    fp_log = freopen(task->log_file, "w+", stdout);
-    if (!fp_log) {
-        fprintf(stderr, "unable to open '%s' for writing: %s\n", task->log_file, strerror(errno));
-        return -1;
+    if (output_fd >= 0) {
+        // The parent reads the output from the other end of the pipe
+        dup2(output_fd, STDOUT_FILENO);
+        dup2(output_fd, STDERR_FILENO);
+        close(output_fd);
+        fp_log = stdout;
+    } else {
+        fp_log = freopen(task->log_file, "w+", stdout);
+        if (!fp_log) {
+            fprintf(stderr, "unable to open '%s' for writing: %s\n", task->log_file, strerror(errno));
+            return -1;
+        }
+        dup2(fileno(stdout), fileno(stderr));
     }
-    dup2(fileno(stdout), fileno(stderr));
 
     // Generate timestamp for log header
     time_t t = time(NULL);
@@ -95,7 +240,7 @@ int child(struct MultiProcessingPool *pool, struct MultiProcessingTask *task) {
 
     // Generate log header
     fprintf(fp_log, "# STARTED: %s\n", timebuf ? timebuf : "unknown");
-    fprintf(fp_log, "# PID: %d\n", task->parent_pid);
+    fprintf(fp_log, "# PID: %d\n", getpid());
     fprintf(fp_log, "# WORKDIR: %s\n", task->working_dir);
     fprintf(fp_log, "# COMMAND:\n%s\n", task->cmd);
     fprintf(fp_log, "# OUTPUT:\n");
@@ -109,7 +254,7 @@ int child(struct MultiProcessingPool *pool, struct MultiProcessingTask *task) {
     return execvp("/bin/bash", args);
 }
 
-int parent(struct MultiProcessingPool *pool, struct MultiProcessingTask *task, pid_t pid, int *child_status) {
+int parent(struct MultiProcessingPool *pool, struct MultiProcessingTask *task, pid_t pid) {
     // Record the task start time
     update_task_start(task);
 
@@ -119,49 +264,175 @@ int parent(struct MultiProcessingPool *pool, struct MultiProcessingTask *task, p
     task->pid = pid;
     task->parent_pid = pid;
 
+    // The task is no longer queued. Its exit status is collected by mp_pool_join().
+    task->status = 0;
+    task->signaled_by = 0;
+
     semaphore_wait(&pool->semaphore);
     mp_global_task_count++;
     semaphore_post(&pool->semaphore);
 
-    // Check child's status
-    pid_t code = waitpid(pid, child_status, WUNTRACED | WCONTINUED | WNOHANG);
-    if (code < 0) {
-        perror("waitpid failed");
-        return -1;
-    }
     return 0;
 }
 
-static int mp_task_fork(struct MultiProcessingPool *pool, struct MultiProcessingTask *task) {
+static int mp_task_fork(struct MultiProcessingPool *pool, struct MultiProcessingTask *task, int *output_fd) {
+    int output[2] = {-1, -1};
+
+    // Task output is read by the parent through a pipe
+    *output_fd = -1;
+    if (globals.enable_task_logging) {
+        if (pipe(output) < 0) {
+            perror("pipe");
+            return -1;
+        }
+        // Other tasks must not inherit this pipe
+        fcntl(output[0], F_SETFD, FD_CLOEXEC);
+        fcntl(output[1], F_SETFD, FD_CLOEXEC);
+    }
+
     SYSDEBUG("Preparing to fork() child task %s:%s", pool->ident, task->ident);
     semaphore_wait(&pool->semaphore);
     pid_t pid = fork();
     int parent_status = 0;
-    int child_status = 0;
     if (pid == -1) {
         return -1;
     }
     if (pid == 0) {
         semaphore_post(&pool->semaphore);
-        child(pool, task);
+        if (output[0] >= 0) {
+            close(output[0]);
+        }
+        child(pool, task, output[1]);
     } else {
-        parent_status = parent(pool, task, pid, &child_status);
+        if (output[1] >= 0) {
+            close(output[1]);
+            fcntl(output[0], F_SETFL, fcntl(output[0], F_GETFL) | O_NONBLOCK);
+            *output_fd = output[0];
+        }
+        parent_status = parent(pool, task, pid);
         fflush(stdout);
         fflush(stderr);
     }
     return parent_status;
 }
 
+/**
+ * Print a line of task output, prefixed by the identity of the pool and task
+ *
+ * @param pool a pointer to MultiProcessingPool
+ * @param slot a pointer to MultiProcessingSlot
+ * @param data line of output (without a line feed)
+ * @param len length of data
+ */
+static void mp_slot_emit(const struct MultiProcessingPool *pool, struct MultiProcessingSlot *slot, const char *data, const size_t len) {
+    // Lines are written whole, so output from concurrent tasks cannot be interleaved
+    printf("[%s:%s] %.*s\n", pool->ident, slot->task->ident, (int) len, data);
+    if (slot->log) {
+        gzwrite(slot->log, data, (unsigned) len);
+        gzwrite(slot->log, "\n", 1);
+    }
+}
+
+/**
+ * Read all output available from a task without blocking
+ *
+ * Complete lines are printed immediately. An incomplete line is held until
+ * its line feed arrives, or the pipe is closed.
+ *
+ * @param pool a pointer to MultiProcessingPool
+ * @param slot a pointer to MultiProcessingSlot
+ */
+static void mp_slot_read(const struct MultiProcessingPool *pool, struct MultiProcessingSlot *slot) {
+    char buf[STASIS_BUFSIZ];
+
+    while (slot->output_fd >= 0) {
+        const ssize_t len = read(slot->output_fd, buf, sizeof(buf));
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (len <= 0) {
+            if (len == 0 || errno != EAGAIN) {
+                // End of output
+                if (slot->line_len) {
+                    mp_slot_emit(pool, slot, slot->line, slot->line_len);
+                    slot->line_len = 0;
+                }
+                close(slot->output_fd);
+                slot->output_fd = -1;
+            }
+            break;
+        }
+
+        const char *pos = buf;
+        const char *end = buf + len;
+        while (pos < end) {
+            const char *lf = memchr(pos, '\n', end - pos);
+            const size_t chunk = lf ? (size_t) (lf - pos) : (size_t) (end - pos);
+
+            if (slot->line_len + chunk > slot->line_alloc) {
+                size_t line_alloc_new = slot->line_alloc ? slot->line_alloc : STASIS_BUFSIZ;
+                while (line_alloc_new < slot->line_len + chunk) {
+                    line_alloc_new *= 2;
+                }
+                char *tmp = realloc(slot->line, line_alloc_new);
+                if (!tmp) {
+                    SYSERROR("Unable to allocate %zu bytes for task output", line_alloc_new);
+                    exit(1);
+                }
+                slot->line = tmp;
+                slot->line_alloc = line_alloc_new;
+            }
+            memcpy(slot->line + slot->line_len, pos, chunk);
+            slot->line_len += chunk;
+
+            if (!lf) {
+                break;
+            }
+            mp_slot_emit(pool, slot, slot->line, slot->line_len);
+            slot->line_len = 0;
+            pos = lf + 1;
+        }
+    }
+    fflush(stdout);
+}
+
+/**
+ * Flush remaining task output and release the slot's output resources
+ *
+ * The pipe is not read until EOF. A process started in the background by the
+ * task may hold it open long after the task ended.
+ *
+ * @param pool a pointer to MultiProcessingPool
+ * @param slot a pointer to MultiProcessingSlot
+ */
+static void mp_slot_close(const struct MultiProcessingPool *pool, struct MultiProcessingSlot *slot) {
+    mp_slot_read(pool, slot);
+    if (slot->line_len) {
+        mp_slot_emit(pool, slot, slot->line, slot->line_len);
+        slot->line_len = 0;
+    }
+    if (slot->output_fd >= 0) {
+        close(slot->output_fd);
+        slot->output_fd = -1;
+    }
+    if (slot->log) {
+        gzclose(slot->log);
+        slot->log = NULL;
+    }
+    guard_free(slot->line);
+    slot->line_alloc = 0;
+    fflush(stdout);
+}
+
 struct MultiProcessingTask *mp_pool_task(struct MultiProcessingPool *pool, const char *ident, char *working_dir, char *cmd) {
     SYSDEBUG("%s", "Finding next available slot");
     struct MultiProcessingTask *slot = mp_pool_next_available(pool);
-    if (pool->num_used != pool->num_alloc) {
-        SYSDEBUG("Using slot %zu of %zu", pool->num_used, pool->num_alloc);
-        pool->num_used++;
-    } else {
-        fprintf(stderr, "Maximum number of tasks reached\n");
+    if (!slot) {
+        fprintf(stderr, "Unable to allocate task record\n");
         return NULL;
     }
+    SYSDEBUG("Using slot %zu of %zu", pool->num_used, pool->num_alloc);
+    pool->num_used++;
 
     // Set default status to "error"
     slot->status = MP_POOL_TASK_STATUS_INITIAL;
@@ -171,10 +442,20 @@ struct MultiProcessingTask *mp_pool_task(struct MultiProcessingPool *pool, const
     strncpy(slot->ident, ident, sizeof(slot->ident) - 1);
 
     // Set log file path
-    memset(slot->log_file, 0, sizeof(*slot->log_file));
+    memset(slot->log_file, 0, sizeof(slot->log_file));
     if (globals.enable_task_logging) {
-        strncat(slot->log_file, pool->log_root, sizeof(slot->log_file) - strlen(slot->log_file) - 1);
-        strncat(slot->log_file, "/", sizeof(slot->log_file) - strlen(slot->log_file) - 1);
+        char ident_safe[sizeof(slot->ident)] = {0};
+        strncpy(ident_safe, slot->ident, sizeof(ident_safe) - 1);
+        for (char *ch = ident_safe; *ch; ch++) {
+            if (!isalnum((unsigned char) *ch) && !strchr("._-", *ch)) {
+                *ch = '_';
+            }
+        }
+        const int log_file_len = snprintf(slot->log_file, sizeof(slot->log_file), "%s/%s-%zu-%s.log.gz", pool->log_root, pool->ident, pool->num_used - 1, ident_safe);
+        if (log_file_len < 0 || (size_t) log_file_len >= sizeof(slot->log_file)) {
+            fprintf(stderr, "Log file path is too long: %s\n", slot->log_file);
+            return NULL;
+        }
     } else {
         strncpy(slot->log_file, "/dev/stdout", sizeof(slot->log_file) - 1);
     }
@@ -224,19 +505,30 @@ struct MultiProcessingTask *mp_pool_task(struct MultiProcessingPool *pool, const
     return slot;
 }
 
+static void mp_pool_show_utilization(struct MultiProcessingPool *pool) {
+    char busy[255] = {0};
+    char wall[255] = {0};
+    seconds_to_human_readable((int) pool->busy, busy, sizeof(busy));
+    seconds_to_human_readable((int) pool->time_data.duration, wall, sizeof(wall));
+    printf("[%s] Core utilization: %3.1f%% (jobs: %zu, busy: %s, wall: %s)\n",
+        pool->ident, pool->utilization, pool->jobs, busy, wall);
+}
+
 void mp_pool_show_summary(struct MultiProcessingPool *pool) {
     print_banner("=", 79);
     printf("Pool execution summary for \"%s\"\n", pool->ident);
     print_banner("=", 79);
     printf("STATUS      PID        DURATION     IDENT\n");
     for (size_t i = 0; i < pool->num_used; i++) {
-        struct MultiProcessingTask *task = &pool->task[i];
+        struct MultiProcessingTask *task = pool->task[i];
         char status_str[10] = {0};
 
         if (task->status == MP_POOL_TASK_STATUS_INITIAL && task->pid == MP_POOL_PID_UNUSED) {
             // You will only see this label if the task pool is killed by
             // MP_POOL_FAIL_FAST and tasks are still queued for execution
             strncpy(status_str, "HOLD", sizeof(status_str) - 1);
+        } else if (task->status == MP_POOL_TASK_STATUS_SKIPPED) {
+            strncpy(status_str, "SKIP", sizeof(status_str) - 1);
         } else if (!task->status && !task->signaled_by) {
             strncpy(status_str, "DONE", sizeof(status_str) - 1);
         } else if (task->signaled_by) {
@@ -250,29 +542,16 @@ void mp_pool_show_summary(struct MultiProcessingPool *pool) {
         printf("%-4s   %10d    %10s     %-10s\n", status_str, task->parent_pid, duration, task->ident) ;
         //printf("%-4s   %10d  %7lds     %-10s\n", status_str, task->parent_pid, task->elapsed, task->ident) ;
     }
-    puts("");
-}
-
-static int show_log_contents(FILE *stream, struct MultiProcessingTask *task) {
-    FILE *fp = fopen(task->log_file, "r");
-    if (!fp) {
-        return -1;
-    }
-    char buf[BUFSIZ] = {0};
-    while ((fgets(buf, sizeof(buf) - 1, fp)) != NULL) {
-        fprintf(stream, "%s", buf);
-        memset(buf, 0, sizeof(buf));
+    if (pool->jobs) {
+        mp_pool_show_utilization(pool);
     }
-    fprintf(stream, "\n");
-    fflush(stream);
-    fclose(fp);
-    return 0;
+    puts("");
 }
 
 int mp_pool_kill(struct MultiProcessingPool *pool, int signum) {
     printf("Sending signal %d to pool '%s'\n", signum, pool->ident);
     for (size_t i = 0; i < pool->num_used; i++) {
-        struct MultiProcessingTask *slot = &pool->task[i];
+        struct MultiProcessingTask *slot = pool->task[i];
         if (!slot) {
             return -1;
         }
@@ -298,15 +577,6 @@ int mp_pool_kill(struct MultiProcessingPool *pool, int signum) {
                 }
             }
         }
-        if (globals.enable_task_logging) {
-            semaphore_wait(&pool->semaphore);
-            if (!access(slot->log_file, F_OK)) {
-                SYSDEBUG("Removing log file: %s", slot->log_file);
-                remove(slot->log_file);
-            }
-            semaphore_post(&pool->semaphore);
-        }
-
         semaphore_wait(&pool->semaphore);
         if (!access(slot->parent_script, F_OK)) {
             SYSDEBUG("Removing runner script: %s", slot->parent_script);
@@ -317,179 +587,416 @@ int mp_pool_kill(struct MultiProcessingPool *pool, int signum) {
     return 0;
 }
 
-int mp_pool_join(struct MultiProcessingPool *pool, size_t jobs, size_t flags) {
+/// Return values for mp_pool_poll_task()
+#define MP_POOL_TASK_RUNNING 0
+#define MP_POOL_TASK_SUCCESS 1
+#define MP_POOL_TASK_FAILED 2
+
+static int mp_task_is_queued(const struct MultiProcessingTask *task) {
+    return task->status == MP_POOL_TASK_STATUS_INITIAL && task->pid == MP_POOL_PID_UNUSED;
+}
+
+/**
+ * Determine whether a queued task may start
+ *
+ * @param task a pointer to a queued MultiProcessingTask
+ * @param running a pointer to the array of task slots
+ * @param jobs the number of task slots
+ * @return 1 if the task may start now
+ * @return 0 if the task must wait for its dependency or group
+ * @return -1 if the task will never start (its dependency did not succeed)
+ */
+static int mp_task_is_ready(const struct MultiProcessingTask *task, const struct MultiProcessingSlot *running, size_t jobs) {
+    const struct MultiProcessingTask *dep = task->depends_on;
+    if (dep) {
+        if (mp_task_is_queued(dep) || dep->pid != MP_POOL_PID_UNUSED) {
+            return 0;
+        }
+        if (dep->status || dep->signaled_by) {
+            return -1;
+        }
+    }
+
+    if (task->group[0]) {
+        for (size_t s = 0; s < jobs; s++) {
+            if (running[s].task && !strcmp(running[s].task->group, task->group)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * Check the state of a running task
+ *
+ * @param pool a pointer to MultiProcessingPool
+ * @param running a pointer to the MultiProcessingSlot of the task to check
+ * @param tasks_complete number of tasks finished so far
+ * @param tasks_total number of tasks executed by the current join
+ * @return MP_POOL_TASK_RUNNING, MP_POOL_TASK_SUCCESS, or MP_POOL_TASK_FAILED
+ * @return <0 on error
+ */
+static int mp_pool_poll_task(struct MultiProcessingPool *pool, struct MultiProcessingSlot *running, const size_t tasks_complete, const size_t tasks_total) {
+    struct MultiProcessingTask *slot = running->task;
     int status = 0;
+    int result = MP_POOL_TASK_RUNNING;
+    char duration[255] = {0};
+
+    // Is the process finished?
+    pid_t pid = waitpid(slot->pid, &status, WNOHANG | WUNTRACED | WCONTINUED);
+
+    char progress[1024] = {0};
+    const double percent = ((double) (tasks_complete + 1) / (double) tasks_total) * 100;
+    snprintf(progress, sizeof(progress), "[%s:%s] [%3.1f%%]", pool->ident, slot->ident, percent);
+
+    if (pid < 0) {
+        fprintf(stderr, "waitpid failed: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (pid == 0) {
+        semaphore_wait(&pool->semaphore);
+        update_task_elapsed(slot);
+        semaphore_post(&pool->semaphore);
+
+        if (slot->timeout && slot->time_data.duration >= (double) slot->timeout) {
+            seconds_to_human_readable(slot->timeout, duration, sizeof(duration));
+            printf("%s Task timed out after %s (pid: %d)\n", progress, duration, slot->pid);
+            if (kill(slot->pid, SIGKILL)) {
+                SYSERROR("Timeout reached, however pid %d could not be killed.", slot->pid);
+                return -1;
+            }
+            // The exit status is collected by the next poll
+            return MP_POOL_TASK_RUNNING;
+        }
+
+        // Track the number of seconds elapsed for each task.
+        // When a task has executed for longer than status_intervals, print a status update
+        // interval_elapsed represents the time between intervals, not the total runtime of the task
+        semaphore_wait(&pool->semaphore);
+        if (fabs(slot->interval_data.duration) > pool->status_interval) {
+            slot->interval_data.duration = 0.0;
+        }
+        if (slot->interval_data.duration == 0.0) {
+            seconds_to_human_readable(slot->time_data.duration, duration, sizeof(duration));
+            printf("[%s:%s] Task is running (pid: %d, elapsed: %s)\n",
+                pool->ident, slot->ident, slot->parent_pid, duration);
+            update_task_interval_start(slot);
+        }
+
+        update_task_interval_elapsed(slot);
+        semaphore_post(&pool->semaphore);
+        return MP_POOL_TASK_RUNNING;
+    }
+
+    // The process ended in one the following ways
+    // Note: SIGSTOP nor SIGCONT will not complete the task
+    if (WIFSTOPPED(status)) {
+        printf("%s Task was suspended (%d)\n", progress, WSTOPSIG(status));
+        return MP_POOL_TASK_RUNNING;
+    }
+    if (WIFCONTINUED(status)) {
+        printf("%s Task was resumed\n", progress);
+        return MP_POOL_TASK_RUNNING;
+    }
+
+    // Update status
+    semaphore_wait(&pool->semaphore);
+    update_task_elapsed(slot);
+    semaphore_post(&pool->semaphore);
+    slot->status = WEXITSTATUS(status);
+    slot->signaled_by = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+
+    // Show the remaining output before the result
+    mp_slot_close(pool, running);
+
+    if (WIFSIGNALED(status)) {
+        printf("%s Task ended by signal %d (%s)\n", progress, slot->signaled_by, strsignal(slot->signaled_by));
+    } else if (WIFEXITED(status)) {
+        printf("%s Task ended (status: %d)\n", progress, slot->status);
+    } else {
+        fprintf(stderr, "%s Task state is unknown (0x%04X)\n", progress, status);
+    }
+
+    seconds_to_human_readable(slot->time_data.duration, duration, sizeof(duration));
+    if (status >> 8 != 0 || (status & 0xff) != 0) {
+        fprintf(stderr, "%s Task failed after %s\n", progress, duration);
+        result = MP_POOL_TASK_FAILED;
+    } else {
+        printf("%s Task finished after %s\n", progress, duration);
+        result = MP_POOL_TASK_SUCCESS;
+    }
+
+    // Clean up the script left behind by the task
+    if (remove(slot->parent_script)) {
+        fprintf(stderr, "%s Unable to remove temporary script '%s': %s\n", progress, slot->parent_script, strerror(errno));
+    }
+
+    // Tell the poller to ignore the PID. The process is gone.
+    slot->pid = MP_POOL_PID_UNUSED;
+    return result;
+}
+
+/**
+ * Sleep until a child process changes state, or a running task reaches its
+ * timeout or status interval
+ *
+ * Output received from tasks in the meantime is printed as it arrives.
+ *
+ * @param pool a pointer to MultiProcessingPool
+ * @param wakeup_fd read end of the SIGCHLD self-pipe
+ * @param running array of running task slots
+ * @param pfd array of at least `jobs + 1` records
+ * @param jobs number of slots in `running`
+ */
+static void mp_pool_wait(const struct MultiProcessingPool *pool, const int wakeup_fd, struct MultiProcessingSlot *running, struct pollfd *pfd, const size_t jobs) {
+    double wait = pool->status_interval;
+    nfds_t nfds = 0;
+
+    pfd[nfds].fd = wakeup_fd;
+    pfd[nfds].events = POLLIN;
+    pfd[nfds].revents = 0;
+    nfds++;
+
+    for (size_t s = 0; s < jobs; s++) {
+        const struct MultiProcessingTask *slot = running[s].task;
+        if (!slot) {
+            continue;
+        }
+        if (running[s].output_fd >= 0) {
+            pfd[nfds].fd = running[s].output_fd;
+            pfd[nfds].events = POLLIN;
+            pfd[nfds].revents = 0;
+            nfds++;
+        }
+        if (slot->timeout && slot->timeout - slot->time_data.duration < wait) {
+            wait = slot->timeout - slot->time_data.duration;
+        }
+        if (pool->status_interval - slot->interval_data.duration < wait) {
+            wait = pool->status_interval - slot->interval_data.duration;
+        }
+    }
+    if (wait < 0.0) {
+        wait = 0.0;
+    }
+
+    // Overshoot slightly so the deadline has passed when the task is polled again
+    if (poll(pfd, nfds, (int) (wait * 1000) + 10) <= 0) {
+        return;
+    }
+
+    if (pfd[0].revents) {
+        char buf[64];
+        while (read(wakeup_fd, buf, sizeof(buf)) > 0) {
+            // drain pending wakeups
+        }
+    }
+    for (size_t s = 0; s < jobs; s++) {
+        if (running[s].task && running[s].output_fd >= 0) {
+            mp_slot_read(pool, &running[s]);
+        }
+    }
+}
+
+int mp_pool_join(struct MultiProcessingPool *pool, size_t jobs, size_t flags) {
     int failures = 0;
     size_t tasks_complete = 0;
-    size_t lower_i = 0;
-    size_t upper_i = jobs;
-
-    do {
-        size_t hang_check = 0;
-        if (upper_i >= pool->num_used) {
-            size_t x = upper_i - pool->num_used;
-            upper_i -= (size_t) x;
-        }
-
-        for (size_t i = lower_i; i < upper_i; i++) {
-            char duration[255] = {0};
-            struct MultiProcessingTask *slot = &pool->task[i];
-            if (slot->status == MP_POOL_TASK_STATUS_INITIAL) {
-                slot->_startup = time(NULL);
-                if (mp_task_fork(pool, slot)) {
-                    fprintf(stderr, "%s: mp_task_fork failed\n", slot->ident);
-                    kill(0, SIGTERM);
-                }
-            }
+    size_t tasks_total = 0;
+    size_t first_queued = 0;
+    struct MultiProcessingSlot *running = NULL;
+    struct pollfd *pfd = NULL;
+    int wakeup[2] = {-1, -1};
+    int use_wakeup = 0;
+
+    if (!pool->num_used) {
+        return 0;
+    }
 
-            // Has the child been processed already?
-            if (slot->pid == MP_POOL_PID_UNUSED) {
-                // Child is already used up, skip it
-                hang_check++;
-                if (hang_check >= pool->num_used) {
-                    // If you join a pool that's already finished it will spin
-                    // forever. This protects the program from entering an
-                    // infinite loop.
-                    SYSDEBUG("slot %zu: hang_check=%zu >= pool->num_used=%zu", i, hang_check, pool->num_used);
-                    SYSERROR("%s is deadlocked\n", pool->ident);
-                    failures++;
-                    goto pool_deadlocked;
-                }
+    for (size_t i = 0; i < pool->num_used; i++) {
+        if (mp_task_is_queued(pool->task[i])) {
+            tasks_total++;
+        }
+    }
+
+    if (!tasks_total) {
+        // If you join a pool that's already finished there is nothing to
+        // wait for. Report it the same way as a pool that cannot progress.
+        SYSERROR("%s is deadlocked\n", pool->ident);
+        failures++;
+        goto pool_deadlocked;
+    }
+
+    // There's no reason to reserve more slots than tasks
+    if (!jobs) {
+        jobs = 1;
+    }
+    if (jobs > tasks_total) {
+        jobs = tasks_total;
+    }
+
+    // Each slot holds a running task. A task is started as soon as a slot is free.
+    running = calloc(jobs, sizeof(*running));
+    pfd = calloc(jobs + 1, sizeof(*pfd));
+    if (!running || !pfd) {
+        SYSERROR("Unable to allocate %zu task slots", jobs);
+        guard_free(running);
+        guard_free(pfd);
+        return -1;
+    }
+    for (size_t s = 0; s < jobs; s++) {
+        running[s].output_fd = -1;
+    }
+
+    // Wake up as soon as a task changes state instead of polling at a fixed interval
+    if (!(flags & MP_POOL_POLL_FIXED)) {
+        if (mp_wakeup_init(wakeup) < 0) {
+            SYSDEBUG("%s", "SIGCHLD wakeup unavailable. Polling at a fixed interval.");
+        } else {
+            use_wakeup = 1;
+        }
+    }
+
+    pool->jobs = jobs;
+    pool->busy = 0.0;
+    if (clock_gettime(CLOCK_REALTIME, &pool->time_data.t_start) < 0) {
+        perror("clock_gettime");
+        exit(1);
+    }
+
+    while (tasks_complete < tasks_total) {
+        // Start queued tasks in any free slot
+        for (size_t s = 0; s < jobs; s++) {
+            if (running[s].task) {
                 continue;
             }
-
-            // Is the process finished?
-            pid_t pid = waitpid(slot->pid, &status, WNOHANG | WUNTRACED | WCONTINUED);
-
-            char progress[1024] = {0};
-            const double percent = ((double) (tasks_complete + 1) / (double) pool->num_used) * 100;
-            snprintf(progress, sizeof(progress), "[%s:%s] [%3.1f%%]", pool->ident, slot->ident, percent);
-
-            int task_timed_out = false;
-            if (slot->timeout) {
-                task_timed_out = slot->time_data.duration >= (double) slot->timeout;
-                if (task_timed_out && pid == 0 && slot->pid != 0) {
-                    seconds_to_human_readable(slot->timeout, duration, sizeof(duration));
-                    printf("%s Task timed out after %s (pid: %d)\n", progress, duration, slot->pid);
-                    if (kill(slot->pid, SIGKILL) == 0) {
-                        status = SIGKILL;
-                    } else {
-                        SYSERROR("Timeout reached, however pid %d could not be killed.", slot->pid);
-                        return -1;
-                    }
-                }
+            // Tasks before first_queued have all been started (or skipped)
+            while (first_queued < pool->num_used && !mp_task_is_queued(pool->task[first_queued])) {
+                first_queued++;
             }
 
-            const int task_ended = WIFEXITED(status);
-            const int task_ended_by_signal = WIFSIGNALED(status);
-            const int task_stopped = WIFSTOPPED(status);
-            const int task_continued = WIFCONTINUED(status);
-            const int status_exit = WEXITSTATUS(status);
-            const int status_signal = WTERMSIG(status);
-            const int status_stopped = WSTOPSIG(status);
-
-            // Update status
-            slot->status = status_exit;
-            slot->signaled_by = status_signal;
-
-            if (pid > 0) {
-                // The process ended in one the following ways
-                // Note: SIGSTOP nor SIGCONT will not increment the tasks_complete counter
-                if (task_stopped) {
-                    printf("%s Task was suspended (%d)\n", progress, status_stopped);
-                    continue;
-                }
-                if (task_continued) {
-                    printf("%s Task was resumed\n", progress);
+            struct MultiProcessingTask *slot = NULL;
+            for (size_t i = first_queued; i < pool->num_used; i++) {
+                struct MultiProcessingTask *task = pool->task[i];
+                if (!mp_task_is_queued(task)) {
                     continue;
                 }
-                if (task_ended_by_signal) {
-                    printf("%s Task ended by signal %d (%s)\n", progress, status_signal, strsignal(status_signal));
+                const int ready = mp_task_is_ready(task, running, jobs);
+                if (ready < 0) {
+                    // The dependency failed. This task cannot succeed, so don't run it.
+                    printf("[%s:%s] Task skipped (dependency '%s' did not succeed)\n", pool->ident, task->ident, task->depends_on->ident);
+                    task->status = MP_POOL_TASK_STATUS_SKIPPED;
                     tasks_complete++;
-                } else if (task_ended) {
-                    printf("%s Task ended (status: %d)\n", progress, status_exit);
-                    tasks_complete++;
-                } else {
-                    fprintf(stderr, "%s Task state is unknown (0x%04X)\n", progress, status);
+                    failures++;
+                    // Skipping a task may have released tasks depending on it. Rescan.
+                    i = first_queued - 1;
+                    continue;
                 }
-
-                if (globals.enable_task_logging) {
-                    // Show the log (always)
-                    if (show_log_contents(stdout, slot)) {
-                        perror(slot->log_file);
-                    }
+                if (ready) {
+                    slot = task;
+                    break;
                 }
+            }
+            if (!slot) {
+                break;
+            }
 
-                if (status >> 8 != 0 || (status & 0xff) != 0) {
-                    semaphore_wait(&pool->semaphore);
-                    update_task_elapsed(slot);
-                    semaphore_post(&pool->semaphore);
-                    seconds_to_human_readable(slot->time_data.duration, duration, sizeof(duration));
-                    fprintf(stderr, "%s Task failed after %s\n", progress, duration);
-                    failures++;
-
-                    if (flags & MP_POOL_FAIL_FAST && pool->num_used > 1) {
-                        mp_pool_kill(pool, SIGTERM);
-                        return -2;
-                    }
-                } else {
-                    seconds_to_human_readable(slot->time_data.duration, duration, sizeof(duration));
-                    printf("%s Task finished after %s\n", progress, duration);
+            slot->_startup = time(NULL);
+            running[s].task = slot;
+            if (mp_task_fork(pool, slot, &running[s].output_fd)) {
+                fprintf(stderr, "%s: mp_task_fork failed\n", slot->ident);
+                kill(0, SIGTERM);
+            }
+            if (running[s].output_fd >= 0 && pool->log_keep) {
+                running[s].log = gzopen(slot->log_file, "wb");
+                if (!running[s].log) {
+                    fprintf(stderr, "%s: unable to open '%s' for writing\n", slot->ident, slot->log_file);
                 }
+            }
+        }
 
-                // Clean up logs and scripts left behind by the task
-                if (globals.enable_task_logging) {
-                    if (remove(slot->log_file)) {
-                        fprintf(stderr, "%s Unable to remove log file: '%s': %s\n", progress, slot->parent_script, strerror(errno));
-                    }
-                }
-                if (remove(slot->parent_script)) {
-                    fprintf(stderr, "%s Unable to remove temporary script '%s': %s\n", progress, slot->parent_script, strerror(errno));
-                }
+        // Nothing is running and nothing can start. The remaining tasks depend
+        // on a task outside of this pool, or on each other.
+        size_t num_running = 0;
+        for (size_t s = 0; s < jobs; s++) {
+            if (running[s].task) {
+                num_running++;
+            }
+        }
+        if (!num_running && tasks_complete < tasks_total) {
+            SYSERROR("%s is deadlocked: %zu task(s) cannot start\n", pool->ident, tasks_total - tasks_complete);
+            failures += (int) (tasks_total - tasks_complete);
+            goto pool_done;
+        }
 
-                // Update progress and tell the poller to ignore the PID. The process is gone.
-                slot->pid = MP_POOL_PID_UNUSED;
-            } else if (pid < 0) {
-                fprintf(stderr, "waitpid failed: %s\n", strerror(errno));
-                return -1;
-            } else {
-                // Track the number of seconds elapsed for each task.
-                // When a task has executed for longer than status_intervals, print a status update
-                // interval_elapsed represents the time between intervals, not the total runtime of the task
-                semaphore_wait(&pool->semaphore);
-                if (fabs(slot->interval_data.duration) > pool->status_interval) {
-                    slot->interval_data.duration = 0.0;
-                }
-                if (slot->interval_data.duration == 0.0) {
-                    seconds_to_human_readable(slot->time_data.duration, duration, sizeof(duration));
-                    printf("[%s:%s] Task is running (pid: %d, elapsed: %s)\n",
-                        pool->ident, slot->ident, slot->parent_pid, duration);
-                    update_task_interval_start(slot);
-                }
+        // Check on the running tasks
+        for (size_t s = 0; s < jobs; s++) {
+            struct MultiProcessingTask *slot = running[s].task;
+            if (!slot) {
+                continue;
+            }
 
-                update_task_interval_elapsed(slot);
-                semaphore_post(&pool->semaphore);
+            const int state = mp_pool_poll_task(pool, &running[s], tasks_complete, tasks_total);
+            if (state < 0) {
+                failures = -1;
+                goto pool_done;
+            }
+            if (state == MP_POOL_TASK_RUNNING) {
+                continue;
             }
 
-            if (!task_ended || !task_ended_by_signal) {
-                semaphore_wait(&pool->semaphore);
-                update_task_elapsed(slot);
-                semaphore_post(&pool->semaphore);
+            // Release the slot
+            running[s].task = NULL;
+            pool->busy += slot->time_data.duration;
+            tasks_complete++;
+
+            if (state == MP_POOL_TASK_FAILED) {
+                failures++;
+                if (flags & MP_POOL_FAIL_FAST && pool->num_used > 1) {
+                    mp_pool_kill(pool, SIGTERM);
+                    // Account for the time spent by tasks cut short
+                    for (size_t k = 0; k < jobs; k++) {
+                        if (running[k].task) {
+                            pool->busy += running[k].task->time_data.duration;
+                        }
+                    }
+                    failures = -2;
+                    goto pool_done;
+                }
             }
         }
 
-        if (tasks_complete == pool->num_used) {
+        if (tasks_complete == tasks_total) {
             break;
         }
 
-        if (tasks_complete == upper_i) {
-            lower_i += jobs;
-            upper_i += jobs;
+        if (use_wakeup) {
+            mp_pool_wait(pool, wakeup[0], running, pfd, jobs);
+        } else {
+            // Show the output received so far, then poll again after a short delay
+            for (size_t s = 0; s < jobs; s++) {
+                if (running[s].task) {
+                    mp_slot_read(pool, &running[s]);
+                }
+            }
+            usleep(100000);
         }
+    }
 
-        // Poll again after a short delay
-        usleep(100000);
-    } while (1);
+    pool_done:
+    // Flush output from tasks that did not finish normally
+    for (size_t s = 0; s < jobs; s++) {
+        if (running[s].task) {
+            mp_slot_close(pool, &running[s]);
+        }
+    }
+    update_pool_elapsed(pool);
+    mp_pool_show_utilization(pool);
+    if (use_wakeup) {
+        mp_wakeup_free(wakeup);
+    }
+    guard_free(running);
+    guard_free(pfd);
 
     pool_deadlocked:
     puts("");
@@ -518,7 +1025,8 @@ struct MultiProcessingPool *mp_pool_init(const char *ident, const char *log_root
     memset(pool->log_root, 0, sizeof(pool->log_root));
     strncpy(pool->log_root, log_root, sizeof(pool->log_root) - 1);
     pool->num_used = 0;
-    pool->num_alloc = MP_POOL_TASK_MAX;
+    pool->num_alloc = 0;
+    pool->task = NULL;
 
     // Create the log directory
     if (mkdirs(log_root, 0700) < 0) {
@@ -529,10 +1037,8 @@ struct MultiProcessingPool *mp_pool_init(const char *ident, const char *log_root
         }
     }
 
-    // Task array is shared with children
-    pool->task = mmap(NULL, (pool->num_alloc + 1) * sizeof(*pool->task), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
-    if (pool->task == MAP_FAILED) {
-        perror("mmap");
+    // Task records are shared with children. More are mapped as tasks are queued.
+    if (mp_pool_grow(pool)) {
         mp_pool_free(&pool);
         return NULL;
     }
@@ -557,14 +1063,21 @@ void mp_pool_free(struct MultiProcessingPool **pool) {
 
     // Unmap all pool tasks
     if ((*pool)->task) {
-        if ((*pool)->task->cmd) {
-            if (munmap((*pool)->task->cmd, (*pool)->task->cmd_len) < 0) {
-                perror("munmap");
+        for (size_t i = 0; i < (*pool)->num_used; i++) {
+            struct MultiProcessingTask *task = (*pool)->task[i];
+            if (task->cmd) {
+                if (munmap(task->cmd, task->cmd_len) < 0) {
+                    perror("munmap");
+                }
             }
         }
-        if (munmap((*pool)->task, sizeof(*(*pool)->task) * (*pool)->num_alloc) < 0) {
-            perror("munmap");
+        // The first record of each block is the address returned by mmap()
+        for (size_t i = 0; i < (*pool)->num_alloc; i += MP_POOL_TASK_CHUNK) {
+            if (munmap((*pool)->task[i], sizeof(*(*pool)->task[i]) * MP_POOL_TASK_CHUNK) < 0) {
+                perror("munmap");
+            }
         }
+        guard_free((*pool)->task);
     }
     // Unmap the pool
     if ((*pool)) {
@@ -573,4 +1086,95 @@ void mp_pool_free(struct MultiProcessingPool **pool) {
         }
         (*pool) = NULL;
     }
-}
\ No newline at end of file
+}
+
+void *mp_shared_alloc(size_t size) {
+    void *result = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (result == MAP_FAILED) {
+        SYSERROR("mmap: %s", strerror(errno));
+        return NULL;
+    }
+    return result;
+}
+
+void mp_shared_free(void *ptr, size_t size) {
+    if (ptr && munmap(ptr, size) < 0) {
+        perror("munmap");
+    }
+}
+
+/// Work queue shared by mp_parallel_for() workers
+struct MultiProcessingQueue {
+    size_t next; ///< Next index to hand out
+    size_t failed; ///< Number of calls that returned non-zero
+};
+
+ssize_t mp_parallel_for(size_t count, size_t jobs, int (*fn)(size_t index, void *arg), void *arg) {
+    if (jobs > count) {
+        jobs = count;
+    }
+
+    struct MultiProcessingQueue *queue = NULL;
+    if (jobs > 1) {
+        queue = mp_shared_alloc(sizeof(*queue));
+    }
+    if (!queue) {
+        ssize_t failed = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (fn(i, arg)) {
+                failed++;
+            }
+        }
+        return failed;
+    }
+
+    pid_t *pids = calloc(jobs, sizeof(*pids));
+    if (!pids) {
+        mp_shared_free(queue, sizeof(*queue));
+        return -1;
+    }
+
+    // Buffered output would be written once by each child
+    fflush(stdout);
+    fflush(stderr);
+
+    size_t started = 0;
+    for (; started < jobs; started++) {
+        const pid_t pid = fork();
+        if (pid < 0) {
+            SYSERROR("fork: %s", strerror(errno));
+            break;
+        }
+        if (pid == 0) {
+            size_t i;
+            while ((i = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED)) < count) {
+                if (fn(i, arg)) {
+                    __atomic_fetch_add(&queue->failed, 1, __ATOMIC_RELAXED);
+                }
+            }
+            fflush(stdout);
+            fflush(stderr);
+            _exit(0);
+        }
+        pids[started] = pid;
+    }
+
+    bool terminated = started == 0;
+    for (size_t i = 0; i < started; i++) {
+        int status = 0;
+        while (waitpid(pids[i], &status, 0) < 0) {
+            if (errno != EINTR) {
+                status = -1;
+                break;
+            }
+        }
+        if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status)) {
+            terminated = true;
+        }
+    }
+
+    const ssize_t result = terminated ? -1 : (ssize_t) queue->failed;
+    guard_free(pids);
+    mp_shared_free(queue, sizeof(*queue));
+    return result;
+}
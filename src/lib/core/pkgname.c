@@ -0,0 +1,164 @@
+#include <ctype.h>
+#include "core.h"
+#include "pkgname.h"
+
+// Characters that end the project name in a package spec
+static const char *pkgname_name_end = "@~=<>!;[(, \t";
+
+static const char *pkgname_start(const char *spec) {
+    while (isspace((unsigned char) *spec)) {
+        spec++;
+    }
+    return spec;
+}
+
+const char *pkgname_end(const char *spec) {
+    spec = pkgname_start(spec);
+    return spec + strcspn(spec, pkgname_name_end);
+}
+
+int pkgname_normalize(const char *spec, char *result, size_t maxlen) {
+    size_t len = 0;
+
+    if (!spec || !maxlen) {
+        return -1;
+    }
+    spec = pkgname_start(spec);
+    const char *end = pkgname_end(spec);
+
+    // PEP 503: lowercase, runs of "-", "_" and "." become a single "-"
+    for (const char *ch = spec; ch < end; ch++) {
+        char c = (char) tolower((unsigned char) *ch);
+        if (strchr("-_.", c)) {
+            if (len && result[len - 1] == '-') {
+                continue;
+            }
+            c = '-';
+        }
+        if (len + 1 >= maxlen) {
+            return -1;
+        }
+        result[len++] = c;
+    }
+    result[len] = '\0';
+    return len ? 0 : -1;
+}
+
+static size_t pkgname_hash(const char *key) {
+    // FNV-1a
+    size_t hash = (size_t) 14695981039346656037ULL;
+    for (const char *ch = key; *ch; ch++) {
+        hash ^= (unsigned char) *ch;
+        hash *= (size_t) 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Find the hash table slot of a normalized name
+ * @return slot holding the name's ID, or the empty slot where it belongs
+ */
+static size_t pkgname_slot(const struct PackageNames *names, const char *name) {
+    const size_t mask = names->table_size - 1;
+    size_t slot = pkgname_hash(name) & mask;
+    while (names->table[slot] >= 0 && strcmp(names->name[names->table[slot]], name) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static int pkgname_table_resize(struct PackageNames *names, size_t table_size) {
+    ssize_t *table = malloc(table_size * sizeof(*table));
+    if (!table) {
+        return -1;
+    }
+    for (size_t i = 0; i < table_size; i++) {
+        table[i] = -1;
+    }
+    guard_free(names->table);
+    names->table = table;
+    names->table_size = table_size;
+    for (size_t id = 0; id < names->num_used; id++) {
+        names->table[pkgname_slot(names, names->name[id])] = (ssize_t) id;
+    }
+    return 0;
+}
+
+struct PackageNames *pkgname_init() {
+    struct PackageNames *names = calloc(1, sizeof(*names));
+    if (!names) {
+        return NULL;
+    }
+    if (pkgname_table_resize(names, 64)) {
+        guard_free(names);
+        return NULL;
+    }
+    return names;
+}
+
+void pkgname_free(struct PackageNames **names) {
+    if (!*names) {
+        return;
+    }
+    for (size_t i = 0; i < (*names)->num_used; i++) {
+        guard_free((*names)->name[i]);
+    }
+    guard_free((*names)->name);
+    guard_free((*names)->table);
+    guard_free(*names);
+}
+
+ssize_t pkgname_lookup(const struct PackageNames *names, const char *spec) {
+    char name[255] = {0};
+
+    if (!names || pkgname_normalize(spec, name, sizeof(name))) {
+        return -1;
+    }
+    return names->table[pkgname_slot(names, name)];
+}
+
+ssize_t pkgname_intern(struct PackageNames *names, const char *spec) {
+    char name[255] = {0};
+
+    if (!names || pkgname_normalize(spec, name, sizeof(name))) {
+        return -1;
+    }
+    size_t slot = pkgname_slot(names, name);
+    if (names->table[slot] >= 0) {
+        return names->table[slot];
+    }
+
+    if (names->num_used + 1 > names->num_alloc) {
+        const size_t num_alloc = names->num_alloc ? names->num_alloc * 2 : 16;
+        char **tmp = realloc(names->name, num_alloc * sizeof(*names->name));
+        if (!tmp) {
+            return -1;
+        }
+        names->name = tmp;
+        names->num_alloc = num_alloc;
+    }
+    names->name[names->num_used] = strdup(name);
+    if (!names->name[names->num_used]) {
+        return -1;
+    }
+    const ssize_t id = (ssize_t) names->num_used++;
+
+    // Keep the table at most half full
+    if (names->num_used * 2 > names->table_size) {
+        if (pkgname_table_resize(names, names->table_size * 2)) {
+            names->num_used--;
+            guard_free(names->name[id]);
+            return -1;
+        }
+    } else {
+        names->table[slot] = id;
+    }
+    return id;
+}
+
+const char *pkgname_str(const struct PackageNames *names, ssize_t id) {
+    if (!names || id < 0 || (size_t) id >= names->num_used) {
+        return NULL;
+    }
+    return names->name[id];
+}
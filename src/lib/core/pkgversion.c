@@ -0,0 +1,350 @@
+#include <ctype.h>
+#include <strings.h>
+#include "core.h"
+#include "pkgversion.h"
+
+#define PKGVERSION_PRE_NONE 3
+
+struct PkgVersion {
+    unsigned long long epoch; ///< Epoch ("1!")
+    const char *release; ///< Release segments ("1.0.2", not NUL terminated)
+    size_t release_len; ///< Length of release segments
+    int pre_kind; ///< 0: alpha, 1: beta, 2: release candidate, PKGVERSION_PRE_NONE: not a pre-release
+    unsigned long long pre; ///< Pre-release number
+    int has_post; ///< Is a post-release
+    unsigned long long post; ///< Post-release number
+    int has_dev; ///< Is a development release
+    unsigned long long dev; ///< Development release number
+    const char *local; ///< Local version label (not NUL terminated)
+    size_t local_len; ///< Length of local version label (0: not present)
+};
+
+struct PkgVersionWord {
+    const char *word;
+    int kind;
+};
+
+static const struct PkgVersionWord pkgversion_pre_words[] = {
+    {"alpha", 0}, {"a", 0},
+    {"beta", 1}, {"b", 1},
+    {"preview", 2}, {"pre", 2}, {"rc", 2}, {"c", 2},
+    {NULL, 0},
+};
+
+static const struct PkgVersionWord pkgversion_post_words[] = {
+    {"post", 0}, {"rev", 0}, {"r", 0},
+    {NULL, 0},
+};
+
+static const struct PkgVersionWord pkgversion_dev_words[] = {
+    {"dev", 0},
+    {NULL, 0},
+};
+
+static int pkgversion_is_sep(const char *s, size_t len, size_t i) {
+    return i < len && s[i] && strchr("-_.", s[i]);
+}
+
+static int pkgversion_number(const char *s, size_t len, size_t *i, unsigned long long *value) {
+    if (*i >= len || !isdigit((unsigned char) s[*i])) {
+        return 0;
+    }
+    *value = 0;
+    for (; *i < len && isdigit((unsigned char) s[*i]); (*i)++) {
+        if (*value <= (~0ULL - 9) / 10) {
+            *value = *value * 10 + (unsigned long long) (s[*i] - '0');
+        }
+    }
+    return 1;
+}
+
+/**
+ * Consume a word, ignoring case
+ * @return pointer to the matching entry of `words`, or NULL (nothing is consumed)
+ */
+static const struct PkgVersionWord *pkgversion_word(const char *s, size_t len, size_t *i, const struct PkgVersionWord *words) {
+    size_t n = 0;
+    while (*i + n < len && isalpha((unsigned char) s[*i + n])) {
+        n++;
+    }
+    for (; n && words->word; words++) {
+        if (strlen(words->word) == n && !strncasecmp(s + *i, words->word, n)) {
+            *i += n;
+            return words;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Consume an optionally separated word and an optional number ("-alpha.1", "rc1", "post")
+ * @return pointer to the matching entry of `words`, or NULL (nothing is consumed)
+ */
+static const struct PkgVersionWord *pkgversion_suffix(const char *s, size_t len, size_t *i, const struct PkgVersionWord *words, unsigned long long *value) {
+    size_t pos = *i;
+    if (pkgversion_is_sep(s, len, pos)) {
+        pos++;
+    }
+    const struct PkgVersionWord *match = pkgversion_word(s, len, &pos, words);
+    if (!match) {
+        return NULL;
+    }
+    size_t num = pos;
+    if (pkgversion_is_sep(s, len, num)) {
+        num++;
+    }
+    *value = 0;
+    if (pkgversion_number(s, len, &num, value)) {
+        pos = num;
+    }
+    *i = pos;
+    return match;
+}
+
+/**
+ * Split a version into its PEP 440 segments
+ * @return 0 on success, -1 if `s` is not a valid version
+ */
+static int pkgversion_parse(const char *s, size_t len, struct PkgVersion *version) {
+    const struct PkgVersionWord *match = NULL;
+    unsigned long long value = 0;
+    size_t i = 0;
+
+    memset(version, 0, sizeof(*version));
+    version->pre_kind = PKGVERSION_PRE_NONE;
+
+    if (i < len && tolower((unsigned char) s[i]) == 'v') {
+        i++;
+    }
+    size_t release = i;
+    if (!pkgversion_number(s, len, &i, &value)) {
+        return -1;
+    }
+    if (i < len && s[i] == '!') {
+        version->epoch = value;
+        release = ++i;
+        if (!pkgversion_number(s, len, &i, &value)) {
+            return -1;
+        }
+    }
+    while (i + 1 < len && s[i] == '.' && isdigit((unsigned char) s[i + 1])) {
+        i++;
+        pkgversion_number(s, len, &i, &value);
+    }
+    version->release = s + release;
+    version->release_len = i - release;
+
+    if ((match = pkgversion_suffix(s, len, &i, pkgversion_pre_words, &version->pre))) {
+        version->pre_kind = match->kind;
+    }
+
+    // "1.0-1" is a post-release
+    if (i + 1 < len && s[i] == '-' && isdigit((unsigned char) s[i + 1])) {
+        i++;
+        version->has_post = pkgversion_number(s, len, &i, &version->post);
+    } else if (pkgversion_suffix(s, len, &i, pkgversion_post_words, &version->post)) {
+        version->has_post = 1;
+    }
+
+    if (pkgversion_suffix(s, len, &i, pkgversion_dev_words, &version->dev)) {
+        version->has_dev = 1;
+    }
+
+    if (i < len && s[i] == '+') {
+        i++;
+        version->local = s + i;
+        version->local_len = len - i;
+        if (!version->local_len || !isalnum((unsigned char) s[i])) {
+            return -1;
+        }
+        for (; i < len; i++) {
+            if (isalnum((unsigned char) s[i])) {
+                continue;
+            }
+            // Segments are not empty
+            if (!pkgversion_is_sep(s, len, i) || !isalnum((unsigned char) (i + 1 < len ? s[i + 1] : '\0'))) {
+                return -1;
+            }
+        }
+    }
+    return i == len ? 0 : -1;
+}
+
+static int pkgversion_ull_cmp(unsigned long long a, unsigned long long b) {
+    return (a > b) - (a < b);
+}
+
+/**
+ * Compare release segments. Missing segments are zero ("1.0" == "1.0.0").
+ */
+static int pkgversion_release_cmp(const struct PkgVersion *a, const struct PkgVersion *b) {
+    size_t x = 0;
+    size_t y = 0;
+    while (x < a->release_len || y < b->release_len) {
+        unsigned long long value_a = 0;
+        unsigned long long value_b = 0;
+        if (pkgversion_number(a->release, a->release_len, &x, &value_a) && x < a->release_len) {
+            x++;
+        }
+        if (pkgversion_number(b->release, b->release_len, &y, &value_b) && y < b->release_len) {
+            y++;
+        }
+        const int result = pkgversion_ull_cmp(value_a, value_b);
+        if (result) {
+            return result;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Get the next segment of a local version label
+ * @return length of segment (0: no segments remain)
+ */
+static size_t pkgversion_local_next(const char *s, size_t len, size_t *i, const char **segment) {
+    if (pkgversion_is_sep(s, len, *i)) {
+        (*i)++;
+    }
+    *segment = s + *i;
+    const size_t start = *i;
+    while (*i < len && !pkgversion_is_sep(s, len, *i)) {
+        (*i)++;
+    }
+    return *i - start;
+}
+
+static int pkgversion_is_number(const char *s, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (!isdigit((unsigned char) s[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Compare local version labels. Numeric segments are newer than alphanumeric segments.
+ */
+static int pkgversion_local_cmp(const struct PkgVersion *a, const struct PkgVersion *b) {
+    size_t x = 0;
+    size_t y = 0;
+    while (1) {
+        const char *segment_a = NULL;
+        const char *segment_b = NULL;
+        const size_t len_a = pkgversion_local_next(a->local, a->local_len, &x, &segment_a);
+        const size_t len_b = pkgversion_local_next(b->local, b->local_len, &y, &segment_b);
+        if (!len_a || !len_b) {
+            return (len_a > 0) - (len_b > 0);
+        }
+
+        const int number_a = pkgversion_is_number(segment_a, len_a);
+        const int number_b = pkgversion_is_number(segment_b, len_b);
+        int result = number_a - number_b;
+        if (!result && number_a) {
+            unsigned long long value_a = 0;
+            unsigned long long value_b = 0;
+            size_t pos = 0;
+            pkgversion_number(segment_a, len_a, &pos, &value_a);
+            pos = 0;
+            pkgversion_number(segment_b, len_b, &pos, &value_b);
+            result = pkgversion_ull_cmp(value_a, value_b);
+        } else if (!result) {
+            result = strncasecmp(segment_a, segment_b, len_a < len_b ? len_a : len_b);
+            if (!result) {
+                result = pkgversion_ull_cmp(len_a, len_b);
+            }
+        }
+        if (result) {
+            return result < 0 ? -1 : 1;
+        }
+    }
+}
+
+/**
+ * Compare strings. Runs of digits are compared by value.
+ */
+static int pkgversion_digits_cmp(const char *a, size_t len_a, const char *b, size_t len_b) {
+    size_t x = 0;
+    size_t y = 0;
+    while (x < len_a && y < len_b) {
+        if (isdigit((unsigned char) a[x]) && isdigit((unsigned char) b[y])) {
+            while (x < len_a && a[x] == '0') {
+                x++;
+            }
+            while (y < len_b && b[y] == '0') {
+                y++;
+            }
+            size_t digits_a = 0;
+            size_t digits_b = 0;
+            while (x + digits_a < len_a && isdigit((unsigned char) a[x + digits_a])) {
+                digits_a++;
+            }
+            while (y + digits_b < len_b && isdigit((unsigned char) b[y + digits_b])) {
+                digits_b++;
+            }
+            if (digits_a != digits_b) {
+                return digits_a < digits_b ? -1 : 1;
+            }
+            const int result = strncmp(a + x, b + y, digits_a);
+            if (result) {
+                return result < 0 ? -1 : 1;
+            }
+            x += digits_a;
+            y += digits_b;
+            continue;
+        }
+        if (a[x] != b[y]) {
+            return (unsigned char) a[x] < (unsigned char) b[y] ? -1 : 1;
+        }
+        x++;
+        y++;
+    }
+    return (x < len_a) - (y < len_b);
+}
+
+/**
+ * A development release of a final release sorts before its pre-releases ("1.0.dev1" < "1.0a1")
+ */
+static int pkgversion_pre_rank(const struct PkgVersion *version) {
+    if (version->pre_kind == PKGVERSION_PRE_NONE && !version->has_post && version->has_dev) {
+        return -1;
+    }
+    return version->pre_kind;
+}
+
+int pkgversion_cmp_len(const char *a, size_t len_a, const char *b, size_t len_b) {
+    struct PkgVersion x;
+    struct PkgVersion y;
+    int result;
+
+    if (pkgversion_parse(a, len_a, &x) || pkgversion_parse(b, len_b, &y)) {
+        return pkgversion_digits_cmp(a, len_a, b, len_b);
+    }
+    if ((result = pkgversion_ull_cmp(x.epoch, y.epoch))) {
+        return result;
+    }
+    if ((result = pkgversion_release_cmp(&x, &y))) {
+        return result;
+    }
+    if ((result = pkgversion_ull_cmp(pkgversion_pre_rank(&x) + 1, pkgversion_pre_rank(&y) + 1))) {
+        return result;
+    }
+    if ((result = pkgversion_ull_cmp(x.pre, y.pre))) {
+        return result;
+    }
+    if ((result = x.has_post - y.has_post) || (result = pkgversion_ull_cmp(x.post, y.post))) {
+        return result;
+    }
+    // A release is newer than its development releases
+    if ((result = y.has_dev - x.has_dev) || (result = pkgversion_ull_cmp(x.dev, y.dev))) {
+        return result;
+    }
+    if (!x.local_len || !y.local_len) {
+        return (x.local_len > 0) - (y.local_len > 0);
+    }
+    return pkgversion_local_cmp(&x, &y);
+}
+
+int pkgversion_cmp(const char *a, const char *b) {
+    return pkgversion_cmp_len(a, strlen(a), b, strlen(b));
+}
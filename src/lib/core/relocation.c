@@ -1,16 +1,258 @@
 /**
  * @file relocation.c
  */
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "relocation.h"
 #include "str.h"
 
+/**
+ * Multi-pattern matcher (Aho-Corasick) over a set of ReplaceRules
+ *
+ * Transitions are stored densely (256 per state). Targets are short, so the
+ * table stays small and each input byte costs a single lookup.
+ */
+struct ReplaceMatcher {
+    size_t num_states; ///< Number of states in use
+    int *next; ///< Transition table (num_states * 256)
+    ssize_t *out; ///< Rule matched by the longest target ending in each state (-1 = none)
+};
+
+static void replace_matcher_free(struct ReplaceMatcher *m) {
+    guard_free(m->next);
+    guard_free(m->out);
+}
+
+static int replace_matcher_init(struct ReplaceMatcher *m, const struct ReplaceRule *rules, size_t count) {
+    size_t max_states = 1;
+    int *fail = NULL;
+    size_t *queue = NULL;
+
+    memset(m, 0, sizeof(*m));
+    for (size_t i = 0; i < count; i++) {
+        if (!rules[i].target || !*rules[i].target || !rules[i].replacement) {
+            errno = EINVAL;
+            return -1;
+        }
+        max_states += strlen(rules[i].target);
+    }
+
+    m->next = malloc(max_states * 256 * sizeof(*m->next));
+    m->out = malloc(max_states * sizeof(*m->out));
+    fail = calloc(max_states, sizeof(*fail));
+    queue = malloc(max_states * sizeof(*queue));
+    if (!m->next || !m->out || !fail || !queue) {
+        SYSERROR("unable to allocate matcher for %zu rules", count);
+        replace_matcher_free(m);
+        guard_free(fail);
+        guard_free(queue);
+        return -1;
+    }
+    for (size_t i = 0; i < max_states * 256; i++) {
+        m->next[i] = -1;
+    }
+    for (size_t i = 0; i < max_states; i++) {
+        m->out[i] = -1;
+    }
+
+    // Build the trie. The first rule wins when targets are duplicated.
+    m->num_states = 1;
+    for (size_t i = 0; i < count; i++) {
+        size_t state = 0;
+        for (const unsigned char *ch = (const unsigned char *) rules[i].target; *ch; ch++) {
+            int *next = &m->next[state * 256 + *ch];
+            if (*next < 0) {
+                *next = (int) m->num_states++;
+            }
+            state = (size_t) *next;
+        }
+        if (m->out[state] < 0) {
+            m->out[state] = (ssize_t) i;
+        }
+    }
+
+    // Resolve failure links breadth first, turning the trie into a DFA
+    size_t head = 0;
+    size_t tail = 0;
+    for (size_t c = 0; c < 256; c++) {
+        int *next = &m->next[c];
+        if (*next < 0) {
+            *next = 0;
+        } else {
+            fail[*next] = 0;
+            queue[tail++] = (size_t) *next;
+        }
+    }
+    while (head < tail) {
+        const size_t state = queue[head++];
+        if (m->out[state] < 0) {
+            m->out[state] = m->out[fail[state]];
+        }
+        for (size_t c = 0; c < 256; c++) {
+            int *next = &m->next[state * 256 + c];
+            const int fallback = m->next[(size_t) fail[state] * 256 + c];
+            if (*next < 0) {
+                *next = fallback;
+            } else {
+                fail[*next] = fallback;
+                queue[tail++] = (size_t) *next;
+            }
+        }
+    }
+
+    guard_free(fail);
+    guard_free(queue);
+    return 0;
+}
+
+struct ReplaceBuffer {
+    char *data;
+    size_t len;
+    size_t alloc;
+};
+
+static int replace_buffer_append(struct ReplaceBuffer *buf, const char *data, size_t len) {
+    if (buf->len + len + 1 > buf->alloc) {
+        size_t alloc = buf->alloc ? buf->alloc : 256;
+        while (buf->len + len + 1 > alloc) {
+            alloc *= 2;
+        }
+        char *tmp = realloc(buf->data, alloc);
+        if (!tmp) {
+            SYSERROR("unable to allocate %zu bytes for replacement buffer", alloc);
+            return -1;
+        }
+        buf->data = tmp;
+        buf->alloc = alloc;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+    return 0;
+}
+
+ssize_t replace_text_batch(const char *data, size_t len, const struct ReplaceRule *rules, size_t count, char **result, size_t *result_len) {
+    struct ReplaceMatcher m;
+    struct ReplaceBuffer buf = {0};
+    ssize_t replaced = 0;
+
+    *result = NULL;
+    if (result_len) {
+        *result_len = 0;
+    }
+    if (!count) {
+        return 0;
+    }
+    if (replace_matcher_init(&m, rules, count)) {
+        return -1;
+    }
+
+    size_t state = 0;
+    size_t last = 0;
+    size_t i = 0;
+    while (i < len) {
+        state = (size_t) m.next[state * 256 + (unsigned char) data[i++]];
+        const ssize_t rule = m.out[state];
+        if (rule < 0) {
+            continue;
+        }
+
+        const struct ReplaceRule *r = &rules[rule];
+        const size_t match = i - strlen(r->target);
+        if (replace_buffer_append(&buf, data + last, match - last)
+            || replace_buffer_append(&buf, r->replacement, strlen(r->replacement))) {
+            goto fail;
+        }
+        if (r->flags & REPLACE_TRUNCATE_AFTER_MATCH) {
+            // Discard the rest of the line, but keep the line ending
+            const char *eol = memchr(data + i, LINE_SEP[0], len - i);
+            if (eol) {
+                if (replace_buffer_append(&buf, LINE_SEP, strlen(LINE_SEP))) {
+                    goto fail;
+                }
+                i = (size_t) (eol - data) + strlen(LINE_SEP);
+            } else {
+                i = len;
+            }
+        }
+        last = i;
+        state = 0;
+        replaced++;
+    }
+
+    if (replaced) {
+        if (replace_buffer_append(&buf, data + last, len - last)) {
+            goto fail;
+        }
+        *result = buf.data;
+        if (result_len) {
+            *result_len = buf.len;
+        }
+    }
+    replace_matcher_free(&m);
+    return replaced;
+
+    fail:
+    replace_matcher_free(&m);
+    guard_free(buf.data);
+    return -1;
+}
+
+/**
+ * Replace all occurrences of `target` with `replacement` in `buf`
+ *
+ * ~~~{.c}
+ * char str[100] = "This are a test.";
+ * if (replace_text_n(str, sizeof(str), "are", "is", 0)) {
+ *     fprintf(stderr, "string replacement failed\n");
+ *     exit(1);
+ * }
+ * // str is: "This is a test."
+ * ~~~
+ *
+ * @param buf string to modify
+ * @param bufsize size of `buf` in bytes
+ * @param target string value to replace
+ * @param replacement string value
+ * @param flags REPLACE_TRUNCATE_AFTER_MATCH
+ * @return 0 on success
+ * @return -1 on error (errno is ENOBUFS if the result does not fit in `buf`, which is left unchanged)
+ */
+int replace_text_n(char *buf, size_t bufsize, const char *target, const char *replacement, unsigned flags) {
+    const struct ReplaceRule rule = {.target = target, .replacement = replacement, .flags = flags};
+    char *result = NULL;
+    size_t result_len = 0;
+
+    const ssize_t replaced = replace_text_batch(buf, strlen(buf), &rule, 1, &result, &result_len);
+    if (replaced < 0) {
+        return -1;
+    }
+    if (replaced) {
+        if (result_len >= bufsize) {
+            guard_free(result);
+            errno = ENOBUFS;
+            return -1;
+        }
+        // replace buf with the result
+        memcpy(buf, result, result_len + 1);
+        guard_free(result);
+    }
+    return 0;
+}
+
 /**
  * Replace all occurrences of `target` with `replacement` in `original`
  *
+ * The size of `original` is not known, so the caller must guarantee it has
+ * room for the result when `replacement` is longer than `target`. Use
+ * replace_text_n() when the size of the buffer is known.
+ *
  * ~~~{.c}
  * char *str = calloc(100, sizeof(char));
  * strcpy(str, "This are a test.");
- * if (replace_text(str, "are", "is")) {
+ * if (replace_text(str, "are", "is", 0)) {
  *     fprintf(stderr, "string replacement failed\n");
  *     exit(1);
  * }
@@ -25,67 +267,7 @@
  * @return 0 on success, -1 on error
  */
 int replace_text(char *original, const char *target, const char *replacement, unsigned flags) {
-    char buffer[STASIS_BUFSIZ] = {0};
-    char *pos = original;
-    char *match = NULL;
-    size_t original_len = strlen(original);
-    size_t target_len = strlen(target);
-    size_t rep_len = strlen(replacement);
-    size_t buffer_len = 0;
-
-    if (original_len > sizeof(buffer)) {
-        errno = EINVAL;
-        SYSERROR("The original string is larger than buffer: %zu > %zu\n", original_len, sizeof(buffer));
-        return -1;
-    }
-
-    memset(buffer, 0, sizeof(buffer));
-    if ((match = strstr(pos, target))) {
-        while (*pos != '\0') {
-            // append to buffer the bytes leading up to the match
-            strncat(buffer, pos, match - pos);
-            // position in the string jump ahead to the beginning of the match
-            pos = match;
-
-            // replacement is shorter than the target
-            if (rep_len < target_len) {
-                // shrink the string
-                strncat(buffer, replacement, sizeof(buffer) - strlen(buffer) - 1);
-                memmove(pos, pos + target_len, strlen(pos) - target_len);
-                memset(pos + (strlen(pos) - target_len), 0, target_len);
-            } else { // replacement is longer than the target
-                // write the replacement value to the buffer
-                strncat(buffer, replacement, sizeof(buffer) - strlen(buffer) - 1);
-                // target consumed. jump to the end of the substring.
-                pos += target_len;
-            }
-            if (flags & REPLACE_TRUNCATE_AFTER_MATCH) {
-                if (strstr(pos, LINE_SEP)) {
-                    strncat(buffer, LINE_SEP, sizeof(buffer) - strlen(buffer) - 1);
-                }
-                break;
-            }
-            // find more matches
-            if (!((match = strstr(pos, target)))) {
-                // no more matches
-                // append whatever remains to the buffer
-                strncat(buffer, pos, sizeof(buffer) - strlen(buffer) - 1);
-                // stop
-                break;
-            }
-        }
-    } else {
-        return 0;
-    }
-
-    buffer_len = strlen(buffer);
-    if (buffer_len < original_len) {
-        // truncate whatever remains of the original buffer
-        memset(original + buffer_len, 0, original_len - buffer_len);
-    }
-    // replace original with contents of buffer
-    strncpy(original, buffer, buffer_len + 1);
-    return 0;
+    return replace_text_n(original, SIZE_MAX, target, replacement, flags);
 }
 
 /**
@@ -105,50 +287,79 @@ int replace_text(char *original, const char *target, const char *replacement, un
  * @return 0 on success, -1 on error
  */
 int file_replace_text(const char* filename, const char* target, const char* replacement, unsigned flags) {
-    char buffer[STASIS_BUFSIZ];
-    char tempfilename[] = "tempfileXXXXXX";
+    const struct ReplaceRule rule = {.target = target, .replacement = replacement, .flags = flags};
+    return file_replace_text_batch(filename, &rule, 1);
+}
+
+int file_replace_text_batch(const char *filename, const struct ReplaceRule *rules, size_t count) {
+    struct stat st;
+    char *data = NULL;
+    char *result = NULL;
+    size_t result_len = 0;
+    char tempfile[PATH_MAX] = {0};
 
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
         fprintf(stderr, "unable to open for reading: %s\n", filename);
         return -1;
     }
-
-    FILE *tfp = fopen(tempfilename, "w+");
-    if (!tfp) {
-        SYSERROR("unable to open temporary fp for writing: %s", tempfilename);
-        fclose(fp);
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        SYSERROR("not a regular file: %s", filename);
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        SYSERROR("unable to map %s: %s", filename, strerror(errno));
         return -1;
     }
 
-    // Write modified strings to temporary file
-    int result = 0;
-    while (fgets(buffer, sizeof(buffer), fp) != NULL) {
-        if (strstr(buffer, target)) {
-            if (replace_text(buffer, target, replacement, flags)) {
-                result = -1;
-            }
-        }
-        fputs(buffer, tfp);
+    const ssize_t replaced = replace_text_batch(data, (size_t) st.st_size, rules, count, &result, &result_len);
+    munmap(data, (size_t) st.st_size);
+    if (replaced <= 0) {
+        // Nothing to write
+        return (int) replaced;
     }
-    fflush(tfp);
 
-    // Replace original with modified copy
-    fclose(fp);
-    fp = fopen(filename, "w+");
-    if (!fp) {
-        SYSERROR("unable to reopen %s for writing", filename);
+    // Write the result next to the original, then swap it into place
+    if (snprintf(tempfile, sizeof(tempfile), "%s.XXXXXX", filename) >= (int) sizeof(tempfile)) {
+        SYSERROR("path too long: %s", filename);
+        guard_free(result);
         return -1;
     }
-
-    // Update original file
-    rewind(tfp);
-    while (fgets(buffer, sizeof(buffer), tfp) != NULL) {
-        fputs(buffer, fp);
+    const int tfd = mkstemp(tempfile);
+    if (tfd < 0) {
+        SYSERROR("unable to create temporary file for writing: %s", tempfile);
+        guard_free(result);
+        return -1;
     }
-    fclose(fp);
-    fclose(tfp);
+    fchmod(tfd, st.st_mode & 07777);
 
-    remove(tempfilename);
-    return result;
-}
\ No newline at end of file
+    int status = 0;
+    for (size_t off = 0; off < result_len;) {
+        const ssize_t bytes = write(tfd, result + off, result_len - off);
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            status = -1;
+            break;
+        }
+        off += (size_t) bytes;
+    }
+    guard_free(result);
+    if (close(tfd) < 0) {
+        status = -1;
+    }
+    if (status || rename(tempfile, filename) < 0) {
+        SYSERROR("unable to replace %s: %s", filename, strerror(errno));
+        remove(tempfile);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "sha256.h"
+
+// FIPS 180-4, section 4.2.2
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR(X, N) (((X) >> (N)) | ((X) << (32 - (N))))
+
+static void sha256_block(struct SHA256 *ctx, const unsigned char *block) {
+    uint32_t w[64];
+    for (size_t i = 0; i < 16; i++) {
+        w[i] = (uint32_t) block[i * 4] << 24 | (uint32_t) block[i * 4 + 1] << 16 | (uint32_t) block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (size_t i = 16; i < 64; i++) {
+        const uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        const uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = ctx->state[0];
+    uint32_t b = ctx->state[1];
+    uint32_t c = ctx->state[2];
+    uint32_t d = ctx->state[3];
+    uint32_t e = ctx->state[4];
+    uint32_t f = ctx->state[5];
+    uint32_t g = ctx->state[6];
+    uint32_t h = ctx->state[7];
+    for (size_t i = 0; i < 64; i++) {
+        const uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        const uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+    ctx->state[4] += e;
+    ctx->state[5] += f;
+    ctx->state[6] += g;
+    ctx->state[7] += h;
+}
+
+#undef ROTR
+
+void sha256_init(struct SHA256 *ctx) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+    ctx->used = 0;
+}
+
+void sha256_update(struct SHA256 *ctx, const void *data, size_t len) {
+    const unsigned char *input = data;
+    ctx->length += len;
+
+    if (ctx->used) {
+        const size_t fill = sizeof(ctx->block) - ctx->used;
+        const size_t count = len < fill ? len : fill;
+        memcpy(ctx->block + ctx->used, input, count);
+        ctx->used += count;
+        input += count;
+        len -= count;
+        if (ctx->used < sizeof(ctx->block)) {
+            return;
+        }
+        sha256_block(ctx, ctx->block);
+        ctx->used = 0;
+    }
+    // Whole blocks are hashed in place
+    for (; len >= sizeof(ctx->block); input += sizeof(ctx->block), len -= sizeof(ctx->block)) {
+        sha256_block(ctx, input);
+    }
+    if (len) {
+        memcpy(ctx->block, input, len);
+        ctx->used = len;
+    }
+}
+
+void sha256_final(struct SHA256 *ctx, unsigned char digest[SHA256_DIGEST_SIZE]) {
+    const uint64_t bits = ctx->length * 8;
+
+    ctx->block[ctx->used++] = 0x80;
+    if (ctx->used > 56) {
+        memset(ctx->block + ctx->used, 0, sizeof(ctx->block) - ctx->used);
+        sha256_block(ctx, ctx->block);
+        ctx->used = 0;
+    }
+    memset(ctx->block + ctx->used, 0, 56 - ctx->used);
+    for (size_t i = 0; i < 8; i++) {
+        ctx->block[56 + i] = (unsigned char) (bits >> (56 - i * 8));
+    }
+    sha256_block(ctx, ctx->block);
+
+    for (size_t i = 0; i < 8; i++) {
+        digest[i * 4] = (unsigned char) (ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char) (ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char) (ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char) ctx->state[i];
+    }
+}
+
+int sha256_file(const char *filename, unsigned char digest[SHA256_DIGEST_SIZE]) {
+    unsigned char buf[65536];
+    struct SHA256 ctx;
+    ssize_t len;
+
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    sha256_init(&ctx);
+    while ((len = read(fd, buf, sizeof(buf))) != 0) {
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            const int saved_errno = errno;
+            close(fd);
+            errno = saved_errno;
+            return -1;
+        }
+        sha256_update(&ctx, buf, len);
+    }
+    close(fd);
+    sha256_final(&ctx, digest);
+    return 0;
+}
+
+void sha256_hex(const unsigned char digest[SHA256_DIGEST_SIZE], char result[SHA256_HEX_SIZE]) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < SHA256_DIGEST_SIZE; i++) {
+        result[i * 2] = digits[digest[i] >> 4];
+        result[i * 2 + 1] = digits[digest[i] & 0x0f];
+    }
+    result[SHA256_DIGEST_SIZE * 2] = '\0';
+}
+
+void sha256_base64(const unsigned char digest[SHA256_DIGEST_SIZE], char result[SHA256_BASE64_SIZE]) {
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    char *out = result;
+    size_t i = 0;
+    for (; i + 3 <= SHA256_DIGEST_SIZE; i += 3) {
+        const uint32_t group = (uint32_t) digest[i] << 16 | (uint32_t) digest[i + 1] << 8 | digest[i + 2];
+        *out++ = digits[group >> 18 & 0x3f];
+        *out++ = digits[group >> 12 & 0x3f];
+        *out++ = digits[group >> 6 & 0x3f];
+        *out++ = digits[group & 0x3f];
+    }
+    // 32 bytes leave two over. Padding is omitted.
+    const uint32_t group = (uint32_t) digest[i] << 16 | (uint32_t) digest[i + 1] << 8;
+    *out++ = digits[group >> 18 & 0x3f];
+    *out++ = digits[group >> 12 & 0x3f];
+    *out++ = digits[group >> 6 & 0x3f];
+    *out = '\0';
+}
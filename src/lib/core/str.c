@@ -63,7 +63,7 @@ void strchrdel(char *sptr, const char *chars) {
     for (size_t i = 0; i < strlen(chars); i++) {
         char ch[2] = {0};
         strncpy(ch, &chars[i], 1);
-        replace_text(sptr, ch, "", 0);
+        replace_text_n(sptr, strlen(sptr) + 1, ch, "", 0);
     }
 }
 
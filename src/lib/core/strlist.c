@@ -27,33 +27,112 @@ void strlist_free(struct StrList **pStrList) {
 }
 
 /**
- * Append a value to the list
+ * Make room for at least `count` records
+ *
+ * Appending never shrinks the list. Capacity doubles as it grows,
+ * so building a list of N records copies O(N) pointers in total.
+ *
+ * ```c
+ * struct StrList *list = strlist_init();
+ * // Allocate once, then append without reallocating
+ * strlist_reserve(list, 1000);
+ * for (size_t i = 0; i < 1000; i++) {
+ *     strlist_appendf(&list, "record %zu", i);
+ * }
+ * ```
+ *
  * @param pStrList `StrList`
- * @param str
+ * @param count total number of records
+ * @return 0 on success, -1 on error
  */
-void strlist_append(struct StrList **pStrList, char *str) {
-    char **tmp = NULL;
+int strlist_reserve(struct StrList *pStrList, size_t count) {
+    if (pStrList == NULL) {
+        return -1;
+    }
+
+    // One extra record holds the NULL terminator
+    if (count + 1 <= pStrList->num_alloc) {
+        return 0;
+    }
+    size_t num_alloc = pStrList->num_alloc ? pStrList->num_alloc : 1;
+    while (num_alloc < count + 1) {
+        num_alloc *= 2;
+    }
+
+    char **tmp = realloc(pStrList->data, num_alloc * sizeof(*pStrList->data));
+    if (tmp == NULL) {
+        return -1;
+    }
+    memset(tmp + pStrList->num_alloc, 0, (num_alloc - pStrList->num_alloc) * sizeof(*tmp));
+    pStrList->data = tmp;
+    pStrList->num_alloc = num_alloc;
+    return 0;
+}
 
+/**
+ * Append a value to the list without copying it
+ *
+ * The list takes ownership of `str`. It is released by `strlist_free`.
+ *
+ * @param pStrList `StrList`
+ * @param str heap allocated string
+ */
+void strlist_append_owned(struct StrList **pStrList, char *str) {
     if (pStrList == NULL) {
+        guard_free(str);
         return;
     }
 
-    tmp = realloc((*pStrList)->data, ((*pStrList)->num_alloc + 1) * sizeof(char *));
-    if (tmp == NULL) {
+    if (strlist_reserve(*pStrList, (*pStrList)->num_inuse + 1)) {
+        guard_free(str);
         guard_strlist_free(pStrList);
         perror("failed to append to array");
         exit(1);
     }
-    (*pStrList)->data = tmp;
-    (*pStrList)->data[(*pStrList)->num_inuse] = strdup(str);
-    (*pStrList)->data[(*pStrList)->num_alloc] = NULL;
+    (*pStrList)->data[(*pStrList)->num_inuse] = str;
     (*pStrList)->num_inuse++;
-    (*pStrList)->num_alloc++;
+    (*pStrList)->data[(*pStrList)->num_inuse] = NULL;
 }
 
-static int reader_strlist_append_file(size_t lineno, char **line) {
-    (void)(lineno);  // unused parameter
-    (void)(line);   // unused parameter
+/**
+ * Append a value to the list
+ * @param pStrList `StrList`
+ * @param str
+ */
+void strlist_append(struct StrList **pStrList, char *str) {
+    if (pStrList == NULL) {
+        return;
+    }
+    strlist_append_owned(pStrList, strdup(str));
+}
+
+struct StrListAppendFile {
+    struct StrList *list;
+    ReaderFn *readerFn;
+    size_t seen;
+    size_t used;
+};
+
+static int strlist_append_file_line(size_t lineno, const char *data, size_t len, void *arg) {
+    (void) lineno;  // unused parameter
+    struct StrListAppendFile *state = arg;
+
+    state->seen++;
+    char *line = strndup(data, len);
+    if (!line) {
+        SYSERROR("unable to allocate %zu bytes for line", len + 1);
+        exit(1);
+    }
+    if (state->readerFn) {
+        // Same contract as file_readlines(): >0 skips the line, <0 stops reading
+        const int status = state->readerFn(state->used, &line);
+        if (status) {
+            guard_free(line);
+            return status < 0 ? -1 : 0;
+        }
+    }
+    strlist_append_owned(&state->list, line);
+    state->used++;
     return 0;
 }
 
@@ -68,12 +147,11 @@ int strlist_append_file(struct StrList *pStrList, char *_path, ReaderFn *readerF
     int retval = 0;
     char *path = NULL;
     char *filename = NULL;
-    char **data = NULL;
     int is_url = strstr(_path, "://") != NULL;
-
-    if (readerFn == NULL) {
-        readerFn = reader_strlist_append_file;
-    }
+    struct StrListAppendFile state = {
+        .list = pStrList,
+        .readerFn = readerFn,
+    };
 
     path = strdup(_path);
     if (path == NULL) {
@@ -107,20 +185,16 @@ int strlist_append_file(struct StrList *pStrList, char *_path, ReaderFn *readerF
         }
     }
 
-    data = file_readlines(filename, 0, 0, readerFn);
-    if (data == NULL) {
+    if (file_foreach_line(filename, strlist_append_file_line, &state)) {
+        SYSERROR("failed to read %s: %s", filename, strerror(errno));
+        retval = -1;
+    } else if (!state.seen) {
         retval = 1;
-        goto fatal;
-    }
-    for (size_t record = 0; data[record] != NULL; record++) {
-        strlist_append(&pStrList, data[record]);
-        guard_free(data[record]);
     }
     if (is_url) {
         // remove temporary data
         remove(filename);
     }
-    guard_free(data);
 
 fatal:
     guard_free(filename);
@@ -186,6 +260,7 @@ void strlist_append_strlist(struct StrList *pStrList1, struct StrList *pStrList2
     }
 
     count = strlist_count(pStrList2);
+    strlist_reserve(pStrList1, strlist_count(pStrList1) + count);
     for (size_t i = 0; i < count; i++) {
         char *item = strlist_item(pStrList2, i);
         strlist_append(&pStrList1, item);
@@ -201,32 +276,63 @@ void strlist_append_strlist(struct StrList *pStrList1, struct StrList *pStrList2
      if (!pStrList || !arr) {
          return;
      }
+     size_t count = 0;
+     while (arr[count] != NULL) {
+         count++;
+     }
+     strlist_reserve(pStrList, strlist_count(pStrList) + count);
      for (size_t i = 0; arr[i] != NULL; i++) {
          strlist_append(&pStrList, arr[i]);
      }
  }
 
 /**
- * Append the contents of a newline delimited string
+ * Split `str` on any character in `delim` and append each token
+ *
+ * Tokens are counted first so the list grows once. Each token is copied once.
+ *
  * @param pStrList `StrList`
  * @param str
  * @param delim
+ * @param strip_leading remove leading whitespace from each token
  */
- void strlist_append_tokenize(struct StrList *pStrList, char *str, char *delim) {
-     if (!str || !delim) {
-         return;
-     }
+static void strlist_append_tokens(struct StrList *pStrList, const char *str, const char *delim, int strip_leading) {
+    if (!pStrList || !str || !delim) {
+        return;
+    }
 
-     char *tmp = strdup(str);
-     char **token = split(tmp, delim, 0);
-     if (token) {
-         for (size_t i = 0; token[i] != NULL; i++) {
-             lstrip(token[i]);
-             strlist_append(&pStrList, token[i]);
-         }
-         guard_array_free(token);
-     }
+    char *tmp = strdup(str);
+    if (!tmp) {
+        return;
+    }
+
+    size_t count = 1;
+    for (const char *ch = tmp; *ch; ch++) {
+        if (strchr(delim, *ch)) {
+            count++;
+        }
+    }
+    strlist_reserve(pStrList, strlist_count(pStrList) + count);
+
+    char *token = NULL;
+    char *cursor = tmp;
+    while ((token = strsep(&cursor, delim)) != NULL) {
+        if (strip_leading) {
+            lstrip(token);
+        }
+        strlist_append_owned(&pStrList, strdup(token));
+    }
     guard_free(tmp);
+}
+
+/**
+ * Append the contents of a newline delimited string
+ * @param pStrList `StrList`
+ * @param str
+ * @param delim
+ */
+ void strlist_append_tokenize(struct StrList *pStrList, char *str, char *delim) {
+     strlist_append_tokens(pStrList, str, delim, 1);
  }
 
 /**
@@ -237,19 +343,7 @@ void strlist_append_strlist(struct StrList *pStrList1, struct StrList *pStrList2
  * @param delim
  */
 void strlist_append_tokenize_raw(struct StrList *pStrList, char *str, char *delim) {
-    if (!str || !delim) {
-        return;
-    }
-
-    char *tmp = strdup(str);
-    char **token = split(tmp, delim, 0);
-    if (token) {
-        for (size_t i = 0; token[i] != NULL; i++) {
-            strlist_append(&pStrList, token[i]);
-        }
-        guard_array_free(token);
-    }
-    guard_free(tmp);
+    strlist_append_tokens(pStrList, str, delim, 0);
 }
 
 /**
@@ -290,6 +384,7 @@ struct StrList *strlist_copy(struct StrList *pStrList) {
         return NULL;
     }
 
+    strlist_reserve(result, strlist_count(pStrList));
     for (size_t i = 0; i < strlist_count(pStrList); i++) {
         strlist_append(&result, strlist_item(pStrList, i));
     }
@@ -332,7 +427,8 @@ int strlist_cmp(struct StrList *a, struct StrList *b) {
         return -2;
     }
 
-    if (a->num_alloc != b->num_alloc || a->num_inuse != b->num_inuse) {
+    // Capacity depends on how a list was built. Only the records matter.
+    if (a->num_inuse != b->num_inuse) {
         return 1;
     }
 
@@ -19,6 +19,50 @@ unsigned tpl_pool_used = 0;
 struct tplfunc_frame *tpl_pool_func[1024] = {0};
 unsigned tpl_pool_func_used = 0;
 
+// Hash indexes into tpl_pool and tpl_pool_func (position + 1, 0 is empty).
+// Twice the size of the pools so probe sequences stay short.
+#define TPL_INDEX_SIZE 2048
+static unsigned tpl_pool_index[TPL_INDEX_SIZE] = {0};
+static unsigned tpl_pool_func_index[TPL_INDEX_SIZE] = {0};
+
+static unsigned tpl_hash(const char *key) {
+    // FNV-1a
+    unsigned hash = 2166136261U;
+    for (const char *ch = key; *ch; ch++) {
+        hash ^= (unsigned char) *ch;
+        hash *= 16777619U;
+    }
+    return hash & (TPL_INDEX_SIZE - 1);
+}
+
+static struct tpl_item *tpl_item_find(const char *key) {
+    for (unsigned slot = tpl_hash(key); tpl_pool_index[slot]; slot = (slot + 1) & (TPL_INDEX_SIZE - 1)) {
+        struct tpl_item *item = tpl_pool[tpl_pool_index[slot] - 1];
+        if (item && item->key && !strcmp(item->key, key)) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+static struct tplfunc_frame *tpl_func_find(const char *key) {
+    for (unsigned slot = tpl_hash(key); tpl_pool_func_index[slot]; slot = (slot + 1) & (TPL_INDEX_SIZE - 1)) {
+        struct tplfunc_frame *frame = tpl_pool_func[tpl_pool_func_index[slot] - 1];
+        if (frame && frame->key && !strcmp(frame->key, key)) {
+            return frame;
+        }
+    }
+    return NULL;
+}
+
+static void tpl_index_insert(unsigned *index, const char *key, unsigned pos) {
+    unsigned slot = tpl_hash(key);
+    while (index[slot]) {
+        slot = (slot + 1) & (TPL_INDEX_SIZE - 1);
+    }
+    index[slot] = pos + 1;
+}
+
 extern void tpl_reset() {
     SYSDEBUG("%s", "Resetting template engine");
     tpl_free();
@@ -27,6 +71,11 @@ extern void tpl_reset() {
 }
 
 void tpl_register_func(char *key, void *tplfunc_ptr, int argc, void *data_in) {
+    if (tpl_pool_func_used >= sizeof(tpl_pool_func) / sizeof(*tpl_pool_func)) {
+        SYSERROR("unable to register function %s: too many functions", key);
+        exit(1);
+    }
+
     struct tplfunc_frame *frame = calloc(1, sizeof(*frame));
     frame->key = strdup(key);
     frame->argc = argc;
@@ -34,19 +83,19 @@ void tpl_register_func(char *key, void *tplfunc_ptr, int argc, void *data_in) {
     frame->data_in = data_in;
     SYSDEBUG("Registering function:\n\tkey=%s\n\targc=%d\n\tfunc=%p\n\tdata_in=%p", frame->key, frame->argc, frame->func, frame->data_in);
 
+    // The first function registered under a name wins
+    if (!tpl_func_find(key)) {
+        tpl_index_insert(tpl_pool_func_index, frame->key, tpl_pool_func_used);
+    }
     tpl_pool_func[tpl_pool_func_used] = frame;
     tpl_pool_func_used++;
 }
 
 int tpl_key_exists(char *key) {
     SYSDEBUG("Key '%s' exists?", key);
-    for (size_t i = 0; i < tpl_pool_used; i++) {
-        if (tpl_pool[i]->key) {
-            if (!strcmp(tpl_pool[i]->key, key)) {
-                SYSDEBUG("%s", "YES");
-                return true;
-            }
-        }
+    if (tpl_item_find(key)) {
+        SYSDEBUG("%s", "YES");
+        return true;
     }
     SYSDEBUG("%s", "NO");
     return false;
@@ -57,21 +106,20 @@ void tpl_register(char *key, char **ptr) {
     int replacing = 0;
 
     SYSDEBUG("Registering string:\n\tkey=%s\n\tptr=%s", key, *ptr ? *ptr : "NOT SET");
-    if (tpl_key_exists(key)) {
-        for (size_t i = 0; i < tpl_pool_used; i++) {
-            if (tpl_pool[i]->key) {
-                if (!strcmp(tpl_pool[i]->key, key)) {
-                    item = tpl_pool[i];
-                    break;
-                }
-            }
-        }
+    item = tpl_item_find(key);
+    if (item) {
         replacing = 1;
         SYSDEBUG("%s", "Item will be replaced");
     } else {
+        if (tpl_pool_used >= sizeof(tpl_pool) / sizeof(*tpl_pool)) {
+            SYSERROR("unable to register tpl_item for %s: too many items", key);
+            exit(1);
+        }
         SYSDEBUG("%s", "Creating new item");
         item = calloc(1, sizeof(*item));
-        item->key = strdup(key);
+        if (item) {
+            item->key = strdup(key);
+        }
     }
 
     if (!item) {
@@ -82,6 +130,7 @@ void tpl_register(char *key, char **ptr) {
     item->ptr = ptr;
     if (!replacing) {
         SYSDEBUG("Registered tpl_item at index %u:\n\tkey=%s\n\tptr=%s", tpl_pool_used, item->key, *item->ptr);
+        tpl_index_insert(tpl_pool_index, item->key, tpl_pool_used);
         tpl_pool[tpl_pool_used] = item;
         tpl_pool_used++;
     }
@@ -107,188 +156,286 @@ void tpl_free() {
         SYSDEBUG("freeing template item: %p", item);
         guard_free(item);
     }
+    memset(tpl_pool_index, 0, sizeof(tpl_pool_index));
+    memset(tpl_pool_func_index, 0, sizeof(tpl_pool_func_index));
 }
 
 char *tpl_getval(char *key) {
-    char *result = NULL;
     SYSDEBUG("Getting value of template string: %s", key);
-    for (size_t i = 0; i < tpl_pool_used; i++) {
-        if (tpl_pool[i]->key) {
-            if (!strcmp(tpl_pool[i]->key, key)) {
-                result = *tpl_pool[i]->ptr;
-                break;
-            }
-        }
-    }
-    return result;
+    const struct tpl_item *item = tpl_item_find(key);
+    return item ? *item->ptr : NULL;
 }
 
 struct tplfunc_frame *tpl_getfunc(char *key) {
     SYSDEBUG("Getting function frame: %s", key);
-    struct tplfunc_frame *result = NULL;
-    for (size_t i = 0; i < tpl_pool_func_used; i++) {
-        if (tpl_pool_func[i]->key) {
-            if (!strcmp(tpl_pool_func[i]->key, key)) {
-                result = tpl_pool_func[i];
-                break;
-            }
+    return tpl_func_find(key);
+}
+
+static struct TemplateToken *tpl_token_new(struct Template *tpl, int type, size_t offset) {
+    if (tpl->num_used >= tpl->num_alloc) {
+        const size_t num_alloc = tpl->num_alloc ? tpl->num_alloc * 2 : 16;
+        struct TemplateToken *tmp = realloc(tpl->token, num_alloc * sizeof(*tpl->token));
+        if (!tmp) {
+            perror("unable to allocate template token");
+            return NULL;
         }
+        tpl->token = tmp;
+        tpl->num_alloc = num_alloc;
     }
-    return result;
+    struct TemplateToken *token = &tpl->token[tpl->num_used];
+    memset(token, 0, sizeof(*token));
+    token->type = type;
+    token->offset = offset;
+    tpl->num_used++;
+    return token;
 }
 
-char *tpl_render(char *str) {
+static int tpl_compile_text(struct Template *tpl, const char *str, size_t offset, size_t len) {
+    struct TemplateToken *token = tpl_token_new(tpl, TPL_TOKEN_TEXT, offset);
+    if (!token) {
+        return -1;
+    }
+    token->data = strndup(str + offset, len);
+    if (!token->data) {
+        return -1;
+    }
+    token->len = len;
+    tpl->text_len += len;
+    return 0;
+}
+
+/**
+ * Parse the inside of a "{{ ... }}" block
+ * @param tpl pointer to Template
+ * @param key text between the braces (whitespace removed)
+ * @param offset position of the block in the source text
+ * @return 0 on success, -1 on error
+ */
+static int tpl_compile_key(struct Template *tpl, char *key, size_t offset) {
+    int type = TPL_TOKEN_VAR;
+    char *type_stop = strchr(key, ':');
+    if (type_stop) {
+        if (type_stop - key == 3 && !strncmp(key, "env", 3)) {
+            SYSDEBUG("%s", "Will render as value of environment variable");
+            type = TPL_TOKEN_ENV;
+        } else if (type_stop - key == 4 && !strncmp(key, "func", 4)) {
+            SYSDEBUG("%s", "Will render as output from function");
+            type = TPL_TOKEN_FUNC;
+        }
+    }
+
+    char *name = type == TPL_TOKEN_VAR ? key : type_stop + 1;
+    char **params = NULL;
+    if (type == TPL_TOKEN_FUNC) { // {{ func:NAME(a, ...) }}
+        char *param_begin = strchr(name, '(');
+        if (!param_begin) {
+            fprintf(stderr, "At position %zu in %s\nfunction name must be followed by a '('\n", offset, key);
+            return -1;
+        }
+        *param_begin = 0;
+        param_begin++;
+        char *param_end = strrchr(param_begin, ')');
+        if (!param_end) {
+            fprintf(stderr, "At position %zu in %s\nfunction arguments must be closed with a ')'\n", offset, key);
+            return -1;
+        }
+        *param_end = 0;
+        params = split(param_begin, ",", 0);
+        if (!params) {
+            return -1;
+        }
+        for (size_t p = 0; params[p] != NULL; p++) {
+            lstrip(params[p]);
+            strip(params[p]);
+        }
+    }
+
+    struct TemplateToken *token = tpl_token_new(tpl, type, offset);
+    if (!token) {
+        guard_array_free(params);
+        return -1;
+    }
+    token->data = strdup(name);
+    if (!token->data) {
+        guard_array_free(params);
+        return -1;
+    }
+    token->len = strlen(token->data);
+    token->argv = params;
+    for (token->argc = 0; params && params[token->argc] != NULL; token->argc++) {}
+    return 0;
+}
+
+struct Template *tpl_compile(const char *str) {
     if (!str) {
         return NULL;
-    } else if (!strlen(str)) {
-        return strdup("");
     }
-    size_t output_bytes = 1024 + strlen(str); // TODO: Is grow working correctly?
-    char *output = NULL;
-    char *b_close = NULL;
-    char *pos = NULL;
-    pos = str;
 
-    output = calloc(output_bytes, sizeof(*output));
-    if (!output) {
-        perror("unable to allocate output buffer");
+    struct Template *tpl = calloc(1, sizeof(*tpl));
+    if (!tpl) {
+        perror("unable to allocate template");
         return NULL;
     }
 
-    for (size_t off = 0, z = 0; off < strlen(str); off++) {
-        char key[255] = {0};
-        char *value = NULL;
-
-        memset(key, 0, sizeof(key));
-        grow(z, &output_bytes, &output);
+    const char *pos = str;
+    while (*pos) {
         // At opening brace
-        if (!strncmp(&pos[off], "{{", 2)) {
-            // Scan until key is reached
-            while (!isalnum(pos[off])) {
-                off++;
+        const char *b_open = strstr(pos, "{{");
+        if (!b_open) {
+            if (tpl_compile_text(tpl, str, pos - str, strlen(pos))) {
+                goto tpl_compile_error;
             }
+            break;
+        }
+        if (b_open > pos && tpl_compile_text(tpl, str, pos - str, b_open - pos)) {
+            goto tpl_compile_error;
+        }
 
-            // Read key name
-            SYSDEBUG("%s", "Reading key");
-            size_t key_len = 0;
-            while (isalnum(pos[off]) || pos[off] != '}') {
-                if (isspace(pos[off]) || isblank(pos[off])) {
-                    // skip whitespace in key
-                    off++;
-                    continue;
-                }
-                key[key_len] = pos[off];
-                key_len++;
-                off++;
-            }
-            SYSDEBUG("Key is %s", key);
-
-            char *type_stop = NULL;
-            type_stop = strchr(key, ':');
-
-            int do_env = 0;
-            int do_func = 0;
-            if (type_stop) {
-                if (!strncmp(key, "env", type_stop - key)) {
-                    SYSDEBUG("%s", "Will render as value of environment variable");
-                    do_env = 1;
-                } else if (!strncmp(key, "func", type_stop - key)) {
-                    SYSDEBUG("%s", "Will render as output from function");
-                    do_func = 1;
-                }
-            }
+        // Find closing brace
+        const char *b_close = strstr(b_open + 2, "}}");
+        if (!b_close) {
+            fprintf(stderr, "error while templating '%s'\n\nunbalanced brace at position %zu\n", str, (size_t) (b_open - str));
+            goto tpl_compile_error;
+        }
 
-            // Find closing brace
-            b_close = strstr(&pos[off], "}}");
-            if (!b_close) {
-                fprintf(stderr, "error while templating '%s'\n\nunbalanced brace at position %zu\n", str, z);
-                guard_free(output);
-                return NULL;
-            } else {
-                // Jump past closing brace
-                off = ((b_close + 2) - pos);
+        // Read key name. Whitespace is not significant.
+        char *key = calloc(b_close - b_open, sizeof(*key));
+        if (!key) {
+            perror("unable to allocate template key");
+            goto tpl_compile_error;
+        }
+        size_t key_len = 0;
+        for (const char *ch = b_open + 2; ch < b_close; ch++) {
+            if (isspace((unsigned char) *ch) || (!key_len && !isalnum((unsigned char) *ch))) {
+                continue;
             }
+            key[key_len++] = *ch;
+        }
+        SYSDEBUG("Key is %s", key);
 
-            if (do_env) { // {{ env:VAR }}
-                char *k = type_stop + 1;
-                size_t klen = strlen(k);
-                memmove(key, k, klen);
-                key[klen] = 0;
-                char *env_val = getenv(key);
-                value = strdup(env_val ? env_val : "");
-            } else if (do_func) { // {{ func:NAME(a, ...) }}
-                char func_name_temp[STASIS_NAME_MAX] = {0};
-                strncpy(func_name_temp, type_stop + 1, sizeof(func_name_temp) - 1);
-                char *param_begin = strchr(func_name_temp, '(');
-                if (!param_begin) {
-                    fprintf(stderr, "At position %zu in %s\nfunction name must be followed by a '('\n", off, key);
-                    guard_free(output);
-                    return NULL;
-                }
-                *param_begin = 0;
-                param_begin++;
-                char *param_end = strrchr(param_begin, ')');
-                if (!param_end) {
-                    fprintf(stderr, "At position %zu in %s\nfunction arguments must be closed with a ')'\n", off, key);
-                    guard_free(output);
-                    return NULL;
+        const int status = tpl_compile_key(tpl, key, b_open - str);
+        guard_free(key);
+        if (status) {
+            goto tpl_compile_error;
+        }
+
+        // Jump past closing brace
+        pos = b_close + 2;
+    }
+    return tpl;
+
+    tpl_compile_error:
+    tpl_compiled_free(&tpl);
+    return NULL;
+}
+
+void tpl_compiled_free(struct Template **tpl) {
+    if (!tpl || !*tpl) {
+        return;
+    }
+    for (size_t i = 0; i < (*tpl)->num_used; i++) {
+        guard_free((*tpl)->token[i].data);
+        guard_array_free((*tpl)->token[i].argv);
+    }
+    guard_free((*tpl)->token);
+    guard_free(*tpl);
+}
+
+/**
+ * Produce the text of a token
+ * @param token pointer to TemplateToken
+ * @param len receives the length of the text
+ * @param allocated receives memory that must be freed after the text is used (may be NULL)
+ * @return text of token
+ */
+static const char *tpl_token_value(const struct TemplateToken *token, size_t *len, char **allocated) {
+    const char *value = NULL;
+
+    *allocated = NULL;
+    switch (token->type) {
+        case TPL_TOKEN_TEXT:
+            *len = token->len;
+            return token->data;
+        case TPL_TOKEN_ENV: // {{ env:VAR }}
+            value = getenv(token->data);
+            break;
+        case TPL_TOKEN_FUNC: { // {{ func:NAME(a, ...) }}
+            struct tplfunc_frame *frame = tpl_func_find(token->data);
+            if (!frame) {
+                fprintf(stderr, "At position %zu\nUnknown function: %s\n", token->offset, token->data);
+            } else if (token->argc != frame->argc) {
+                fprintf(stderr, "At position %zu\nIncorrect number of arguments for function: %s (expected %d, got %d)\n", token->offset, frame->key, frame->argc, token->argc);
+            } else {
+                for (size_t p = 0; p < sizeof(frame->argv) / sizeof(*frame->argv) && p < (size_t) token->argc; p++) {
+                    frame->argv[p].t_char_ptr = token->argv[p];
                 }
-                *param_end = 0;
-                char *k = func_name_temp;
-                char **params = split(param_begin, ",", 0);
-                int params_count;
-                for (params_count = 0; params[params_count] != NULL; params_count++) {}
-
-                struct tplfunc_frame *frame = tpl_getfunc(k);
-                if (params_count > frame->argc || params_count < frame->argc) {
-                    fprintf(stderr, "At position %zu in %s\nIncorrect number of arguments for function: %s (expected %d, got %d)\n", off, key, frame->key, frame->argc, params_count);
-                    value = strdup("");
-                } else {
-                    for (size_t p = 0; p < sizeof(frame->argv) / sizeof(*frame->argv) && params[p] != NULL; p++) {
-                        lstrip(params[p]);
-                        strip(params[p]);
-                        frame->argv[p].t_char_ptr = params[p];
-                    }
-                    char *func_result = NULL;
-                    int func_status = 0;
-                    if ((func_status = frame->func(frame, &func_result))) {
-                        fprintf(stderr, "%s returned non-zero status: %d\n", frame->key, func_status);
-                    }
-                    value = strdup(func_result ? func_result : "");
-                    SYSDEBUG("Returned from function: %s (status: %d)\nData OUT\n--------\n'%s'", k, func_status, value);
-                    guard_free(func_result);
+                int func_status = 0;
+                if ((func_status = frame->func(frame, allocated))) {
+                    fprintf(stderr, "%s returned non-zero status: %d\n", frame->key, func_status);
                 }
-                guard_array_free(params);
-            } else {
-                // Read replacement value
-                value = strdup(tpl_getval(key) ? tpl_getval(key) : "");
-                SYSDEBUG("Rendered:\nData\n----\n'%s'", value);
+                value = *allocated;
+                SYSDEBUG("Returned from function: %s (status: %d)\nData OUT\n--------\n'%s'", token->data, func_status, value ? value : "");
             }
+            break;
         }
+        default:
+            // Read replacement value
+            value = tpl_getval(token->data);
+            SYSDEBUG("Rendered:\nData\n----\n'%s'", value ? value : "");
+            break;
+    }
 
-        if (value) {
-            // Set output iterator to end of replacement value
-            z += strlen(value);
+    if (!value) {
+        value = "";
+    }
+    *len = strlen(value);
+    return value;
+}
 
-            // Append replacement value
-            grow(z, &output_bytes, &output);
-            strncat(output, value, output_bytes - strlen(output) - 1);
-            guard_free(value);
-            output[z] = 0;
-        }
+char *tpl_render_compiled(const struct Template *tpl) {
+    if (!tpl) {
+        return NULL;
+    }
 
-        output[z] = pos[off];
-        z++;
+    size_t output_bytes = 1024 + tpl->text_len;
+    size_t z = 0;
+    char *output = calloc(output_bytes, sizeof(*output));
+    if (!output) {
+        perror("unable to allocate output buffer");
+        return NULL;
     }
-    //SYSDEBUG("template output length: %zu", strlen(output));
-    //SYSDEBUG("template output bytes: %zu", output_bytes);
+
+    for (size_t i = 0; i < tpl->num_used; i++) {
+        char *allocated = NULL;
+        size_t len = 0;
+        const char *value = tpl_token_value(&tpl->token[i], &len, &allocated);
+
+        if (z + len >= output_bytes) {
+            // Grow geometrically so rendering stays linear
+            size_t new_size = output_bytes * 2;
+            while (z + len >= new_size) {
+                new_size *= 2;
+            }
+            char *tmp = realloc(output, new_size);
+            if (!tmp) {
+                perror("unable to grow output buffer");
+                guard_free(allocated);
+                guard_free(output);
+                return NULL;
+            }
+            output = tmp;
+            output_bytes = new_size;
+        }
+        memcpy(output + z, value, len);
+        z += len;
+        guard_free(allocated);
+    }
+    output[z] = 0;
     return output;
 }
 
-int tpl_render_to_file(char *str, const char *filename) {
-    // Render the input string
-    char *result = tpl_render(str);
-    if (!result) {
+int tpl_render_compiled_to_file(const struct Template *tpl, const char *filename) {
+    if (!tpl) {
         return -1;
     }
 
@@ -296,15 +443,53 @@ int tpl_render_to_file(char *str, const char *filename) {
     SYSDEBUG("Rendering to %s", filename);
     FILE *fp = fopen(filename, "w+");
     if (!fp) {
-        guard_free(result);
         return -1;
     }
 
-    // Write rendered string to file
-    fprintf(fp, "%s", result);
-    fclose(fp);
-    SYSDEBUG("%s", "Rendered successfully");
+    // Write rendered tokens to file
+    int status = 0;
+    for (size_t i = 0; i < tpl->num_used; i++) {
+        char *allocated = NULL;
+        size_t len = 0;
+        const char *value = tpl_token_value(&tpl->token[i], &len, &allocated);
+        if (len && fwrite(value, 1, len, fp) != len) {
+            status = -1;
+        }
+        guard_free(allocated);
+    }
+    if (fclose(fp)) {
+        status = -1;
+    }
+    if (!status) {
+        SYSDEBUG("%s", "Rendered successfully");
+    }
+    return status;
+}
 
-    guard_free(result);
-    return 0;
-}
\ No newline at end of file
+char *tpl_render(char *str) {
+    if (!str) {
+        return NULL;
+    } else if (!strlen(str)) {
+        return strdup("");
+    }
+
+    struct Template *tpl = tpl_compile(str);
+    if (!tpl) {
+        return NULL;
+    }
+    char *output = tpl_render_compiled(tpl);
+    tpl_compiled_free(&tpl);
+    return output;
+}
+
+int tpl_render_to_file(char *str, const char *filename) {
+    // Parse the input string
+    struct Template *tpl = tpl_compile(str);
+    if (!tpl) {
+        return -1;
+    }
+
+    const int status = tpl_render_compiled_to_file(tpl, filename);
+    tpl_compiled_free(&tpl);
+    return status;
+}
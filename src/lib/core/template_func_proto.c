@@ -36,9 +36,9 @@ int get_github_release_notes_auto_tplfunc_entrypoint(void *frame, void *data_out
             char *match = strstr(repository, "spacetelescope/");
             // Cull repository URL
             if (match) {
-                replace_text(repository, "https://github.com/", "", 0);
+                replace_text_n(repository, strlen(repository) + 1, "https://github.com/", "", 0);
                 if (endswith(repository, ".git")) {
-                    replace_text(repository, ".git", "", 0);
+                    replace_text_n(repository, strlen(repository) + 1, ".git", "", 0);
                 }
                 // Record release notes for version relative to HEAD
                 // Using HEAD, GitHub returns the previous tag
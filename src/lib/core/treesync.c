@@ -0,0 +1,653 @@
+#include <dirent.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+#include "treesync.h"
+#include "copy.h"
+#include "multiprocessing.h"
+#include "utils.h"
+
+struct TreeSyncEntry {
+    char *rel; ///< Path relative to the destination
+    size_t source; ///< Index of the root the entry was found in
+    mode_t mode; ///< Type and permission bits
+    off_t size; ///< Size in bytes
+    dev_t rdev; ///< Device number of special files
+    struct timespec mtime; ///< Modification time
+};
+
+struct TreeSync {
+    char **roots; ///< Source directories (relative paths are resolved against these)
+    size_t roots_count; ///< Number of roots
+    const char *dest; ///< Destination directory
+    const struct TreeSyncOptions *opts; ///< Options
+    struct TreeSyncEntry *entry; ///< Array of entries found in the sources
+    size_t num_used; ///< Number of entries populated in the entry array
+    size_t num_alloc; ///< Number of entries allocated by the entry array
+    size_t *files; ///< Indexes of entries copied by tree_sync_copy_entry()
+    size_t files_count; ///< Number of indexes in the files array
+    struct TreeSyncStats *counters; ///< Counters shared with worker processes
+};
+
+static const struct TreeSyncOptions tree_sync_defaults = {0};
+
+static size_t tree_sync_count(char **arr) {
+    size_t result = 0;
+    while (arr && arr[result]) {
+        result++;
+    }
+    return result;
+}
+
+/**
+ * Compare paths so a directory's children sort immediately after the directory
+ */
+static int tree_sync_path_cmp(const char *a, const char *b) {
+    for (; *a && *a == *b; a++, b++) {}
+    const unsigned char ca = *a == '/' ? 1 : (unsigned char) *a;
+    const unsigned char cb = *b == '/' ? 1 : (unsigned char) *b;
+    return (ca > cb) - (ca < cb);
+}
+
+static int tree_sync_entry_cmp(const void *a, const void *b) {
+    const struct TreeSyncEntry *ea = a;
+    const struct TreeSyncEntry *eb = b;
+    const int result = tree_sync_path_cmp(ea->rel, eb->rel);
+    if (result) {
+        return result;
+    }
+    return (ea->source > eb->source) - (ea->source < eb->source);
+}
+
+static int tree_sync_entry_find_cmp(const void *key, const void *entry) {
+    return tree_sync_path_cmp(key, ((const struct TreeSyncEntry *) entry)->rel);
+}
+
+static struct TreeSyncEntry *tree_sync_find(const struct TreeSync *ts, const char *rel, size_t count) {
+    return bsearch(rel, ts->entry, count, sizeof(*ts->entry), tree_sync_entry_find_cmp);
+}
+
+/**
+ * Match a path against a list of patterns
+ * @param patterns list of patterns (may be NULL)
+ * @param rel path relative to the root
+ * @param is_dir path is a directory
+ * @return true if any pattern matches
+ */
+static bool tree_sync_match(const struct StrList *patterns, const char *rel, bool is_dir) {
+    const char *base = strrchr(rel, '/');
+    base = base ? base + 1 : rel;
+
+    for (size_t i = 0; i < strlist_count((struct StrList *) patterns); i++) {
+        char pattern[PATH_MAX] = {0};
+        strncpy(pattern, strlist_item((struct StrList *) patterns, i), sizeof(pattern) - 1);
+
+        const size_t len = strlen(pattern);
+        if (len && pattern[len - 1] == '/') {
+            if (!is_dir) {
+                continue;
+            }
+            pattern[len - 1] = '\0';
+        }
+
+        const char *pat = pattern;
+        while (*pat == '/') {
+            pat++;
+        }
+        if (strchr(pat, '/')) {
+            if (!fnmatch(pat, rel, FNM_PATHNAME)) {
+                return true;
+            }
+        } else if (!fnmatch(pat, base, 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Determine whether a path is excluded by the include and exclude patterns
+ */
+static bool tree_sync_filtered(const struct TreeSync *ts, const char *rel, bool is_dir) {
+    if (tree_sync_match(ts->opts->exclude, rel, is_dir)) {
+        return true;
+    }
+    if (!is_dir && strlist_count(ts->opts->include) && !tree_sync_match(ts->opts->include, rel, false)) {
+        return true;
+    }
+    return false;
+}
+
+static int tree_sync_append(struct TreeSync *ts, size_t source, const char *rel, const struct stat *st) {
+    if (ts->num_used == ts->num_alloc) {
+        const size_t num_alloc = ts->num_alloc ? ts->num_alloc * 2 : 64;
+        struct TreeSyncEntry *tmp = realloc(ts->entry, num_alloc * sizeof(*ts->entry));
+        if (!tmp) {
+            SYSERROR("%s", "Unable to allocate tree entries");
+            return -1;
+        }
+        ts->entry = tmp;
+        ts->num_alloc = num_alloc;
+    }
+
+    struct TreeSyncEntry *entry = &ts->entry[ts->num_used];
+    entry->rel = strdup(rel);
+    if (!entry->rel) {
+        return -1;
+    }
+    entry->source = source;
+    entry->mode = st->st_mode;
+    entry->size = st->st_size;
+    entry->rdev = st->st_rdev;
+#if defined(STASIS_OS_DARWIN)
+    entry->mtime = st->st_mtimespec;
+#else
+    entry->mtime = st->st_mtim;
+#endif
+    ts->num_used++;
+    return 0;
+}
+
+static int tree_sync_scan(struct TreeSync *ts, size_t source, int parent_fd, const char *name, const char *rel);
+
+/**
+ * Record the contents of a directory
+ * @param fd an open directory (closed on return)
+ */
+static int tree_sync_scan_dir(struct TreeSync *ts, size_t source, int fd, const char *rel) {
+    DIR *dp = fdopendir(fd);
+    if (!dp) {
+        SYSERROR("%s: %s", rel, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    int status = 0;
+    struct dirent *rec;
+    while (!status && (rec = readdir(dp)) != NULL) {
+        if (!strcmp(rec->d_name, ".") || !strcmp(rec->d_name, "..")) {
+            continue;
+        }
+        char child[PATH_MAX] = {0};
+        if (snprintf(child, sizeof(child), "%s%s%s", rel, *rel ? "/" : "", rec->d_name) >= (int) sizeof(child)) {
+            SYSERROR("Path is too long: %s/%s", rel, rec->d_name);
+            status = -1;
+            break;
+        }
+        status = tree_sync_scan(ts, source, dirfd(dp), rec->d_name, child);
+    }
+    closedir(dp);
+    return status;
+}
+
+/**
+ * Record a source entry, and everything below it
+ */
+static int tree_sync_scan(struct TreeSync *ts, size_t source, int parent_fd, const char *name, const char *rel) {
+    struct stat st;
+    if (fstatat(parent_fd, name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+        SYSERROR("%s/%s: %s", ts->roots[source], rel, strerror(errno));
+        return -1;
+    }
+
+    const bool is_dir = S_ISDIR(st.st_mode);
+    if (tree_sync_filtered(ts, rel, is_dir)) {
+        return 0;
+    }
+    if (tree_sync_append(ts, source, rel, &st)) {
+        return -1;
+    }
+    if (is_dir) {
+        const int fd = openat(parent_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0) {
+            SYSERROR("%s/%s: %s", ts->roots[source], rel, strerror(errno));
+            return -1;
+        }
+        return tree_sync_scan_dir(ts, source, fd, rel);
+    }
+    return 0;
+}
+
+/**
+ * Sort entries and drop the ones hidden by an earlier source
+ */
+static void tree_sync_merge(struct TreeSync *ts) {
+    qsort(ts->entry, ts->num_used, sizeof(*ts->entry), tree_sync_entry_cmp);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < ts->num_used; i++) {
+        struct TreeSyncEntry *entry = &ts->entry[i];
+        bool drop = kept && !strcmp(ts->entry[kept - 1].rel, entry->rel);
+
+        // An earlier source may provide a file where this source has a directory
+        char *sep = strrchr(entry->rel, '/');
+        if (!drop && sep) {
+            *sep = '\0';
+            const struct TreeSyncEntry *parent = tree_sync_find(ts, entry->rel, kept);
+            drop = !parent || !S_ISDIR(parent->mode);
+            *sep = '/';
+        }
+
+        if (drop) {
+            guard_free(entry->rel);
+            continue;
+        }
+        ts->entry[kept++] = *entry;
+    }
+    ts->num_used = kept;
+}
+
+static int tree_sync_path(const char *root, const char *rel, char *result, size_t maxlen) {
+    if (snprintf(result, maxlen, "%s/%s", root, rel) >= (int) maxlen) {
+        SYSERROR("Path is too long: %s/%s", root, rel);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Remove destination entries that do not exist in the sources
+ * @param fd an open directory (closed on return)
+ */
+static int tree_sync_prune(struct TreeSync *ts, int fd, const char *rel) {
+    DIR *dp = fdopendir(fd);
+    if (!dp) {
+        SYSERROR("%s/%s: %s", ts->dest, rel, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    int status = 0;
+    struct dirent *rec;
+    while (!status && (rec = readdir(dp)) != NULL) {
+        if (!strcmp(rec->d_name, ".") || !strcmp(rec->d_name, "..")) {
+            continue;
+        }
+        char child[PATH_MAX] = {0};
+        if (snprintf(child, sizeof(child), "%s%s%s", rel, *rel ? "/" : "", rec->d_name) >= (int) sizeof(child)) {
+            SYSERROR("Path is too long: %s/%s", rel, rec->d_name);
+            status = -1;
+            break;
+        }
+
+        struct stat st;
+        if (fstatat(dirfd(dp), rec->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+            continue;
+        }
+        const bool is_dir = S_ISDIR(st.st_mode);
+        if (tree_sync_filtered(ts, child, is_dir)) {
+            continue;
+        }
+
+        const struct TreeSyncEntry *entry = tree_sync_find(ts, child, ts->num_used);
+        if (entry) {
+            if (is_dir && S_ISDIR(entry->mode)) {
+                const int child_fd = openat(dirfd(dp), rec->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                if (child_fd < 0) {
+                    SYSERROR("%s/%s: %s", ts->dest, child, strerror(errno));
+                    status = -1;
+                    break;
+                }
+                status = tree_sync_prune(ts, child_fd, child);
+            }
+            // Type changes are handled while copying
+            continue;
+        }
+
+        if (is_dir) {
+            char path[PATH_MAX] = {0};
+            if (tree_sync_path(ts->dest, child, path, sizeof(path)) || rmtree(path)) {
+                status = -1;
+                break;
+            }
+        } else if (unlinkat(dirfd(dp), rec->d_name, 0) < 0) {
+            SYSERROR("%s/%s: %s", ts->dest, child, strerror(errno));
+            status = -1;
+            break;
+        }
+        if (ts->opts->verbose) {
+            msg(STASIS_MSG_L3, "deleting %s\n", child);
+        }
+        ts->counters->deleted++;
+    }
+    closedir(dp);
+    return status;
+}
+
+/**
+ * Create the destination's directories (parents first)
+ */
+static int tree_sync_mkdirs(struct TreeSync *ts) {
+    for (size_t i = 0; i < ts->num_used; i++) {
+        const struct TreeSyncEntry *entry = &ts->entry[i];
+        if (!S_ISDIR(entry->mode)) {
+            continue;
+        }
+
+        char path[PATH_MAX] = {0};
+        if (tree_sync_path(ts->dest, entry->rel, path, sizeof(path))) {
+            return -1;
+        }
+
+        struct stat st;
+        if (lstat(path, &st) == 0) {
+            if (S_ISDIR(st.st_mode)) {
+                continue;
+            }
+            if (unlink(path) < 0) {
+                SYSERROR("%s: %s", path, strerror(errno));
+                return -1;
+            }
+        }
+        // Permissions are applied by tree_sync_finalize_dirs()
+        if (mkdir(path, (entry->mode & 07777) | S_IRWXU) < 0) {
+            SYSERROR("%s: %s", path, strerror(errno));
+            return -1;
+        }
+        ts->counters->dirs++;
+    }
+    return 0;
+}
+
+/**
+ * Apply directory permissions and modification times (children first)
+ */
+static void tree_sync_finalize_dirs(struct TreeSync *ts) {
+    for (size_t i = ts->num_used; i > 0; i--) {
+        const struct TreeSyncEntry *entry = &ts->entry[i - 1];
+        if (!S_ISDIR(entry->mode)) {
+            continue;
+        }
+        char path[PATH_MAX] = {0};
+        if (tree_sync_path(ts->dest, entry->rel, path, sizeof(path))) {
+            continue;
+        }
+        const struct timespec times[2] = {{.tv_sec = 0, .tv_nsec = UTIME_OMIT}, entry->mtime};
+        if (chmod(path, entry->mode & 07777) < 0 || utimensat(AT_FDCWD, path, times, 0) < 0) {
+            SYSDEBUG("%s: %s", path, strerror(errno));
+        }
+    }
+}
+
+/**
+ * Compare the contents of two files of equal size
+ * @return true if the files are identical
+ */
+static bool tree_sync_same_content(const char *a, const char *b) {
+    char buf_a[BUFSIZ * 8];
+    char buf_b[BUFSIZ * 8];
+    bool result = false;
+
+    const int fd_a = open(a, O_RDONLY | O_CLOEXEC);
+    const int fd_b = open(b, O_RDONLY | O_CLOEXEC);
+    if (fd_a < 0 || fd_b < 0) {
+        goto done;
+    }
+    while (1) {
+        const ssize_t len = read(fd_a, buf_a, sizeof(buf_a));
+        if (len < 0) {
+            goto done;
+        }
+        ssize_t got = 0;
+        while (got < len) {
+            const ssize_t n = read(fd_b, buf_b + got, len - got);
+            if (n <= 0) {
+                goto done;
+            }
+            got += n;
+        }
+        if (memcmp(buf_a, buf_b, len) != 0) {
+            goto done;
+        }
+        if (len == 0) {
+            // The second file must end too
+            result = read(fd_b, buf_b, 1) == 0;
+            goto done;
+        }
+    }
+
+    done:
+    if (fd_a >= 0) {
+        close(fd_a);
+    }
+    if (fd_b >= 0) {
+        close(fd_b);
+    }
+    return result;
+}
+
+/**
+ * Determine whether the destination already holds a copy of an entry
+ */
+static bool tree_sync_up_to_date(const struct TreeSync *ts, const struct TreeSyncEntry *entry, const char *src, const char *dest, const struct stat *st) {
+    if ((st->st_mode & S_IFMT) != (entry->mode & S_IFMT)) {
+        return false;
+    }
+    if (S_ISREG(entry->mode)) {
+        if (st->st_size != entry->size) {
+            return false;
+        }
+        struct stat src_st;
+        if (st->st_nlink > 1 && stat(src, &src_st) == 0 && src_st.st_dev == st->st_dev && src_st.st_ino == st->st_ino) {
+            // A hard link to the source is not a copy. Changing one would change the other.
+            return false;
+        }
+        if (ts->opts->strict) {
+            return tree_sync_same_content(src, dest);
+        }
+        return st->st_mtime == entry->mtime.tv_sec;
+    }
+    if (S_ISLNK(entry->mode)) {
+        char target_src[PATH_MAX] = {0};
+        char target_dest[PATH_MAX] = {0};
+        if (readlink(src, target_src, sizeof(target_src) - 1) < 0 || readlink(dest, target_dest, sizeof(target_dest) - 1) < 0) {
+            return false;
+        }
+        return !strcmp(target_src, target_dest);
+    }
+    return st->st_rdev == entry->rdev;
+}
+
+/**
+ * Copy one file (mp_parallel_for() callback)
+ */
+static int tree_sync_copy_entry(size_t index, void *arg) {
+    struct TreeSync *ts = arg;
+    const struct TreeSyncEntry *entry = &ts->entry[ts->files[index]];
+    char src[PATH_MAX] = {0};
+    char dest[PATH_MAX] = {0};
+
+    if (tree_sync_path(ts->roots[entry->source], entry->rel, src, sizeof(src))
+        || tree_sync_path(ts->dest, entry->rel, dest, sizeof(dest))) {
+        return -1;
+    }
+
+    struct stat st;
+    if (lstat(dest, &st) == 0) {
+        if (tree_sync_up_to_date(ts, entry, src, dest, &st)) {
+            if (S_ISREG(st.st_mode) && (st.st_mode & 07777) != (entry->mode & 07777)) {
+                chmod(dest, entry->mode & 07777);
+            }
+            __atomic_fetch_add(&ts->counters->skipped, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+        if (S_ISDIR(st.st_mode) && rmtree(dest)) {
+            SYSERROR("Unable to replace directory with file: %s", dest);
+            return -1;
+        }
+    }
+
+    // Like rsync without -H, every file is an independent copy
+    const unsigned op = CT_PERM | CT_ATOMIC | CT_NO_HARDLINK | (geteuid() == 0 ? CT_OWNER : 0);
+    if (copy2(src, dest, op)) {
+        SYSERROR("Unable to copy %s to %s: %s", src, dest, strerror(errno));
+        return -1;
+    }
+    const struct timespec times[2] = {{.tv_sec = 0, .tv_nsec = UTIME_OMIT}, entry->mtime};
+    if (utimensat(AT_FDCWD, dest, times, AT_SYMLINK_NOFOLLOW) < 0) {
+        SYSDEBUG("%s: %s", dest, strerror(errno));
+    }
+
+    if (ts->opts->verbose) {
+        msg(STASIS_MSG_L3, "%s\n", entry->rel);
+    }
+    __atomic_fetch_add(&ts->counters->copied, 1, __ATOMIC_RELAXED);
+    if (S_ISREG(entry->mode)) {
+        __atomic_fetch_add(&ts->counters->bytes, (size_t) entry->size, __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+static int tree_sync_run(struct TreeSync *ts, char **names, struct TreeSyncStats *stats) {
+    struct timespec t_start, t_stop;
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+
+    int status = 0;
+    for (size_t i = 0; !status && i < ts->roots_count; i++) {
+        const int fd = open(ts->roots[i], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            SYSERROR("%s: %s", ts->roots[i], strerror(errno));
+            status = -1;
+        } else if (names) {
+            // Only this entry of the root is copied
+            status = tree_sync_scan(ts, i, fd, names[i], names[i]);
+            close(fd);
+        } else {
+            status = tree_sync_scan_dir(ts, i, fd, "");
+        }
+    }
+    if (status) {
+        return -1;
+    }
+    tree_sync_merge(ts);
+
+    if (mkdirs(ts->dest, 0755)) {
+        SYSERROR("Unable to create directory: %s", ts->dest);
+        return -1;
+    }
+
+    ts->counters = mp_shared_alloc(sizeof(*ts->counters));
+    if (!ts->counters) {
+        return -1;
+    }
+
+    if (ts->opts->delete) {
+        const int fd = open(ts->dest, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0 || tree_sync_prune(ts, fd, "")) {
+            status = -1;
+        }
+    }
+
+    if (!status) {
+        status = tree_sync_mkdirs(ts);
+    }
+
+    if (!status) {
+        ts->files = calloc(ts->num_used + 1, sizeof(*ts->files));
+        if (!ts->files) {
+            status = -1;
+        }
+    }
+    if (!status) {
+        for (size_t i = 0; i < ts->num_used; i++) {
+            if (!S_ISDIR(ts->entry[i].mode)) {
+                ts->files[ts->files_count++] = i;
+            }
+        }
+        ts->counters->files = ts->files_count;
+        if (mp_parallel_for(ts->files_count, ts->opts->jobs, tree_sync_copy_entry, ts)) {
+            status = -1;
+        }
+        tree_sync_finalize_dirs(ts);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t_stop);
+    ts->counters->duration = timespec_to_double(timespec_sub(t_stop, t_start));
+    if (stats) {
+        *stats = *ts->counters;
+    }
+    mp_shared_free(ts->counters, sizeof(*ts->counters));
+    ts->counters = NULL;
+    return status;
+}
+
+static void tree_sync_free(struct TreeSync *ts) {
+    for (size_t i = 0; i < ts->num_used; i++) {
+        guard_free(ts->entry[i].rel);
+    }
+    guard_free(ts->entry);
+    guard_free(ts->files);
+}
+
+int tree_sync(char **srcs, const char *dest, const struct TreeSyncOptions *opts, struct TreeSyncStats *stats) {
+    struct TreeSync ts = {0};
+    ts.roots = srcs;
+    ts.roots_count = tree_sync_count(srcs);
+    ts.dest = dest;
+    ts.opts = opts ? opts : &tree_sync_defaults;
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+    }
+
+    const int status = tree_sync_run(&ts, NULL, stats);
+    tree_sync_free(&ts);
+    return status;
+}
+
+int tree_sync_files(char **files, const char *dest, const struct TreeSyncOptions *opts, struct TreeSyncStats *stats) {
+    struct TreeSync ts = {0};
+    const size_t count = tree_sync_count(files);
+    char **names = calloc(count + 1, sizeof(*names));
+    ts.roots = calloc(count + 1, sizeof(*ts.roots));
+    ts.roots_count = count;
+    ts.dest = dest;
+    ts.opts = opts ? opts : &tree_sync_defaults;
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+    }
+
+    int status = 0;
+    if (!names || !ts.roots) {
+        status = -1;
+    }
+    for (size_t i = 0; !status && i < count; i++) {
+        char *path = strdup(files[i]);
+        if (!path || !*path) {
+            guard_free(path);
+            status = -1;
+            break;
+        }
+        // Trailing slashes do not change the name of the entry
+        for (size_t len = strlen(path); len > 1 && path[len - 1] == '/'; len--) {
+            path[len - 1] = '\0';
+        }
+        char *sep = strrchr(path, '/');
+        names[i] = strdup(sep ? sep + 1 : path);
+        if (sep == path) {
+            sep[1] = '\0';
+        } else if (sep) {
+            *sep = '\0';
+        } else {
+            strcpy(path, ".");
+        }
+        ts.roots[i] = path;
+        if (!names[i]) {
+            status = -1;
+        }
+    }
+
+    if (!status) {
+        status = tree_sync_run(&ts, names, stats);
+    }
+    tree_sync_free(&ts);
+    guard_array_n_free(names, count);
+    guard_array_n_free(ts.roots, count);
+    return status;
+}
+
+void tree_sync_show_summary(const struct TreeSyncStats *stats) {
+    const double duration = stats->duration > 0 ? stats->duration : 1e-9;
+    const double mib = (double) stats->bytes / (1024 * 1024);
+    msg(STASIS_MSG_L3, "%zu of %zu files copied (%.2f MiB), %zu up to date, %zu deleted in %.2fs (%.0f files/s, %.2f MiB/s)\n",
+        stats->copied, stats->files, mib, stats->skipped, stats->deleted,
+        stats->duration, (double) stats->copied / duration, mib / duration);
+}
@@ -1,6 +1,12 @@
+#include <ctype.h>
 #include <stdarg.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "core.h"
 #include "utils.h"
+#include "gitcache.h"
+#include "multiprocessing.h"
 
 char *dirstack[STASIS_DIRSTACK_MAX];
 const ssize_t dirstack_max = sizeof(dirstack) / sizeof(dirstack[0]);
@@ -32,47 +38,320 @@ int popd() {
     return result;
 }
 
-int rmtree(char *_path) {
-    int status = 0;
-    char path[PATH_MAX] = {0};
-    strncpy(path, _path, sizeof(path) - 1);
-    struct dirent *d_entity;
+/// Paths that could not be removed by rmtree_parallel() (shared with worker processes)
+struct RmtreeFailures {
+    size_t count; ///< Number of entries that could not be removed
+    size_t used; ///< Bytes of data in use
+    char data[STASIS_BUFSIZ * 8]; ///< Line-separated paths (truncated when full)
+};
+
+/// Child processes started by rmtree_background()
+static pid_t *rmtree_pending = NULL;
+static size_t rmtree_pending_used = 0;
+static size_t rmtree_pending_alloc = 0;
+static size_t rmtree_pending_failed = 0;
+
+static void rmtree_fail(struct RmtreeFailures *failures, const char *path) {
+    fprintf(stderr, "Unable to remove %s: %s\n", path, strerror(errno));
+    if (!failures) {
+        return;
+    }
+    __atomic_fetch_add(&failures->count, 1, __ATOMIC_RELAXED);
+    const size_t len = strlen(path) + 1;
+    const size_t offset = __atomic_fetch_add(&failures->used, len, __ATOMIC_RELAXED);
+    if (offset + len <= sizeof(failures->data)) {
+        memcpy(failures->data + offset, path, len - 1);
+        failures->data[offset + len - 1] = '\n';
+    }
+}
 
-    DIR *dir = opendir(path);
-    if (!dir) {
-        return 1;
+static int rmtree_unlinkat(int dir_fd, const char *name, int flags) {
+    if (unlinkat(dir_fd, name, flags) == 0) {
+        return 0;
+    }
+    if (errno != EACCES || dir_fd == AT_FDCWD) {
+        return -1;
     }
+    // Read-only directories are common in package caches
+    if (fchmod(dir_fd, S_IRWXU) < 0) {
+        errno = EACCES;
+        return -1;
+    }
+    return unlinkat(dir_fd, name, flags);
+}
 
-    while ((d_entity = readdir(dir)) != NULL) {
-        char abspath[PATH_MAX] = {0};
-        strncat(abspath, path, sizeof(abspath) - strlen(abspath) - 1);
-        strncat(abspath, DIR_SEP, sizeof(abspath) - strlen(abspath) - 1);
-        strncat(abspath, d_entity->d_name, sizeof(abspath) - strlen(abspath) - 1);
+/**
+ * Remove an entry relative to an open directory
+ * @param dir_fd an open directory, or AT_FDCWD
+ * @param name entry to remove
+ * @param path buffer holding the entry's path (used for error messages, restored on return)
+ * @param failures failure log (may be NULL)
+ * @return 0 on success, -1 if anything could not be removed
+ */
+static int rmtree_at(int dir_fd, const char *name, char *path, struct RmtreeFailures *failures) {
+    int fd = openat(dir_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0 && errno == EACCES && dir_fd != AT_FDCWD && fchmodat(dir_fd, name, S_IRWXU, 0) == 0) {
+        fd = openat(dir_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    }
+    if (fd < 0) {
+        if (errno == ENOTDIR || errno == ELOOP) {
+            // Files, and symbolic links (never followed)
+            if (rmtree_unlinkat(dir_fd, name, 0) < 0) {
+                rmtree_fail(failures, path);
+                return -1;
+            }
+            return 0;
+        }
+        rmtree_fail(failures, path);
+        return -1;
+    }
+
+    DIR *dp = fdopendir(fd);
+    if (!dp) {
+        rmtree_fail(failures, path);
+        close(fd);
+        return -1;
+    }
 
-        if (!strcmp(d_entity->d_name, ".") || !strcmp(d_entity->d_name, "..") || !strcmp(abspath, path)) {
+    int status = 0;
+    const size_t path_len = strlen(path);
+    struct dirent *rec;
+    while ((rec = readdir(dp)) != NULL) {
+        if (!strcmp(rec->d_name, ".") || !strcmp(rec->d_name, "..")) {
             continue;
         }
+        snprintf(path + path_len, PATH_MAX - path_len, "%s%s", DIR_SEP, rec->d_name);
+        if (rec->d_type == DT_DIR || rec->d_type == DT_UNKNOWN) {
+            status |= rmtree_at(dirfd(dp), rec->d_name, path, failures);
+        } else if (rmtree_unlinkat(dirfd(dp), rec->d_name, 0) < 0) {
+            rmtree_fail(failures, path);
+            status = -1;
+        }
+        path[path_len] = '\0';
+    }
+    closedir(dp);
 
-        // Test for sufficient privilege
-        if (access(abspath, F_OK) < 0 && errno == EACCES) {
+    if (rmtree_unlinkat(dir_fd, name, AT_REMOVEDIR) < 0) {
+        rmtree_fail(failures, path);
+        return -1;
+    }
+    return status;
+}
+
+/**
+ * Remove one subtree (mp_parallel_for() callback)
+ */
+static int rmtree_subtree(size_t index, void *arg) {
+    void **args = arg;
+    struct StrList *subtrees = args[0];
+    struct RmtreeFailures *failures = args[1];
+    char path[PATH_MAX] = {0};
+
+    strncpy(path, strlist_item(subtrees, index), sizeof(path) - 1);
+    return rmtree_at(AT_FDCWD, path, path, failures);
+}
+
+/**
+ * Empty a directory of everything but its subdirectories
+ * @param subdirs receives the paths of subdirectories
+ * @return 0 on success, -1 if anything could not be removed
+ */
+static int rmtree_split(const char *path, struct StrList **subdirs, struct RmtreeFailures *failures) {
+    char child[PATH_MAX] = {0};
+    const int fd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    DIR *dp = fdopendir(fd);
+    if (!dp) {
+        close(fd);
+        return -1;
+    }
+
+    int status = 0;
+    struct dirent *rec;
+    while ((rec = readdir(dp)) != NULL) {
+        if (!strcmp(rec->d_name, ".") || !strcmp(rec->d_name, "..")) {
             continue;
         }
+        snprintf(child, sizeof(child), "%s%s%s", path, DIR_SEP, rec->d_name);
+
+        struct stat st;
+        const bool is_dir = rec->d_type == DT_DIR
+            || (rec->d_type == DT_UNKNOWN && fstatat(dirfd(dp), rec->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode));
+        if (is_dir) {
+            strlist_append(subdirs, child);
+        } else if (rmtree_unlinkat(dirfd(dp), rec->d_name, 0) < 0) {
+            rmtree_fail(failures, child);
+            status = -1;
+        }
+    }
+    closedir(dp);
+    return status;
+}
 
-        // Push directories on to the stack first
-        if (d_entity->d_type == DT_DIR) {
-            rmtree(abspath);
-        } else {
-            remove(abspath);
+int rmtree_parallel(const char *path, size_t jobs, struct StrList **failed) {
+    char root[PATH_MAX] = {0};
+    struct stat st;
+
+    strncpy(root, path, sizeof(root) - 1);
+    if (lstat(root, &st) < 0) {
+        return -1;
+    }
+
+    struct RmtreeFailures *failures = mp_shared_alloc(sizeof(*failures));
+    if (!failures) {
+        return -1;
+    }
+
+    int status = 0;
+    if (jobs < 2 || !S_ISDIR(st.st_mode)) {
+        status = rmtree_at(AT_FDCWD, root, root, failures);
+    } else {
+        // Split the top of the tree until there is enough work to go around.
+        // Directories emptied along the way are removed last, deepest first.
+        struct StrList *emptied = strlist_init();
+        struct StrList *level = strlist_init();
+        strlist_append(&level, root);
+        for (size_t depth = 0; depth < 4 && strlist_count(level) && strlist_count(level) < jobs * 4; depth++) {
+            struct StrList *next = strlist_init();
+            for (size_t i = 0; i < strlist_count(level); i++) {
+                char *dir = strlist_item(level, i);
+                if (rmtree_split(dir, &next, failures)) {
+                    status = -1;
+                }
+                strlist_append(&emptied, dir);
+            }
+            guard_strlist_free(&level);
+            level = next;
         }
+
+        void *args[] = {level, failures};
+        if (mp_parallel_for(strlist_count(level), jobs, rmtree_subtree, args)) {
+            status = -1;
+        }
+        for (size_t i = strlist_count(emptied); i > 0; i--) {
+            char *dir = strlist_item(emptied, i - 1);
+            if (rmdir(dir) < 0) {
+                rmtree_fail(failures, dir);
+                status = -1;
+            }
+        }
+        guard_strlist_free(&level);
+        guard_strlist_free(&emptied);
     }
-    closedir(dir);
 
-    if (access(path, F_OK) == 0) {
-        remove(path);
+    if (failures->count) {
+        status = -1;
+    }
+    if (failed) {
+        *failed = strlist_init();
+        const char *data = failures->data;
+        const char *end = data + (failures->used < sizeof(failures->data) ? failures->used : sizeof(failures->data));
+        while (*failed && data < end) {
+            const char *eol = memchr(data, '\n', end - data);
+            if (!eol) {
+                break;
+            }
+            char *line = strndup(data, eol - data);
+            if (line) {
+                strlist_append(failed, line);
+            }
+            guard_free(line);
+            data = eol + 1;
+        }
     }
+    mp_shared_free(failures, sizeof(*failures));
     return status;
 }
 
+int rmtree(char *_path) {
+    return rmtree_parallel(_path, 1, NULL);
+}
+
+/**
+ * Collect the exit status of background removals
+ * @param options passed to waitpid() (`0` waits for all removals to finish)
+ */
+static void rmtree_reap(int options) {
+    size_t kept = 0;
+    for (size_t i = 0; i < rmtree_pending_used; i++) {
+        int status = 0;
+        pid_t pid;
+        while ((pid = waitpid(rmtree_pending[i], &status, options)) < 0 && errno == EINTR) {}
+        if (pid == 0) {
+            rmtree_pending[kept++] = rmtree_pending[i];
+        } else if (pid > 0 && (!WIFEXITED(status) || WEXITSTATUS(status))) {
+            rmtree_pending_failed++;
+        }
+    }
+    rmtree_pending_used = kept;
+}
+
+int rmtree_background(const char *path, size_t jobs) {
+    static size_t serial = 0;
+    char trash[PATH_MAX] = {0};
+    char dir[PATH_MAX] = {0};
+
+    // Finished removals do not linger as zombies
+    rmtree_reap(WNOHANG);
+
+    strncpy(dir, path, sizeof(dir) - 1);
+    for (size_t len = strlen(dir); len > 1 && dir[len - 1] == '/'; len--) {
+        dir[len - 1] = '\0';
+    }
+    char *base = strrchr(dir, '/');
+    if (base) {
+        *base++ = '\0';
+    } else {
+        base = dir;
+    }
+
+    // The hidden name keeps the tree out of globs like "build_sources_dir/*"
+    int status = -1;
+    if (*base && strcmp(base, ".") && strcmp(base, "..")
+        && snprintf(trash, sizeof(trash), "%s/.%s.stasis-rm-%d-%zu", base == dir ? "." : dir, base, (int) getpid(), serial++) < (int) sizeof(trash)) {
+        status = rename(path, trash);
+    }
+    if (status < 0) {
+        SYSDEBUG("Unable to rename %s for background removal: %s", path, strerror(errno));
+        return rmtree_parallel(path, jobs, NULL);
+    }
+
+    if (rmtree_pending_used == rmtree_pending_alloc) {
+        const size_t alloc = rmtree_pending_alloc ? rmtree_pending_alloc * 2 : 8;
+        pid_t *tmp = realloc(rmtree_pending, alloc * sizeof(*rmtree_pending));
+        if (!tmp) {
+            return rmtree_parallel(trash, jobs, NULL);
+        }
+        rmtree_pending = tmp;
+        rmtree_pending_alloc = alloc;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    const pid_t pid = fork();
+    if (pid < 0) {
+        return rmtree_parallel(trash, jobs, NULL);
+    }
+    if (pid == 0) {
+        const int result = rmtree_parallel(trash, jobs, NULL);
+        fflush(stderr);
+        _exit(result ? 1 : 0);
+    }
+    rmtree_pending[rmtree_pending_used++] = pid;
+    return 0;
+}
+
+int rmtree_wait() {
+    rmtree_reap(0);
+    const int result = (int) rmtree_pending_failed;
+    guard_free(rmtree_pending);
+    rmtree_pending_alloc = 0;
+    rmtree_pending_failed = 0;
+    return result;
+}
+
 char *expandpath(const char *_path) {
     if (_path == NULL) {
         return NULL;
@@ -162,101 +441,160 @@ char *path_dirname(char *path) {
     return path;
 }
 
-char **file_readlines(const char *filename, size_t start, size_t limit, ReaderFn *readerFn) {
-    FILE *fp = NULL;
-    char **result = NULL;
-    size_t lines = 0;
-    int use_stdin = 0;
-
-    if (strcmp(filename, "-") == 0) {
-        use_stdin = 1;
+/**
+ * Call `fn` for each line of a stream
+ */
+static int file_foreach_line_stream(FILE *fp, LineFn *fn, void *arg) {
+    char *buffer = NULL;
+    size_t buffer_size = 0;
+    ssize_t len;
+    size_t line = 0;
+
+    while ((len = getline(&buffer, &buffer_size, fp)) >= 0) {
+        if (fn(line++, buffer, (size_t) len, arg) < 0) {
+            break;
+        }
     }
+    const int status = ferror(fp) ? -1 : 0;
+    guard_free(buffer);
+    return status;
+}
 
-    if (use_stdin) {
-        fp = stdin;
-    } else {
-        fp = fopen(filename, "r");
-    }
+int file_foreach_line(const char *filename, LineFn *fn, void *arg) {
+    struct stat st;
 
-    if (fp == NULL) {
-        perror(filename);
-        SYSERROR("failed to open %s for reading", filename);
-        return NULL;
+    if (!filename || !fn) {
+        errno = EINVAL;
+        return -1;
     }
-
-    // Allocate buffer
-    char *buffer = calloc(STASIS_BUFSIZ, sizeof(char));
-    if (buffer == NULL) {
-        SYSERROR("unable to allocate %d bytes for buffer", STASIS_BUFSIZ);
-        if (!use_stdin) {
-            fclose(fp);
-        }
-        return NULL;
+    if (strcmp(filename, "-") == 0) {
+        return file_foreach_line_stream(stdin, fn, arg);
     }
 
-    // count number the of lines in the file
-    while ((fgets(buffer, STASIS_BUFSIZ - 1, fp)) != NULL) {
-        lines++;
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
     }
-
-    if (!lines) {
-        guard_free(buffer);
-        if (!use_stdin) {
-            fclose(fp);
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        if (st.st_size == 0) {
+            close(fd);
+            return 0;
+        }
+        const size_t size = (size_t) st.st_size;
+        char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            close(fd);
+            madvise(data, size, MADV_SEQUENTIAL);
+
+            const char *pos = data;
+            const char *end = data + size;
+            size_t line = 0;
+            while (pos < end) {
+                const char *eol = memchr(pos, '\n', (size_t) (end - pos));
+                const char *next = eol ? eol + 1 : end;
+                if (fn(line++, pos, (size_t) (next - pos), arg) < 0) {
+                    break;
+                }
+                pos = next;
+            }
+            munmap(data, size);
+            return 0;
         }
-        return NULL;
     }
 
-    rewind(fp);
-
-    // Handle invalid start offset
-    if (start > lines) {
-        start = 0;
+    // Pipes, devices, and files that cannot be mapped
+    FILE *fp = fdopen(fd, "r");
+    if (!fp) {
+        close(fd);
+        return -1;
     }
+    const int status = file_foreach_line_stream(fp, fn, arg);
+    fclose(fp);
+    return status;
+}
 
-    // Adjust line count when start offset is non-zero
-    if (start != 0 && start < lines) {
-        lines -= start;
+struct FileReadlines {
+    size_t start;
+    size_t limit;
+    ReaderFn *readerFn;
+    size_t seen;
+    int error;
+    size_t num_used;
+    size_t num_alloc;
+    char **data;
+};
+
+static int file_readlines_line(size_t line, const char *data, size_t len, void *arg) {
+    struct FileReadlines *state = arg;
+
+    state->seen++;
+    if (line < state->start) {
+        return 0;
     }
-
-
-    // Handle minimum and maximum limits
-    if (limit == 0 || limit > lines) {
-        limit = lines;
+    if (state->limit && state->num_used >= state->limit) {
+        return -1;
     }
-
-    // Populate results array
-    result = calloc(limit + 1, sizeof(char *));
-    for (size_t i = start; i < limit; i++) {
-        if (i < start) {
-            continue;
-        }
-
-        if (fgets(buffer, STASIS_BUFSIZ - 1, fp) == NULL) {
-            break;
+    if (state->num_used + 2 > state->num_alloc) {
+        const size_t num_alloc = state->num_alloc ? state->num_alloc * 2 : 64;
+        char **tmp = realloc(state->data, num_alloc * sizeof(*tmp));
+        if (!tmp) {
+            SYSERROR("unable to allocate %zu records", num_alloc);
+            state->error = 1;
+            return -1;
         }
+        state->data = tmp;
+        state->num_alloc = num_alloc;
+    }
 
-        if (readerFn != NULL) {
-            int status = readerFn(i - start, &buffer);
-            // A status greater than zero indicates we should ignore this line entirely and "continue"
-            // A status less than zero indicates we should "break"
-            // A zero status proceeds normally
-            if (status > 0) {
-                i--;
-                continue;
-            } else if (status < 0) {
-                break;
-            }
+    char *buffer = strndup(data, len);
+    if (!buffer) {
+        SYSERROR("unable to allocate %zu bytes for line", len + 1);
+        state->error = 1;
+        return -1;
+    }
+    if (state->readerFn != NULL) {
+        int status = state->readerFn(state->num_used, &buffer);
+        // A status greater than zero indicates we should ignore this line entirely and "continue"
+        // A status less than zero indicates we should "break"
+        // A zero status proceeds normally
+        if (status > 0) {
+            guard_free(buffer);
+            return 0;
+        } else if (status < 0) {
+            guard_free(buffer);
+            return -1;
         }
-        result[i] = strdup(buffer);
-        memset(buffer, '\0', STASIS_BUFSIZ);
     }
+    state->data[state->num_used++] = buffer;
+    state->data[state->num_used] = NULL;
+    return 0;
+}
 
-    guard_free(buffer);
-    if (!use_stdin) {
-        fclose(fp);
+char **file_readlines(const char *filename, size_t start, size_t limit, ReaderFn *readerFn) {
+    struct FileReadlines state = {
+        .start = start,
+        .limit = limit,
+        .readerFn = readerFn,
+    };
+
+    if (file_foreach_line(filename, file_readlines_line, &state) < 0) {
+        perror(filename);
+        SYSERROR("failed to read %s", filename);
+        guard_array_n_free(state.data, state.num_used);
+        return NULL;
     }
-    return result;
+    if (state.error) {
+        guard_array_n_free(state.data, state.num_used);
+        return NULL;
+    }
+    if (!state.seen) {
+        return NULL;
+    }
+    if (!state.data) {
+        // Every line was filtered
+        state.data = calloc(1, sizeof(*state.data));
+    }
+    return state.data;
 }
 
 char *find_program(const char *name) {
@@ -316,18 +654,21 @@ int git_clone(struct Process *proc, char *url, char *destdir, char *gitref) {
     }
 
     static char command[PATH_MAX] = {0};
-    snprintf(command, sizeof(command), "%s clone -c advice.detachedHead=false --recursive %s", program, url);
 
     if (destdir && access(destdir, F_OK) < 0) {
         // Destination directory does not exist
-        const char *command_fmt = " %s";
-        const int command_fmt_len = snprintf(NULL, 0, command_fmt, destdir);
-        snprintf(command + strlen(command), sizeof(command) - command_fmt_len, command_fmt, destdir);
-        // Clone the repo
-        result = shell(proc, command);
+        // Clone the repo (through the git cache if enabled)
+        char *script = git_clone_script(program, url, destdir, gitref);
+        if (!script) {
+            result = -1;
+            goto die_quick;
+        }
+        result = shell(proc, script);
+        guard_free(script);
         if (result) {
             goto die_quick;
         }
+        git_cache_record(destdir);
     }
 
     if (destdir) {
@@ -767,21 +1108,21 @@ char *collapse_whitespace(char **s) {
 int redact_sensitive(const char **to_redact, size_t to_redact_size, char *src, char *dest, size_t maxlen) {
     const char *redacted = "***REDACTED***";
 
-    char *tmp = calloc(strlen(redacted) + strlen(src) + 1, sizeof(*tmp));
-    if (!tmp) {
-        return -1;
-    }
-    strncpy(tmp, src, strlen(redacted) + strlen(src));
+    char *tmp = NULL;
 
     for (size_t i = 0; i < to_redact_size; i++) {
-        if (to_redact[i] && strstr(tmp, to_redact[i])) {
-            replace_text(tmp, to_redact[i], redacted, 0);
+        if (to_redact[i] && strstr(src, to_redact[i])) {
+            // The token may occur more than once, so let the result grow as needed
+            const struct ReplaceRule rule = {.target = to_redact[i], .replacement = redacted};
+            if (replace_text_batch(src, strlen(src), &rule, 1, &tmp, NULL) < 0) {
+                return -1;
+            }
             break;
         }
     }
 
     memset(dest, 0, maxlen);
-    strncpy(dest, tmp, maxlen - 1);
+    strncpy(dest, tmp ? tmp : src, maxlen - 1);
     guard_free(tmp);
 
     return 0;
@@ -905,7 +1246,7 @@ int gen_file_extension_str(char *filename, const size_t maxlen, const char *exte
         return 0;
     }
 
-    return replace_text(ext_orig, ext_orig, extension, 0);
+    return replace_text_n(ext_orig, maxlen - (size_t) (ext_orig - filename), ext_orig, extension, 0);
 }
 
 #define DEBUG_HEXDUMP_FMT_BYTES 6
@@ -1017,52 +1358,62 @@ int is_git_sha(char const *hash) {
     return 1;
 }
 
-static int read_vcs_records(const size_t line, char **data) {
+/**
+ * Collect lines containing a VCS requirement (e.g. "git+https://...")
+ */
+static int read_vcs_records(size_t line, const char *data, size_t len, void *arg) {
     (void) line;  // unused
+    struct StrList **records = arg;
     const char *vcs_name[] = {
         "git",
         "svn",
         "hg",
         "bzr",
     };
-    for (size_t i = 0; i < sizeof(vcs_name) / sizeof(vcs_name[0]); i++) {
-        const char *vcs = vcs_name[i];
-        char *data_local = strdup(*data);
-        if (!data_local) {
-            fprintf(stderr, "Out of memory\n");
-            return -1;
-        }
 
-        // Remove leading/trailing blanks
-        lstrip(data_local);
-        strip(data_local);
+    // Remove leading/trailing blanks
+    while (len && isspace((unsigned char) *data)) {
+        data++;
+        len--;
+    }
+    while (len && isspace((unsigned char) data[len - 1])) {
+        len--;
+    }
 
-        // Ignore file comment(s)
-        if (startswith(data_local, "#") || startswith(data_local, ";")) {
-            // continue
-            guard_free(data_local);
-            return 1;
-        }
+    // Ignore file comment(s)
+    if (!len || *data == '#' || *data == ';') {
+        return 0;
+    }
+
+    for (size_t i = 0; i < sizeof(vcs_name) / sizeof(vcs_name[0]); i++) {
+        const char *vcs = vcs_name[i];
+        const char *end = data + len;
 
         // Begin matching VCS package syntax
-        const char *match_vcs = strstr(data_local,vcs);
-        if (match_vcs) {
-            const char *match_protocol_sep = strstr(match_vcs, "+");
-            if (match_protocol_sep) {
-                const char *match_protocol = strstr(match_protocol_sep, "://");
-                if (match_protocol) {
-                    guard_free(data_local);
-                    // match found
-                    return 0;
-                }
+        const char *match_vcs = memmem(data, len, vcs, strlen(vcs));
+        if (!match_vcs) {
+            continue;
+        }
+        const char *match_protocol_sep = memchr(match_vcs, '+', (size_t) (end - match_vcs));
+        if (!match_protocol_sep) {
+            continue;
+        }
+        if (memmem(match_protocol_sep, (size_t) (end - match_protocol_sep), "://", 3)) {
+            // match found
+            char *record = strndup(data, len);
+            if (!record) {
+                fprintf(stderr, "Out of memory\n");
+                return -1;
             }
+            strlist_append_owned(records, record);
+            return 0;
         }
-        guard_free(data_local);
     }
 
     // no match, continue
-    return 1;
+    return 0;
 }
+
 int check_python_package_dependencies(const char *srcdir) {
     const char *configs[] = {
         "pyproject.toml",
@@ -1079,10 +1430,8 @@ int check_python_package_dependencies(const char *srcdir) {
             continue;
         }
 
-        //char **data = file_readlines(path, 0, 0, NULL);
         struct StrList *data = strlist_init();
-        int err = 0;
-        if ((err = strlist_append_file(data, path, read_vcs_records))) {
+        if (!data || file_foreach_line(path, read_vcs_records, &data)) {
             guard_strlist_free(&data);
             return -1;
         }
@@ -1090,10 +1439,7 @@ int check_python_package_dependencies(const char *srcdir) {
         if (count) {
             printf("\nERROR: VCS requirement(s) detected in %s:\n", configfile);
             for (size_t j = 0; j < count; j++) {
-                char *record = strlist_item(data, j);
-                lstrip(record);
-                strip(record);
-                printf("[%zu] %s\n", j, record);
+                printf("[%zu] %s\n", j, strlist_item(data, j));
             }
             guard_strlist_free(&data);
             return 1;
@@ -2,6 +2,7 @@
 
 #include <ctype.h>
 
+#include "sha256.h"
 #include "str.h"
 #include "strlist.h"
 
@@ -617,59 +618,161 @@ static ssize_t wheel_parse_metadata(struct WheelMetadata * const pkg, const char
     return 0;
 }
 
+/**
+ * Read a file from an open archive
+ * @param zip open archive
+ * @param index archive index of file
+ * @param contents pointer to store file contents
+ * @return 0 on success, -1 on error
+ */
+static int wheel_read_index(zip_t *zip, const zip_uint64_t index, char **contents) {
+    struct zip_stat info;
+    zip_stat_init(&info);
+    if (zip_stat_index(zip, index, 0, &info) < 0) {
+        return -1;
+    }
+
+    zip_file_t *handle = zip_fopen_index(zip, index, 0);
+    if (!handle) {
+        return -1;
+    }
+
+    *contents = calloc(info.size + 1, sizeof(**contents));
+    if (!*contents) {
+        zip_fclose(handle);
+        return -1;
+    }
+
+    for (zip_uint64_t total = 0; total < info.size;) {
+        const zip_int64_t nread = zip_fread(handle, *contents + total, info.size - total);
+        if (nread <= 0) {
+            zip_fclose(handle);
+            guard_free(*contents);
+            return -1;
+        }
+        total += nread;
+    }
+    zip_fclose(handle);
+    return 0;
+}
+
 int wheel_get_file_contents(const char *wheelfile, const char *filename, char **contents) {
     int status = 0;
     int err = 0;
-    struct zip_stat archive_info;
-    zip_t *archive = zip_open(wheelfile, 0, &err);
+    zip_t *archive = zip_open(wheelfile, ZIP_RDONLY, &err);
     if (!archive) {
-        return status;
+        return -1;
     }
 
-    zip_stat_init(&archive_info);
-    for (size_t i = 0; zip_stat_index(archive, i, 0, &archive_info) >= 0; i++) {
-        char internal_path[1024] = {0};
-        snprintf(internal_path, sizeof(internal_path), "%s", filename);
-        const int match = fnmatch(internal_path, archive_info.name, 0);
+    const zip_int64_t count = zip_get_num_entries(archive, 0);
+    for (zip_int64_t i = 0; i < count; i++) {
+        const char *name = zip_get_name(archive, i, 0);
+        if (!name) {
+            continue;
+        }
+        const int match = fnmatch(filename, name, 0);
         if (match == FNM_NOMATCH) {
             continue;
         }
-        if (match < 0) {
-            goto GWM_FAIL;
+        if (match < 0 || wheel_read_index(archive, i, contents)) {
+            status = -1;
         }
+        break;
+    }
 
-        zip_file_t *handle = zip_fopen_index(archive, i, 0);
-        if (!handle) {
-            goto GWM_FAIL;
-        }
+    zip_close(archive);
+    return status;
+}
 
-        *contents = calloc(archive_info.size + 1, sizeof(**contents));
-        if (!*contents) {
-            zip_fclose(handle);
-            goto GWM_FAIL;
+// File names indexed by WHEEL_ARCHIVE_*
+static const char *WHEEL_ARCHIVE_NAME[] = {
+    "WHEEL",
+    "METADATA",
+    "top_level.txt",
+    "RECORD",
+    "entry_points.txt",
+    "zip-safe",
+    NULL,
+};
+
+/**
+ * Identify a `*.dist-info/` file by its path in the archive
+ *
+ * Only the `.dist-info` directory at the root of the archive is considered.
+ * Vendored packages may carry their own.
+ *
+ * @param name path inside of wheel file archive
+ * @return a WHEEL_ARCHIVE_ member, or -1 if not a `*.dist-info/` file of interest
+ */
+static int wheel_archive_member(const char *name) {
+    const char *suffix = ".dist-info";
+    const size_t suffix_len = strlen(suffix);
+    const char *base = strchr(name, '/');
+
+    if (!base || strchr(base + 1, '/') || (size_t) (base - name) < suffix_len || strncmp(base - suffix_len, suffix, suffix_len) != 0) {
+        return -1;
+    }
+    for (int i = 0; WHEEL_ARCHIVE_NAME[i] != NULL; i++) {
+        if (!strcmp(base + 1, WHEEL_ARCHIVE_NAME[i])) {
+            return i;
         }
+    }
+    return -1;
+}
 
-        if (zip_fread(handle, *contents, archive_info.size) < 0) {
-            zip_fclose(handle);
-            guard_free(*contents);
-            goto GWM_FAIL;
+struct WheelArchive *wheel_archive_open(const char *filename) {
+    int err = 0;
+    struct WheelArchive *archive = calloc(1, sizeof(*archive));
+    if (!archive) {
+        return NULL;
+    }
+    for (size_t i = 0; i < WHEEL_ARCHIVE_END_ENUM; i++) {
+        archive->member[i] = -1;
+    }
+
+    archive->zip = zip_open(filename, ZIP_RDONLY, &err);
+    if (!archive->zip) {
+        guard_free(archive);
+        return NULL;
+    }
+
+    // One pass over the central directory. The first match wins.
+    const zip_int64_t count = zip_get_num_entries(archive->zip, 0);
+    for (zip_int64_t i = 0; i < count; i++) {
+        const char *name = zip_get_name(archive->zip, i, 0);
+        if (!name) {
+            continue;
+        }
+        const int member = wheel_archive_member(name);
+        if (member >= 0 && archive->member[member] < 0) {
+            archive->member[member] = i;
         }
-        zip_fclose(handle);
-        break;
     }
+    return archive;
+}
 
-    goto GWM_END;
-    GWM_FAIL:
-    status = -1;
+int wheel_archive_read(struct WheelArchive *archive, const int member, char **contents) {
+    *contents = NULL;
+    if (!archive || member < 0 || member >= WHEEL_ARCHIVE_END_ENUM) {
+        return -1;
+    }
+    if (archive->member[member] < 0) {
+        return 1;
+    }
+    return wheel_read_index(archive->zip, archive->member[member], contents);
+}
 
-    GWM_END:
-    zip_close(archive);
-    return status;
+void wheel_archive_close(struct WheelArchive **archive) {
+    if (!archive || !*archive) {
+        return;
+    }
+    zip_close((*archive)->zip);
+    guard_free(*archive);
 }
 
-static int wheel_metadata_get(const struct Wheel *pkg, const char *wheel_filename) {
+static int wheel_metadata_get(const struct Wheel *pkg, struct WheelArchive *archive) {
     char *data = NULL;
-    if (wheel_get_file_contents(wheel_filename, "*.dist-info/METADATA", &data)) {
+    if (wheel_archive_read(archive, WHEEL_ARCHIVE_METADATA, &data)) {
         return -1;
     }
     const ssize_t result = wheel_parse_metadata(pkg->metadata, data);
@@ -960,7 +1063,7 @@ void wheel_metadata_free(struct WheelMetadata *meta) {
     guard_strlist_free(&meta->keywords);
     guard_strlist_free(&meta->license_file);
 
-    for (size_t i = 0; meta->provides_extra[i] != NULL; i++) {
+    for (size_t i = 0; meta->provides_extra && meta->provides_extra[i] != NULL; i++) {
         guard_free(meta->provides_extra[i]->target);
         guard_strlist_free(&meta->provides_extra[i]->requires_dist);
         guard_free(meta->provides_extra[i]);
@@ -990,10 +1093,9 @@ void wheel_package_free(struct Wheel **pkg) {
     guard_free((*pkg));
 }
 
-int wheel_get_top_level(struct Wheel *pkg, const char *filename) {
+static int wheel_get_top_level(struct Wheel *pkg, struct WheelArchive *archive) {
     char *data = NULL;
-    if (wheel_get_file_contents(filename, "*.dist-info/top_level.txt", &data)) {
-        guard_free(data);
+    if (wheel_archive_read(archive, WHEEL_ARCHIVE_TOP_LEVEL, &data) < 0) {
         return -1;
     }
     if (!pkg->top_level) {
@@ -1004,26 +1106,18 @@ int wheel_get_top_level(struct Wheel *pkg, const char *filename) {
     return 0;
 }
 
-int wheel_get_zip_safe(struct Wheel *pkg, const char *filename) {
-    char *data = NULL;
-    const int exists = wheel_get_file_contents(filename, "*.dist-info/zip-safe", &data) == 0;
-    guard_free(data);
-
-    pkg->zip_safe = 0;
-    if (exists) {
-        pkg->zip_safe = 1;
-    }
-
+static int wheel_get_zip_safe(struct Wheel *pkg, const struct WheelArchive *archive) {
+    // Only the presence of the marker matters
+    pkg->zip_safe = archive->member[WHEEL_ARCHIVE_ZIP_SAFE] >= 0;
     return 0;
 }
 
-int wheel_get_records(struct Wheel *pkg, const char *filename) {
+static int wheel_get_records(struct Wheel *pkg, struct WheelArchive *archive) {
     char *data = NULL;
-    const int exists = wheel_get_file_contents(filename, "*.dist-info/RECORD", &data) == 0;
+    const int status = wheel_archive_read(archive, WHEEL_ARCHIVE_RECORD, &data);
 
-    if (!exists) {
-        guard_free(data);
-        return 1;
+    if (status) {
+        return status;
     }
 
     const size_t records_initial_count = 2;
@@ -1068,6 +1162,7 @@ int wheel_get_records(struct Wheel *pkg, const char *filename) {
             return -1;
         }
         pkg->record = tmp;
+        pkg->record[records_count] = NULL;
         pkg->record[records_count + 1] = NULL;
     }
 
@@ -1076,9 +1171,131 @@ int wheel_get_records(struct Wheel *pkg, const char *filename) {
     return 0;
 }
 
-int wheel_get(struct Wheel **pkg, const char *filename) {
+static int wheel_record_cmp(const void *a, const void *b) {
+    const struct WheelRecord *left = *(struct WheelRecord * const *) a;
+    const struct WheelRecord *right = *(struct WheelRecord * const *) b;
+    return strcmp(left->filename ? left->filename : "", right->filename ? right->filename : "");
+}
+
+static int wheel_digest_index(zip_t *zip, const zip_uint64_t index, char *digest, size_t *size) {
+    unsigned char buf[65536];
+    unsigned char result[SHA256_DIGEST_SIZE];
+    struct SHA256 ctx;
+    zip_int64_t nread;
+
+    zip_file_t *handle = zip_fopen_index(zip, index, 0);
+    if (!handle) {
+        return -1;
+    }
+    sha256_init(&ctx);
+    *size = 0;
+    while ((nread = zip_fread(handle, buf, sizeof(buf))) > 0) {
+        sha256_update(&ctx, buf, nread);
+        *size += nread;
+    }
+    zip_fclose(handle);
+    if (nread < 0) {
+        return -1;
+    }
+    sha256_final(&ctx, result);
+    sha256_base64(result, digest);
+    return 0;
+}
+
+ssize_t wheel_verify_records(const char *filename) {
+    struct Wheel pkg = {0};
+    char *seen = NULL;
+    ssize_t failed = 0;
+
+    struct WheelArchive *archive = wheel_archive_open(filename);
+    if (!archive) {
+        fprintf(stderr, "%s: unable to open wheel\n", filename);
+        return -1;
+    }
+    if (wheel_get_records(&pkg, archive)) {
+        fprintf(stderr, "%s: unable to read RECORD\n", filename);
+        failed = -1;
+        goto WVR_END;
+    }
+    seen = calloc(pkg.num_record + 1, sizeof(*seen));
+    if (!seen) {
+        failed = -1;
+        goto WVR_END;
+    }
+    qsort(pkg.record, pkg.num_record, sizeof(*pkg.record), wheel_record_cmp);
+
+    const char *record_name = zip_get_name(archive->zip, archive->member[WHEEL_ARCHIVE_RECORD], 0);
+    const size_t record_name_len = strlen(record_name);
+    const zip_int64_t count = zip_get_num_entries(archive->zip, 0);
+    for (zip_int64_t i = 0; i < count; i++) {
+        const char *name = zip_get_name(archive->zip, i, 0);
+        if (!name) {
+            failed = -1;
+            goto WVR_END;
+        }
+        if (endswith(name, "/")) {
+            // directory
+            continue;
+        }
+        const int is_record = !strncmp(name, record_name, record_name_len)
+            && (!name[record_name_len] || !strcmp(&name[record_name_len], ".jws") || !strcmp(&name[record_name_len], ".p7s"));
+
+        const struct WheelRecord key = {.filename = (char *) name};
+        const struct WheelRecord *keyp = &key;
+        struct WheelRecord **found = bsearch(&keyp, pkg.record, pkg.num_record, sizeof(*pkg.record), wheel_record_cmp);
+        if (!found) {
+            // RECORD cannot list itself with a digest, and signatures of RECORD are not listed
+            if (!is_record) {
+                fprintf(stderr, "%s: %s: not listed in RECORD\n", filename, name);
+                failed++;
+            }
+            continue;
+        }
+        seen[found - pkg.record] = 1;
+        const struct WheelRecord *record = *found;
+        if (is_record) {
+            continue;
+        }
+        if (!record->checksum || !startswith(record->checksum, "sha256=")) {
+            fprintf(stderr, "%s: %s: unsupported digest in RECORD: '%s'\n", filename, name, record->checksum ? record->checksum : "");
+            failed++;
+            continue;
+        }
+
+        char digest[SHA256_BASE64_SIZE];
+        size_t size = 0;
+        if (wheel_digest_index(archive->zip, i, digest, &size)) {
+            fprintf(stderr, "%s: %s: unable to read\n", filename, name);
+            failed++;
+        } else if (strcmp(record->checksum + strlen("sha256="), digest) != 0) {
+            fprintf(stderr, "%s: %s: digest mismatch\n", filename, name);
+            failed++;
+        } else if (record->size && record->size != size) {
+            fprintf(stderr, "%s: %s: size mismatch\n", filename, name);
+            failed++;
+        }
+    }
+
+    for (size_t i = 0; i < pkg.num_record; i++) {
+        if (!seen[i]) {
+            fprintf(stderr, "%s: %s: listed in RECORD but not present\n", filename, pkg.record[i]->filename ? pkg.record[i]->filename : "");
+            failed++;
+        }
+    }
+
+    WVR_END:
+    for (size_t i = 0; pkg.record && pkg.record[i] != NULL; i++) {
+        wheel_record_free(&pkg.record[i]);
+    }
+    guard_free(pkg.record);
+    guard_free(seen);
+    wheel_archive_close(&archive);
+    return failed;
+}
+
+static int wheel_get(struct Wheel **pkg, struct WheelArchive *archive) {
     char *data = NULL;
-    if (wheel_get_file_contents(filename, "*.dist-info/WHEEL", &data) < 0) {
+    if (wheel_archive_read(archive, WHEEL_ARCHIVE_WHEEL, &data)) {
         return -1;
     }
     const ssize_t result = wheel_parse_wheel(*pkg, data);
@@ -1086,9 +1303,9 @@ int wheel_get(struct Wheel **pkg, const char *filename) {
     return (int) result;
 }
 
-int wheel_get_entry_point(struct Wheel *pkg, const char *filename) {
+static int wheel_get_entry_point(struct Wheel *pkg, struct WheelArchive *archive) {
     char *data = NULL;
-    if (wheel_get_file_contents(filename, "*.dist-info/entry_points.txt", &data) < 0) {
+    if (wheel_archive_read(archive, WHEEL_ARCHIVE_ENTRY_POINTS, &data) < 0) {
         return -1;
     }
 
@@ -1331,26 +1548,29 @@ int wheel_package(struct Wheel **pkg, const char *filename) {
             return WHEEL_PACKAGE_E_ALLOC;
         }
     }
-    if (wheel_get(pkg, filename) < 0) {
+    struct WheelArchive *archive = wheel_archive_open(filename);
+    if (!archive) {
         return WHEEL_PACKAGE_E_GET;
     }
-    if (wheel_metadata_get(*pkg, filename) < 0) {
-        return WHEEL_PACKAGE_E_GET_METADATA;
-    }
-    if (wheel_get_top_level(*pkg, filename) < 0) {
-        return WHEEL_PACKAGE_E_GET_TOP_LEVEL;
-    }
-    if (wheel_get_records(*pkg, filename) < 0) {
-        return WHEEL_PACKAGE_E_GET_RECORDS;
-    }
-    if (wheel_get_entry_point(*pkg, filename) < 0) {
-        return WHEEL_PACKAGE_E_GET_ENTRY_POINT;
-    }
 
-    // Optional marker
-    wheel_get_zip_safe(*pkg, filename);
+    int status = WHEEL_PACKAGE_E_SUCCESS;
+    if (wheel_get(pkg, archive) < 0) {
+        status = WHEEL_PACKAGE_E_GET;
+    } else if (wheel_metadata_get(*pkg, archive) < 0) {
+        status = WHEEL_PACKAGE_E_GET_METADATA;
+    } else if (wheel_get_top_level(*pkg, archive) < 0) {
+        status = WHEEL_PACKAGE_E_GET_TOP_LEVEL;
+    } else if (wheel_get_records(*pkg, archive) < 0) {
+        status = WHEEL_PACKAGE_E_GET_RECORDS;
+    } else if (wheel_get_entry_point(*pkg, archive) < 0) {
+        status = WHEEL_PACKAGE_E_GET_ENTRY_POINT;
+    } else {
+        // Optional marker
+        wheel_get_zip_safe(*pkg, archive);
+    }
 
-    return WHEEL_PACKAGE_E_SUCCESS;
+    wheel_archive_close(&archive);
+    return status;
 }
 
 
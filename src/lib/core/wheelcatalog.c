@@ -0,0 +1,533 @@
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "wheelcatalog.h"
+#include "multiprocessing.h"
+#include "pkgname.h"
+#include "pkgversion.h"
+#include "sha256.h"
+#include "utils.h"
+#include "wheel.h"
+
+struct WheelCatalogWork {
+    const char *root; ///< Directory containing wheel files
+    int fd; ///< Catalog being written (O_APPEND)
+    const struct WheelCatalogEntry *entry; ///< Wheels found below root
+    const size_t *pending; ///< Indexes of entries to read
+};
+
+struct WheelCatalogLoad {
+    struct WheelCatalog *catalog;
+    int current; ///< An entry is being read
+};
+
+static void wheel_catalog_entry_free(struct WheelCatalogEntry *entry) {
+    guard_free(entry->path);
+    guard_free(entry->sha256);
+    guard_free(entry->metadata_sha256);
+    guard_free(entry->name);
+    guard_free(entry->version);
+    guard_free(entry->requires_python);
+    guard_strlist_free(&entry->tag);
+    guard_strlist_free(&entry->requires_dist);
+}
+
+static int wheel_catalog_append(struct WheelCatalog *catalog, const struct WheelCatalogEntry *entry) {
+    if (catalog->num_used + 1 > catalog->num_alloc) {
+        const size_t num_alloc = catalog->num_alloc ? catalog->num_alloc * 2 : 64;
+        struct WheelCatalogEntry *tmp = realloc(catalog->entry, num_alloc * sizeof(*catalog->entry));
+        if (!tmp) {
+            return -1;
+        }
+        catalog->entry = tmp;
+        catalog->num_alloc = num_alloc;
+    }
+    catalog->entry[catalog->num_used++] = *entry;
+    return 0;
+}
+
+static int wheel_catalog_entry_cmp(const void *a, const void *b) {
+    const struct WheelCatalogEntry *x = a;
+    const struct WheelCatalogEntry *y = b;
+    int result = strcmp(x->name, y->name);
+    if (!result) {
+        result = pkgversion_cmp(x->version, y->version);
+    }
+    if (!result) {
+        result = strcmp(x->path, y->path);
+    }
+    return result;
+}
+
+static int wheel_catalog_path_cmp(const void *a, const void *b) {
+    const struct WheelCatalogEntry *x = *(const struct WheelCatalogEntry **) a;
+    const struct WheelCatalogEntry *y = *(const struct WheelCatalogEntry **) b;
+    return strcmp(x->path, y->path);
+}
+
+/**
+ * Write an entry with a single write(2)
+ *
+ * Entries written by concurrent processes to a file opened with O_APPEND
+ * never interleave.
+ */
+static int wheel_catalog_entry_write(const int fd, const struct WheelCatalogEntry *entry) {
+    char *data = NULL;
+    size_t len = 0;
+    FILE *fp = open_memstream(&data, &len);
+    if (!fp) {
+        return -1;
+    }
+
+    fprintf(fp, "wheel %s\n", entry->path);
+    fprintf(fp, "size %zu\n", entry->size);
+    fprintf(fp, "mtime %lld\n", (long long) entry->mtime);
+    fprintf(fp, "sha256 %s\n", entry->sha256);
+    fprintf(fp, "metadata_sha256 %s\n", entry->metadata_sha256);
+    fprintf(fp, "name %s\n", entry->name);
+    fprintf(fp, "version %s\n", entry->version);
+    if (entry->requires_python) {
+        fprintf(fp, "requires_python %s\n", entry->requires_python);
+    }
+    for (size_t i = 0; i < strlist_count(entry->tag); i++) {
+        fprintf(fp, "tag %s\n", strlist_item(entry->tag, i));
+    }
+    for (size_t i = 0; i < strlist_count(entry->requires_dist); i++) {
+        fprintf(fp, "requires_dist %s\n", strlist_item(entry->requires_dist, i));
+    }
+    fprintf(fp, "\n");
+    if (fclose(fp)) {
+        guard_free(data);
+        return -1;
+    }
+
+    const ssize_t written = write(fd, data, len);
+    guard_free(data);
+    return written == (ssize_t) len ? 0 : -1;
+}
+
+/**
+ * Call `fn` for each header of a `WHEEL` or `METADATA` file
+ *
+ * Headers end at the first empty line. Continuation lines are ignored.
+ * `data` is modified.
+ */
+static int wheel_catalog_headers(char *data, int (*fn)(const char *key, const char *value, void *arg), void *arg) {
+    char *line = NULL;
+    while ((line = strsep(&data, "\n")) != NULL) {
+        line[strcspn(line, "\r")] = '\0';
+        if (!*line) {
+            break;
+        }
+        if (isspace((unsigned char) *line)) {
+            continue;
+        }
+        char *value = strchr(line, ':');
+        if (!value) {
+            continue;
+        }
+        *value++ = '\0';
+        while (isspace((unsigned char) *value)) {
+            value++;
+        }
+        if (fn(line, value, arg)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int wheel_catalog_wheel_header(const char *key, const char *value, void *arg) {
+    struct WheelCatalogEntry *entry = arg;
+    if (!strcasecmp(key, "Tag")) {
+        strlist_append(&entry->tag, (char *) value);
+    }
+    return 0;
+}
+
+static int wheel_catalog_metadata_header(const char *key, const char *value, void *arg) {
+    struct WheelCatalogEntry *entry = arg;
+    if (!strcasecmp(key, "Name") && !entry->name) {
+        char name[255] = {0};
+        if (pkgname_normalize(value, name, sizeof(name))) {
+            return -1;
+        }
+        entry->name = strdup(name);
+        return entry->name ? 0 : -1;
+    }
+    if (!strcasecmp(key, "Version") && !entry->version) {
+        entry->version = strdup(value);
+        return entry->version ? 0 : -1;
+    }
+    if (!strcasecmp(key, "Requires-Python") && !entry->requires_python) {
+        entry->requires_python = strdup(value);
+        return entry->requires_python ? 0 : -1;
+    }
+    if (!strcasecmp(key, "Requires-Dist")) {
+        strlist_append(&entry->requires_dist, (char *) value);
+    }
+    return 0;
+}
+
+/**
+ * Read one wheel and append its entry to the catalog
+ */
+static int wheel_catalog_read_wheel(size_t index, void *arg) {
+    const struct WheelCatalogWork *work = arg;
+    const struct WheelCatalogEntry *found = &work->entry[work->pending[index]];
+    struct WheelCatalogEntry entry = {
+        .path = strdup(found->path),
+        .size = found->size,
+        .mtime = found->mtime,
+        .tag = strlist_init(),
+        .requires_dist = strlist_init(),
+    };
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char hex[SHA256_HEX_SIZE];
+    char path[PATH_MAX];
+    char *data = NULL;
+    int status = -1;
+
+    snprintf(path, sizeof(path), "%s/%s", work->root, found->path);
+    struct WheelArchive *archive = wheel_archive_open(path);
+    if (!entry.path || !entry.tag || !entry.requires_dist || !archive) {
+        goto WCR_END;
+    }
+    if (sha256_file(path, digest)) {
+        goto WCR_END;
+    }
+    sha256_hex(digest, hex);
+    entry.sha256 = strdup(hex);
+    if (wheel_archive_read(archive, WHEEL_ARCHIVE_WHEEL, &data) || wheel_catalog_headers(data, wheel_catalog_wheel_header, &entry)) {
+        goto WCR_END;
+    }
+    guard_free(data);
+    if (wheel_archive_read(archive, WHEEL_ARCHIVE_METADATA, &data)) {
+        goto WCR_END;
+    }
+    // Hashed before the headers are parsed in place
+    struct SHA256 ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, strlen(data));
+    sha256_final(&ctx, digest);
+    sha256_hex(digest, hex);
+    entry.metadata_sha256 = strdup(hex);
+    if (wheel_catalog_headers(data, wheel_catalog_metadata_header, &entry)) {
+        goto WCR_END;
+    }
+    if (!entry.sha256 || !entry.metadata_sha256 || !entry.name || !entry.version) {
+        goto WCR_END;
+    }
+    status = wheel_catalog_entry_write(work->fd, &entry);
+
+    WCR_END:
+    if (status) {
+        SYSERROR("Unable to read wheel metadata: %s", path);
+    }
+    guard_free(data);
+    wheel_archive_close(&archive);
+    wheel_catalog_entry_free(&entry);
+    return status;
+}
+
+/**
+ * Find wheel files below `root`/`rel`
+ */
+static int wheel_catalog_walk(struct WheelCatalog *found, const char *root, const char *rel) {
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s%s%s", root, *rel ? "/" : "", rel) >= (int) sizeof(path)) {
+        SYSERROR("Path is too long: %s/%s", root, rel);
+        return -1;
+    }
+
+    DIR *dp = opendir(path);
+    if (!dp) {
+        SYSERROR("Unable to open directory: %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    int status = 0;
+    struct dirent *rec;
+    while (!status && (rec = readdir(dp)) != NULL) {
+        char child[PATH_MAX];
+        struct stat st;
+
+        if (!strcmp(rec->d_name, ".") || !strcmp(rec->d_name, "..")) {
+            continue;
+        }
+        if (snprintf(child, sizeof(child), "%s%s%s", rel, *rel ? "/" : "", rec->d_name) >= (int) sizeof(child)) {
+            SYSERROR("Path is too long: %s/%s", path, rec->d_name);
+            status = -1;
+            break;
+        }
+        if (fstatat(dirfd(dp), rec->d_name, &st, AT_SYMLINK_NOFOLLOW)) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            status = wheel_catalog_walk(found, root, child);
+            continue;
+        }
+        if (!endswith(rec->d_name, ".whl") || strchr(child, '\n')) {
+            continue;
+        }
+        // Linked wheels are fine. Linked directories are not followed.
+        if (S_ISLNK(st.st_mode) && fstatat(dirfd(dp), rec->d_name, &st, 0)) {
+            continue;
+        }
+        if (!S_ISREG(st.st_mode)) {
+            continue;
+        }
+
+        struct WheelCatalogEntry entry = {
+            .path = strdup(child),
+            .size = st.st_size,
+            .mtime = st.st_mtime,
+        };
+        if (!entry.path || wheel_catalog_append(found, &entry)) {
+            guard_free(entry.path);
+            status = -1;
+        }
+    }
+    closedir(dp);
+    return status;
+}
+
+ssize_t wheel_catalog_build(const char *root, const char *filename, size_t jobs) {
+    struct WheelCatalog found = {0};
+    struct WheelCatalog *previous = NULL;
+    struct WheelCatalogEntry **by_path = NULL;
+    size_t *pending = NULL;
+    size_t num_pending = 0;
+    char tempfile[PATH_MAX];
+    ssize_t status = -1;
+    int fd = -1;
+
+    if (snprintf(tempfile, sizeof(tempfile), "%s.%d", filename, (int) getpid()) >= (int) sizeof(tempfile)) {
+        SYSERROR("Path is too long: %s", filename);
+        return -1;
+    }
+    if (wheel_catalog_walk(&found, root, "")) {
+        goto WCB_END;
+    }
+
+    if (access(filename, F_OK) == 0) {
+        previous = wheel_catalog_load(filename);
+        if (!previous) {
+            SYSDEBUG("Ignoring unreadable wheel catalog: %s", filename);
+        }
+    }
+    if (previous && previous->num_used) {
+        by_path = calloc(previous->num_used, sizeof(*by_path));
+        if (!by_path) {
+            goto WCB_END;
+        }
+        for (size_t i = 0; i < previous->num_used; i++) {
+            by_path[i] = &previous->entry[i];
+        }
+        qsort(by_path, previous->num_used, sizeof(*by_path), wheel_catalog_path_cmp);
+    }
+
+    pending = calloc(found.num_used + 1, sizeof(*pending));
+    if (!pending) {
+        goto WCB_END;
+    }
+
+    fd = open(tempfile, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) {
+        SYSERROR("Unable to create wheel catalog: %s: %s", tempfile, strerror(errno));
+        goto WCB_END;
+    }
+
+    for (size_t i = 0; i < found.num_used; i++) {
+        const struct WheelCatalogEntry *key = &found.entry[i];
+        struct WheelCatalogEntry **match = NULL;
+        if (by_path) {
+            match = bsearch(&key, by_path, previous->num_used, sizeof(*by_path), wheel_catalog_path_cmp);
+        }
+        if (match && (*match)->size == key->size && (*match)->mtime == key->mtime && (*match)->sha256 && (*match)->metadata_sha256) {
+            if (wheel_catalog_entry_write(fd, *match)) {
+                SYSERROR("Unable to write wheel catalog: %s: %s", tempfile, strerror(errno));
+                goto WCB_END;
+            }
+            continue;
+        }
+        pending[num_pending++] = i;
+    }
+    SYSDEBUG("Wheel catalog: %zu wheels, %zu unchanged", found.num_used, found.num_used - num_pending);
+
+    const struct WheelCatalogWork work = {
+        .root = root,
+        .fd = fd,
+        .entry = found.entry,
+        .pending = pending,
+    };
+    status = mp_parallel_for(num_pending, jobs, wheel_catalog_read_wheel, (void *) &work);
+    if (status < 0) {
+        goto WCB_END;
+    }
+
+    if (close(fd) || rename(tempfile, filename)) {
+        SYSERROR("Unable to write wheel catalog: %s: %s", filename, strerror(errno));
+        fd = -1;
+        status = -1;
+        goto WCB_END;
+    }
+    fd = -1;
+
+    WCB_END:
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (status < 0) {
+        remove(tempfile);
+    }
+    for (size_t i = 0; i < found.num_used; i++) {
+        wheel_catalog_entry_free(&found.entry[i]);
+    }
+    guard_free(found.entry);
+    guard_free(by_path);
+    guard_free(pending);
+    wheel_catalog_free(&previous);
+    return status;
+}
+
+static int wheel_catalog_load_line(size_t line, const char *data, size_t len, void *arg) {
+    struct WheelCatalogLoad *load = arg;
+    struct WheelCatalog *catalog = load->catalog;
+    (void) line;
+
+    while (len && (data[len - 1] == '\n' || data[len - 1] == '\r')) {
+        len--;
+    }
+    const char *sep = memchr(data, ' ', len);
+    if (!sep) {
+        return 0;
+    }
+    const size_t key_len = sep - data;
+    char *value = strndup(sep + 1, len - key_len - 1);
+    if (!value) {
+        return -1;
+    }
+
+    #define KEY_IS(NAME) (key_len == strlen(NAME) && !strncmp(data, NAME, key_len))
+    if (KEY_IS("wheel")) {
+        struct WheelCatalogEntry entry = {
+            .path = value,
+            .tag = strlist_init(),
+            .requires_dist = strlist_init(),
+        };
+        if (!entry.tag || !entry.requires_dist || wheel_catalog_append(catalog, &entry)) {
+            wheel_catalog_entry_free(&entry);
+            return -1;
+        }
+        load->current = 1;
+        return 0;
+    }
+    if (!load->current) {
+        guard_free(value);
+        return 0;
+    }
+
+    struct WheelCatalogEntry *entry = &catalog->entry[catalog->num_used - 1];
+    if (KEY_IS("size")) {
+        entry->size = strtoull(value, NULL, 10);
+    } else if (KEY_IS("mtime")) {
+        entry->mtime = (time_t) strtoll(value, NULL, 10);
+    } else if (KEY_IS("sha256")) {
+        guard_free(entry->sha256);
+        entry->sha256 = value;
+        value = NULL;
+    } else if (KEY_IS("metadata_sha256")) {
+        guard_free(entry->metadata_sha256);
+        entry->metadata_sha256 = value;
+        value = NULL;
+    } else if (KEY_IS("name")) {
+        guard_free(entry->name);
+        entry->name = value;
+        value = NULL;
+    } else if (KEY_IS("version")) {
+        guard_free(entry->version);
+        entry->version = value;
+        value = NULL;
+    } else if (KEY_IS("requires_python")) {
+        guard_free(entry->requires_python);
+        entry->requires_python = value;
+        value = NULL;
+    } else if (KEY_IS("tag")) {
+        strlist_append(&entry->tag, value);
+    } else if (KEY_IS("requires_dist")) {
+        strlist_append(&entry->requires_dist, value);
+    }
+    #undef KEY_IS
+    guard_free(value);
+    return 0;
+}
+
+struct WheelCatalog *wheel_catalog_load(const char *filename) {
+    struct WheelCatalog *catalog = calloc(1, sizeof(*catalog));
+    if (!catalog) {
+        return NULL;
+    }
+
+    struct WheelCatalogLoad load = {.catalog = catalog};
+    if (file_foreach_line(filename, wheel_catalog_load_line, &load)) {
+        wheel_catalog_free(&catalog);
+        return NULL;
+    }
+
+    // Drop incomplete entries
+    size_t used = 0;
+    for (size_t i = 0; i < catalog->num_used; i++) {
+        if (!catalog->entry[i].name || !catalog->entry[i].version) {
+            wheel_catalog_entry_free(&catalog->entry[i]);
+            continue;
+        }
+        catalog->entry[used++] = catalog->entry[i];
+    }
+    catalog->num_used = used;
+
+    if (catalog->num_used) {
+        qsort(catalog->entry, catalog->num_used, sizeof(*catalog->entry), wheel_catalog_entry_cmp);
+    }
+    return catalog;
+}
+
+const struct WheelCatalogEntry *wheel_catalog_find(const struct WheelCatalog *catalog, const char *name, size_t *count) {
+    char key[255] = {0};
+
+    *count = 0;
+    if (!catalog || pkgname_normalize(name, key, sizeof(key))) {
+        return NULL;
+    }
+
+    // First entry with a name not less than key
+    size_t lo = 0;
+    size_t hi = catalog->num_used;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(catalog->entry[mid].name, key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    size_t end = lo;
+    while (end < catalog->num_used && !strcmp(catalog->entry[end].name, key)) {
+        end++;
+    }
+    *count = end - lo;
+    return *count ? &catalog->entry[lo] : NULL;
+}
+
+void wheel_catalog_free(struct WheelCatalog **catalog) {
+    if (!catalog || !*catalog) {
+        return;
+    }
+    for (size_t i = 0; i < (*catalog)->num_used; i++) {
+        wheel_catalog_entry_free(&(*catalog)->entry[i]);
+    }
+    guard_free((*catalog)->entry);
+    guard_free(*catalog);
+}
@@ -0,0 +1,348 @@
+#include <sys/stat.h>
+#include "wheelindex.h"
+#include "multiprocessing.h"
+#include "sha256.h"
+#include "utils.h"
+#include "wheel.h"
+
+struct WheelIndexWork {
+    const char *root; ///< Directory containing wheel files
+    const struct WheelCatalogEntry *entry; ///< Catalog entries
+    const size_t *pending; ///< Indexes of entries without an up-to-date .metadata file
+};
+
+static void wheel_index_put_html(FILE *fp, const char *s) {
+    for (; *s; s++) {
+        switch (*s) {
+            case '&':
+                fputs("&amp;", fp);
+                break;
+            case '<':
+                fputs("&lt;", fp);
+                break;
+            case '>':
+                fputs("&gt;", fp);
+                break;
+            case '"':
+                fputs("&quot;", fp);
+                break;
+            case '\'':
+                fputs("&#39;", fp);
+                break;
+            default:
+                fputc(*s, fp);
+                break;
+        }
+    }
+}
+
+static void wheel_index_put_json(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', fp);
+            fputc(*s, fp);
+        } else if ((unsigned char) *s < 0x20) {
+            fprintf(fp, "\\u%04x", (unsigned char) *s);
+        } else {
+            fputc(*s, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+static void wheel_index_put_url(FILE *fp, const char *s) {
+    for (; *s; s++) {
+        const unsigned char ch = (unsigned char) *s;
+        if (isalnum(ch) || strchr("-._~/+", ch)) {
+            fputc(ch, fp);
+        } else {
+            fprintf(fp, "%%%02X", ch);
+        }
+    }
+}
+
+static const char *wheel_index_filename(const struct WheelCatalogEntry *entry) {
+    const char *base = strrchr(entry->path, '/');
+    return base ? base + 1 : entry->path;
+}
+
+/**
+ * Open a temporary file to be renamed over `filename` by wheel_index_commit()
+ */
+static FILE *wheel_index_open(const char *filename, char *tempfile, size_t maxlen) {
+    if (snprintf(tempfile, maxlen, "%s.%d", filename, (int) getpid()) >= (int) maxlen) {
+        SYSERROR("Path is too long: %s", filename);
+        return NULL;
+    }
+    FILE *fp = fopen(tempfile, "w");
+    if (!fp) {
+        SYSERROR("Unable to open %s for writing: %s", tempfile, strerror(errno));
+    }
+    return fp;
+}
+
+static int wheel_index_commit(FILE *fp, const char *tempfile, const char *filename) {
+    if (ferror(fp) | fclose(fp) || rename(tempfile, filename)) {
+        SYSERROR("Unable to write %s: %s", filename, strerror(errno));
+        remove(tempfile);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Determine whether a .metadata file is a copy of the catalog entry's `METADATA`
+ *
+ * A wheel may be replaced without changing its modification time, so the
+ * contents are compared with the hash recorded in the catalog.
+ *
+ * @return non-zero if the file is up-to-date
+ */
+static int wheel_index_metadata_current(const char *sidecar, const struct WheelCatalogEntry *entry) {
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char hex[SHA256_HEX_SIZE];
+    struct stat st;
+
+    if (stat(sidecar, &st) || st.st_mtime != entry->mtime) {
+        return 0;
+    }
+    if (sha256_file(sidecar, digest)) {
+        return 0;
+    }
+    sha256_hex(digest, hex);
+    return !strcmp(hex, entry->metadata_sha256);
+}
+
+/**
+ * Extract `METADATA` from a wheel (PEP 658)
+ *
+ * The modification time of the .metadata file is set to the wheel's, so a
+ * replaced wheel is noticed without hashing the file in most cases.
+ */
+static int wheel_index_write_metadata(size_t index, void *arg) {
+    const struct WheelIndexWork *work = arg;
+    const struct WheelCatalogEntry *entry = &work->entry[work->pending[index]];
+    char path[PATH_MAX];
+    char sidecar[PATH_MAX + 16];
+    char tempfile[PATH_MAX + 32];
+    char *data = NULL;
+    int status = -1;
+
+    snprintf(path, sizeof(path), "%s/%s", work->root, entry->path);
+    snprintf(sidecar, sizeof(sidecar), "%s.metadata", path);
+    struct WheelArchive *archive = wheel_archive_open(path);
+    if (!archive || wheel_archive_read(archive, WHEEL_ARCHIVE_METADATA, &data)) {
+        SYSERROR("Unable to read metadata: %s", path);
+        goto WIM_END;
+    }
+
+    FILE *fp = wheel_index_open(sidecar, tempfile, sizeof(tempfile));
+    if (!fp) {
+        goto WIM_END;
+    }
+    fwrite(data, 1, strlen(data), fp);
+    if (wheel_index_commit(fp, tempfile, sidecar)) {
+        goto WIM_END;
+    }
+
+    const struct timespec times[2] = {{.tv_sec = entry->mtime}, {.tv_sec = entry->mtime}};
+    status = utimensat(AT_FDCWD, sidecar, times, 0);
+
+    WIM_END:
+    guard_free(data);
+    wheel_archive_close(&archive);
+    return status;
+}
+
+/**
+ * Write the HTML (PEP 503) and JSON (PEP 691) pages of one project
+ * @param root directory containing wheel files
+ * @param entry first catalog entry of the project
+ * @param count number of entries belonging to the project
+ */
+static int wheel_index_write_project(const char *root, const struct WheelCatalogEntry *entry, const size_t count) {
+    char dir[PATH_MAX];
+    char filename[PATH_MAX + 16];
+    char tempfile[PATH_MAX + 32];
+    const char *name = entry->name;
+
+    if (snprintf(dir, sizeof(dir), "%s/%s", root, name) >= (int) sizeof(dir) || mkdirs(dir, 0755)) {
+        SYSERROR("Unable to create project directory: %s/%s", root, name);
+        return -1;
+    }
+    if (globals.verbose) {
+        printf("+ %s\n", name);
+    }
+
+    snprintf(filename, sizeof(filename), "%s/index.html", dir);
+    FILE *fp = wheel_index_open(filename, tempfile, sizeof(tempfile));
+    if (!fp) {
+        return -1;
+    }
+    fprintf(fp, "<!DOCTYPE html>\n<html>\n<head>\n");
+    fprintf(fp, "<meta name=\"pypi:repository-version\" content=\"%s\">\n", WHEEL_INDEX_API_VERSION);
+    fprintf(fp, "<title>Links for %s</title>\n</head>\n<body>\n<h1>Links for %s</h1>\n", name, name);
+    for (size_t i = 0; i < count; i++) {
+        const struct WheelCatalogEntry *wheel = &entry[i];
+        if (globals.verbose) {
+            printf("`- %s\n", wheel_index_filename(wheel));
+        }
+        fprintf(fp, "<a href=\"../");
+        wheel_index_put_url(fp, wheel->path);
+        fprintf(fp, "#sha256=%s\"", wheel->sha256);
+        if (wheel->requires_python) {
+            fprintf(fp, " data-requires-python=\"");
+            wheel_index_put_html(fp, wheel->requires_python);
+            fprintf(fp, "\"");
+        }
+        fprintf(fp, " data-dist-info-metadata=\"sha256=%s\"", wheel->metadata_sha256);
+        fprintf(fp, " data-core-metadata=\"sha256=%s\">", wheel->metadata_sha256);
+        wheel_index_put_html(fp, wheel_index_filename(wheel));
+        fprintf(fp, "</a><br/>\n");
+    }
+    fprintf(fp, "</body>\n</html>\n");
+    if (wheel_index_commit(fp, tempfile, filename)) {
+        return -1;
+    }
+
+    snprintf(filename, sizeof(filename), "%s/index.json", dir);
+    fp = wheel_index_open(filename, tempfile, sizeof(tempfile));
+    if (!fp) {
+        return -1;
+    }
+    fprintf(fp, "{\"meta\": {\"api-version\": \"%s\"}, \"name\": ", WHEEL_INDEX_API_VERSION);
+    wheel_index_put_json(fp, name);
+    fprintf(fp, ", \"files\": [");
+    for (size_t i = 0; i < count; i++) {
+        const struct WheelCatalogEntry *wheel = &entry[i];
+        fprintf(fp, "%s{\"filename\": ", i ? ", " : "");
+        wheel_index_put_json(fp, wheel_index_filename(wheel));
+        fprintf(fp, ", \"url\": \"../");
+        wheel_index_put_url(fp, wheel->path);
+        fprintf(fp, "\", \"hashes\": {\"sha256\": \"%s\"}", wheel->sha256);
+        if (wheel->requires_python) {
+            fprintf(fp, ", \"requires-python\": ");
+            wheel_index_put_json(fp, wheel->requires_python);
+        }
+        fprintf(fp, ", \"core-metadata\": {\"sha256\": \"%s\"}", wheel->metadata_sha256);
+        fprintf(fp, ", \"dist-info-metadata\": {\"sha256\": \"%s\"}", wheel->metadata_sha256);
+        fprintf(fp, ", \"size\": %zu}", wheel->size);
+    }
+    fprintf(fp, "], \"versions\": [");
+    for (size_t i = 0; i < count; i++) {
+        // Entries are sorted by version
+        if (i && !strcmp(entry[i].version, entry[i - 1].version)) {
+            continue;
+        }
+        fprintf(fp, "%s", i ? ", " : "");
+        wheel_index_put_json(fp, entry[i].version);
+    }
+    fprintf(fp, "]}\n");
+    return wheel_index_commit(fp, tempfile, filename);
+}
+
+/**
+ * Write the HTML (PEP 503) and JSON (PEP 691) project lists
+ */
+static int wheel_index_write_root(const char *root, const struct WheelCatalog *catalog) {
+    char filename[PATH_MAX];
+    char tempfile[PATH_MAX + 16];
+
+    snprintf(filename, sizeof(filename), "%s/index.html", root);
+    FILE *fp = wheel_index_open(filename, tempfile, sizeof(tempfile));
+    if (!fp) {
+        return -1;
+    }
+    fprintf(fp, "<!DOCTYPE html>\n<html>\n<head>\n");
+    fprintf(fp, "<meta name=\"pypi:repository-version\" content=\"%s\">\n", WHEEL_INDEX_API_VERSION);
+    fprintf(fp, "<title>Simple index</title>\n</head>\n<body>\n");
+    for (size_t i = 0; i < catalog->num_used; i++) {
+        const char *name = catalog->entry[i].name;
+        if (i && !strcmp(name, catalog->entry[i - 1].name)) {
+            continue;
+        }
+        fprintf(fp, "<a href=\"%s/\">%s</a><br/>\n", name, name);
+    }
+    fprintf(fp, "</body>\n</html>\n");
+    if (wheel_index_commit(fp, tempfile, filename)) {
+        return -1;
+    }
+
+    snprintf(filename, sizeof(filename), "%s/index.json", root);
+    fp = wheel_index_open(filename, tempfile, sizeof(tempfile));
+    if (!fp) {
+        return -1;
+    }
+    fprintf(fp, "{\"meta\": {\"api-version\": \"%s\"}, \"projects\": [", WHEEL_INDEX_API_VERSION);
+    for (size_t i = 0; i < catalog->num_used; i++) {
+        const char *name = catalog->entry[i].name;
+        if (i && !strcmp(name, catalog->entry[i - 1].name)) {
+            continue;
+        }
+        fprintf(fp, "%s{\"name\": ", i ? ", " : "");
+        wheel_index_put_json(fp, name);
+        fprintf(fp, "}");
+    }
+    fprintf(fp, "]}\n");
+    return wheel_index_commit(fp, tempfile, filename);
+}
+
+ssize_t wheel_index_build(const char *root, size_t jobs) {
+    char catalog_file[PATH_MAX];
+    size_t *pending = NULL;
+    size_t num_pending = 0;
+    int status = -1;
+
+    if (snprintf(catalog_file, sizeof(catalog_file), "%s/%s", root, WHEEL_CATALOG_FILENAME) >= (int) sizeof(catalog_file)) {
+        SYSERROR("Path is too long: %s", root);
+        return -1;
+    }
+    const ssize_t unreadable = wheel_catalog_build(root, catalog_file, jobs);
+    if (unreadable < 0) {
+        return -1;
+    }
+    struct WheelCatalog *catalog = wheel_catalog_load(catalog_file);
+    if (!catalog) {
+        SYSERROR("Unable to read wheel catalog: %s", catalog_file);
+        return -1;
+    }
+
+    pending = calloc(catalog->num_used + 1, sizeof(*pending));
+    if (!pending) {
+        goto WIB_END;
+    }
+    for (size_t i = 0; i < catalog->num_used; i++) {
+        char sidecar[PATH_MAX];
+        snprintf(sidecar, sizeof(sidecar), "%s/%s.metadata", root, catalog->entry[i].path);
+        if (!wheel_index_metadata_current(sidecar, &catalog->entry[i])) {
+            pending[num_pending++] = i;
+        }
+    }
+    const struct WheelIndexWork work = {
+        .root = root,
+        .entry = catalog->entry,
+        .pending = pending,
+    };
+    if (mp_parallel_for(num_pending, jobs, wheel_index_write_metadata, (void *) &work)) {
+        goto WIB_END;
+    }
+
+    for (size_t i = 0; i < catalog->num_used;) {
+        size_t count = 0;
+        const struct WheelCatalogEntry *project = wheel_catalog_find(catalog, catalog->entry[i].name, &count);
+        if (!project || wheel_index_write_project(root, project, count)) {
+            goto WIB_END;
+        }
+        i += count;
+    }
+    if (wheel_index_write_root(root, catalog)) {
+        goto WIB_END;
+    }
+    status = 0;
+
+    WIB_END:
+    guard_free(pending);
+    wheel_catalog_free(&catalog);
+    return status ? -1 : unreadable;
+}
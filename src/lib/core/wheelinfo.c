@@ -1,116 +1,400 @@
+#include <ctype.h>
+#include <sys/stat.h>
 #include "wheelinfo.h"
+#include "pkgversion.h"
+#include "wheelcatalog.h"
 
-struct WheelInfo *wheelinfo_get(const char *basepath, const char *name, char *to_match[], unsigned match_mode) {
-    struct dirent *rec;
-    struct WheelInfo *result = NULL;
-    char package_path[PATH_MAX];
-    char package_name[NAME_MAX];
+struct WheelInfoListing {
+    char *path; ///< Directory
+    struct timespec mtime; ///< Modification time of directory when it was read
+    char **file_name; ///< Wheel file names
+    struct WheelName *token; ///< Tokens of each wheel file name
+    size_t num_used; ///< Total wheel file names
+    size_t num_alloc; ///< Total wheel file name slots
+};
 
-    strncpy(package_name, name, sizeof(package_name) - 1);
-    tolower_s(package_name);
-    snprintf(package_path, sizeof(package_path), "%s/%s", basepath, package_name);
+static struct WheelInfoCache {
+    struct WheelInfoListing *listing;
+    size_t num_used;
+    size_t num_alloc;
+} wheelinfo_cache = {0};
+
+struct WheelInfoScore {
+    size_t matched; ///< Patterns found in the file name
+    int python_tag; ///< A pattern was found in the Python tag
+    int abi_tag; ///< A pattern was found in the ABI tag
+    int platform_tag; ///< A pattern was found in the platform tag
+};
+
+int wheelinfo_tokenize(const char *filename, struct WheelName *result) {
+    struct WheelNameToken part[6] = {0};
+    size_t count = 0;
 
-    DIR *dp = opendir(package_path);
+    const size_t len = strlen(filename);
+    if (len < 4 || strcmp(filename + len - 4, ".whl") != 0) {
+        return -1;
+    }
+    const char *end = filename + len - 4;
+    for (const char *pos = filename; pos <= end; count++) {
+        const char *next = memchr(pos, '-', end - pos);
+        if (!next) {
+            next = end;
+        }
+        if (count == sizeof(part) / sizeof(*part) || next == pos) {
+            return -1;
+        }
+        part[count].data = pos;
+        part[count].len = next - pos;
+        pos = next + 1;
+    }
+
+    memset(result, 0, sizeof(*result));
+    if (count == 5) {
+        // no build tag
+        result->distribution = part[0];
+        result->version = part[1];
+        result->python_tag = part[2];
+        result->abi_tag = part[3];
+        result->platform_tag = part[4];
+    } else if (count == 6) {
+        // has build tag
+        result->distribution = part[0];
+        result->version = part[1];
+        result->build_tag = part[2];
+        result->python_tag = part[3];
+        result->abi_tag = part[4];
+        result->platform_tag = part[5];
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static void wheelinfo_listing_free(struct WheelInfoListing *listing) {
+    for (size_t i = 0; i < listing->num_used; i++) {
+        guard_free(listing->file_name[i]);
+    }
+    guard_free(listing->file_name);
+    guard_free(listing->token);
+    listing->num_used = 0;
+    listing->num_alloc = 0;
+}
+
+void wheelinfo_cache_clear() {
+    for (size_t i = 0; i < wheelinfo_cache.num_used; i++) {
+        wheelinfo_listing_free(&wheelinfo_cache.listing[i]);
+        guard_free(wheelinfo_cache.listing[i].path);
+    }
+    guard_free(wheelinfo_cache.listing);
+    wheelinfo_cache.num_used = 0;
+    wheelinfo_cache.num_alloc = 0;
+}
+
+static int wheelinfo_listing_read(struct WheelInfoListing *listing) {
+    struct dirent *rec;
+    DIR *dp = opendir(listing->path);
     if (!dp) {
-        return NULL;
+        return -1;
     }
 
+    wheelinfo_listing_free(listing);
     while ((rec = readdir(dp)) != NULL) {
-        if (!strcmp(rec->d_name, ".") || !strcmp(rec->d_name, "..")) {
+        struct WheelName token;
+        if (!endswith(rec->d_name, ".whl")) {
+            // not a wheel file. nothing to do
             continue;
         }
-        char filename[NAME_MAX];
-        strncpy(filename, rec->d_name, sizeof(filename) - 1);
-        char *ext = strstr(filename, ".whl");
-        if (ext) {
-            *ext = '\0';
-        } else {
-            // not a wheel file. nothing to do
+        if (wheelinfo_tokenize(rec->d_name, &token)) {
+            msg(STASIS_MSG_WARN | STASIS_MSG_L2, "Ignoring wheel with unknown file name format: %s/%s\n", listing->path, rec->d_name);
             continue;
         }
 
-        size_t match = 0;
-        size_t pattern_count = 0;
-        for (; to_match[pattern_count] != NULL; pattern_count++) {
-            if (strstr(filename, to_match[pattern_count])) {
-                match++;
+        if (listing->num_used == listing->num_alloc) {
+            const size_t num_alloc = listing->num_alloc ? listing->num_alloc * 2 : 16;
+            char **file_name = realloc(listing->file_name, num_alloc * sizeof(*file_name));
+            if (!file_name) {
+                closedir(dp);
+                return -1;
             }
+            listing->file_name = file_name;
+            struct WheelName *tokens = realloc(listing->token, num_alloc * sizeof(*tokens));
+            if (!tokens) {
+                closedir(dp);
+                return -1;
+            }
+            listing->token = tokens;
+            listing->num_alloc = num_alloc;
         }
 
-        if (!startswith(rec->d_name, name)) {
-            continue;
+        char *file_name = strdup(rec->d_name);
+        if (!file_name) {
+            closedir(dp);
+            return -1;
         }
+        // Tokens point into the copy
+        wheelinfo_tokenize(file_name, &listing->token[listing->num_used]);
+        listing->file_name[listing->num_used] = file_name;
+        listing->num_used++;
+    }
+    closedir(dp);
+    return 0;
+}
 
-        if (match_mode == WHEEL_MATCH_EXACT && match != pattern_count) {
-            continue;
-        }
+/**
+ * Get the wheel file names in a directory
+ *
+ * The directory is only read again after its modification time changes.
+ *
+ * @param path directory containing wheel files
+ * @return pointer to WheelInfoListing, or NULL on error (errno is set)
+ */
+static const struct WheelInfoListing *wheelinfo_listing(const char *path) {
+    struct stat st;
+    struct WheelInfoListing *listing = NULL;
 
-        result = calloc(1, sizeof(*result));
-        if (!result) {
-            SYSERROR("Unable to allocate %zu bytes for wheel struct", sizeof(*result));
-            closedir(dp);
-            return NULL;
+    if (stat(path, &st) < 0) {
+        return NULL;
+    }
+    for (size_t i = 0; i < wheelinfo_cache.num_used; i++) {
+        if (!strcmp(wheelinfo_cache.listing[i].path, path)) {
+            listing = &wheelinfo_cache.listing[i];
+            break;
         }
+    }
+    if (listing && listing->mtime.tv_sec == st.st_mtim.tv_sec && listing->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+        return listing;
+    }
 
-        result->path_name = realpath(package_path, NULL);
-        if (!result->path_name) {
-            SYSERROR("Unable to resolve absolute path to %s: %s", filename, strerror(errno));
-            wheelinfo_free(&result);
-            closedir(dp);
-            return NULL;
+    if (!listing) {
+        if (wheelinfo_cache.num_used == wheelinfo_cache.num_alloc) {
+            const size_t num_alloc = wheelinfo_cache.num_alloc ? wheelinfo_cache.num_alloc * 2 : 8;
+            struct WheelInfoListing *tmp = realloc(wheelinfo_cache.listing, num_alloc * sizeof(*tmp));
+            if (!tmp) {
+                return NULL;
+            }
+            wheelinfo_cache.listing = tmp;
+            wheelinfo_cache.num_alloc = num_alloc;
         }
-        result->file_name = strdup(rec->d_name);
-        if (!result->file_name) {
-            SYSERROR("Unable to allocate bytes for %s: %s", rec->d_name, strerror(errno));
-            wheelinfo_free(&result);
-            closedir(dp);
+        listing = &wheelinfo_cache.listing[wheelinfo_cache.num_used];
+        memset(listing, 0, sizeof(*listing));
+        listing->path = strdup(path);
+        if (!listing->path) {
             return NULL;
         }
+        wheelinfo_cache.num_used++;
+    }
 
-        size_t parts_total;
-        char **parts = split(filename, "-", 0);
-        if (!parts) {
-            // This shouldn't happen unless a wheel file is present in the
-            // directory with a malformed file name, or we've managed to
-            // exhaust the system's memory
-            SYSERROR("%s has no '-' separators! (Delete this file and try again)", filename);
-            wheelinfo_free(&result);
-            closedir(dp);
-            return NULL;
+    // Recorded before reading, so a wheel added while reading is seen next time
+    listing->mtime = st.st_mtim;
+    if (wheelinfo_listing_read(listing)) {
+        const int saved_errno = errno;
+        wheelinfo_listing_free(listing);
+        listing->mtime = (struct timespec) {0};
+        errno = saved_errno;
+        return NULL;
+    }
+    return listing;
+}
+
+static int wheelinfo_token_contains(const struct WheelNameToken *token, const char *pattern) {
+    const size_t len = strlen(pattern);
+    for (size_t i = 0; i + len <= token->len; i++) {
+        if (!strncmp(token->data + i, pattern, len)) {
+            return 1;
         }
+    }
+    return 0;
+}
 
-        for (parts_total = 0; parts[parts_total] != NULL; parts_total++) {}
-        if (parts_total == 5) {
-            // no build tag
-            result->distribution = strdup(parts[0]);
-            result->version = strdup(parts[1]);
-            result->build_tag = NULL;
-            result->python_tag = strdup(parts[2]);
-            result->abi_tag = strdup(parts[3]);
-            result->platform_tag = strdup(parts[4]);
-        } else if (parts_total == 6) {
-            // has build tag
-            result->distribution = strdup(parts[0]);
-            result->version = strdup(parts[1]);
-            result->build_tag = strdup(parts[2]);
-            result->python_tag = strdup(parts[3]);
-            result->abi_tag = strdup(parts[4]);
-            result->platform_tag = strdup(parts[5]);
-        } else {
-            SYSERROR("Unknown wheel name format: %s. Expected 5 or 6 strings "
-                     "separated by '-', but got %zu instead", filename, parts_total);
-            guard_array_free(parts);
-            wheelinfo_free(&result);
-            closedir(dp);
-            return NULL;
+/**
+ * Compare a distribution name with a package name
+ *
+ * Letters are compared without regard to case. '-', '_' and '.' are equal.
+ */
+static int wheelinfo_name_equal(const struct WheelNameToken *distribution, const char *name) {
+    size_t i = 0;
+    for (; i < distribution->len && name[i]; i++) {
+        int a = tolower((unsigned char) distribution->data[i]);
+        int b = tolower((unsigned char) name[i]);
+        if (a == '_' || a == '.') {
+            a = '-';
+        }
+        if (b == '_' || b == '.') {
+            b = '-';
+        }
+        if (a != b) {
+            return 0;
         }
-        guard_array_free(parts);
-        break;
     }
-    closedir(dp);
+    return i == distribution->len && !name[i];
+}
+
+/**
+ * Score a wheel file name
+ * @return 0 on match
+ * @return -1 when the wheel does not satisfy `match_mode`
+ */
+static int wheelinfo_score(const struct WheelName *token, char *to_match[], unsigned match_mode, struct WheelInfoScore *score) {
+    // The file name without ".whl"
+    const struct WheelNameToken stem = {
+        .data = token->distribution.data,
+        .len = token->platform_tag.data + token->platform_tag.len - token->distribution.data,
+    };
+    size_t pattern_count = 0;
+
+    memset(score, 0, sizeof(*score));
+    for (; to_match[pattern_count] != NULL; pattern_count++) {
+        const char *pattern = to_match[pattern_count];
+        if (wheelinfo_token_contains(&stem, pattern)) {
+            score->matched++;
+            score->python_tag |= wheelinfo_token_contains(&token->python_tag, pattern);
+            score->abi_tag |= wheelinfo_token_contains(&token->abi_tag, pattern);
+            score->platform_tag |= wheelinfo_token_contains(&token->platform_tag, pattern);
+        }
+    }
+    if (match_mode == WHEEL_MATCH_EXACT && score->matched != pattern_count) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @return >0 when wheel `a` is a better match than wheel `b`
+ */
+static int wheelinfo_better(const struct WheelName *a, const struct WheelInfoScore *score_a, const struct WheelName *b, const struct WheelInfoScore *score_b) {
+    if (score_a->matched != score_b->matched) {
+        return score_a->matched > score_b->matched ? 1 : -1;
+    }
+    if (score_a->python_tag != score_b->python_tag) {
+        return score_a->python_tag - score_b->python_tag;
+    }
+    if (score_a->abi_tag != score_b->abi_tag) {
+        return score_a->abi_tag - score_b->abi_tag;
+    }
+    if (score_a->platform_tag != score_b->platform_tag) {
+        return score_a->platform_tag - score_b->platform_tag;
+    }
+    const int result = pkgversion_cmp_len(a->version.data, a->version.len, b->version.data, b->version.len);
+    if (result) {
+        return result;
+    }
+    return pkgversion_cmp_len(a->build_tag.data, a->build_tag.len, b->build_tag.data, b->build_tag.len);
+}
+
+static char *wheelinfo_token_dup(const struct WheelNameToken *token) {
+    return token->len ? strndup(token->data, token->len) : NULL;
+}
+
+/**
+ * Populate a WheelInfo from the tokens of a wheel file name
+ * @param dir directory containing the wheel file
+ * @param file_name name of wheel file (`token` points into it)
+ * @param token tokens of `file_name`
+ * @return pointer to WheelInfo, or NULL on error
+ */
+static struct WheelInfo *wheelinfo_new(const char *dir, const char *file_name, const struct WheelName *token) {
+    struct WheelInfo *result = calloc(1, sizeof(*result));
+    if (!result) {
+        SYSERROR("Unable to allocate %zu bytes for wheel struct", sizeof(*result));
+        return NULL;
+    }
+
+    result->path_name = realpath(dir, NULL);
+    if (!result->path_name) {
+        SYSERROR("Unable to resolve absolute path to %s: %s", dir, strerror(errno));
+        wheelinfo_free(&result);
+        return NULL;
+    }
+    result->file_name = strdup(file_name);
+    result->distribution = wheelinfo_token_dup(&token->distribution);
+    result->version = wheelinfo_token_dup(&token->version);
+    result->build_tag = wheelinfo_token_dup(&token->build_tag);
+    result->python_tag = wheelinfo_token_dup(&token->python_tag);
+    result->abi_tag = wheelinfo_token_dup(&token->abi_tag);
+    result->platform_tag = wheelinfo_token_dup(&token->platform_tag);
+    if (!result->file_name || !result->distribution || !result->version || !result->python_tag || !result->abi_tag || !result->platform_tag) {
+        SYSERROR("Unable to allocate bytes for %s: %s", file_name, strerror(errno));
+        wheelinfo_free(&result);
+        return NULL;
+    }
     return result;
 }
 
+struct WheelInfo *wheelinfo_get(const char *basepath, const char *name, char *to_match[], unsigned match_mode) {
+    char package_path[PATH_MAX];
+    char package_name[NAME_MAX] = {0};
+
+    strncpy(package_name, name, sizeof(package_name) - 1);
+    tolower_s(package_name);
+    snprintf(package_path, sizeof(package_path), "%s/%s", basepath, package_name);
+
+    const struct WheelInfoListing *listing = wheelinfo_listing(package_path);
+    if (!listing) {
+        return NULL;
+    }
+
+    const struct WheelName *best = NULL;
+    struct WheelInfoScore best_score = {0};
+    size_t best_index = 0;
+    for (size_t i = 0; i < listing->num_used; i++) {
+        const struct WheelName *token = &listing->token[i];
+        struct WheelInfoScore score;
+        if (!wheelinfo_name_equal(&token->distribution, name)) {
+            continue;
+        }
+        if (wheelinfo_score(token, to_match, match_mode, &score)) {
+            continue;
+        }
+        // Ties go to the first name in sort order, regardless of directory order
+        const int better = best ? wheelinfo_better(token, &score, best, &best_score) : 1;
+        if (better > 0 || (!better && strcmp(listing->file_name[i], listing->file_name[best_index]) < 0)) {
+            best = token;
+            best_score = score;
+            best_index = i;
+        }
+    }
+    if (!best) {
+        return NULL;
+    }
+    return wheelinfo_new(package_path, listing->file_name[best_index], best);
+}
+
+struct WheelInfo *wheelinfo_get_cataloged(const struct WheelCatalog *catalog, const char *basepath, const char *name, char *to_match[], unsigned match_mode) {
+    size_t count = 0;
+    const struct WheelCatalogEntry *entry = wheel_catalog_find(catalog, name, &count);
+    if (!entry) {
+        return NULL;
+    }
+
+    struct WheelName best = {0};
+    struct WheelInfoScore best_score = {0};
+    const struct WheelCatalogEntry *best_entry = NULL;
+    for (size_t i = 0; i < count; i++) {
+        const char *file_name = path_basename(entry[i].path);
+        struct WheelName token;
+        struct WheelInfoScore score;
+        if (wheelinfo_tokenize(file_name, &token) || wheelinfo_score(&token, to_match, match_mode, &score)) {
+            continue;
+        }
+        // Ties go to the first name in sort order, like wheelinfo_get()
+        const int better = best_entry ? wheelinfo_better(&token, &score, &best, &best_score) : 1;
+        if (better > 0 || (!better && strcmp(file_name, path_basename(best_entry->path)) < 0)) {
+            best = token;
+            best_score = score;
+            best_entry = &entry[i];
+        }
+    }
+    if (!best_entry) {
+        return NULL;
+    }
+
+    // Catalog paths are relative to the directory it describes
+    char dir[PATH_MAX];
+    const char *file_name = path_basename(best_entry->path);
+    snprintf(dir, sizeof(dir), "%s/%.*s", basepath, (int) (file_name - best_entry->path), best_entry->path);
+    return wheelinfo_new(dir, file_name, &best);
+}
+
 void wheelinfo_free(struct WheelInfo **wheel) {
     struct WheelInfo *w = (*wheel);
     if (!w) {
@@ -1,4 +1,5 @@
 #include "delivery.h"
+#include "indexcache.h"
 
 static char *strdup_maybe(const char * restrict s) {
     if (s != NULL) {
@@ -19,6 +20,7 @@ struct Delivery *delivery_duplicate(const struct Delivery *ctx) {
     result->conda.pip_packages_defer = strlist_copy(ctx->conda.pip_packages_defer);
     result->conda.pip_packages_purge = strlist_copy(ctx->conda.pip_packages_purge);
     result->conda.wheels_packages = strlist_copy(ctx->conda.wheels_packages);
+    result->conda.wheels_verified = strlist_copy(ctx->conda.wheels_verified);
     result->conda.installer_arch = strdup_maybe(ctx->conda.installer_arch);
     result->conda.installer_baseurl = strdup_maybe(ctx->conda.installer_baseurl);
     result->conda.installer_name = strdup_maybe(ctx->conda.installer_name);
@@ -229,6 +231,7 @@ void delivery_free(struct Delivery *ctx) {
     guard_strlist_free(&ctx->conda.pip_packages_defer);
     guard_strlist_free(&ctx->conda.pip_packages_purge);
     guard_strlist_free(&ctx->conda.wheels_packages);
+    guard_strlist_free(&ctx->conda.wheels_verified);
 
     tests_free(&ctx->tests);
 
@@ -349,11 +352,18 @@ void delivery_defer_packages(struct Delivery *ctx, int type) {
     }
     msg(STASIS_MSG_L2, "Filtering %s packages by test definition...\n", mode);
 
-    struct StrList *filtered = NULL;
-    filtered = strlist_init();
-    for (size_t i = 0; i < strlist_count(dataptr); i++) {
-        int build_for_host = 0;
+    const size_t num_packages = strlist_count(dataptr);
+    struct StrList *filtered = strlist_init();
+    struct StrList *upstream_specs = strlist_init();
+    // Maps a package to its record in upstream_specs (0 when the package is not tested)
+    size_t *upstream_index = calloc(num_packages + 1, sizeof(*upstream_index));
+    if (!filtered || !upstream_specs || !upstream_index) {
+        SYSERROR("Unable to allocate memory to filter %s packages", mode);
+        exit(1);
+    }
 
+    // Pass 1: Find packages that are *also* to be tested, and collect their specs
+    for (size_t i = 0; i < num_packages; i++) {
         name = strlist_item(dataptr, i);
         if (!strlen(name) || isblank(*name) || isspace(*name)) {
             // no data
@@ -376,78 +386,111 @@ void delivery_defer_packages(struct Delivery *ctx, int type) {
         }
         remove_extras(package_name);
 
-        msg(STASIS_MSG_L3, "package '%s': ", package_name);
-
         // When spec is present in name, set tests->version to the version detected in the name
-        for (size_t x = 0; x < ctx->tests->num_used; x++) {
-            struct Test *test = ctx->tests->test[x];
+        // Is the [test:NAME] in the package name?
+        struct Test *test = tests_find(ctx->tests, package_name);
+        if (test) {
             char nametmp[1024] = {0};
-
             strncpy(nametmp, package_name, sizeof(nametmp) - 1);
-            // Is the [test:NAME] in the package name?
-            if (!strcmp(nametmp, test->name)) {
-                // Override test->version when a version is provided by the (pip|conda)_package list item
-                guard_free(test->version);
-                if (spec_begin && spec_end) {
-                    char *version_at = strrchr(spec_end, '@');
-                    if (version_at) {
-                        if (strlen(version_at)) {
-                            version_at++;
-                        }
-                        test->version = strdup(version_at);
-                    } else {
-                        test->version = strdup(spec_end);
+
+            // Override test->version when a version is provided by the (pip|conda)_package list item
+            guard_free(test->version);
+            if (spec_begin && spec_end) {
+                char *version_at = strrchr(spec_end, '@');
+                if (version_at) {
+                    if (strlen(version_at)) {
+                        version_at++;
                     }
+                    test->version = strdup(version_at);
                 } else {
-                    // There are too many possible default branches nowadays: master, main, develop, xyz, etc.
-                    // HEAD is a safe bet.
-                    test->version = strdup("HEAD");
+                    test->version = strdup(spec_end);
                 }
+            } else {
+                // There are too many possible default branches nowadays: master, main, develop, xyz, etc.
+                // HEAD is a safe bet.
+                test->version = strdup("HEAD");
+            }
 
-                // Is the list item a git+schema:// URL?
-                // TODO: nametmp is just the name so this will never work. but do we want it to? this looks like
-                // TODO:     an unsafe feature. We shouldn't be able to change what's in the config. we should
-                // TODO:     be getting what we asked for, or exit the program with an error.
-                if (strstr(nametmp, "git+") && strstr(nametmp, "://")) {
-                    char *xrepo = strstr(nametmp, "+");
-                    if (xrepo) {
-                        xrepo++;
-                        guard_free(test->repository);
-                        test->repository = strdup(xrepo);
-                        xrepo = NULL;
-                    }
-                    // Extract the name of the package
-                    char *xbasename = path_basename(nametmp);
-                    if (xbasename) {
-                        // Replace the git+schema:// URL with the package name
-                        strlist_set(&dataptr, i, xbasename);
-                        name = strlist_item(dataptr, i);
-                    }
+            // Is the list item a git+schema:// URL?
+            // TODO: nametmp is just the name so this will never work. but do we want it to? this looks like
+            // TODO:     an unsafe feature. We shouldn't be able to change what's in the config. we should
+            // TODO:     be getting what we asked for, or exit the program with an error.
+            if (strstr(nametmp, "git+") && strstr(nametmp, "://")) {
+                char *xrepo = strstr(nametmp, "+");
+                if (xrepo) {
+                    xrepo++;
+                    guard_free(test->repository);
+                    test->repository = strdup(xrepo);
+                    xrepo = NULL;
                 }
-
-                int upstream_exists = 0;
-                if (DEFER_PIP == type) {
-                    upstream_exists = pkg_index_provides(PKG_USE_PIP, PYPI_INDEX_DEFAULT, name);
-                } else if (DEFER_CONDA == type) {
-                    upstream_exists = pkg_index_provides(PKG_USE_CONDA, NULL, name);
+                // Extract the name of the package
+                char *xbasename = path_basename(nametmp);
+                if (xbasename) {
+                    // Replace the git+schema:// URL with the package name
+                    strlist_set(&dataptr, i, xbasename);
+                    name = strlist_item(dataptr, i);
                 }
+            }
 
-                if (PKG_INDEX_PROVIDES_FAILED(upstream_exists)) {
-                    fprintf(stderr, "%s's existence command failed for '%s': %s\n",
-                            mode, name, pkg_index_provides_strerror(upstream_exists));
-                    exit(1);
-                }
+            strlist_append(&upstream_specs, name);
+            upstream_index[i] = strlist_count(upstream_specs);
+        }
+    }
 
-                if (upstream_exists == PKG_NOT_FOUND) {
-                    build_for_host = 1;
-                } else {
-                    build_for_host = 0;
-                }
+    // Query the upstream index for every tested package at once
+    int *upstream_exists = NULL;
+    const size_t num_upstream = strlist_count(upstream_specs);
+    if (num_upstream) {
+        upstream_exists = calloc(num_upstream, sizeof(*upstream_exists));
+        if (!upstream_exists) {
+            SYSERROR("Unable to allocate memory to check %zu %s packages", num_upstream, mode);
+            exit(1);
+        }
 
-                break;
+        msg(STASIS_MSG_L3, "Checking %zu %s package(s) against upstream index\n", num_upstream, mode);
+        int status = 0;
+        if (DEFER_PIP == type) {
+            status = pkg_index_provides_many(PKG_USE_PIP, PYPI_INDEX_DEFAULT, upstream_specs, upstream_exists, globals.cpu_limit);
+        } else if (DEFER_CONDA == type) {
+            status = pkg_index_provides_many(PKG_USE_CONDA, NULL, upstream_specs, upstream_exists, globals.cpu_limit);
+        }
+        if (status) {
+            fprintf(stderr, "%s's existence check failed\n", mode);
+            exit(1);
+        }
+        if (globals.enable_index_cache) {
+            const struct IndexCacheStats *stats = index_cache_stats();
+            msg(STASIS_MSG_L3, "Index cache: %zu hit(s), %zu miss(es), %zu revalidated, %zu stale\n",
+                stats->hits, stats->misses, stats->revalidated, stats->stale);
+        }
+    }
+
+    // Pass 2: Sort packages by where they will come from
+    for (size_t i = 0; i < num_packages; i++) {
+        int build_for_host = 0;
+
+        name = strlist_item(dataptr, i);
+        if (!strlen(name) || isblank(*name) || isspace(*name)) {
+            // no data
+            continue;
+        }
+
+        if (upstream_index[i]) {
+            const int result = upstream_exists[upstream_index[i] - 1];
+            if (PKG_INDEX_PROVIDES_FAILED(result)) {
+                fprintf(stderr, "%s's existence command failed for '%s': %s\n",
+                        mode, name, pkg_index_provides_strerror(result));
+                exit(1);
             }
+            build_for_host = result == PKG_NOT_FOUND;
         }
 
+        char package_name[255] = {0};
+        const size_t package_name_len = strcspn(name, "@~=<>!");
+        strncpy(package_name, name, package_name_len < sizeof(package_name) ? package_name_len : sizeof(package_name) - 1);
+        remove_extras(package_name);
+        msg(STASIS_MSG_L3, "package '%s': ", package_name);
+
         if (build_for_host) {
             printf("BUILD FOR HOST\n");
             strlist_append(&deferred, name);
@@ -456,6 +499,9 @@ void delivery_defer_packages(struct Delivery *ctx, int type) {
             strlist_append(&filtered, name);
         }
     }
+    guard_free(upstream_exists);
+    guard_free(upstream_index);
+    guard_strlist_free(&upstream_specs);
 
     if (!strlist_count(deferred)) {
         msg(STASIS_MSG_WARN | STASIS_MSG_L2, "No %s packages were filtered by test definitions\n", mode);
@@ -171,13 +171,20 @@ int delivery_mission_render_files(struct Delivery *ctx) {
         }
         fclose(fp);
 
-        msg(STASIS_MSG_L3, "Writing %s\n", data.dest);
-        if (tpl_render_to_file(contents, data.dest)) {
-            guard_free(contents);
+        // The rendered file is streamed to disk token by token
+        struct Template *tpl = tpl_compile(contents);
+        guard_free(contents);
+        if (!tpl) {
+            fprintf(stderr, "Unable to parse template: %s\n", data.src);
             guard_free(data.dest);
             continue;
         }
-        guard_free(contents);
+
+        msg(STASIS_MSG_L3, "Writing %s\n", data.dest);
+        if (tpl_render_compiled_to_file(tpl, data.dest)) {
+            perror(data.dest);
+        }
+        tpl_compiled_free(&tpl);
         guard_free(data.dest);
     }
 
@@ -203,7 +210,7 @@ int delivery_series_sync(struct Delivery *ctx) {
     const char *to_wild[] = {"%r", "%R"};
     for (size_t i = 0; i < sizeof(to_wild) / sizeof(*to_wild); i++) {
         const char *formatter = to_wild[i];
-        if (replace_text(r_fmt, formatter, "*", 0) < 0) {
+        if (replace_text_n(r_fmt, strlen(r_fmt) + 1, formatter, "*", 0) < 0) {
             SYSERROR("Failed to replace '%s' in delivery format string", formatter);
             return -1;
         }
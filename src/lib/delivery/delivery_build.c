@@ -62,11 +62,14 @@ int delivery_build_recipes(struct Delivery *ctx) {
                     // For now, remove the sha256 requirement
                     file_replace_text("meta.yaml", "sha256:", "\n", flags);
                 } else {
-                    file_replace_text("meta.yaml", "{% set version = ", recipe_version, flags);
-                    file_replace_text("meta.yaml", "  url:", recipe_git_url, flags);
-                    //file_replace_text("meta.yaml", "sha256:", recipe_git_rev);
-                    file_replace_text("meta.yaml", "  sha256:", "\n", flags);
-                    file_replace_text("meta.yaml", "  number:", recipe_buildno, flags);
+                    const struct ReplaceRule rules[] = {
+                        {.target = "{% set version = ", .replacement = recipe_version, .flags = flags},
+                        {.target = "  url:", .replacement = recipe_git_url, .flags = flags},
+                        //{.target = "sha256:", .replacement = recipe_git_rev},
+                        {.target = "  sha256:", .replacement = "\n", .flags = flags},
+                        {.target = "  number:", .replacement = recipe_buildno, .flags = flags},
+                    };
+                    file_replace_text_batch("meta.yaml", rules, sizeof(rules) / sizeof(*rules));
                 }
 
                 char command[PATH_MAX];
@@ -146,14 +149,29 @@ int filter_repo_tags(char *repo, struct StrList *patterns) {
     return result;
 }
 
-static int read_without_line_endings(const size_t line, char ** arg) {
+struct WheelPaths {
+    struct StrList *list; ///< Paths of wheels inside the container
+    int failed; ///< A path could not be recorded
+};
+
+static int read_wheel_paths(size_t line, const char *data, size_t len, void *arg) {
     (void) line;
-    if (*arg) {
-        strip(*arg);
-        if (isempty(*arg)) {
-            return 1; // skip
-        }
+    struct WheelPaths *wheel_paths = arg;
+
+    // Remove line endings (docker -t emits "\r\n") and blank lines
+    while (len && isspace((unsigned char) data[len - 1])) {
+        len--;
+    }
+    if (!len) {
+        return 0;
     }
+    char *path = strndup(data, len);
+    if (!path) {
+        SYSERROR("%s", "unable to allocate memory for wheel path");
+        wheel_paths->failed = 1;
+        return -1;
+    }
+    strlist_append_owned(&wheel_paths->list, path);
     return 0;
 }
 
@@ -169,6 +187,7 @@ int manylinux_exec(const char *image, const char *script, const char *copy_to_co
     char *find_command = NULL;
     char *wheel_paths_filename = NULL;
     char *args = NULL;
+    struct WheelPaths wheel_paths = {0};
 
     const uid_t uid = geteuid();
     char suffix[7] = {0};
@@ -247,19 +266,20 @@ int manylinux_exec(const char *image, const char *script, const char *copy_to_co
         goto manylinux_fail;
     }
 
-    struct StrList *wheel_paths = strlist_init();
-    if (!wheel_paths) {
+    wheel_paths.list = strlist_init();
+    if (!wheel_paths.list) {
         SYSERROR("%s", "wheel_paths not initialized");
         goto manylinux_fail;
     }
 
-    if (strlist_append_file(wheel_paths, wheel_paths_filename, read_without_line_endings)) {
+    // A partial list would silently drop wheels
+    if (file_foreach_line(wheel_paths_filename, read_wheel_paths, &wheel_paths) || wheel_paths.failed || !strlist_count(wheel_paths.list)) {
         SYSERROR("%s", "wheel_paths append failed");
         goto manylinux_fail;
     }
 
-    for (size_t i = 0; i < strlist_count(wheel_paths); i++) {
-        const char *item = strlist_item(wheel_paths, i);
+    for (size_t i = 0; i < strlist_count(wheel_paths.list); i++) {
+        const char *item = strlist_item(wheel_paths.list, i);
         if (asprintf(&copy_command, "cp %s:%s %s", container_name, item, copy_to_host_dir) < 0) {
             SYSERROR("%s", "unable to allocate memory for docker copy command");
             goto manylinux_fail;
@@ -313,7 +333,7 @@ int manylinux_exec(const char *image, const char *script, const char *copy_to_co
     guard_free(nop_rm_command);
     guard_free(find_command);
     guard_free(wheel_paths_filename);
-    guard_strlist_free(&wheel_paths);
+    guard_strlist_free(&wheel_paths.list);
     return result;
 }
 
@@ -359,6 +379,34 @@ int delivery_build_wheels_manylinux(struct Delivery *ctx, const char *outdir) {
     return 0;
 }
 
+/**
+ * Restore a checkout to the state delivery_fetch_sources() left it in
+ *
+ * Test scripts run in the same checkout. Anything they modified or generated
+ * (build directories, `*.egg-info`, ...) is discarded, so it cannot end up in
+ * a wheel or make setuptools_scm report a dirty version.
+ *
+ * @param test pointer to Test
+ * @return 0 on success, non-zero on error
+ */
+static int delivery_restore_sources(const struct Test *test) {
+    char cmd[PATH_MAX * 2] = {0};
+    const char *ref = !isempty(test->repository_info_ref) ? test->repository_info_ref : "HEAD";
+
+    if (pushd(test->repository_dir)) {
+        return -1;
+    }
+    snprintf(cmd, sizeof(cmd),
+             "git -c advice.detachedHead=false checkout --quiet --force --detach %s"
+             " && git clean -fdxq"
+             " && git submodule --quiet update --init --recursive --force"
+             " && git submodule --quiet foreach --recursive 'git clean -fdxq'",
+             ref);
+    const int status = system(cmd);
+    popd();
+    return status;
+}
+
 struct StrList *delivery_build_wheels(struct Delivery *ctx) {
     const int on_linux = strcmp(ctx->system.platform[DELIVERY_PLATFORM], "Linux") == 0;
     const int docker_usable = ctx->deploy.docker.capabilities.usable;
@@ -373,7 +421,6 @@ struct StrList *delivery_build_wheels(struct Delivery *ctx) {
     }
 
     struct StrList *result = NULL;
-    struct Process proc = {0};
 
     result = strlist_init();
     if (!result) {
@@ -398,21 +445,18 @@ struct StrList *delivery_build_wheels(struct Delivery *ctx) {
                 memset(srcdir, 0, sizeof(srcdir));
                 memset(wheeldir, 0, sizeof(wheeldir));
 
-                snprintf(srcdir, sizeof(srcdir), "%s/%s", ctx->storage.build_sources_dir, ctx->tests->test[i]->name);
-                if (git_clone(&proc, ctx->tests->test[i]->repository, srcdir, ctx->tests->test[i]->version)) {
+                // Reuse the checkout created by delivery_fetch_sources()
+                if (!ctx->tests->test[i]->repository_dir) {
                     SYSERROR("Unable to checkout tag '%s' for package '%s' from repository '%s'\n",
                     ctx->tests->test[i]->version, ctx->tests->test[i]->name, ctx->tests->test[i]->repository);
                     return NULL;
                 }
-
-                if (!ctx->tests->test[i]->repository_info_tag) {
-                    ctx->tests->test[i]->repository_info_tag = strdup(git_describe(srcdir));
-                }
-                if (!ctx->tests->test[i]->repository_info_ref) {
-                    ctx->tests->test[i]->repository_info_ref = strdup(git_rev_parse(srcdir, ctx->tests->test[i]->version));
-                }
-                if (ctx->tests->test[i]->repository_remove_tags && strlist_count(ctx->tests->test[i]->repository_remove_tags)) {
-                    filter_repo_tags(srcdir, ctx->tests->test[i]->repository_remove_tags);
+                strncpy(srcdir, ctx->tests->test[i]->repository_dir, sizeof(srcdir) - 1);
+                msg(STASIS_MSG_L3, "Restoring sources: %s\n", srcdir);
+                if (delivery_restore_sources(ctx->tests->test[i])) {
+                    SYSERROR("Unable to restore sources for package '%s': %s", ctx->tests->test[i]->name, srcdir);
+                    guard_strlist_free(&result);
+                    return NULL;
                 }
 
                 if (!pushd(srcdir)) {
@@ -64,7 +64,8 @@ void delivery_install_conda(char *install_script, char *conda_install_dir) {
     if (globals.conda_fresh_start) {
         if (!access(conda_install_dir, F_OK)) {
             // directory exists so remove it
-            if (rmtree(conda_install_dir)) {
+            // The new installation does not wait for the old one to be removed
+            if (rmtree_background(conda_install_dir, globals.delete_jobs)) {
                 perror("unable to remove previous installation");
                 exit(1);
             }
@@ -67,7 +67,8 @@ int delivery_docker(struct Delivery *ctx) {
     // Build the image
     char delivery_file[PATH_MAX] = {0};
     char dest[PATH_MAX] = {0};
-    char rsync_cmd[PATH_MAX * 2] = {0};
+    struct TreeSyncOptions sync_opts = {.jobs = globals.copy_jobs, .verbose = globals.verbose};
+    struct TreeSyncStats sync_stats = {0};
     memset(delivery_file, 0, sizeof(delivery_file));
     memset(dest, 0, sizeof(dest));
 
@@ -87,19 +88,17 @@ int delivery_docker(struct Delivery *ctx) {
     snprintf(dest, sizeof(dest), "%s/packages", ctx->storage.build_docker_dir);
 
     msg(STASIS_MSG_L2, "Copying conda packages\n");
-    memset(rsync_cmd, 0, sizeof(rsync_cmd));
-    snprintf(rsync_cmd, sizeof(rsync_cmd), "rsync -avi --progress '%s' '%s'", ctx->storage.conda_artifact_dir, dest);
-    if (system(rsync_cmd)) {
+    if (tree_sync_files((char *[]) {ctx->storage.conda_artifact_dir, NULL}, dest, &sync_opts, &sync_stats)) {
         fprintf(stderr, "Failed to copy conda artifacts to docker build directory\n");
         return -1;
     }
+    tree_sync_show_summary(&sync_stats);
 
     msg(STASIS_MSG_L2, "Copying wheel packages\n");
-    memset(rsync_cmd, 0, sizeof(rsync_cmd));
-    snprintf(rsync_cmd, sizeof(rsync_cmd), "rsync -avi --progress '%s' '%s'", ctx->storage.wheel_artifact_dir, dest);
-    if (system(rsync_cmd)) {
+    if (tree_sync_files((char *[]) {ctx->storage.wheel_artifact_dir, NULL}, dest, &sync_opts, &sync_stats)) {
         fprintf(stderr, "Failed to copy wheel artifacts to docker build directory\n");
     }
+    tree_sync_show_summary(&sync_stats);
 
     if (docker_build(ctx->storage.build_docker_dir, args, ctx->deploy.docker.capabilities.build)) {
         return -1;
@@ -0,0 +1,173 @@
+#include "delivery.h"
+#include "gitcache.h"
+
+/**
+ * Generate the shell script used to clone and check out a test block's repository
+ *
+ * The commands mirror git_clone(), including its use of the git cache
+ *
+ * @param git path to git program
+ * @param test pointer to Test
+ * @param destdir path to checkout
+ * @return pointer to script (caller must free)
+ * @return NULL on error
+ */
+static char *delivery_fetch_script(const char *git, const struct Test *test, const char *destdir) {
+    char *script = NULL;
+    char checkout[PATH_MAX] = {0};
+
+    if (!isempty(test->version)) {
+        snprintf(checkout, sizeof(checkout), "%s checkout \"%s\"\n", git, test->version);
+    }
+
+    char *clone = git_clone_script(git, test->repository, destdir, test->version);
+    if (!clone) {
+        return NULL;
+    }
+
+    // The clone script runs in a subshell because it may change directories
+    if (asprintf(&script,
+                 "set -e\n"
+                 "(\n%s)\n"
+                 "cd \"%s\"\n"
+                 "%s fetch --all\n"
+                 "%s",
+                 clone,
+                 destdir,
+                 git,
+                 checkout) < 0) {
+        script = NULL;
+    }
+    guard_free(clone);
+    return script;
+}
+
+int delivery_fetch_sources(struct Delivery *ctx) {
+    int failures = 0;
+
+    if (!ctx->tests || !ctx->tests->num_used) {
+        return 0;
+    }
+
+    char git[PATH_MAX] = {0};
+    const char *git_found = find_program("git");
+    if (!git_found) {
+        SYSERROR("%s", "git is not installed");
+        return -1;
+    }
+    strncpy(git, git_found, sizeof(git) - 1);
+
+    struct MultiProcessingPool *pool = mp_pool_init("fetch", ctx->storage.tmpdir);
+    if (!pool) {
+        perror("mp_pool_init/fetch");
+        return -1;
+    }
+    pool->status_interval = globals.pool_status_interval;
+
+    struct MultiProcessingTask **task = calloc(ctx->tests->num_used, sizeof(*task));
+    if (!task) {
+        SYSERROR("Unable to allocate fetch task array: %s", strerror(errno));
+        mp_pool_free(&pool);
+        return -1;
+    }
+
+    // Queue one clone per repository. Network and git work is the bulk of the
+    // time spent here, so the tasks are not limited by cpu_limit.
+    for (size_t i = 0; i < ctx->tests->num_used; i++) {
+        struct Test *test = ctx->tests->test[i];
+        if (!test->name || isempty(test->repository)) {
+            continue;
+        }
+
+        char destdir[PATH_MAX];
+        snprintf(destdir, sizeof(destdir), "%s/%s", ctx->storage.build_sources_dir, test->name);
+        guard_free(test->repository_dir);
+
+        if (!access(destdir, F_OK)) {
+            msg(STASIS_MSG_L3, "Purging repository %s\n", destdir);
+            if (rmtree_background(destdir, globals.delete_jobs)) {
+                COE_CHECK_ABORT(1, "Unable to remove repository\n");
+                failures++;
+                continue;
+            }
+        }
+
+        char *script = delivery_fetch_script(git, test, destdir);
+        if (!script) {
+            SYSERROR("Unable to allocate memory for fetch script: %s", strerror(errno));
+            failures++;
+            continue;
+        }
+
+        msg(STASIS_MSG_L3, "Queuing clone of %s\n", test->repository);
+        task[i] = mp_pool_task(pool, test->name, NULL, script);
+        guard_free(script);
+        if (!task[i]) {
+            SYSERROR("Failed to add task to %s pool: %s", pool->ident, test->name);
+            failures++;
+            continue;
+        }
+
+        // Test blocks sharing a repository share a mirror. Only one task may update it at a time.
+        char mirror[PATH_MAX] = {0};
+        if (globals.enable_git_cache
+            && !git_cache_mirror_path(globals.git_cache_dir, test->repository, mirror, sizeof(mirror))) {
+            strncpy(task[i]->group, path_basename(mirror), sizeof(task[i]->group) - 1);
+        }
+    }
+
+    if (pool->num_used) {
+        if (mp_pool_join(pool, globals.fetch_jobs, 0)) {
+            mp_pool_show_summary(pool);
+        }
+    }
+
+    // Record where each repository was checked out. The test and wheel build
+    // phases use these directories instead of cloning again.
+    for (size_t i = 0; i < ctx->tests->num_used; i++) {
+        struct Test *test = ctx->tests->test[i];
+        if (!task[i]) {
+            continue;
+        }
+        if (task[i]->status || task[i]->signaled_by) {
+            SYSERROR("Unable to clone repository '%s' for %s", test->repository, test->name);
+            failures++;
+            continue;
+        }
+
+        char destdir[PATH_MAX];
+        snprintf(destdir, sizeof(destdir), "%s/%s", ctx->storage.build_sources_dir, test->name);
+        git_cache_record(destdir);
+        test->repository_dir = strdup(destdir);
+        if (!test->repository_dir) {
+            SYSERROR("Unable to allocate memory for repository path: %s", strerror(errno));
+            failures++;
+            continue;
+        }
+
+        const char *tag = git_describe(destdir);
+        const char *ref = git_rev_parse(destdir, "HEAD");
+        guard_free(test->repository_info_tag);
+        guard_free(test->repository_info_ref);
+        test->repository_info_tag = tag ? strdup(tag) : NULL;
+        test->repository_info_ref = ref ? strdup(ref) : NULL;
+
+        if (test->repository_remove_tags && strlist_count(test->repository_remove_tags)) {
+            filter_repo_tags(destdir, test->repository_remove_tags);
+        }
+    }
+
+    if (globals.enable_git_cache && !isempty(globals.git_cache_dir)) {
+        // Checkouts do not depend on the mirrors they were cloned from, so it is safe to evict them now
+        if (globals.git_cache_max_size) {
+            git_cache_evict(globals.git_cache_dir, globals.git_cache_max_size * 1024 * 1024);
+        }
+        const struct GitCacheStats *stats = git_cache_stats();
+        msg(STASIS_MSG_L2, "Git cache: %zu hit(s), %zu miss(es), %zu eviction(s)\n",
+            stats->hits, stats->misses, stats->evictions);
+    }
+
+    guard_free(task);
+    mp_pool_free(&pool);
+    return failures;
+}
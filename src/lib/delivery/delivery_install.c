@@ -1,46 +1,19 @@
 #include "delivery.h"
 
-static struct Test *requirement_from_test(struct Delivery *ctx, const char *name) {
-    struct Test *result = NULL;
-    for (size_t i = 0; i < ctx->tests->num_used; i++) {
-        char *package_name = strdup(name);
-        if (package_name) {
-            char *spec = find_version_spec(package_name);
-            if (spec) {
-                *spec = '\0';
-            }
-            remove_extras(package_name);
-
-            if (ctx->tests->test[i]->name && !strcmp(package_name, ctx->tests->test[i]->name)) {
-                result = ctx->tests->test[i];
-                guard_free(package_name);
-                break;
-            }
-            guard_free(package_name);
-        } else {
-            SYSERROR("unable to allocate memory for package name: %s", name);
-            return NULL;
-        }
-    }
-    return result;
-}
-
-static char *have_spec_in_config(const struct Delivery *ctx, const char *name) {
-    for (size_t x = 0; x < strlist_count(ctx->conda.pip_packages); x++) {
-        char *config_spec = strlist_item(ctx->conda.pip_packages, x);
-        char *op = find_version_spec(config_spec);
-        char package[255] = {0};
-        if (op) {
-            strncpy(package, config_spec, op - config_spec);
-        } else {
-            strncpy(package, config_spec, sizeof(package) - 1);
-        }
-        remove_extras(package);
-        if (strncmp(package, name, strlen(name)) == 0) {
-            return config_spec;
-        }
+/**
+ * Find the configured pip spec for a package
+ * @param ctx pointer to Delivery
+ * @param names interned names of ctx->conda.pip_packages
+ * @param config_index maps a name ID to its first record in ctx->conda.pip_packages
+ * @param name package name or spec
+ * @return spec from the configuration, or NULL if the package is not configured
+ */
+static char *have_spec_in_config(const struct Delivery *ctx, const struct PackageNames *names, const size_t *config_index, const char *name) {
+    const ssize_t id = pkgname_lookup(names, name);
+    if (id < 0) {
+        return NULL;
     }
-    return NULL;
+    return strlist_item(ctx->conda.pip_packages, config_index[id]);
 }
 
 int delivery_overlay_packages_from_env(struct Delivery *ctx, const char *env_name) {
@@ -70,6 +43,16 @@ int delivery_overlay_packages_from_env(struct Delivery *ctx, const char *env_nam
     guard_free(freeze_output);
 
     struct StrList *new_list = strlist_init();
+    struct PackageNames *config_names = pkgname_init();
+    size_t *config_index = calloc(strlist_count(ctx->conda.pip_packages) + 1, sizeof(*config_index));
+    if (!config_names || !config_index) {
+        SYSERROR("%s", "Unable to allocate memory for package names");
+        pkgname_free(&config_names);
+        guard_free(config_index);
+        guard_strlist_free(&new_list);
+        guard_strlist_free(&frozen_list);
+        return -1;
+    }
 
     // - consume package specs that have no test blocks.
     // - these will be third-party packages like numpy, scipy, etc.
@@ -77,15 +60,15 @@ int delivery_overlay_packages_from_env(struct Delivery *ctx, const char *env_nam
     //   get installed first.
     for (size_t i = 0; i < strlist_count(ctx->conda.pip_packages); i++) {
         char *spec = strlist_item(ctx->conda.pip_packages, i);
-        char spec_name[255] = {0};
-        char *op = find_version_spec(spec);
-        if (op) {
-            strncpy(spec_name, spec, op - spec);
-        } else {
-            strncpy(spec_name, spec, sizeof(spec_name) - 1);
+
+        // Remember where each package is configured. The first spec wins.
+        const size_t count = config_names->num_used;
+        const ssize_t id = pkgname_intern(config_names, spec);
+        if (id >= 0 && (size_t) id == count) {
+            config_index[id] = i;
         }
 
-        struct Test *test_block = requirement_from_test(ctx, spec_name);
+        struct Test *test_block = tests_find(ctx->tests, spec);
         if (!test_block) {
             msg(STASIS_MSG_L2 | STASIS_MSG_WARN, "from config without test: %s\n", spec);
             strlist_append(&new_list, spec);
@@ -97,17 +80,9 @@ int delivery_overlay_packages_from_env(struct Delivery *ctx, const char *env_nam
     // otherwise, use the spec derived from the environment
     for (size_t i = 0; i < strlist_count(frozen_list); i++) {
         char *frozen_spec = strlist_item(frozen_list, i);
-        char frozen_name[255] = {0};
-        char *op = find_version_spec(frozen_spec);
-        // we only care about packages with specs here. if something else arrives, ignore it
-        if (op) {
-            strncpy(frozen_name, frozen_spec, op - frozen_spec);
-        } else {
-            strncpy(frozen_name, frozen_spec, sizeof(frozen_name) - 1);
-        }
-        struct Test *test = requirement_from_test(ctx, frozen_name);
-        if (test && strcmp(test->name, frozen_name) == 0) {
-            char *config_spec = have_spec_in_config(ctx, frozen_name);
+        struct Test *test = tests_find(ctx->tests, frozen_spec);
+        if (test) {
+            char *config_spec = have_spec_in_config(ctx, config_names, config_index, frozen_spec);
             if (config_spec) {
                 msg(STASIS_MSG_L2, "from config: %s\n", config_spec);
                 strlist_append(&new_list, config_spec);
@@ -123,6 +98,8 @@ int delivery_overlay_packages_from_env(struct Delivery *ctx, const char *env_nam
         guard_strlist_free(&ctx->conda.pip_packages);
         ctx->conda.pip_packages = strlist_copy(new_list);
     }
+    pkgname_free(&config_names);
+    guard_free(config_index);
     guard_strlist_free(&new_list);
     guard_strlist_free(&frozen_list);
     return 0;
@@ -188,6 +165,38 @@ int delivery_purge_packages(struct Delivery *ctx, const char *env_name, int use_
     return status;
 }
 
+/**
+ * Find the best wheel built for a package
+ *
+ * The catalog written by delivery_index_wheel_artifacts() is preferred.
+ * Wheel file names are listed only when the package is not cataloged.
+ *
+ * @param ctx pointer to Delivery
+ * @param name package name
+ * @param to_match a NULL terminated array of patterns
+ * @return pointer to WheelInfo (caller must free with wheelinfo_free())
+ * @return NULL on error, or if no wheel matches
+ */
+static struct WheelInfo *delivery_find_wheel(const struct Delivery *ctx, const char *name, char *to_match[]) {
+    char catalog_file[PATH_MAX];
+    struct WheelInfo *whl = NULL;
+
+    snprintf(catalog_file, sizeof(catalog_file), "%s/%s", ctx->storage.wheel_artifact_dir, WHEEL_CATALOG_FILENAME);
+    if (!access(catalog_file, F_OK)) {
+        struct WheelCatalog *catalog = wheel_catalog_load(catalog_file);
+        if (catalog) {
+            whl = wheelinfo_get_cataloged(catalog, ctx->storage.wheel_artifact_dir, name, to_match, WHEEL_MATCH_ANY);
+            wheel_catalog_free(&catalog);
+        }
+        if (whl) {
+            return whl;
+        }
+        // Wheels that could not be cataloged are still found by name
+        errno = 0;
+    }
+    return wheelinfo_get(ctx->storage.wheel_artifact_dir, name, to_match, WHEEL_MATCH_ANY);
+}
+
 int delivery_install_packages(struct Delivery *ctx, char *conda_install_dir, char *env_name, int type, struct StrList **manifest) {
     char command_base[PATH_MAX];
     const char *env_current = getenv("CONDA_DEFAULT_ENV");
@@ -243,7 +252,7 @@ int delivery_install_packages(struct Delivery *ctx, char *conda_install_dir, cha
                 continue;
             }
             if (INSTALL_PKG_PIP_DEFERRED & type) {
-                struct Test *info = requirement_from_test(ctx, name);
+                struct Test *info = tests_find(ctx->tests, name);
                 if (info) {
                     if (!strcmp(info->version, "HEAD") || is_git_sha(info->version)) {
                         struct StrList *tag_data = strlist_init();
@@ -266,11 +275,11 @@ int delivery_install_packages(struct Delivery *ctx, char *conda_install_dir, cha
                         // equal to the tag; setuptools_scm auto-increments the value, the user can change it manually,
                         // etc.
                         errno = 0;
-                        whl = wheelinfo_get(ctx->storage.wheel_artifact_dir, info->name,
-                                             (char *[]) {ctx->meta.python_compact, ctx->system.arch,
-                                                         "none", "any",
-                                                         post_commit, hash,
-                                                         NULL}, WHEEL_MATCH_ANY);
+                        whl = delivery_find_wheel(ctx, info->name,
+                                                  (char *[]) {ctx->meta.python_compact, ctx->system.arch,
+                                                              "none", "any",
+                                                              post_commit, hash,
+                                                              NULL});
                         if (!whl && errno) {
                             // error
                             SYSERROR("Unable to read Python wheel info: %s\n", strerror(errno));
@@ -175,7 +175,7 @@ static void normalize_ini_list(struct INIFILE **inip, struct StrList **listp, ch
 
     if (data[0] && strpbrk(data[0], " \t")) {
         normalize_space(data[0]);
-        replace_text(data[0], " ", LINE_SEP, 0);
+        replace_text_n(data[0], strlen(data[0]) + 1, " ", LINE_SEP, 0);
         char *replacement = join(data, LINE_SEP);
         ini_setval(&ini, INI_SETVAL_REPLACE, section, key, replacement);
         guard_free(replacement);
@@ -205,7 +205,8 @@ int populate_delivery_ini(struct Delivery *ctx, int render_mode) {
     while ((rtdata = ini_getall(ini, "runtime")) != NULL) {
         runtime_set(rt, rtdata->key, rtdata->value);
     }
-    runtime_apply(rt);
+    // rt is a copy of the global environment. Only the variables set above need to be pushed.
+    runtime_apply_changed(rt);
     ctx->runtime.environ = rt;
 
     int err = 0;
@@ -307,7 +308,11 @@ int populate_delivery_ini(struct Delivery *ctx, int render_mode) {
             test->repository_remove_tags = ini_getval_strlist(ini, section_name, "repository_remove_tags", LINE_SEP, render_mode, &err);
             test->build_recipe = ini_getval_str(ini, section_name, "build_recipe", render_mode, &err);
 
-            test->runtime->environ = ini_getval_strlist(ini, section_name, "runtime", LINE_SEP, render_mode, &err);
+            struct StrList *runtime_list = ini_getval_strlist(ini, section_name, "runtime", LINE_SEP, render_mode, &err);
+            if (runtime_list) {
+                test->runtime->environ = runtime_copy(runtime_list->data);
+                guard_strlist_free(&runtime_list);
+            }
             const char *timeout_str = ini_getval_str(ini, section_name, "timeout", render_mode, &err);
             if (timeout_str) {
                 test->timeout = str_to_timeout((char *) timeout_str);
@@ -1,3 +1,4 @@
+#include <glob.h>
 #include "delivery.h"
 
 
@@ -61,6 +62,9 @@ int delivery_dump_metadata(struct Delivery *ctx) {
     fprintf(fp, "conda_installer_version %s\n", ctx->conda.installer_version);
     fprintf(fp, "conda_installer_platform %s\n", ctx->conda.installer_platform);
     fprintf(fp, "conda_installer_arch %s\n", ctx->conda.installer_arch);
+    for (size_t i = 0; i < strlist_count(ctx->conda.wheels_verified); i++) {
+        fprintf(fp, "wheel_verified %s\n", strlist_item(ctx->conda.wheels_verified, i));
+    }
 
     fclose(fp);
     return 0;
@@ -133,7 +137,7 @@ void delivery_rewrite_spec(struct Delivery *ctx, char *filename, unsigned stage)
         SYSDEBUG("Done writing temporary file: %s", tempfile);
 
         // Replace the original file with our temporary data
-        if (copy2(tempfile, filename, CT_PERM) < 0) {
+        if (copy2(tempfile, filename, CT_PERM | CT_ATOMIC) < 0) {
             fprintf(stderr, "%s: could not rename '%s' to '%s'\n", strerror(errno), tempfile, filename);
             exit(1);
         }
@@ -143,43 +147,46 @@ void delivery_rewrite_spec(struct Delivery *ctx, char *filename, unsigned stage)
     } else if (globals.enable_rewrite_spec_stage_2 && stage == DELIVERY_REWRITE_SPEC_STAGE_2) {
         SYSDEBUG("%s", "Entering stage 2");
         char output[PATH_MAX] = {0};
+        char pip_arguments[PATH_MAX] = {0};
+        const char *conda_channel = NULL;
         // Replace "local" channel with the staging URL
         if (ctx->storage.conda_staging_url) {
             SYSDEBUG("%s", "Will replace conda channel with staging area url");
-            file_replace_text(filename, "@CONDA_CHANNEL@", ctx->storage.conda_staging_url, 0);
+            conda_channel = ctx->storage.conda_staging_url;
         } else if (globals.jfrog.repo) {
             SYSDEBUG("%s", "Will replace conda channel with artifactory repo packages/conda url");
             snprintf(output, sizeof(output), "%s/%s/%s/%s/packages/conda", globals.jfrog.url, globals.jfrog.repo, ctx->meta.mission, ctx->info.build_name);
-            file_replace_text(filename, "@CONDA_CHANNEL@", output, 0);
+            conda_channel = output;
         } else {
             SYSDEBUG("%s", "Will replace conda channel with local conda artifact directory");
             msg(STASIS_MSG_WARN, "conda_staging_dir is not configured. Using fallback: '%s'\n", ctx->storage.conda_artifact_dir);
-            file_replace_text(filename, "@CONDA_CHANNEL@", ctx->storage.conda_artifact_dir, 0);
+            conda_channel = ctx->storage.conda_artifact_dir;
         }
 
         if (ctx->storage.wheel_staging_url) {
             SYSDEBUG("%s", "Will replace pip arguments with wheel staging url");
-            snprintf(output, sizeof(output), "--extra-index-url %s/%s/%s/packages/wheels", ctx->storage.wheel_staging_url, ctx->meta.mission, ctx->info.build_name);
-            file_replace_text(filename, "@PIP_ARGUMENTS@", ctx->storage.wheel_staging_url, 0);
+            strncpy(pip_arguments, ctx->storage.wheel_staging_url, sizeof(pip_arguments) - 1);
         } else if (globals.enable_artifactory && globals.jfrog.url && globals.jfrog.repo) {
             SYSDEBUG("%s", "Will replace pip arguments with artifactory repo packages/wheel url");
-            snprintf(output, sizeof(output), "--extra-index-url %s/%s/%s/%s/packages/wheels", globals.jfrog.url, globals.jfrog.repo, ctx->meta.mission, ctx->info.build_name);
-            file_replace_text(filename, "@PIP_ARGUMENTS@", output, 0);
+            snprintf(pip_arguments, sizeof(pip_arguments), "--extra-index-url %s/%s/%s/%s/packages/wheels", globals.jfrog.url, globals.jfrog.repo, ctx->meta.mission, ctx->info.build_name);
         } else {
             SYSDEBUG("%s", "Will replace pip arguments with local wheel artifact directory");
             msg(STASIS_MSG_WARN, "wheel_staging_dir is not configured. Using fallback: '%s'\n", ctx->storage.wheel_artifact_dir);
-            snprintf(output, sizeof(output), "--extra-index-url file://%s", ctx->storage.wheel_artifact_dir);
-            file_replace_text(filename, "@PIP_ARGUMENTS@", output, 0);
+            snprintf(pip_arguments, sizeof(pip_arguments), "--extra-index-url file://%s", ctx->storage.wheel_artifact_dir);
         }
+
+        const struct ReplaceRule rules[] = {
+            {.target = "@CONDA_CHANNEL@", .replacement = conda_channel ? conda_channel : ""},
+            {.target = "@PIP_ARGUMENTS@", .replacement = pip_arguments},
+        };
+        file_replace_text_batch(filename, rules, sizeof(rules) / sizeof(*rules));
     }
     SYSDEBUG("%s", "Rewriting finished");
 }
 
 int delivery_copy_conda_artifacts(struct Delivery *ctx) {
-    char cmd[STASIS_BUFSIZ];
     char conda_build_dir[PATH_MAX];
     char subdir[PATH_MAX];
-    memset(cmd, 0, sizeof(cmd));
     memset(conda_build_dir, 0, sizeof(conda_build_dir));
     memset(subdir, 0, sizeof(subdir));
 
@@ -192,12 +199,18 @@ int delivery_copy_conda_artifacts(struct Delivery *ctx) {
         return 0;
     }
 
-    snprintf(cmd, sizeof(cmd), "rsync -avi --progress %s/%s %s",
-             conda_build_dir,
-             ctx->system.platform[DELIVERY_PLATFORM_CONDA_SUBDIR],
-             ctx->storage.conda_artifact_dir);
+    if (snprintf(subdir, sizeof(subdir), "%s/%s",
+                 conda_build_dir,
+                 ctx->system.platform[DELIVERY_PLATFORM_CONDA_SUBDIR]) >= (int) sizeof(subdir)) {
+        SYSERROR("Path is too long: %s", conda_build_dir);
+        return -1;
+    }
 
-    return system(cmd);
+    struct TreeSyncOptions opts = {.jobs = globals.copy_jobs, .verbose = globals.verbose};
+    struct TreeSyncStats stats = {0};
+    const int status = tree_sync_files((char *[]) {subdir, NULL}, ctx->storage.conda_artifact_dir, &opts, &stats);
+    tree_sync_show_summary(&stats);
+    return status;
 }
 
 int delivery_index_conda_artifacts(struct Delivery *ctx) {
@@ -205,82 +218,69 @@ int delivery_index_conda_artifacts(struct Delivery *ctx) {
 }
 
 int delivery_copy_wheel_artifacts(struct Delivery *ctx) {
-    char cmd[PATH_MAX] = {0};
-    snprintf(cmd, sizeof(cmd), "rsync -avi --progress %s/*/dist/*.whl %s",
-             ctx->storage.build_sources_dir,
-             ctx->storage.wheel_artifact_dir);
-    return system(cmd);
-}
-
-int delivery_index_wheel_artifacts(struct Delivery *ctx) {
-    struct dirent *rec;
+    char pattern[PATH_MAX] = {0};
+    glob_t wheels = {0};
+    snprintf(pattern, sizeof(pattern), "%s/*/dist/*.whl", ctx->storage.build_sources_dir);
 
-    DIR *dp = opendir(ctx->storage.wheel_artifact_dir);
-    if (!dp) {
+    if (glob(pattern, 0, NULL, &wheels)) {
+        fprintf(stderr, "No wheels found: %s\n", pattern);
+        globfree(&wheels);
         return -1;
     }
 
-    // Generate a "dumb" local pypi index that is compatible with:
-    // pip install --extra-index-url
-    char top_index[PATH_MAX] = {0};
-    snprintf(top_index, sizeof(top_index),"%s/index.html", ctx->storage.wheel_artifact_dir);
-    SYSDEBUG("Opening top-level index for writing: %s", top_index);
-    FILE *top_fp = fopen(top_index, "w+");
-    if (!top_fp) {
-        closedir(dp);
-        return -2;
-    }
+    struct TreeSyncOptions opts = {.jobs = globals.copy_jobs, .verbose = globals.verbose};
+    struct TreeSyncStats stats = {0};
+    const int status = tree_sync_files(wheels.gl_pathv, ctx->storage.wheel_artifact_dir, &opts, &stats);
+    tree_sync_show_summary(&stats);
+    globfree(&wheels);
+    return status;
+}
 
-    while ((rec = readdir(dp)) != NULL) {
-        // skip directories
-        if (DT_REG == rec->d_type || !strcmp(rec->d_name, "..") || !strcmp(rec->d_name, ".")) {
-            continue;
-        }
+static int delivery_verify_wheel(size_t index, void *arg) {
+    char **paths = arg;
+    return wheel_verify_records(paths[index]) != 0;
+}
 
-        char bottom_index[PATH_MAX * 2] = {0};
-        snprintf(bottom_index, sizeof(bottom_index), "%s/%s/index.html", ctx->storage.wheel_artifact_dir, rec->d_name);
-        SYSDEBUG("Opening bottom-level for writing: %s", bottom_index);
-        FILE *bottom_fp = fopen(bottom_index, "w+");
-        if (!bottom_fp) {
-            closedir(dp);
-            return -3;
-        }
+int delivery_verify_wheel_artifacts(struct Delivery *ctx) {
+    char pattern[PATH_MAX] = {0};
+    glob_t found = {0};
 
-        if (globals.verbose) {
-            printf("+ %s\n", rec->d_name);
-        }
-        // Add record to top level index
-        SYSDEBUG("Appending top-level link for %s", rec->d_name);
-        fprintf(top_fp, "<a href=\"%s/\">%s</a><br/>\n", rec->d_name, rec->d_name);
+    snprintf(pattern, sizeof(pattern), "%s/*/*.whl", ctx->storage.wheel_artifact_dir);
+    const int status = glob(pattern, 0, NULL, &found);
+    if (status && status != GLOB_NOMATCH) {
+        SYSERROR("Unable to list wheels: %s", pattern);
+        return -1;
+    }
 
-        char dpath[PATH_MAX * 2] = {0};
-        snprintf(dpath, sizeof(dpath), "%s/%s", ctx->storage.wheel_artifact_dir, rec->d_name);
-        struct StrList *packages = listdir(dpath);
-        if (!packages) {
-            closedir(dp);
-            fclose(top_fp);
-            fclose(bottom_fp);
-            return -4;
+    const ssize_t failed = mp_parallel_for(found.gl_pathc, globals.scan_jobs, delivery_verify_wheel, found.gl_pathv);
+    if (failed) {
+        if (failed > 0) {
+            msg(STASIS_MSG_ERROR | STASIS_MSG_L2, "%zd wheel(s) do not match their RECORD\n", failed);
         }
+        globfree(&found);
+        return -1;
+    }
 
-        for (size_t i = 0; i < strlist_count(packages); i++) {
-            char *package = path_basename(strlist_item(packages, i));
-            if (!endswith(package, ".whl")) {
-                continue;
-            }
-            if (globals.verbose) {
-                printf("`- %s\n", package);
-            }
-            // Write record to bottom level index
-            SYSDEBUG("Appending bottom-level link for %s", package);
-            fprintf(bottom_fp, "<a href=\"%s\">%s</a><br/>\n", package, package);
-        }
-        fclose(bottom_fp);
+    guard_strlist_free(&ctx->conda.wheels_verified);
+    ctx->conda.wheels_verified = strlist_init();
+    for (size_t i = 0; i < found.gl_pathc; i++) {
+        strlist_append(&ctx->conda.wheels_verified, found.gl_pathv[i] + strlen(ctx->storage.wheel_artifact_dir) + 1);
+    }
+    globfree(&found);
+    SYSDEBUG("%s", "Wheel verification complete");
+    return 0;
+}
 
-        guard_strlist_free(&packages);
+int delivery_index_wheel_artifacts(struct Delivery *ctx) {
+    // Generate a local pypi index that is compatible with:
+    // pip install --extra-index-url
+    const ssize_t unreadable = wheel_index_build(ctx->storage.wheel_artifact_dir, globals.scan_jobs);
+    if (unreadable < 0) {
+        return -1;
+    }
+    if (unreadable) {
+        msg(STASIS_MSG_WARN | STASIS_MSG_L2, "%zd wheel(s) left out of the index in %s\n", unreadable, ctx->storage.wheel_artifact_dir);
     }
-    closedir(dp);
-    fclose(top_fp);
     SYSDEBUG("%s", "Wheel indexing complete");
     return 0;
 }
@@ -97,7 +97,10 @@ void delivery_tests_show(struct Delivery *ctx) {
 void delivery_runtime_show(struct Delivery *ctx) {
     printf("\n====RUNTIME====\n");
     struct StrList *rt = NULL;
-    rt = strlist_copy(ctx->runtime.environ);
+    if (ctx->runtime.environ) {
+        rt = strlist_init();
+        strlist_append_array(rt, ctx->runtime.environ->data);
+    }
     if (!rt) {
         // no data
         return;
@@ -18,16 +18,18 @@ struct Tests *tests_init(const size_t num_tests) {
 
 int tests_add(struct Tests *tests, struct Test *x) {
     if (tests->num_used >= tests->num_alloc) {
-#ifdef DEBUG
         const size_t old_alloc = tests->num_alloc;
-#endif
-        struct Test **tmp = realloc(tests->test, tests->num_alloc++ * sizeof(**tests->test));
-        SYSDEBUG("Increasing size of test array: %zu -> %zu", old_alloc, tests->num_alloc);
+        const size_t num_alloc = old_alloc ? old_alloc * 2 : TEST_NUM_ALLOC_INITIAL;
+        struct Test **tmp = realloc(tests->test, num_alloc * sizeof(*tests->test));
+        SYSDEBUG("Increasing size of test array: %zu -> %zu", old_alloc, num_alloc);
         if (!tmp) {
-            SYSDEBUG("Failed to allocate %zu bytes for test array", tests->num_alloc * sizeof(**tests->test));
+            SYSDEBUG("Failed to allocate %zu bytes for test array", num_alloc * sizeof(*tests->test));
             return -1;
         }
+        // tests_free() visits every record
+        memset(tmp + old_alloc, 0, (num_alloc - old_alloc) * sizeof(*tmp));
         tests->test = tmp;
+        tests->num_alloc = num_alloc;
     }
 
     SYSDEBUG("Adding test: '%s'", x->name);
@@ -35,6 +37,58 @@ int tests_add(struct Tests *tests, struct Test *x) {
     return 0;
 }
 
+/**
+ * Add tests to the name index
+ *
+ * Tests are indexed on first use, so records added by tests_add() or
+ * assigned directly are both found.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int tests_index_update(struct Tests *tests) {
+    if (!tests->names) {
+        tests->names = pkgname_init();
+        if (!tests->names) {
+            return -1;
+        }
+    }
+    if (tests->num_indexed >= tests->num_used) {
+        return 0;
+    }
+
+    // A name ID is never larger than the number of tests interned before it
+    struct Test **tmp = realloc(tests->by_name, tests->num_used * sizeof(*tests->by_name));
+    if (!tmp) {
+        return -1;
+    }
+    tests->by_name = tmp;
+
+    for (; tests->num_indexed < tests->num_used; tests->num_indexed++) {
+        struct Test *test = tests->test[tests->num_indexed];
+        if (!test || !test->name) {
+            continue;
+        }
+        const size_t count = tests->names->num_used;
+        const ssize_t id = pkgname_intern(tests->names, test->name);
+        if (id >= 0 && (size_t) id == count) {
+            // The first test block with this name wins
+            tests->by_name[id] = test;
+        }
+    }
+    return 0;
+}
+
+struct Test *tests_find(struct Tests *tests, const char *spec) {
+    if (!tests || !spec || tests_index_update(tests)) {
+        return NULL;
+    }
+    const ssize_t id = pkgname_lookup(tests->names, spec);
+    if (id < 0) {
+        return NULL;
+    }
+    return tests->by_name[id];
+}
+
 struct Test *test_init() {
     struct Test *result = calloc(1, sizeof(*result));
     if (!result) {
@@ -59,6 +113,7 @@ void test_free(struct Test **x) {
     guard_free(test->repository);
     guard_free(test->repository_info_ref);
     guard_free(test->repository_info_tag);
+    guard_free(test->repository_dir);
     guard_strlist_free(&test->repository_remove_tags);
     guard_free(test->script);
     guard_free(test->script_setup);
@@ -78,16 +133,73 @@ void tests_free(struct Tests **x) {
     for (size_t i = 0; i < tests->num_alloc; i++) {
         test_free(&tests->test[i]);
     }
+    pkgname_free(&tests->names);
+    guard_free(tests->by_name);
     guard_free(tests->test);
     guard_free(tests);
 }
 
+/**
+ * Render a test block script and wrap it for execution by a pool task
+ *
+ * @param script the script text
+ * @return pointer to the runner command (caller must free)
+ * @return NULL on error
+ */
+static char *delivery_test_runner_cmd(const char *script) {
+    // Test block scripts shall exit non-zero on error.
+    // This will fail a test block immediately if "string" is not found in file.txt:
+    //      grep string file.txt
+    //
+    // And this is how to avoid that scenario:
+    // #1:
+    //      if ! grep string file.txt; then
+    //          # handle error
+    //      fi
+    //
+    //  #2:
+    //      grep string file.txt || handle error
+    //
+    //  #3:
+    //      # Use ':' as a NO-OP if/when the result doesn't matter
+    //      grep string file.txt || :
+    const char *runner_cmd_fmt = "set -e -x\n%s\n";
+
+    const size_t cmd_len = strlen(script) + STASIS_BUFSIZ;
+    char *cmd = calloc(cmd_len, sizeof(*cmd));
+    if (!cmd) {
+        SYSERROR("Unable to allocate test script buffer: %s", strerror(errno));
+        return NULL;
+    }
+
+    strncpy(cmd, script, cmd_len - 1);
+    char *cmd_rendered = tpl_render(cmd);
+    if (cmd_rendered) {
+        if (strcmp(cmd_rendered, cmd) != 0) {
+            strncpy(cmd, cmd_rendered, cmd_len - 1);
+            cmd[strlen(cmd_rendered) ? strlen(cmd_rendered) - 1 : 0] = 0;
+        }
+        guard_free(cmd_rendered);
+    } else {
+        SYSERROR("An error occurred while rendering the following:\n%s", cmd);
+        guard_free(cmd);
+        return NULL;
+    }
+    // Move indents
+    // HEREDOCs will not work otherwise
+    unindent(cmd);
+
+    char *runner_cmd = NULL;
+    if (asprintf(&runner_cmd, runner_cmd_fmt, cmd) < 0) {
+        SYSERROR("Unable to allocate memory for runner command: %s", strerror(errno));
+        runner_cmd = NULL;
+    }
+    guard_free(cmd);
+    return runner_cmd;
+}
+
 void delivery_tests_run(struct Delivery *ctx) {
-    static const int SETUP = 0;
-    static const int PARALLEL = 1;
-    static const int SERIAL = 2;
-    struct MultiProcessingPool *pool[3];
-    struct Process proc = {0};
+    struct MultiProcessingPool *pool;
 
     if (!globals.workaround.conda_reactivate) {
         globals.workaround.conda_reactivate = calloc(PATH_MAX, sizeof(*globals.workaround.conda_reactivate));
@@ -101,47 +213,23 @@ void delivery_tests_run(struct Delivery *ctx) {
     if (!ctx->tests || !ctx->tests->num_used) {
         msg(STASIS_MSG_WARN | STASIS_MSG_L2, "no tests are defined!\n");
     } else {
-        pool[PARALLEL] = mp_pool_init("parallel", ctx->storage.tmpdir);
-        if (!pool[PARALLEL]) {
-            perror("mp_pool_init/parallel");
-            exit(1);
-        }
-        pool[PARALLEL]->status_interval = globals.pool_status_interval;
-
-        pool[SERIAL] = mp_pool_init("serial", ctx->storage.tmpdir);
-        if (!pool[SERIAL]) {
-            perror("mp_pool_init/serial");
+        // Task output is streamed to the console. Compressed copies are only kept on request.
+        const char *log_root = globals.enable_task_log_archive ? ctx->storage.results_dir : ctx->storage.tmpdir;
+
+        // All test blocks share one pool. Ordering is expressed per package instead of per phase:
+        //  - A package's "script" waits for its own "script_setup" to succeed
+        //  - "script_setup" tasks never overlap each other (they modify the shared environment)
+        //  - Non-parallel "script" tasks never overlap each other
+        // Everything else runs as soon as a slot is free.
+        pool = mp_pool_init("tests", log_root);
+        if (!pool) {
+            perror("mp_pool_init/tests");
             exit(1);
         }
-        pool[SERIAL]->status_interval = globals.pool_status_interval;
+        pool->status_interval = globals.pool_status_interval;
+        pool->log_keep = globals.enable_task_log_archive;
 
-        pool[SETUP] = mp_pool_init("setup", ctx->storage.tmpdir);
-        if (!pool[SETUP]) {
-            perror("mp_pool_init/setup");
-            exit(1);
-        }
-        pool[SETUP]->status_interval = globals.pool_status_interval;
-
-        // Test block scripts shall exit non-zero on error.
-        // This will fail a test block immediately if "string" is not found in file.txt:
-        //      grep string file.txt
-        //
-        // And this is how to avoid that scenario:
-        // #1:
-        //      if ! grep string file.txt; then
-        //          # handle error
-        //      fi
-        //
-        //  #2:
-        //      grep string file.txt || handle error
-        //
-        //  #3:
-        //      # Use ':' as a NO-OP if/when the result doesn't matter
-        //      grep string file.txt || :
-        const char *runner_cmd_fmt = "set -e -x\n%s\n";
-
-        // Iterate over our test records, retrieving the source code for each package, and assigning its scripted tasks
-        // to the appropriate processing pool
+        // Iterate over our test records, queuing the scripted tasks for each package's checkout
         for (size_t i = 0; i < ctx->tests->num_used; i++) {
             struct Test *test = ctx->tests->test[i];
             if (!test->name && !test->repository && !test->script) {
@@ -155,26 +243,13 @@ void delivery_tests_run(struct Delivery *ctx) {
                 continue;
             }
 
-            char destdir[PATH_MAX];
-            snprintf(destdir, sizeof(destdir), "%s/%s", ctx->storage.build_sources_dir, path_basename(test->repository));
-
-            if (!access(destdir, F_OK)) {
-                msg(STASIS_MSG_L3, "Purging repository %s\n", destdir);
-                if (rmtree(destdir)) {
-                    COE_CHECK_ABORT(1, "Unable to remove repository\n");
-                }
-            }
-            msg(STASIS_MSG_L3, "Cloning repository %s\n", test->repository);
-            if (!git_clone(&proc, test->repository, destdir, test->version)) {
-                test->repository_info_tag = strdup(git_describe(destdir));
-                test->repository_info_ref = strdup(git_rev_parse(destdir, "HEAD"));
-            } else {
+            // The repository was cloned by delivery_fetch_sources()
+            if (!test->repository_dir) {
+                msg(STASIS_MSG_ERROR | STASIS_MSG_L3, "Repository is not available: %s\n", test->repository);
                 COE_CHECK_ABORT(1, "Unable to clone repository\n");
+                continue;
             }
-
-            if (test->repository_remove_tags && strlist_count(test->repository_remove_tags)) {
-                filter_repo_tags(destdir, test->repository_remove_tags);
-            }
+            const char *destdir = test->repository_dir;
 
             if (pushd(destdir)) {
                 COE_CHECK_ABORT(1, "Unable to enter repository directory\n");
@@ -191,54 +266,48 @@ void delivery_tests_run(struct Delivery *ctx) {
                     COE_CHECK_ABORT(dep_status, "Unreproducible delivery");
                 }
 
-                char *cmd = calloc(strlen(test->script) + STASIS_BUFSIZ, sizeof(*cmd));
-                if (!cmd) {
-                    SYSERROR("Unable to allocate test script buffer: %s", strerror(errno));
-                    exit(1);
-                }
+                struct MultiProcessingTask *setup_task = NULL;
+                if (test->script_setup) {
+                    msg(STASIS_MSG_L3, "Queuing setup task for %s\n", test->name);
+                    char *runner_cmd = delivery_test_runner_cmd(test->script_setup);
+                    if (!runner_cmd) {
+                        exit(1);
+                    }
 
-                msg(STASIS_MSG_L3, "Queuing task for %s\n", test->name);
-                memset(&proc, 0, sizeof(proc));
-
-                strncpy(cmd, test->script, strlen(test->script) + STASIS_BUFSIZ - 1);
-                char *cmd_rendered = tpl_render(cmd);
-                if (cmd_rendered) {
-                    if (strcmp(cmd_rendered, cmd) != 0) {
-                        strncpy(cmd, cmd_rendered, strlen(test->script) + STASIS_BUFSIZ - 1);
-                        cmd[strlen(cmd_rendered) ? strlen(cmd_rendered) - 1 : 0] = 0;
+                    char ident[sizeof(setup_task->ident)] = {0};
+                    snprintf(ident, sizeof(ident), "%s:setup", test->name);
+                    setup_task = mp_pool_task(pool, ident, (char *) destdir, runner_cmd);
+                    if (!setup_task) {
+                        SYSERROR("Failed to add task %s to %s pool: %s", ident, pool->ident, runner_cmd);
+                        popd();
+                        if (!globals.continue_on_error) {
+                            guard_free(runner_cmd);
+                            tpl_free();
+                            delivery_free(ctx);
+                            globals_free();
+                        }
+                        exit(1);
                     }
-                    guard_free(cmd_rendered);
-                } else {
-                    SYSERROR("An error occurred while rendering the following:\n%s", cmd);
-                    exit(1);
+                    strncpy(setup_task->group, "setup", sizeof(setup_task->group) - 1);
+                    guard_free(runner_cmd);
                 }
-                // Move indents
-                // HEREDOCs will not work otherwise
-                unindent(cmd);
 
                 if (test->disable) {
                     msg(STASIS_MSG_L2, "Script execution disabled by configuration\n", test->name);
-                    guard_free(cmd);
+                    popd();
                     continue;
                 }
 
-                char *runner_cmd = NULL;
-                char pool_name[100] = "parallel";
-                struct MultiProcessingTask *task = NULL;
-                int selected = PARALLEL;
-                if (!globals.enable_parallel || !test->parallel) {
-                    selected = SERIAL;
-                    memset(pool_name, 0, sizeof(pool_name));
-                    strncpy(pool_name, "serial", sizeof(pool_name) - 1);
-                }
+                msg(STASIS_MSG_L3, "Queuing task for %s\n", test->name);
 
-                if (asprintf(&runner_cmd, runner_cmd_fmt, cmd) < 0) {
-                    SYSERROR("Unable to allocate memory for runner command: %s", strerror(errno));
+                char *runner_cmd = delivery_test_runner_cmd(test->script);
+                if (!runner_cmd) {
                     exit(1);
                 }
-                task = mp_pool_task(pool[selected], test->name, destdir, runner_cmd);
+
+                struct MultiProcessingTask *task = mp_pool_task(pool, test->name, (char *) destdir, runner_cmd);
                 if (!task) {
-                    SYSERROR("Failed to add task to %s pool: %s", pool_name, runner_cmd);
+                    SYSERROR("Failed to add task to %s pool: %s", pool->ident, runner_cmd);
                     popd();
                     if (!globals.continue_on_error) {
                         guard_free(runner_cmd);
@@ -249,77 +318,18 @@ void delivery_tests_run(struct Delivery *ctx) {
                     exit(1);
                 }
 
+                task->depends_on = setup_task;
+                if (!globals.enable_parallel || !test->parallel) {
+                    strncpy(task->group, "serial", sizeof(task->group) - 1);
+                }
+
                 // Apply timeout from test block
                 if (test->timeout) {
                     task->timeout = test->timeout;
                 }
 
                 guard_free(runner_cmd);
-                guard_free(cmd);
                 popd();
-
-            }
-        }
-
-        // Configure "script_setup" tasks
-        // Directories should exist now, so no need to go through initializing everything all over again.
-        for (size_t i = 0; i < ctx->tests->num_used; i++) {
-            const struct Test *test = ctx->tests->test[i];
-            if (test->script_setup) {
-                char destdir[PATH_MAX];
-                snprintf(destdir, sizeof(destdir), "%s/%s", ctx->storage.build_sources_dir, path_basename(test->repository));
-                if (access(destdir, F_OK)) {
-                    SYSERROR("%s: %s", destdir, strerror(errno));
-                    exit(1);
-                }
-                if (!pushd(destdir)) {
-                    const size_t cmd_len = strlen(test->script_setup) + STASIS_BUFSIZ;
-                    char *cmd = calloc(cmd_len, sizeof(*cmd));
-                    if (!cmd) {
-                        SYSERROR("Unable to allocate test script_setup buffer: %s", strerror(errno));
-                        exit(1);
-                    }
-
-                    strncpy(cmd, test->script_setup, cmd_len - 1);
-                    char *cmd_rendered = tpl_render(cmd);
-                    if (cmd_rendered) {
-                        if (strcmp(cmd_rendered, cmd) != 0) {
-                            strncpy(cmd, cmd_rendered, cmd_len - 1);
-                            cmd[strlen(cmd_rendered) ? strlen(cmd_rendered) - 1 : 0] = 0;
-                        }
-                        guard_free(cmd_rendered);
-                    } else {
-                        SYSERROR("An error occurred while rendering the following:\n%s", cmd);
-                        exit(1);
-                    }
-                    unindent(cmd);
-
-                    struct MultiProcessingTask *task = NULL;
-                    char *runner_cmd = NULL;
-                    if (asprintf(&runner_cmd, runner_cmd_fmt, cmd) < 0) {
-                        SYSERROR("Unable to allocate memory for runner command: %s", strerror(errno));
-                        exit(1);
-                    }
-
-                    task = mp_pool_task(pool[SETUP], test->name, destdir, runner_cmd);
-                    if (!task) {
-                        SYSERROR("Failed to add task %s to setup pool: %s", test->name, runner_cmd);
-                        popd();
-                        if (!globals.continue_on_error) {
-                            guard_free(runner_cmd);
-                            tpl_free();
-                            delivery_free(ctx);
-                            globals_free();
-                        }
-                        exit(1);
-                    }
-                    guard_free(runner_cmd);
-                    guard_free(cmd);
-                    popd();
-                } else {
-                    SYSERROR("Failed to change directory: %s\n", destdir);
-                    exit(1);
-                }
             }
         }
 
@@ -329,40 +339,24 @@ void delivery_tests_run(struct Delivery *ctx) {
         }
 
         // Execute all queued tasks
-        for (size_t p = 0; p < sizeof(pool) / sizeof(*pool); p++) {
-            long jobs = globals.cpu_limit;
-
-            if (!pool[p]->num_used) {
-                // Skip empty pool
-                continue;
-            }
-
-            // Setup tasks run sequentially
-            if (p == (size_t) SETUP || p == (size_t) SERIAL) {
-                jobs = 1;
-            }
+        long jobs = globals.cpu_limit;
+        if (!globals.enable_parallel) {
+            jobs = 1;
+        }
 
-            // Run tasks in the pool
-            // 1. Setup (builds)
-            // 2. Parallel (fast jobs)
-            // 3. Serial (long jobs)
-            int pool_status = mp_pool_join(pool[p], jobs, opt_flags);
+        if (pool->num_used) {
+            int pool_status = mp_pool_join(pool, jobs, opt_flags);
 
-            // On error show a summary of the current pool, and die
+            // On error show a summary of the pool, and die
             if (pool_status != 0) {
-                mp_pool_show_summary(pool[p]);
+                mp_pool_show_summary(pool);
                 COE_CHECK_ABORT(true, "Task failure");
+            } else {
+                // All tasks were successful
+                mp_pool_show_summary(pool);
             }
         }
-
-        // All tasks were successful
-        for (size_t p = 0; p < sizeof(pool) / sizeof(*pool); p++) {
-            if (pool[p]->num_used) {
-                // Only show pools that actually had jobs to run
-                mp_pool_show_summary(pool[p]);
-            }
-            mp_pool_free(&pool[p]);
-        }
+        mp_pool_free(&pool);
     }
 }
 
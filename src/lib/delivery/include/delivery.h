@@ -17,8 +17,12 @@
 #include "environment.h"
 #include "ini.h"
 #include "multiprocessing.h"
+#include "pkgname.h"
 #include "recipe.h"
+#include "treesync.h"
 #include "wheel.h"
+#include "wheelcatalog.h"
+#include "wheelindex.h"
 #include "wheelinfo.h"
 #include "environment.h"
 
@@ -63,6 +67,7 @@ struct Test {
     char *build_recipe;             ///< Conda recipe to build (optional)
     char *repository_info_ref;      ///< Git commit hash
     char *repository_info_tag;      ///< Git tag (first parent)
+    char *repository_dir;           ///< Path to local checkout (populated by delivery_fetch_sources)
     struct StrList *repository_remove_tags;   ///< Git tags to remove (to fix duplicate commit tags)
     struct Runtime *runtime;         ///< Environment variables specific to the test context
     int timeout;                    ///< Timeout in seconds
@@ -168,6 +173,7 @@ struct Delivery {
         struct StrList *pip_packages_defer;     ///< Python packages to be built for delivery
         struct StrList *pip_packages_purge;     ///< Python packages to remove from a delivery (for: based_on)
         struct StrList *wheels_packages;        ///< Wheel packages built for delivery
+        struct StrList *wheels_verified;        ///< Wheel packages that match their RECORD (relative to wheel_artifact_dir)
     } conda;
 
     /*! \struct Runtime
@@ -181,6 +187,9 @@ struct Delivery {
         struct Test **test;
         size_t num_used;
         size_t num_alloc;
+        struct PackageNames *names;     ///< Interned test names (see tests_find())
+        struct Test **by_name;          ///< Tests indexed by name ID
+        size_t num_indexed;             ///< Total tests added to the name index
     } *tests;
 
     struct Deploy {
@@ -263,6 +272,11 @@ int delivery_build_recipes(struct Delivery *ctx);
 
 /**
  * Produce a list of wheels built for the Delivery (Unused)
+ *
+ * Wheels are built in the checkouts created by delivery_fetch_sources(). Each
+ * checkout is restored to its fetched commit, and untracked files are removed,
+ * before its wheel is built.
+ *
  * @param ctx pointer to Delivery context
  * @return pointer to StrList
  * @return NULL on error
@@ -270,13 +284,29 @@ int delivery_build_recipes(struct Delivery *ctx);
 struct StrList *delivery_build_wheels(struct Delivery *ctx);
 
 /**
- * Copy wheel packages to artifact storage
+ * Generate a simple package index for wheel artifact storage
+ *
+ * See wheel_index_build()
+ *
  * @param ctx pointer to Delivery context
  * @return 0 on success
  * @return Non-zero on error
  */
 int delivery_index_wheel_artifacts(struct Delivery *ctx);
 
+/**
+ * Check every wheel in wheel artifact storage against its `RECORD`
+ *
+ * Wheels are read by up to `globals.scan_jobs` processes at the same time
+ * (see wheel_verify_records()). On success, the verified wheels are stored
+ * in `ctx->conda.wheels_verified`.
+ *
+ * @param ctx pointer to Delivery context
+ * @return 0 on success
+ * @return Non-zero if a wheel does not match its `RECORD`, or on error
+ */
+int delivery_verify_wheel_artifacts(struct Delivery *ctx);
+
 /**
  * Generate a header block that is applied to delivery artifacts
  * @param ctx pointer to Delivery context
@@ -347,8 +377,25 @@ int delivery_install_packages(struct Delivery *ctx, char *conda_install_dir, cha
  */
 int delivery_index_conda_artifacts(struct Delivery *ctx);
 
+/**
+ * Clone and check out every test block's repository
+ *
+ * Repositories are fetched concurrently (see `globals.fetch_jobs`) into
+ * `build_sources_dir/<test name>`. On success `repository_dir`,
+ * `repository_info_tag` and `repository_info_ref` are populated for each Test.
+ *
+ * @param ctx pointer to Delivery context
+ * @return 0 on success
+ * @return >0 number of repositories that could not be fetched
+ * @return <0 on error
+ */
+int delivery_fetch_sources(struct Delivery *ctx);
+
 /**
  * Execute Delivery test array
+ *
+ * Test blocks are executed in the checkouts created by delivery_fetch_sources()
+ *
  * @param ctx pointer to Delivery context
  */
 void delivery_tests_run(struct Delivery *ctx);
@@ -517,6 +564,19 @@ struct Tests *tests_init(size_t num_tests);
  */
 int tests_add(struct Tests *tests, struct Test *x);
 
+/**
+ * Find the test block for a package
+ *
+ * Names are compared after normalization (PEP 503), so a spec such as
+ * "Foo_Bar[extra]>=1.0" finds [test:foo-bar]. When several test blocks
+ * share a name, the first one is returned.
+ *
+ * @param tests list to search
+ * @param spec package name or spec
+ * @return pointer to `Test`, or NULL if no test block matches
+ */
+struct Test *tests_find(struct Tests *tests, const char *spec);
+
 /**
  * Free a `Test` structure
  * @param x pointer to `Test`
@@ -0,0 +1,88 @@
+#include "benchmark.h"
+#include "copy.h"
+
+static const size_t bench_file_mb = 1024;
+static const char *bench_src = "bench_copy_src.bin";
+
+/**
+ * The copy loop copy2() used before it learned to copy in the kernel
+ */
+static int copy_buffered(const char *src, const char *dest) {
+    char buf[STASIS_BUFSIZ];
+    size_t bytes_read;
+    FILE *fp1 = fopen(src, "rb");
+    if (!fp1) {
+        return -1;
+    }
+    FILE *fp2 = fopen(dest, "w+b");
+    if (!fp2) {
+        fclose(fp1);
+        return -1;
+    }
+    while ((bytes_read = fread(buf, sizeof(char), sizeof(buf), fp1)) != 0) {
+        fwrite(buf, sizeof(char), bytes_read, fp2);
+    }
+    fclose(fp1);
+    fclose(fp2);
+    return 0;
+}
+
+static void bench_copy_setup() {
+    struct stat st;
+    if (stat(bench_src, &st) == 0 && (size_t) st.st_size == bench_file_mb * 1024 * 1024) {
+        return;
+    }
+    char *block = malloc(1024 * 1024);
+    STASIS_ASSERT_FATAL(block != NULL, "Unable to allocate block");
+    FILE *fp = fopen(bench_src, "wb");
+    STASIS_ASSERT_FATAL(fp != NULL, "Unable to create source file");
+    for (size_t i = 0; i < bench_file_mb; i++) {
+        memset(block, (int) (i & 0xff), 1024 * 1024);
+        fwrite(block, 1, 1024 * 1024, fp);
+    }
+    fclose(fp);
+    guard_free(block);
+}
+
+static void bench_copy_run(const char *name, const char *dest, unsigned op, int buffered) {
+    struct stasis_bench_t bench;
+    struct stat st;
+
+    bench_copy_setup();
+    // ops are MiB copied
+    stasis_bench_start(&bench, name, bench_file_mb);
+    const int status = buffered ? copy_buffered(bench_src, dest) : copy2(bench_src, dest, op);
+    stasis_bench_stop(&bench);
+    stasis_bench_report(&bench);
+    STASIS_ASSERT(status == 0, "File should be copied");
+    STASIS_ASSERT(stat(dest, &st) == 0 && (size_t) st.st_size == bench_file_mb * 1024 * 1024, "Copy should be complete");
+    remove(dest);
+}
+
+static void bench_copy_buffered() {
+    bench_copy_run("fread/fwrite (8 KiB) MiB", "bench_copy_buffered.bin", 0, 1);
+}
+
+static void bench_copy2() {
+    bench_copy_run("copy2 MiB", "bench_copy2.bin", CT_PERM, 0);
+}
+
+static void bench_copy2_atomic_fsync() {
+    bench_copy_run("copy2 (atomic, fsync) MiB", "bench_copy2_atomic.bin", CT_PERM | CT_ATOMIC | CT_FSYNC, 0);
+}
+
+static void bench_copy_cleanup() {
+    remove(bench_src);
+}
+
+int main(int argc, char *argv[]) {
+    STASIS_TEST_BEGIN_MAIN();
+    STASIS_TEST_FUNC *tests[] = {
+        bench_copy_buffered,
+        bench_copy2,
+        bench_copy2_atomic_fsync,
+        bench_copy_cleanup,
+    };
+    STASIS_TEST_RUN(tests);
+    STASIS_TEST_END_MAIN();
+}
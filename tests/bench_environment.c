@@ -0,0 +1,64 @@
+#include "benchmark.h"
+#include "environment.h"
+
+static const size_t bench_num_keys = 2000;
+static const size_t bench_num_probes = 1000000;
+
+static RuntimeEnv *bench_runtime_env() {
+    RuntimeEnv *env = runtime_copy((char *[]) {NULL});
+    for (size_t i = 0; i < bench_num_keys; i++) {
+        char key[32];
+        char value[64];
+        snprintf(key, sizeof(key), "BENCH_KEY_%zu", i);
+        snprintf(value, sizeof(value), "/bench/value/%zu", i);
+        runtime_set(env, key, value);
+    }
+    return env;
+}
+
+static void bench_runtime_get() {
+    struct stasis_bench_t bench;
+    RuntimeEnv *env = bench_runtime_env();
+    size_t found = 0;
+
+    stasis_bench_start(&bench, "runtime_get", bench_num_probes);
+    for (size_t i = 0; i < bench_num_probes; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "BENCH_KEY_%zu", i % bench_num_keys);
+        char *value = runtime_get(env, key);
+        if (value) {
+            found++;
+        }
+        guard_free(value);
+    }
+    stasis_bench_stop(&bench);
+    stasis_bench_report(&bench);
+    STASIS_ASSERT(found == bench_num_probes, "Every key should be found");
+    guard_runtime_free(env);
+}
+
+static void bench_runtime_set() {
+    struct stasis_bench_t bench;
+    RuntimeEnv *env = bench_runtime_env();
+
+    stasis_bench_start(&bench, "runtime_set", bench_num_probes);
+    for (size_t i = 0; i < bench_num_probes; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "BENCH_KEY_%zu", i % bench_num_keys);
+        runtime_set(env, key, "$BENCH_KEY_0:/bench/value");
+    }
+    stasis_bench_stop(&bench);
+    stasis_bench_report(&bench);
+    STASIS_ASSERT(env->num_inuse == bench_num_keys, "Existing keys should be replaced");
+    guard_runtime_free(env);
+}
+
+int main(int argc, char *argv[]) {
+    STASIS_TEST_BEGIN_MAIN();
+    STASIS_TEST_FUNC *tests[] = {
+        bench_runtime_get,
+        bench_runtime_set,
+    };
+    STASIS_TEST_RUN(tests);
+    STASIS_TEST_END_MAIN();
+}
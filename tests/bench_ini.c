@@ -0,0 +1,71 @@
+#include "benchmark.h"
+#include "ini.h"
+
+static const char *bench_ini_filename = "bench.ini";
+static const size_t bench_num_sections = 50;
+static const size_t bench_num_keys = 100; // per section (5,000 total)
+static const size_t bench_num_passes = 10;
+
+static void bench_ini_write() {
+    FILE *fp = fopen(bench_ini_filename, "w");
+    STASIS_ASSERT_FATAL(fp != NULL, "Unable to create INI file");
+    for (size_t s = 0; s < bench_num_sections; s++) {
+        fprintf(fp, "[section_%03zu]\n", s);
+        for (size_t k = 0; k < bench_num_keys; k++) {
+            fprintf(fp, "key_%03zu = value_%03zu_%03zu\n", k, s, k);
+        }
+    }
+    fclose(fp);
+}
+
+static void bench_ini_getval(struct INIFILE *ini, const char *name) {
+    struct stasis_bench_t bench;
+    size_t found = 0;
+
+    stasis_bench_start(&bench, name, bench_num_passes * bench_num_sections * bench_num_keys);
+    for (size_t pass = 0; pass < bench_num_passes; pass++) {
+        for (size_t s = 0; s < bench_num_sections; s++) {
+            char section[20];
+            snprintf(section, sizeof(section), "section_%03zu", s);
+            for (size_t k = 0; k < bench_num_keys; k++) {
+                char key[20];
+                snprintf(key, sizeof(key), "key_%03zu", k);
+                union INIVal val;
+                if (!ini_getval(ini, section, key, INIVAL_TYPE_STR, INI_READ_RAW, &val)) {
+                    found++;
+                    guard_free(val.as_char_p);
+                }
+            }
+        }
+    }
+    stasis_bench_stop(&bench);
+    stasis_bench_report(&bench);
+    STASIS_ASSERT(found == bench.ops, "Every key should be found");
+}
+
+static void bench_ini_lookup() {
+    struct stasis_bench_t bench;
+    bench_ini_write();
+
+    stasis_bench_start(&bench, "ini_open (5000 keys)", bench_num_sections * bench_num_keys);
+    struct INIFILE *ini = ini_open(bench_ini_filename);
+    stasis_bench_stop(&bench);
+    stasis_bench_report(&bench);
+    STASIS_ASSERT_FATAL(ini != NULL, "Unable to open INI file");
+
+    bench_ini_getval(ini, "ini_getval (hash index)");
+    ini_index_free(ini);
+    bench_ini_getval(ini, "ini_getval (linear search)");
+
+    ini_free(&ini);
+    remove(bench_ini_filename);
+}
+
+int main(int argc, char *argv[]) {
+    STASIS_TEST_BEGIN_MAIN();
+    STASIS_TEST_FUNC *tests[] = {
+        bench_ini_lookup,
+    };
+    STASIS_TEST_RUN(tests);
+    STASIS_TEST_END_MAIN();
+}
@@ -0,0 +1,41 @@
+#include "benchmark.h"
+#include "multiprocessing.h"
+
+static const size_t bench_num_tasks = 1000;
+
+static void bench_mp_pool_join(const char *name, size_t flags) {
+    struct MultiProcessingPool *p = NULL;
+    struct stasis_bench_t bench;
+
+    STASIS_ASSERT_FATAL((p = mp_pool_init(name, "benchlogs")) != NULL, "Failed to initialize pool");
+    for (size_t i = 0; i < bench_num_tasks; i++) {
+        char taskname[100] = {0};
+        snprintf(taskname, sizeof(taskname), "task_%04zu", i);
+        STASIS_ASSERT_FATAL(mp_pool_task(p, taskname, NULL, "true") != NULL, "Failed to queue task");
+    }
+
+    stasis_bench_start(&bench, name, bench_num_tasks);
+    STASIS_ASSERT(mp_pool_join(p, get_cpu_count(), flags) == 0, "Pool tasks should not have failed");
+    stasis_bench_stop(&bench);
+    stasis_bench_report(&bench);
+    mp_pool_free(&p);
+}
+
+static void bench_mp_pool_join_poll_fixed() {
+    bench_mp_pool_join("mp_pool_join (poll every 100ms)", MP_POOL_POLL_FIXED);
+}
+
+static void bench_mp_pool_join_wakeup() {
+    bench_mp_pool_join("mp_pool_join (SIGCHLD wakeup)", 0);
+}
+
+int main(int argc, char *argv[]) {
+    STASIS_TEST_BEGIN_MAIN();
+    STASIS_TEST_FUNC *tests[] = {
+        bench_mp_pool_join_poll_fixed,
+        bench_mp_pool_join_wakeup,
+    };
+    globals.task_timeout = 60;
+    STASIS_TEST_RUN(tests);
+    STASIS_TEST_END_MAIN();
+}
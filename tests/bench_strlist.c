@@ -0,0 +1,88 @@
+#include "benchmark.h"
+#include "strlist.h"
+
+static const size_t bench_num_items = 1000000;
+static const char *bench_item = "There are many strings but this one is mine.";
+
+static void bench_strlist_append() {
+    struct stasis_bench_t bench;
+    struct StrList *list = strlist_init();
+
+    stasis_bench_start(&bench, "strlist_append", bench_num_items);
+    for (size_t i = 0; i < bench_num_items; i++) {
+        strlist_append(&list, (char *) bench_item);
+    }
+    stasis_bench_stop(&bench);
+    stasis_bench_report(&bench);
+    STASIS_ASSERT(strlist_count(list) == bench_num_items, "Every item should be appended");
+    guard_strlist_free(&list);
+}
+
+static void bench_strlist_append_reserved() {
+    struct stasis_bench_t bench;
+    struct StrList *list = strlist_init();
+
+    stasis_bench_start(&bench, "strlist_append (reserved)", bench_num_items);
+    strlist_reserve(list, bench_num_items);
+    for (size_t i = 0; i < bench_num_items; i++) {
+        strlist_append(&list, (char *) bench_item);
+    }
+    stasis_bench_stop(&bench);
+    stasis_bench_report(&bench);
+    STASIS_ASSERT(strlist_count(list) == bench_num_items, "Every item should be appended");
+    guard_strlist_free(&list);
+}
+
+static void bench_strlist_append_owned() {
+    struct stasis_bench_t bench;
+    struct StrList *list = strlist_init();
+    char **items = calloc(bench_num_items, sizeof(*items));
+    STASIS_ASSERT_FATAL(items != NULL, "Unable to allocate items");
+    for (size_t i = 0; i < bench_num_items; i++) {
+        items[i] = strdup(bench_item);
+    }
+
+    stasis_bench_start(&bench, "strlist_append_owned", bench_num_items);
+    for (size_t i = 0; i < bench_num_items; i++) {
+        strlist_append_owned(&list, items[i]);
+    }
+    stasis_bench_stop(&bench);
+    stasis_bench_report(&bench);
+    STASIS_ASSERT(strlist_count(list) == bench_num_items, "Every item should be appended");
+    guard_strlist_free(&list);
+    guard_free(items);
+}
+
+static void bench_strlist_append_tokenize() {
+    struct stasis_bench_t bench;
+    struct StrList *list = strlist_init();
+    const size_t item_len = strlen(bench_item) + 1;
+    char *data = calloc(bench_num_items * item_len + 1, sizeof(*data));
+    STASIS_ASSERT_FATAL(data != NULL, "Unable to allocate data");
+    for (size_t i = 0; i < bench_num_items; i++) {
+        memcpy(data + i * item_len, bench_item, item_len - 1);
+        data[(i + 1) * item_len - 1] = '\n';
+    }
+    // Drop the trailing newline so the count is exact
+    data[bench_num_items * item_len - 1] = '\0';
+
+    stasis_bench_start(&bench, "strlist_append_tokenize", bench_num_items);
+    strlist_append_tokenize(list, data, "\n");
+    stasis_bench_stop(&bench);
+    stasis_bench_report(&bench);
+    STASIS_ASSERT(strlist_count(list) == bench_num_items, "Every token should be appended");
+    guard_strlist_free(&list);
+    guard_free(data);
+}
+
+int main(int argc, char *argv[]) {
+    STASIS_TEST_BEGIN_MAIN();
+    STASIS_TEST_FUNC *tests[] = {
+        bench_strlist_append,
+        bench_strlist_append_reserved,
+        bench_strlist_append_owned,
+        bench_strlist_append_tokenize,
+    };
+    STASIS_TEST_RUN(tests);
+    STASIS_TEST_END_MAIN();
+}
@@ -0,0 +1,36 @@
+#ifndef STASIS_BENCHMARK_H
+#define STASIS_BENCHMARK_H
+#include "testing.h"
+#include "timespec.h"
+
+struct stasis_bench_t {
+    const char *name;
+    size_t ops;
+    struct timespec t_start;
+    struct timespec t_stop;
+    double duration;
+};
+
+extern inline void stasis_bench_start(struct stasis_bench_t *bench, const char *name, size_t ops);
+extern inline void stasis_bench_stop(struct stasis_bench_t *bench);
+extern inline void stasis_bench_report(const struct stasis_bench_t *bench);
+
+inline void stasis_bench_start(struct stasis_bench_t *bench, const char *name, size_t ops) {
+    memset(bench, 0, sizeof(*bench));
+    bench->name = name;
+    bench->ops = ops;
+    clock_gettime(CLOCK_MONOTONIC, &bench->t_start);
+}
+
+inline void stasis_bench_stop(struct stasis_bench_t *bench) {
+    clock_gettime(CLOCK_MONOTONIC, &bench->t_stop);
+    bench->duration = timespec_to_double(timespec_sub(bench->t_stop, bench->t_start));
+}
+
+inline void stasis_bench_report(const struct stasis_bench_t *bench) {
+    const double rate = bench->duration > 0.0 ? (double) bench->ops / bench->duration : 0.0;
+    fprintf(stderr, "[BENCH] %-40s %10zu ops in %10.4lfs (%.1lf ops/s)\n",
+        bench->name, bench->ops, bench->duration, rate);
+}
+
+#endif //STASIS_BENCHMARK_H
@@ -38,6 +38,7 @@ extern inline int stasis_testing_has_failed();
 extern inline void stasis_testing_record_result_summary();
 extern inline char *stasis_testing_read_ascii(const char *filename);
 extern inline int stasis_testing_write_ascii(const char *filename, const char *data);
+extern inline int stasis_testing_write_zip(const char *filename, const char **members);
 
 inline void stasis_testing_record_result(struct stasis_test_result_t result) {
     memcpy(&stasis_test_results[stasis_test_results_i], &result, sizeof(result));
@@ -132,6 +133,126 @@ inline int stasis_testing_write_ascii(const char *filename, const char *data) {
     return 0;
 }
 
+static inline void stasis_testing_zip_put(FILE *fp, const unsigned long value, const int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        fputc((int) (value >> (i * 8)) & 0xff, fp);
+    }
+}
+
+/**
+ * Write an uncompressed zip archive (i.e. a Python wheel)
+ *
+ * ```c
+ * stasis_testing_write_zip("pkg-1.0-py3-none-any.whl", (const char *[]) {
+ *     "pkg/__init__.py", "",
+ *     "pkg-1.0.dist-info/WHEEL", "Wheel-Version: 1.0\n",
+ *     NULL,
+ * });
+ * ```
+ *
+ * @param filename path to archive
+ * @param members NULL terminated array of name and data pairs
+ * @return 0 on success, -1 on error
+ */
+inline int stasis_testing_write_zip(const char *filename, const char **members) {
+    const unsigned long dos_date = 0x21; // 1980-01-01
+    size_t total = 0;
+    while (members[total * 2] != NULL) {
+        total++;
+    }
+    unsigned long *offsets = calloc(total + 1, sizeof(*offsets));
+    unsigned long *crcs = calloc(total + 1, sizeof(*crcs));
+    size_t count = 0;
+    if (!offsets || !crcs) {
+        perror("unable to allocate memory for zip members");
+        guard_free(offsets);
+        guard_free(crcs);
+        return -1;
+    }
+
+    FILE *fp = fopen(filename, "wb");
+    if (!fp) {
+        perror(filename);
+        guard_free(offsets);
+        guard_free(crcs);
+        return -1;
+    }
+    for (; count < total; count++) {
+        const char *name = members[count * 2];
+        const char *data = members[count * 2 + 1];
+        const size_t len = strlen(data);
+        unsigned long crc = 0xffffffff;
+        for (size_t i = 0; i < len; i++) {
+            crc ^= (unsigned char) data[i];
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+            }
+        }
+        crcs[count] = crc ^ 0xffffffff;
+        offsets[count] = (unsigned long) ftell(fp);
+
+        // Local file header
+        stasis_testing_zip_put(fp, 0x04034b50, 4);
+        stasis_testing_zip_put(fp, 20, 2);
+        stasis_testing_zip_put(fp, 0, 2);
+        stasis_testing_zip_put(fp, 0, 2);
+        stasis_testing_zip_put(fp, 0, 2);
+        stasis_testing_zip_put(fp, dos_date, 2);
+        stasis_testing_zip_put(fp, crcs[count], 4);
+        stasis_testing_zip_put(fp, len, 4);
+        stasis_testing_zip_put(fp, len, 4);
+        stasis_testing_zip_put(fp, strlen(name), 2);
+        stasis_testing_zip_put(fp, 0, 2);
+        fputs(name, fp);
+        fwrite(data, 1, len, fp);
+    }
+
+    const unsigned long directory = (unsigned long) ftell(fp);
+    for (size_t i = 0; i < count; i++) {
+        const char *name = members[i * 2];
+        const size_t len = strlen(members[i * 2 + 1]);
+
+        // Central directory header
+        stasis_testing_zip_put(fp, 0x02014b50, 4);
+        stasis_testing_zip_put(fp, 20, 2);
+        stasis_testing_zip_put(fp, 20, 2);
+        stasis_testing_zip_put(fp, 0, 2);
+        stasis_testing_zip_put(fp, 0, 2);
+        stasis_testing_zip_put(fp, 0, 2);
+        stasis_testing_zip_put(fp, dos_date, 2);
+        stasis_testing_zip_put(fp, crcs[i], 4);
+        stasis_testing_zip_put(fp, len, 4);
+        stasis_testing_zip_put(fp, len, 4);
+        stasis_testing_zip_put(fp, strlen(name), 2);
+        stasis_testing_zip_put(fp, 0, 2);
+        stasis_testing_zip_put(fp, 0, 2);
+        stasis_testing_zip_put(fp, 0, 2);
+        stasis_testing_zip_put(fp, 0, 2);
+        stasis_testing_zip_put(fp, 0, 4);
+        stasis_testing_zip_put(fp, offsets[i], 4);
+        fputs(name, fp);
+    }
+    const unsigned long directory_size = (unsigned long) ftell(fp) - directory;
+
+    // End of central directory
+    stasis_testing_zip_put(fp, 0x06054b50, 4);
+    stasis_testing_zip_put(fp, 0, 2);
+    stasis_testing_zip_put(fp, 0, 2);
+    stasis_testing_zip_put(fp, count, 2);
+    stasis_testing_zip_put(fp, count, 2);
+    stasis_testing_zip_put(fp, directory_size, 4);
+    stasis_testing_zip_put(fp, directory, 4);
+    stasis_testing_zip_put(fp, 0, 2);
+    guard_free(offsets);
+    guard_free(crcs);
+
+    if (fclose(fp)) {
+        perror(filename);
+        return -1;
+    }
+    return 0;
+}
+
 char TEST_DATA_DIR[PATH_MAX] = {0};
 char TEST_START_DIR[PATH_MAX] = {0};
 char TEST_WORKSPACE_DIR[PATH_MAX] = {0};
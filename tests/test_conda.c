@@ -162,6 +162,23 @@ void test_conda_get_active_environment() {
     guard_free(active_env);
 }
 
+void test_pip_index_provides_many() {
+    struct StrList *specs = strlist_init();
+    const char *names[] = {"firewatch", "doesnotexistfirewatch", "", "firewatch"};
+    const int expected[] = {PKG_FOUND, PKG_NOT_FOUND, PKG_NOT_FOUND, PKG_FOUND};
+    int result[sizeof(names) / sizeof(*names)];
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++) {
+        strlist_append(&specs, (char *) names[i]);
+    }
+    STASIS_ASSERT_FATAL(pkg_index_provides_many(PKG_USE_PIP, PYPI_INDEX_DEFAULT, specs, result, 4) == 0, "batch query failed");
+    for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++) {
+        printf("%s returned %d, expecting %d\n", names[i], result[i], expected[i]);
+        STASIS_ASSERT(result[i] == expected[i], "Unexpected result");
+    }
+    guard_strlist_free(&specs);
+}
+
 void test_conda_provides() {
     struct testcase {
         const char *name;
@@ -197,6 +214,7 @@ int main(int argc, char *argv[]) {
         test_conda_setup_headless,
         test_conda_provides,
         test_pip_index_provides,
+        test_pip_index_provides_many,
         test_conda_get_active_environment,
         test_conda_exec,
         test_python_exec,
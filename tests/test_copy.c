@@ -34,10 +34,103 @@ void test_copy() {
     }
 }
 
+static int files_equal(const char *a, const char *b) {
+    FILE *fa = fopen(a, "rb");
+    FILE *fb = fopen(b, "rb");
+    int result = fa && fb;
+    while (result) {
+        const int ca = fgetc(fa);
+        const int cb = fgetc(fb);
+        if (ca != cb) {
+            result = 0;
+        }
+        if (ca == EOF || cb == EOF) {
+            break;
+        }
+    }
+    if (fa) {
+        fclose(fa);
+    }
+    if (fb) {
+        fclose(fb);
+    }
+    return result;
+}
+
+void test_copy_modes() {
+    const char *src = "file_to_copy_modes.bin";
+    const size_t size = 3 * 1024 * 1024 + 17;
+    struct stat st_src, st_dest;
+
+    FILE *fp = fopen(src, "wb");
+    STASIS_ASSERT_FATAL(fp != NULL, "unable to create source file");
+    for (size_t i = 0; i < size; i++) {
+        fputc((int) (i * 31 % 251), fp);
+    }
+    fclose(fp);
+    chmod(src, 0640);
+    stat(src, &st_src);
+
+    struct testcase {
+        unsigned op;
+        const char *dest;
+    };
+    struct testcase tc[] = {
+        {.op = CT_PERM, .dest = "file_copied_modes_perm.bin"},
+        {.op = CT_PERM | CT_FSYNC, .dest = "file_copied_modes_fsync.bin"},
+        {.op = CT_PERM | CT_ATOMIC, .dest = "file_copied_modes_atomic.bin"},
+        {.op = CT_OWNER | CT_PERM | CT_FSYNC | CT_ATOMIC, .dest = "file_copied_modes_all.bin"},
+    };
+    for (size_t i = 0; i < sizeof(tc) / sizeof(*tc); i++) {
+        // Overwrite existing data
+        stasis_testing_write_ascii(tc[i].dest, "previous contents");
+        STASIS_ASSERT(copy2(src, tc[i].dest, tc[i].op) == 0, "copy2 failed");
+        STASIS_ASSERT(stat(tc[i].dest, &st_dest) == 0, "destination stat failed");
+        STASIS_ASSERT((size_t) st_dest.st_size == size, "destination file is not the expected size");
+        STASIS_ASSERT((st_dest.st_mode & 0777) == 0640, "permissions should be preserved");
+        STASIS_ASSERT(files_equal(src, tc[i].dest), "destination contents should match the source");
+    }
+
+    // Without CT_PERM the destination gets the default mode, even when written atomically
+    const mode_t mask = umask(0);
+    umask(mask);
+    STASIS_ASSERT(copy2(src, "file_copied_modes_default.bin", CT_ATOMIC) == 0, "copy2 failed");
+    STASIS_ASSERT(stat("file_copied_modes_default.bin", &st_dest) == 0, "destination stat failed");
+    STASIS_ASSERT((st_dest.st_mode & 0777) == (0666 & ~mask), "default permissions should be used");
+
+    stasis_testing_write_ascii("file_copied_modes_empty.bin", "");
+    STASIS_ASSERT(copy2("file_copied_modes_empty.bin", "file_copied_modes_empty_copy.bin", CT_PERM | CT_ATOMIC) == 0, "empty file should be copied");
+    STASIS_ASSERT(stat("file_copied_modes_empty_copy.bin", &st_dest) == 0 && st_dest.st_size == 0, "empty file should be empty");
+    STASIS_ASSERT(copy2("file_copied_modes_missing.bin", "file_copied_modes_missing_copy.bin", CT_ATOMIC) < 0, "missing file should be an error");
+}
+
+void test_copy_hardlinks() {
+    const char *src = "file_to_copy_linked.txt";
+    struct stat st_src, st_dest;
+
+    unlink("file_copied_linked.txt");
+    stasis_testing_write_ascii(src, "linked");
+    unlink("file_to_copy_linked_1.txt");
+    unlink("file_to_copy_linked_2.txt");
+    link(src, "file_to_copy_linked_1.txt");
+    link(src, "file_to_copy_linked_2.txt");
+    STASIS_ASSERT_FATAL(stat(src, &st_src) == 0 && st_src.st_nlink > 2, "source should have several links");
+
+    // The destination's directory must be on the same device
+    STASIS_ASSERT(copy2(src, "./file_copied_linked.txt", CT_PERM) == 0, "copy2 failed");
+    STASIS_ASSERT(stat("file_copied_linked.txt", &st_dest) == 0 && st_dest.st_ino == st_src.st_ino, "source with several links should be hard linked");
+
+    STASIS_ASSERT(copy2(src, "./file_copied_unlinked.txt", CT_PERM | CT_NO_HARDLINK) == 0, "copy2 failed");
+    STASIS_ASSERT(stat("file_copied_unlinked.txt", &st_dest) == 0 && st_dest.st_ino != st_src.st_ino, "CT_NO_HARDLINK should write an independent copy");
+    STASIS_ASSERT(files_equal(src, "file_copied_unlinked.txt"), "destination contents should match the source");
+}
+
 int main(int argc, char *argv[]) {
     STASIS_TEST_BEGIN_MAIN();
     STASIS_TEST_FUNC *tests[] = {
         test_copy,
+        test_copy_modes,
+        test_copy_hardlinks,
     };
     STASIS_TEST_RUN(tests);
     STASIS_TEST_END_MAIN();
@@ -6,8 +6,8 @@ void test_runtime_copy() {
     RuntimeEnv *env = runtime_copy(environ);
     STASIS_ASSERT(env->data != environ, "copied array is not unique");
     int difference = 0;
-    for (size_t i = 0; i < strlist_count(env); i++) {
-        char *item = strlist_item(env, i);
+    for (size_t i = 0; i < env->num_inuse; i++) {
+        char *item = env->data[i];
         if (!strstr_array(environ, item)) {
             difference++;
         }
@@ -29,7 +29,7 @@ void test_runtime() {
     runtime_set(env, "CUSTOM_KEY", "Very custom");
     ssize_t idx;
     STASIS_ASSERT((idx = runtime_contains(env, "CUSTOM_KEY")) >= 0, "CUSTOM_KEY should exist in object");
-    STASIS_ASSERT(strcmp(strlist_item(env, idx), "CUSTOM_KEY=Very custom") == 0, "Incorrect index returned by runtime_contains");
+    STASIS_ASSERT(strcmp(env->data[idx], "CUSTOM_KEY=Very custom") == 0, "Incorrect index returned by runtime_contains");
 
     char *custom_value = runtime_get(env, "CUSTOM_KEY");
     STASIS_ASSERT_FATAL(custom_value != NULL, "CUSTOM_KEY should not be NULL");
@@ -71,12 +71,83 @@ void test_runtime() {
     // requires dumping stdout to a file and comparing it with the current environment array
 }
 
+void test_runtime_index() {
+    RuntimeEnv *env = runtime_copy((char *[]) {"A=1", "AB=2", "EMPTY=", "DUP=first", "DUP=second", "EQ=x=y", NULL});
+    STASIS_ASSERT_FATAL(env != NULL, "environment should be copied");
+    STASIS_ASSERT(env->data[env->num_inuse] == NULL, "records should be NULL terminated");
+    STASIS_ASSERT(runtime_contains(env, "A") == 0, "A should be the first record");
+    STASIS_ASSERT(runtime_contains(env, "AB") == 1, "AB should not be confused with A");
+    STASIS_ASSERT(runtime_contains(env, "ABC") < 0, "ABC should not exist");
+    STASIS_ASSERT(runtime_contains(env, "DUP") == 3, "first record of a duplicate key should be found");
+
+    char *value = runtime_get(env, "EQ");
+    STASIS_ASSERT(value && strcmp(value, "x=y") == 0, "value should be everything after the first '='");
+    guard_free(value);
+    value = runtime_get(env, "EMPTY");
+    STASIS_ASSERT(value && strcmp(value, "") == 0, "empty value should be returned");
+    guard_free(value);
+
+    // Enough keys to grow the records and the hash table several times
+    for (size_t i = 0; i < 1000; i++) {
+        char key[32];
+        char val[32];
+        snprintf(key, sizeof(key), "KEY_%zu", i);
+        snprintf(val, sizeof(val), "value_%zu", i);
+        runtime_set(env, key, val);
+    }
+    runtime_set(env, "KEY_500", "replaced");
+    STASIS_ASSERT(env->num_inuse == 1006, "new keys should be appended once");
+    STASIS_ASSERT(env->data[env->num_inuse] == NULL, "records should be NULL terminated");
+    int errors = 0;
+    for (size_t i = 0; i < 1000; i++) {
+        char key[32];
+        char expected[32];
+        snprintf(key, sizeof(key), "KEY_%zu", i);
+        snprintf(expected, sizeof(expected), "value_%zu", i);
+        value = runtime_get(env, key);
+        if (!value || strcmp(value, i == 500 ? "replaced" : expected) != 0) {
+            errors++;
+        }
+        guard_free(value);
+    }
+    STASIS_ASSERT(errors == 0, "every key should be found with its value");
+    guard_runtime_free(env);
+}
+
+void test_runtime_apply_changed() {
+    unsetenv("STASIS_RUNTIME_CHANGED");
+    setenv("STASIS_RUNTIME_UNCHANGED", "global", 1);
+    RuntimeEnv *env = runtime_copy((char *[]) {"STASIS_RUNTIME_UNCHANGED=local", NULL});
+    STASIS_ASSERT_FATAL(env != NULL, "environment should be copied");
+
+    runtime_set(env, "STASIS_RUNTIME_CHANGED", "$STASIS_RUNTIME_UNCHANGED");
+    runtime_apply_changed(env);
+    const char *value = getenv("STASIS_RUNTIME_CHANGED");
+    STASIS_ASSERT(value && strcmp(value, "local") == 0, "modified key should be applied");
+    value = getenv("STASIS_RUNTIME_UNCHANGED");
+    STASIS_ASSERT(value && strcmp(value, "global") == 0, "copied key should not be applied");
+
+    setenv("STASIS_RUNTIME_CHANGED", "global", 1);
+    runtime_apply_changed(env);
+    value = getenv("STASIS_RUNTIME_CHANGED");
+    STASIS_ASSERT(value && strcmp(value, "global") == 0, "applied key should not be applied again");
+
+    runtime_apply(env);
+    value = getenv("STASIS_RUNTIME_UNCHANGED");
+    STASIS_ASSERT(value && strcmp(value, "local") == 0, "runtime_apply() should apply every key");
+    guard_runtime_free(env);
+    unsetenv("STASIS_RUNTIME_CHANGED");
+    unsetenv("STASIS_RUNTIME_UNCHANGED");
+}
+
 int main(int argc, char *argv[], char *arge[]) {
     STASIS_TEST_BEGIN_MAIN();
     STASIS_TEST_FUNC *tests[] = {
         test_runtime_copy,
         test_runtime_copy_empty,
         test_runtime,
+        test_runtime_index,
+        test_runtime_apply_changed,
     };
     STASIS_TEST_RUN(tests);
     STASIS_TEST_END_MAIN();
@@ -0,0 +1,234 @@
+#include "testing.h"
+#include "gitcache.h"
+#include <utime.h>
+
+static const char *git_identity = "git -c user.name=stasis -c user.email=null@null.null";
+
+static int mock_upstream(const char *path) {
+    char cmd[PATH_MAX * 2] = {0};
+    snprintf(cmd, sizeof(cmd),
+             "git init -q '%s'"
+             " && cd '%s'"
+             " && git config uploadpack.allowFilter true"
+             " && echo data > README"
+             " && git add README"
+             " && %s commit -q -m 'initial commit'"
+             " && git tag 1.0.0",
+             path, path, git_identity);
+    return system(cmd);
+}
+
+static int mock_upstream_commit(const char *path, const char *tag) {
+    char cmd[PATH_MAX * 2] = {0};
+    snprintf(cmd, sizeof(cmd),
+             "cd '%s'"
+             " && date +%%s%%N >> README"
+             " && %s commit -q -a -m 'update'"
+             " && { [ -z '%s' ] || git tag '%s'; }",
+             path, git_identity, tag ? tag : "", tag ? tag : "");
+    return system(cmd);
+}
+
+static char *origin_url(const char *path) {
+    char cmd[PATH_MAX] = {0};
+    snprintf(cmd, sizeof(cmd), "cd '%s' && git remote get-url origin", path);
+    int status = 0;
+    char *result = shell_output(cmd, &status);
+    if (result) {
+        strip(result);
+    }
+    return result;
+}
+
+void test_git_cache_mirror_path() {
+    char a[PATH_MAX] = {0};
+    char b[PATH_MAX] = {0};
+    char c[PATH_MAX] = {0};
+    char d[PATH_MAX] = {0};
+
+    STASIS_ASSERT(git_cache_mirror_path("cache", "https://example.com/org/repo", a, sizeof(a)) == 0, "mirror path should be generated");
+    STASIS_ASSERT(git_cache_mirror_path("cache", "https://example.com/org/repo/", b, sizeof(b)) == 0, "mirror path should be generated");
+    STASIS_ASSERT(git_cache_mirror_path("cache", "https://example.com/org/repo.git", c, sizeof(c)) == 0, "mirror path should be generated");
+    STASIS_ASSERT(git_cache_mirror_path("cache", "https://example.com/fork/repo", d, sizeof(d)) == 0, "mirror path should be generated");
+    STASIS_ASSERT(startswith(a, "cache/repo-") && endswith(a, ".git"), "mirror should be named after the repository");
+    STASIS_ASSERT(strcmp(a, b) == 0 && strcmp(a, c) == 0, "equivalent URLs should share a mirror");
+    STASIS_ASSERT(strcmp(a, d) != 0, "different URLs should not share a mirror");
+    STASIS_ASSERT(git_cache_mirror_path("cache", "https://example.com/org/repo", a, 8) < 0, "truncated path should be an error");
+    STASIS_ASSERT(git_cache_mirror_path(NULL, "https://example.com/org/repo", a, sizeof(a)) < 0, "root is required");
+}
+
+void test_git_clone_cached() {
+    struct Process proc = {0};
+    char cwd[PATH_MAX] = {0};
+    char upstream[PATH_MAX] = {0};
+    char cache[PATH_MAX] = {0};
+    char mirror[PATH_MAX] = {0};
+
+    STASIS_ASSERT_FATAL(getcwd(cwd, sizeof(cwd)) != NULL, "unable to determine current directory");
+    snprintf(upstream, sizeof(upstream), "%s/upstream_cached", cwd);
+    snprintf(cache, sizeof(cache), "%s/git-cache", cwd);
+    STASIS_ASSERT_FATAL(mock_upstream(upstream) == 0, "unable to create upstream repository");
+
+    globals.enable_git_cache = true;
+    globals.git_cache_dir = strdup(cache);
+    const struct GitCacheStats *stats = git_cache_stats();
+    const size_t hits = stats->hits;
+    const size_t misses = stats->misses;
+
+    STASIS_ASSERT(git_clone(&proc, upstream, "cached_1", "1.0.0") == 0, "clone should succeed");
+    STASIS_ASSERT(stats->misses == misses + 1, "first clone should miss the cache");
+    STASIS_ASSERT(git_cache_mirror_path(cache, upstream, mirror, sizeof(mirror)) == 0, "mirror path should be generated");
+    STASIS_ASSERT(access(mirror, F_OK) == 0, "mirror should exist");
+
+    char *url = origin_url("cached_1");
+    STASIS_ASSERT(url && strcmp(url, upstream) == 0, "origin should point to upstream, not the mirror");
+    guard_free(url);
+
+    // The mirror is updated incrementally
+    STASIS_ASSERT_FATAL(mock_upstream_commit(upstream, "1.0.1") == 0, "unable to update upstream repository");
+    STASIS_ASSERT(git_clone(&proc, upstream, "cached_2", "1.0.1") == 0, "clone should succeed");
+    STASIS_ASSERT(stats->hits == hits + 1, "second clone should hit the cache");
+    const char *tag = git_describe("cached_2");
+    STASIS_ASSERT(tag && startswith(tag, "1.0.1"), "new upstream tag should be checked out");
+
+    // Checkouts are independent of the mirror
+    STASIS_ASSERT(git_cache_evict(cache, 1) == 1, "mirror should be evicted");
+    STASIS_ASSERT(access(mirror, F_OK) != 0, "mirror should not exist");
+    tag = git_describe("cached_2");
+    STASIS_ASSERT(tag && startswith(tag, "1.0.1"), "checkout should still be usable after eviction");
+
+    guard_free(globals.git_cache_dir);
+}
+
+void test_git_cache_record() {
+    struct Process proc = {0};
+    char cwd[PATH_MAX] = {0};
+    char upstream[PATH_MAX] = {0};
+    char missing[PATH_MAX] = {0};
+    char cache[PATH_MAX] = {0};
+
+    STASIS_ASSERT_FATAL(getcwd(cwd, sizeof(cwd)) != NULL, "unable to determine current directory");
+    snprintf(upstream, sizeof(upstream), "%s/upstream_record", cwd);
+    snprintf(missing, sizeof(missing), "%s/upstream_missing", cwd);
+    snprintf(cache, sizeof(cache), "%s/git-cache-record", cwd);
+    STASIS_ASSERT_FATAL(mock_upstream(upstream) == 0, "unable to create upstream repository");
+
+    globals.enable_git_cache = true;
+    globals.git_cache_dir = strdup(cache);
+    const struct GitCacheStats *stats = git_cache_stats();
+    const size_t hits = stats->hits;
+    const size_t misses = stats->misses;
+
+    // Scripts are generated before any of them runs, like delivery_fetch_sources() does
+    char *first = git_clone_script("git", upstream, "record_1", NULL);
+    char *second = git_clone_script("git", upstream, "record_2", NULL);
+    char *broken = git_clone_script("git", missing, "record_3", NULL);
+    STASIS_ASSERT_FATAL(first && second && broken, "scripts should be generated");
+    STASIS_ASSERT(stats->hits == hits && stats->misses == misses, "generating a script should not be counted");
+
+    STASIS_ASSERT(shell(&proc, first) == 0, "first clone should succeed");
+    STASIS_ASSERT(shell(&proc, second) == 0, "second clone should succeed");
+    STASIS_ASSERT(shell(&proc, broken) != 0, "clone of missing repository should fail");
+    STASIS_ASSERT(git_cache_record("record_1") == 0, "first clone should create the mirror");
+    STASIS_ASSERT(git_cache_record("record_2") == 1, "second clone should reuse the mirror");
+    STASIS_ASSERT(git_cache_record("record_3") < 0, "failed clone should not be counted");
+    STASIS_ASSERT(git_cache_record("record_1") < 0, "a clone should only be counted once");
+    STASIS_ASSERT(stats->misses == misses + 1 && stats->hits == hits + 1, "outcomes should be counted");
+
+    guard_free(first);
+    guard_free(second);
+    guard_free(broken);
+    guard_free(globals.git_cache_dir);
+}
+
+void test_git_clone_modes() {
+    struct Process proc = {0};
+    char cwd[PATH_MAX] = {0};
+    char upstream[PATH_MAX] = {0};
+    char url[PATH_MAX + 10] = {0};
+
+    STASIS_ASSERT_FATAL(getcwd(cwd, sizeof(cwd)) != NULL, "unable to determine current directory");
+    snprintf(upstream, sizeof(upstream), "%s/upstream_modes", cwd);
+    // Partial and shallow clones are ignored for local paths
+    snprintf(url, sizeof(url), "file://%s", upstream);
+    STASIS_ASSERT_FATAL(mock_upstream(upstream) == 0, "unable to create upstream repository");
+    for (size_t i = 0; i < 3; i++) {
+        STASIS_ASSERT_FATAL(mock_upstream_commit(upstream, NULL) == 0, "unable to update upstream repository");
+    }
+
+    globals.enable_git_cache = false;
+    STASIS_ASSERT(git_clone_mode_from_str("full") == GIT_CLONE_MODE_FULL, "full mode should be recognized");
+    STASIS_ASSERT(git_clone_mode_from_str("blobless") == GIT_CLONE_MODE_BLOBLESS, "blobless mode should be recognized");
+    STASIS_ASSERT(git_clone_mode_from_str("shallow") == GIT_CLONE_MODE_SHALLOW, "shallow mode should be recognized");
+    STASIS_ASSERT(git_clone_mode_from_str("deep") < 0, "unknown mode should be an error");
+
+    globals.git_clone_mode = GIT_CLONE_MODE_BLOBLESS;
+    STASIS_ASSERT(git_clone(&proc, url, "blobless", NULL) == 0, "blobless clone should succeed");
+    const char *tag = git_describe("blobless");
+    STASIS_ASSERT(tag && startswith(tag, "1.0.0-3-"), "blobless clone should be described");
+
+    // A tag is described without deepening the clone
+    globals.git_clone_mode = GIT_CLONE_MODE_SHALLOW;
+    STASIS_ASSERT(git_clone(&proc, url, "shallow_tag", "1.0.0") == 0, "shallow clone should succeed");
+    STASIS_ASSERT(access("shallow_tag/.git/shallow", F_OK) == 0, "clone should be shallow");
+    tag = git_describe("shallow_tag");
+    STASIS_ASSERT(tag && startswith(tag, "1.0.0-0-"), "shallow clone of a tag should be described");
+
+    // The default branch is three commits ahead of the tag. The clone must be deepened to find it.
+    STASIS_ASSERT(git_clone(&proc, url, "shallow", NULL) == 0, "shallow clone should succeed");
+    tag = git_describe("shallow");
+    STASIS_ASSERT(tag && startswith(tag, "1.0.0-3-"), "shallow clone should be deepened until it can be described");
+
+    globals.git_clone_mode = GIT_CLONE_MODE_FULL;
+    globals.enable_git_cache = true;
+}
+
+void test_git_cache_evict() {
+    const char *root = "evict_cache";
+    const char *mirrors[] = {"oldest.git", "middle.git", "newest.git"};
+    char data[4096];
+    memset(data, 'x', sizeof(data));
+
+    mkdir(root, 0755);
+    for (size_t i = 0; i < sizeof(mirrors) / sizeof(*mirrors); i++) {
+        char path[PATH_MAX] = {0};
+        snprintf(path, sizeof(path), "%s/%s", root, mirrors[i]);
+        mkdir(path, 0755);
+        snprintf(path, sizeof(path), "%s/%s/objects", root, mirrors[i]);
+        FILE *fp = fopen(path, "w");
+        STASIS_ASSERT_FATAL(fp != NULL, "unable to create mirror data");
+        for (size_t k = 0; k < 16; k++) {
+            fwrite(data, 1, sizeof(data), fp);
+        }
+        fclose(fp);
+
+        snprintf(path, sizeof(path), "%s/%s/%s", root, mirrors[i], GIT_CACHE_LAST_USED);
+        touch(path);
+        struct utimbuf when = {.actime = 1000 * (time_t) (i + 1), .modtime = 1000 * (time_t) (i + 1)};
+        utime(path, &when);
+    }
+    // Not a mirror. Must never be removed.
+    touch("evict_cache/unrelated");
+
+    STASIS_ASSERT(git_cache_evict(root, 0) == 0, "a size limit of zero should disable eviction");
+    // Three mirrors of at least 64 KiB do not fit in 150 KiB. Only the oldest should be removed.
+    STASIS_ASSERT(git_cache_evict(root, 150 * 1024) == 1, "one mirror should be evicted");
+    STASIS_ASSERT(access("evict_cache/oldest.git", F_OK) != 0, "least recently used mirror should be evicted");
+    STASIS_ASSERT(access("evict_cache/middle.git", F_OK) == 0, "mirror should be kept");
+    STASIS_ASSERT(access("evict_cache/newest.git", F_OK) == 0, "most recently used mirror should be kept");
+    STASIS_ASSERT(access("evict_cache/unrelated", F_OK) == 0, "unrelated file should be kept");
+    STASIS_ASSERT(git_cache_evict("evict_cache_missing", 1) < 0, "missing cache should be an error");
+}
+
+int main(int argc, char *argv[]) {
+    STASIS_TEST_BEGIN_MAIN();
+    STASIS_TEST_FUNC *tests[] = {
+        test_git_cache_mirror_path,
+        test_git_clone_cached,
+        test_git_cache_record,
+        test_git_clone_modes,
+        test_git_cache_evict,
+    };
+    STASIS_TEST_RUN(tests);
+    STASIS_TEST_END_MAIN();
+}
@@ -0,0 +1,197 @@
+#include "testing.h"
+#include "conda.h"
+#include "indexcache.h"
+
+static pid_t server_pid;
+
+static int mock_index_page(const char *name, const char *data) {
+    char path[PATH_MAX] = {0};
+    snprintf(path, sizeof(path), "index_root/simple/%s", name);
+    if (mkdirs(path, 0755)) {
+        return -1;
+    }
+    strncat(path, "/index.html", sizeof(path) - strlen(path) - 1);
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        return -1;
+    }
+    fprintf(fp, "<html><body>\n%s\n</body></html>\n", data);
+    return fclose(fp);
+}
+
+static int mock_index_server(char *url, size_t maxlen) {
+    if (system("python3 -m http.server 0 --bind 127.0.0.1 --directory index_root > server.log 2>&1 & echo $! > server.pid")) {
+        return -1;
+    }
+
+    int port = 0;
+    for (size_t retry = 0; retry < 50 && !port; retry++) {
+        usleep(100000);
+        FILE *fp = fopen("server.log", "r");
+        if (fp) {
+            char line[255] = {0};
+            while (fgets(line, sizeof(line), fp) != NULL) {
+                char *port_at = strstr(line, " port ");
+                if (port_at) {
+                    port = (int) strtol(port_at + strlen(" port "), NULL, 10);
+                }
+            }
+            fclose(fp);
+        }
+    }
+
+    FILE *fp = fopen("server.pid", "r");
+    if (fp) {
+        if (fscanf(fp, "%d", &server_pid) != 1) {
+            server_pid = 0;
+        }
+        fclose(fp);
+    }
+    if (!port) {
+        return -1;
+    }
+    snprintf(url, maxlen, "http://127.0.0.1:%d/simple", port);
+    return 0;
+}
+
+static void mock_index_server_stop() {
+    if (server_pid > 0) {
+        kill(server_pid, SIGTERM);
+        waitpid(server_pid, NULL, 0);
+        server_pid = 0;
+    }
+}
+
+void test_index_cache_package_name() {
+    struct testcase {
+        const char *spec;
+        const char *expected;
+    };
+    struct testcase tc[] = {
+        {.spec = "numpy", .expected = "numpy"},
+        {.spec = "  NumPy>=1.26", .expected = "numpy"},
+        {.spec = "Foo.Bar_baz[extra]>=1.0", .expected = "foo-bar-baz"},
+        {.spec = "foo__--..bar==1.0", .expected = "foo-bar"},
+        {.spec = "foo @ git+https://example.com/foo", .expected = "foo"},
+        {.spec = "fitsverify=4.22", .expected = "fitsverify"},
+    };
+    for (size_t i = 0; i < sizeof(tc) / sizeof(*tc); i++) {
+        char name[255] = {0};
+        STASIS_ASSERT(index_cache_package_name(tc[i].spec, name, sizeof(name)) == 0, "name should be extracted");
+        STASIS_ASSERT(strcmp(name, tc[i].expected) == 0, "name should be normalized");
+    }
+
+    char name[4] = {0};
+    STASIS_ASSERT(index_cache_package_name(">=1.0", name, sizeof(name)) < 0, "spec without a name should be an error");
+    STASIS_ASSERT(index_cache_package_name("toolong", name, sizeof(name)) < 0, "truncated name should be an error");
+}
+
+void test_index_cache_ttl() {
+    int result = -1;
+    globals.enable_index_cache = true;
+    globals.index_cache_dir = strdup("index_cache_ttl");
+    globals.index_cache_ttl = 3600;
+
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_CONDA, NULL, "fitsverify", &result) < 0, "empty cache should miss");
+    STASIS_ASSERT(index_cache_store(PKG_USE_CONDA, NULL, "fitsverify", PKG_FOUND) == 0, "result should be stored");
+    STASIS_ASSERT(index_cache_store(PKG_USE_CONDA, NULL, "fitsverify=0.0.0", PKG_NOT_FOUND) == 0, "result should be stored");
+    STASIS_ASSERT(index_cache_store(PKG_USE_CONDA, NULL, "fitsverify", PKG_INDEX_PROVIDES_E_MANAGER_RUNTIME) < 0, "errors should not be stored");
+
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_CONDA, NULL, "fitsverify", &result) == 0 && result == PKG_FOUND, "cached result should be used");
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_CONDA, NULL, " FitsVerify=0.0.0 ", &result) == 0 && result == PKG_NOT_FOUND, "spec should be normalized");
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_CONDA, "other-channel", "fitsverify", &result) < 0, "results should not be shared between channels");
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_PIP, NULL, "fitsverify", &result) < 0, "results should not be shared between package managers");
+
+    // Expired results are only used as a fallback
+    globals.index_cache_ttl = 0;
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_CONDA, NULL, "fitsverify", &result) < 0, "expired result should not be used");
+    STASIS_ASSERT(index_cache_lookup_stale(PKG_USE_CONDA, NULL, "fitsverify", &result) < 0, "stale result should not be used unless allowed");
+    globals.index_cache_stale = true;
+    STASIS_ASSERT(index_cache_lookup_stale(PKG_USE_CONDA, NULL, "fitsverify", &result) == 0 && result == PKG_FOUND, "stale result should be used");
+    globals.index_cache_stale = false;
+
+    globals.index_cache_ttl = 3600;
+    globals.enable_index_cache = false;
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_CONDA, NULL, "fitsverify", &result) < 0, "disabled cache should miss");
+    globals.enable_index_cache = true;
+    guard_free(globals.index_cache_dir);
+}
+
+void test_index_cache_revalidate() {
+    char url[255] = {0};
+    int result = -1;
+
+    STASIS_SKIP_IF(!find_program("python3"), "python3 is required to serve a mock index");
+    STASIS_ASSERT_FATAL(mock_index_page("foo", "<a href=\"foo-1.0.tar.gz\">foo-1.0.tar.gz</a>") == 0, "unable to create index page");
+    STASIS_ASSERT_FATAL(mock_index_server(url, sizeof(url)) == 0, "unable to start index server");
+
+    globals.enable_index_cache = true;
+    globals.index_cache_dir = strdup("index_cache_http");
+    globals.index_cache_ttl = 3600;
+    const struct IndexCacheStats *stats = index_cache_stats();
+
+    // Only a missing project is answered by the index page
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_PIP, url, "bar>=1.0", &result) == 0 && result == PKG_NOT_FOUND, "missing project should not be found");
+
+    // A listed file may not be installable by this interpreter. The package manager decides.
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_PIP, url, "Foo", &result) < 0, "project name alone should miss");
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_PIP, url, "foo>=1.0", &result) < 0, "version spec should miss");
+    STASIS_ASSERT(index_cache_store(PKG_USE_PIP, url, "foo>=1.0", PKG_FOUND) == 0, "result should be stored");
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_PIP, url, "foo>=1.0", &result) == 0 && result == PKG_FOUND, "stored result should be used");
+
+    // Results are not shared between interpreters
+    char *path_orig = strdup(getenv("PATH"));
+    STASIS_ASSERT_FATAL(mkdirs("index_cache_bin", 0755) == 0, "unable to create mock interpreter directory");
+    stasis_testing_write_ascii("index_cache_bin/python", "#!/bin/sh\necho cpython-399-mock-platform\n");
+    chmod("index_cache_bin/python", 0755);
+    char cwd[PATH_MAX] = {0};
+    char path_mock[PATH_MAX * 2] = {0};
+    STASIS_ASSERT_FATAL(getcwd(cwd, sizeof(cwd)) != NULL, "unable to get current directory");
+    snprintf(path_mock, sizeof(path_mock), "%s/index_cache_bin:%s", cwd, path_orig);
+    setenv("PATH", path_mock, 1);
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_PIP, url, "foo>=1.0", &result) < 0, "result should not be shared with another interpreter");
+    setenv("PATH", path_orig, 1);
+    guard_free(path_orig);
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_PIP, url, "foo>=1.0", &result) == 0 && result == PKG_FOUND, "result should be used by the original interpreter");
+
+    // Expired pages are revalidated. Results expire too.
+    globals.index_cache_ttl = 0;
+    const size_t revalidated = stats->revalidated;
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_PIP, url, "foo>=1.0", &result) < 0, "expired result should not be used");
+    STASIS_ASSERT(stats->revalidated == revalidated + 1, "unchanged page should be revalidated");
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_PIP, url, "bar>=1.0", &result) == 0 && result == PKG_NOT_FOUND, "missing project should still be answered");
+
+    globals.index_cache_ttl = 3600;
+    STASIS_ASSERT(index_cache_store(PKG_USE_PIP, url, "foo>=1.0", PKG_FOUND) == 0, "result should be stored");
+    STASIS_ASSERT_FATAL(mock_index_page("foo", "<a href=\"foo-2.0.tar.gz\">foo-2.0.tar.gz</a>") == 0, "unable to update index page");
+    STASIS_ASSERT_FATAL(system("touch -d '+1 minute' index_root/simple/foo/index.html") == 0, "unable to update index page");
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_PIP, url, "foo>=1.0", &result) == 0 && result == PKG_FOUND, "page should not be revalidated before it expires");
+    globals.index_cache_ttl = 0;
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_PIP, url, "foo>=1.0", &result) < 0, "result should be discarded when the page changes");
+    globals.index_cache_ttl = 3600;
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_PIP, url, "foo>=1.0", &result) < 0, "discarded result should stay discarded");
+
+    // Stale data is used when the index is unreachable
+    STASIS_ASSERT(index_cache_store(PKG_USE_PIP, url, "foo>=1.0", PKG_FOUND) == 0, "result should be stored");
+    globals.index_cache_ttl = 0;
+    mock_index_server_stop();
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_PIP, url, "foo>=1.0", &result) < 0, "unreachable index should miss");
+    globals.index_cache_stale = true;
+    STASIS_ASSERT(index_cache_lookup(PKG_USE_PIP, url, "foo>=1.0", &result) == 0 && result == PKG_FOUND, "stale result should be used");
+    globals.index_cache_stale = false;
+
+    globals.index_cache_ttl = 3600;
+    guard_free(globals.index_cache_dir);
+}
+
+int main(int argc, char *argv[]) {
+    STASIS_TEST_BEGIN_MAIN();
+    STASIS_TEST_FUNC *tests[] = {
+        test_index_cache_package_name,
+        test_index_cache_ttl,
+        test_index_cache_revalidate,
+    };
+    STASIS_TEST_RUN(tests);
+    mock_index_server_stop();
+    STASIS_TEST_END_MAIN();
+}
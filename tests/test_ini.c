@@ -212,6 +212,110 @@ void test_ini_getall() {
     ini_free(&ini);
 }
 
+void test_ini_index() {
+    const char *filename = "ini_index.ini";
+    const char *data = "[default]\na=1\nb=2\n[section]\nkey=value\n[section]\nkey=duplicate\nother=2\n";
+    struct INIFILE *ini;
+
+    stasis_testing_write_ascii(filename, data);
+    ini = ini_open(filename);
+    STASIS_ASSERT_FATAL(ini != NULL, "failed to open ini file");
+    STASIS_ASSERT(ini->index != NULL, "sections should be indexed");
+    STASIS_ASSERT(ini->section[1]->index != NULL, "keys should be indexed");
+
+    // Duplicate sections resolve to the first one, the same as a linear search
+    struct INISection *section = ini_section_search(&ini, INI_SEARCH_EXACT, "section");
+    STASIS_ASSERT(section == ini->section[1], "first matching section should be found");
+    STASIS_ASSERT(ini_section_search(&ini, INI_SEARCH_EXACT, "sect") == NULL, "partial name should not match");
+    STASIS_ASSERT(ini_section_search(&ini, INI_SEARCH_BEGINS, "sect") == ini->section[1], "prefix search should still work");
+    STASIS_ASSERT(ini_section_search(&ini, INI_SEARCH_SUBSTR, "ctio") == ini->section[1], "substring search should still work");
+
+    // The index follows new sections and keys
+    STASIS_ASSERT(ini_section_create(&ini, "new") == 0, "failed to create section");
+    STASIS_ASSERT(ini_section_search(&ini, INI_SEARCH_EXACT, "new") != NULL, "new section should be found");
+    STASIS_ASSERT(ini_data_append(&ini, "new", "c", "3", INIVAL_TYPE_STR) == 0, "failed to append data");
+    STASIS_ASSERT(ini_has_key(ini, "new", "c"), "new key should be found");
+    for (size_t i = 0; i < 100; i++) {
+        char key[20] = {0};
+        snprintf(key, sizeof(key), "key_%zu", i);
+        ini_data_append(&ini, "new", key, key, INIVAL_TYPE_STR);
+    }
+    STASIS_ASSERT(ini_has_key(ini, "new", "key_0") && ini_has_key(ini, "new", "key_99"), "keys should be found after the index grows");
+    STASIS_ASSERT(ini_setval(&ini, INI_SETVAL_REPLACE, "new", "c", "changed") == 0, "failed to set value");
+
+    int err = 0;
+    char *value = ini_getval_str(ini, "new", "c", INI_READ_RAW, &err);
+    STASIS_ASSERT(value && strcmp(value, "changed") == 0, "indexed value should be updated");
+    guard_free(value);
+
+    // Without the index, lookups behave the same
+    ini_index_free(ini);
+    STASIS_ASSERT(ini->index == NULL, "index should be removed");
+    STASIS_ASSERT(ini_section_search(&ini, INI_SEARCH_EXACT, "section") == ini->section[1], "linear search should find the first section");
+    STASIS_ASSERT(ini_has_key(ini, "new", "key_99"), "linear search should find key");
+    STASIS_ASSERT(ini_index_build(ini) == 0, "failed to rebuild index");
+    STASIS_ASSERT(ini_has_key(ini, "new", "key_99"), "rebuilt index should find key");
+
+    ini_free(&ini);
+    remove(filename);
+}
+
+void test_ini_long_value() {
+    const char *filename = "ini_long_value.ini";
+    const char *filename_out = "ini_long_value_out.ini";
+    const size_t num_lines = 1000;
+    struct INIFILE *ini = NULL;
+    int err = 0;
+
+    // A multi-line value several times larger than STASIS_BUFSIZ, and a single line that is too
+    FILE *fp = fopen(filename, "w");
+    STASIS_ASSERT_FATAL(fp != NULL, "unable to create ini file");
+    fprintf(fp, "[test:long]\nscript =\n");
+    for (size_t i = 0; i < num_lines; i++) {
+        fprintf(fp, "    echo line %04zu\n", i);
+    }
+    fprintf(fp, "line = ");
+    for (size_t i = 0; i < STASIS_BUFSIZ * 2; i++) {
+        fputc('x', fp);
+    }
+    fprintf(fp, "\n");
+    fclose(fp);
+
+    ini = ini_open(filename);
+    STASIS_ASSERT_FATAL(ini != NULL, "failed to open ini file");
+    char *script = ini_getval_str_array(ini, "test:long", "script", INI_READ_RAW, &err);
+    STASIS_ASSERT_FATAL(script != NULL, "script should be read");
+    STASIS_ASSERT(strlen(script) > STASIS_BUFSIZ, "multi-line value should not be truncated");
+    STASIS_ASSERT(strstr(script, "echo line 0000") && strstr(script, "echo line 0999"), "every line should be read");
+    char *line = ini_getval_str(ini, "test:long", "line", INI_READ_RAW, &err);
+    STASIS_ASSERT(line && strlen(line) == STASIS_BUFSIZ * 2, "long line should not be truncated");
+    guard_free(line);
+
+    // Replaced values are released by ini_free() the same as values read from the file
+    STASIS_ASSERT(ini_setval(&ini, INI_SETVAL_REPLACE, "test:long", "line", "short") == 0, "failed to set value");
+    STASIS_ASSERT(ini_setval(&ini, INI_SETVAL_APPEND, "test:long", "line", " and longer") == 0, "failed to append value");
+    line = ini_getval_str(ini, "test:long", "line", INI_READ_RAW, &err);
+    STASIS_ASSERT(line && strcmp(line, "short and longer") == 0, "value should be replaced");
+    guard_free(line);
+
+    // Long values survive a round trip
+    fp = fopen(filename_out, "w");
+    STASIS_ASSERT_FATAL(fp != NULL, "unable to create output file");
+    STASIS_ASSERT(ini_write(ini, &fp, INI_WRITE_RAW) == 0, "failed to write ini file");
+    fclose(fp);
+    ini_free(&ini);
+
+    ini = ini_open(filename_out);
+    STASIS_ASSERT_FATAL(ini != NULL, "failed to open written ini file");
+    char *script_out = ini_getval_str_array(ini, "test:long", "script", INI_READ_RAW, &err);
+    STASIS_ASSERT(script_out && strstr(script_out, "echo line 0999"), "written value should not be truncated");
+    guard_free(script_out);
+    guard_free(script);
+    ini_free(&ini);
+    remove(filename);
+    remove(filename_out);
+}
+
 int main(int argc, char *argv[]) {
     STASIS_TEST_BEGIN_MAIN();
     STASIS_TEST_FUNC *tests[] = {
@@ -222,6 +326,8 @@ int main(int argc, char *argv[]) {
         test_ini_setval_getval,
         test_ini_getval_wrappers,
         test_ini_getall,
+        test_ini_index,
+        test_ini_long_value,
     };
     STASIS_TEST_RUN(tests);
     STASIS_TEST_END_MAIN();
@@ -1,6 +1,7 @@
 #include "testing.h"
 #include "multiprocessing.h"
 #include <pthread.h>
+#include <zlib.h>
 
 static struct MultiProcessingPool *pool;
 char *commands[] = {
@@ -19,7 +20,7 @@ void test_mp_pool_init() {
     pool = NULL;
     STASIS_ASSERT((pool = mp_pool_init("mypool", "mplogs")) != NULL, "Pool initialization failed");
     STASIS_ASSERT_FATAL(pool != NULL, "Should not be NULL");
-    STASIS_ASSERT(pool->num_alloc == MP_POOL_TASK_MAX, "Wrong number of default records");
+    STASIS_ASSERT(pool->num_alloc == MP_POOL_TASK_CHUNK, "Wrong number of default records");
     STASIS_ASSERT(pool->num_used == 0, "Wrong number of used records");
     STASIS_ASSERT(strcmp(pool->log_root, "mplogs") == 0, "Wrong log root directory");
     STASIS_ASSERT(strcmp(pool->ident, "mypool") == 0, "Wrong identity");
@@ -27,7 +28,7 @@ void test_mp_pool_init() {
     int data_bad_total = 0;
     for (size_t i = 0; i < pool->num_alloc; i++) {
         int data_bad = 0;
-        struct MultiProcessingTask *task = &pool->task[i];
+        struct MultiProcessingTask *task = pool->task[i];
 
         data_bad += task->status == 0 ? 0 : 1;
         data_bad += task->pid == 0 ? 0 : 1;
@@ -79,7 +80,7 @@ void test_mp_task() {
 void test_mp_pool_join() {
     STASIS_ASSERT(mp_pool_join(pool, get_cpu_count(), 0) == 0, "Pool tasks should have not have failed");
     for (size_t i = 0; i < pool->num_used; i++) {
-        struct MultiProcessingTask *task = &pool->task[i];
+        struct MultiProcessingTask *task = pool->task[i];
         STASIS_ASSERT(task->pid == MP_POOL_PID_UNUSED, "Task should be marked as unused");
         STASIS_ASSERT(task->status == 0, "Task status should be zero (success)");
     }
@@ -155,7 +156,7 @@ void test_mp_fail_fast() {
         .total_unused = 0,
     };
     for (size_t i = 0; i < p->num_used; i++) {
-        struct MultiProcessingTask *task = &p->task[i];
+        struct MultiProcessingTask *task = p->task[i];
         if (task->signaled_by) result.total_signaled++;
         if (task->status > 0) result.total_status_fail++;
         if (task->status == 0) result.total_status_success++;
@@ -184,6 +185,77 @@ static void test_mp_timeout() {
     mp_pool_free(&p);
 }
 
+static void test_mp_sliding_window() {
+    // One long task must not hold back the short tasks queued behind it
+    char *commands_sw[] = {
+        "sleep 3",
+        "sleep 1",
+        "sleep 1",
+        "sleep 1",
+    };
+    struct MultiProcessingPool *p = NULL;
+    STASIS_ASSERT_FATAL((p = mp_pool_init("slidingwindow", "slidingwindowlogs")) != NULL, "Failed to initialize pool");
+    for (size_t i = 0; i < sizeof(commands_sw) / sizeof(*commands_sw); i++) {
+        char taskname[100] = {0};
+        snprintf(taskname, sizeof(taskname), "task_%03zu", i);
+        STASIS_ASSERT(mp_pool_task(p, taskname, NULL, commands_sw[i]) != NULL, "Failed to queue task");
+    }
+    STASIS_ASSERT(mp_pool_join(p, 2, 0) == 0, "Pool tasks should not have failed");
+    STASIS_TEST_MSG("pool duration: %lf, utilization: %lf", p->time_data.duration, p->utilization);
+    // A fixed batch of two would take at least 4 seconds (3 + 1)
+    STASIS_ASSERT(p->time_data.duration < 4.0, "Queued tasks should start as soon as a slot is available");
+    STASIS_ASSERT(p->jobs == 2, "Wrong number of jobs recorded");
+    STASIS_ASSERT(p->utilization > 0.0 && p->utilization <= 100.0, "Utilization out of range");
+    mp_pool_show_summary(p);
+    mp_pool_free(&p);
+}
+
+static void test_mp_pool_grow() {
+    struct MultiProcessingPool *p = NULL;
+    struct MultiProcessingTask *first = NULL;
+    const size_t num_tasks = MP_POOL_TASK_CHUNK * 2 + 1;
+
+    STASIS_ASSERT_FATAL((p = mp_pool_init("grow", "growlogs")) != NULL, "Failed to initialize pool");
+    for (size_t i = 0; i < num_tasks; i++) {
+        struct MultiProcessingTask *task = NULL;
+        char taskname[100] = {0};
+        snprintf(taskname, sizeof(taskname), "task_%03zu", i);
+        STASIS_ASSERT_FATAL((task = mp_pool_task(p, taskname, NULL, "true")) != NULL, "Failed to queue task");
+        if (!first) {
+            first = task;
+        }
+    }
+    STASIS_ASSERT(p->num_used == num_tasks, "Wrong number of used records");
+    STASIS_ASSERT(p->num_alloc == MP_POOL_TASK_CHUNK * 3, "Pool should grow one block at a time");
+    STASIS_ASSERT(p->task[0] == first, "Task records must not move when the pool grows");
+    STASIS_ASSERT(strcmp(p->task[num_tasks - 1]->ident, "task_032") == 0, "Wrong task identity");
+    STASIS_ASSERT(mp_pool_join(p, 4, 0) == 0, "Pool tasks should not have failed");
+    mp_pool_free(&p);
+}
+
+static void test_mp_log_keep() {
+    struct MultiProcessingPool *p = NULL;
+    struct MultiProcessingTask *task = NULL;
+    STASIS_ASSERT_FATAL((p = mp_pool_init("logkeep", "logkeeplogs")) != NULL, "Failed to initialize pool");
+    p->log_keep = true;
+    STASIS_ASSERT_FATAL((task = mp_pool_task(p, "task", NULL, "echo hello; echo world >&2; printf 'no line feed'")) != NULL, "Failed to queue task");
+    STASIS_ASSERT(strstr(task->log_file, ".log.gz") != NULL, "Log file should be compressed");
+    STASIS_ASSERT(mp_pool_join(p, 1, 0) == 0, "Pool tasks should not have failed");
+    STASIS_ASSERT_FATAL(access(task->log_file, F_OK) == 0, "Log file should be kept");
+
+    char data[STASIS_BUFSIZ] = {0};
+    gzFile log = gzopen(task->log_file, "rb");
+    STASIS_ASSERT_FATAL(log != NULL, "Unable to open log file");
+    STASIS_ASSERT(gzread(log, data, sizeof(data) - 1) > 0, "Log file should not be empty");
+    gzclose(log);
+    STASIS_TEST_MSG("log contents:\n%s", data);
+    STASIS_ASSERT(strstr(data, "# COMMAND:\n") != NULL, "Log header is missing");
+    STASIS_ASSERT(strstr(data, "\nhello\n") != NULL, "stdout is missing");
+    STASIS_ASSERT(strstr(data, "\nworld\n") != NULL, "stderr is missing");
+    STASIS_ASSERT(strstr(data, "\nno line feed\n") != NULL, "Incomplete line was not flushed");
+    mp_pool_free(&p);
+}
+
 static void test_mp_seconds_to_human_readable() {
     const struct testcase {
         int seconds;
@@ -230,16 +302,85 @@ void test_mp_stop_continue() {
     pthread_t th;
     pthread_create(&th, NULL, pool_container, &p);
     sleep(2);
-    if (p->task[0].pid != MP_POOL_PID_UNUSED) {
-        STASIS_ASSERT(kill(p->task[0].pid, SIGSTOP) == 0, "SIGSTOP failed");
+    if (p->task[0]->pid != MP_POOL_PID_UNUSED) {
+        STASIS_ASSERT(kill(p->task[0]->pid, SIGSTOP) == 0, "SIGSTOP failed");
         sleep(2);
-        STASIS_ASSERT(kill(p->task[0].pid, SIGCONT) == 0, "SIGCONT failed");
+        STASIS_ASSERT(kill(p->task[0]->pid, SIGCONT) == 0, "SIGCONT failed");
     } else {
         STASIS_ASSERT(false, "Task was marked as unused when it shouldn't have been");
     }
     pthread_join(th, NULL);
 }
 
+static void test_mp_dependencies() {
+    struct MultiProcessingPool *p = NULL;
+    struct MultiProcessingTask *setup_ok, *test_ok, *setup_bad, *test_bad, *test_bad_next, *grouped[2];
+    STASIS_ASSERT_FATAL((p = mp_pool_init("dependencies", "dependencieslogs")) != NULL, "Failed to initialize pool");
+
+    // Dependent tasks are queued before their dependencies on purpose
+    test_ok = mp_pool_task(p, "test_ok", NULL, "test -f mp_dependency_ok");
+    setup_ok = mp_pool_task(p, "setup_ok", NULL, "sleep 1; touch mp_dependency_ok");
+    test_bad_next = mp_pool_task(p, "test_bad_next", NULL, "true");
+    test_bad = mp_pool_task(p, "test_bad", NULL, "true");
+    setup_bad = mp_pool_task(p, "setup_bad", NULL, "false");
+    grouped[0] = mp_pool_task(p, "grouped_0", NULL, "sleep 1");
+    grouped[1] = mp_pool_task(p, "grouped_1", NULL, "sleep 1");
+    STASIS_ASSERT_FATAL(test_ok && setup_ok && test_bad_next && test_bad && setup_bad && grouped[0] && grouped[1], "Failed to queue tasks");
+
+    test_ok->depends_on = setup_ok;
+    test_bad->depends_on = setup_bad;
+    test_bad_next->depends_on = test_bad;
+    strcpy(grouped[0]->group, "exclusive");
+    strcpy(grouped[1]->group, "exclusive");
+
+    remove("mp_dependency_ok");
+    // setup_bad fails, test_bad and test_bad_next are skipped
+    STASIS_ASSERT(mp_pool_join(p, 4, 0) == 3, "Expected one failure and two skipped tasks");
+    mp_pool_show_summary(p);
+
+    STASIS_ASSERT(setup_ok->status == 0, "setup_ok should have succeeded");
+    STASIS_ASSERT(test_ok->status == 0, "test_ok should run after setup_ok");
+    STASIS_ASSERT(setup_bad->status != 0, "setup_bad should have failed");
+    STASIS_ASSERT(test_bad->status == MP_POOL_TASK_STATUS_SKIPPED, "test_bad should have been skipped");
+    STASIS_ASSERT(test_bad_next->status == MP_POOL_TASK_STATUS_SKIPPED, "test_bad_next should have been skipped");
+
+    const double g0_start = (double) grouped[0]->time_data.t_start.tv_sec + grouped[0]->time_data.t_start.tv_nsec / 1e9;
+    const double g0_stop = (double) grouped[0]->time_data.t_stop.tv_sec + grouped[0]->time_data.t_stop.tv_nsec / 1e9;
+    const double g1_start = (double) grouped[1]->time_data.t_start.tv_sec + grouped[1]->time_data.t_start.tv_nsec / 1e9;
+    const double g1_stop = (double) grouped[1]->time_data.t_stop.tv_sec + grouped[1]->time_data.t_stop.tv_nsec / 1e9;
+    STASIS_ASSERT(g1_start >= g0_stop || g0_start >= g1_stop, "Tasks in the same group should not overlap");
+
+    remove("mp_dependency_ok");
+    mp_pool_free(&p);
+}
+
+static int mp_parallel_square(size_t index, void *arg) {
+    size_t *result = arg;
+    result[index] = index * index;
+    // Odd indexes fail
+    return (int) (index & 1);
+}
+
+void test_mp_parallel_for() {
+    const size_t count = 100;
+    const size_t jobs[] = {1, 4};
+
+    for (size_t j = 0; j < sizeof(jobs) / sizeof(*jobs); j++) {
+        size_t *result = mp_shared_alloc(count * sizeof(*result));
+        STASIS_ASSERT_FATAL(result != NULL, "shared memory should be allocated");
+        STASIS_ASSERT(mp_parallel_for(count, jobs[j], mp_parallel_square, result) == (ssize_t) count / 2, "failed calls should be counted");
+        size_t done = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (result[i] == i * i) {
+                done++;
+            }
+        }
+        STASIS_ASSERT(done == count, "every index should be visited once");
+        mp_shared_free(result, count * sizeof(*result));
+    }
+    STASIS_ASSERT(mp_parallel_for(0, 4, mp_parallel_square, NULL) == 0, "nothing to do should succeed");
+}
+
 int main(int argc, char *argv[]) {
     STASIS_TEST_BEGIN_MAIN();
     STASIS_TEST_FUNC *tests[] = {
@@ -250,8 +391,13 @@ int main(int argc, char *argv[]) {
         test_mp_pool_workflow,
         test_mp_fail_fast,
         test_mp_timeout,
+        test_mp_sliding_window,
+        test_mp_pool_grow,
+        test_mp_log_keep,
+        test_mp_dependencies,
         test_mp_seconds_to_human_readable,
-        test_mp_stop_continue
+        test_mp_stop_continue,
+        test_mp_parallel_for,
     };
 
     globals.task_timeout = 60;
@@ -0,0 +1,72 @@
+#include "testing.h"
+#include "pkgname.h"
+
+void test_pkgname_normalize() {
+    struct testcase {
+        const char *spec;
+        const char *expected;
+    };
+    struct testcase tc[] = {
+        {.spec = "numpy", .expected = "numpy"},
+        {.spec = "  NumPy>=1.26", .expected = "numpy"},
+        {.spec = "Foo.Bar_baz[extra]>=1.0", .expected = "foo-bar-baz"},
+        {.spec = "foo__--..bar==1.0", .expected = "foo-bar"},
+        {.spec = "foo @ git+https://example.com/foo", .expected = "foo"},
+        {.spec = "foo; python_version < '3.12'", .expected = "foo"},
+    };
+    for (size_t i = 0; i < sizeof(tc) / sizeof(*tc); i++) {
+        char name[255] = {0};
+        STASIS_ASSERT(pkgname_normalize(tc[i].spec, name, sizeof(name)) == 0, "name should be extracted");
+        STASIS_ASSERT(strcmp(name, tc[i].expected) == 0, "name should be normalized");
+    }
+
+    char name[4] = {0};
+    STASIS_ASSERT(pkgname_normalize("==1.0", name, sizeof(name)) < 0, "spec without a name should be an error");
+    STASIS_ASSERT(pkgname_normalize("toolong", name, sizeof(name)) < 0, "truncated name should be an error");
+}
+
+void test_pkgname_end() {
+    STASIS_ASSERT(strcmp(pkgname_end("numpy>=1.26"), ">=1.26") == 0, "name should end at the version spec");
+    STASIS_ASSERT(strcmp(pkgname_end("  foo[extra]"), "[extra]") == 0, "leading whitespace should be skipped");
+    STASIS_ASSERT(strcmp(pkgname_end("foo @ git+https://example.com/foo"), " @ git+https://example.com/foo") == 0, "name should end at whitespace");
+    STASIS_ASSERT(*pkgname_end("Foo.Bar_baz") == '\0', "bare name should end at the terminator");
+}
+
+void test_pkgname_intern() {
+    struct PackageNames *names = pkgname_init();
+    STASIS_ASSERT_FATAL(names != NULL, "pool should be allocated");
+
+    const ssize_t a = pkgname_intern(names, "NumPy>=1.26");
+    const ssize_t b = pkgname_intern(names, "numpy==2.0");
+    const ssize_t c = pkgname_intern(names, "Foo_Bar[extra]");
+    STASIS_ASSERT(a == 0 && c == 1, "IDs should be assigned in order");
+    STASIS_ASSERT(a == b, "equivalent specs should share an ID");
+    STASIS_ASSERT(strcmp(pkgname_str(names, a), "numpy") == 0, "normalized name should be stored");
+    STASIS_ASSERT(pkgname_lookup(names, "foo.bar<2") == c, "lookup should normalize the spec");
+    STASIS_ASSERT(pkgname_lookup(names, "scipy") < 0, "unknown name should not be found");
+    STASIS_ASSERT(pkgname_intern(names, ">=1.0") < 0, "spec without a name should be an error");
+    STASIS_ASSERT(pkgname_str(names, 100) == NULL, "out of range ID should be an error");
+
+    // IDs stay the same while the pool grows
+    for (size_t i = 0; i < 1000; i++) {
+        char spec[20] = {0};
+        snprintf(spec, sizeof(spec), "package_%zu", i);
+        pkgname_intern(names, spec);
+    }
+    STASIS_ASSERT(names->num_used == 1002, "every distinct name should be stored");
+    STASIS_ASSERT(pkgname_lookup(names, "NUMPY") == a, "ID should not change");
+    STASIS_ASSERT(pkgname_lookup(names, "package-999") == 1001, "ID should match insertion order");
+    pkgname_free(&names);
+    STASIS_ASSERT(names == NULL, "pool should be freed");
+}
+
+int main(int argc, char *argv[]) {
+    STASIS_TEST_BEGIN_MAIN();
+    STASIS_TEST_FUNC *tests[] = {
+        test_pkgname_normalize,
+        test_pkgname_end,
+        test_pkgname_intern,
+    };
+    STASIS_TEST_RUN(tests);
+    STASIS_TEST_END_MAIN();
+}
@@ -0,0 +1,86 @@
+#include "testing.h"
+#include "pkgversion.h"
+
+void test_pkgversion_cmp_order() {
+    // Oldest to newest
+    const char *versions[] = {
+        "0.9",
+        "1.0.dev1",
+        "1.0.dev3",
+        "1.0a1.dev1",
+        "1.0a1",
+        "1.0a2",
+        "1.0b1",
+        "1.0rc1",
+        "1.0",
+        "1.0+abc",
+        "1.0+abc.5",
+        "1.0+5",
+        "1.0.post1.dev1",
+        "1.0.post1",
+        "1.0.1",
+        "1.9",
+        "1.10",
+        "1!0.1",
+    };
+    const size_t count = sizeof(versions) / sizeof(*versions);
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < count; j++) {
+            const int result = pkgversion_cmp(versions[i], versions[j]);
+            const int expected = (i > j) - (i < j);
+            STASIS_ASSERT((result > 0) - (result < 0) == expected, "versions should be ordered by PEP 440");
+        }
+    }
+}
+
+void test_pkgversion_cmp_equal() {
+    struct testcase {
+        const char *a;
+        const char *b;
+    };
+    struct testcase tc[] = {
+        {.a = "1.0", .b = "1.0.0"},
+        {.a = "1.0", .b = "v1.0"},
+        {.a = "01.002", .b = "1.2"},
+        {.a = "0!1.0", .b = "1.0"},
+        {.a = "1.0-alpha.1", .b = "1.0a1"},
+        {.a = "1.0RC1", .b = "1.0rc1"},
+        {.a = "1.0c1", .b = "1.0rc1"},
+        {.a = "1.0pre", .b = "1.0rc0"},
+        {.a = "1.0-1", .b = "1.0.post1"},
+        {.a = "1.0_rev2", .b = "1.0.post2"},
+        {.a = "1.0dev", .b = "1.0.dev0"},
+        {.a = "1.0+Local-1", .b = "1.0+local.1"},
+    };
+    for (size_t i = 0; i < sizeof(tc) / sizeof(*tc); i++) {
+        STASIS_ASSERT(pkgversion_cmp(tc[i].a, tc[i].b) == 0, "alternate spellings should be equal");
+        STASIS_ASSERT(pkgversion_cmp(tc[i].b, tc[i].a) == 0, "alternate spellings should be equal");
+    }
+}
+
+void test_pkgversion_cmp_len() {
+    const char *a = "1.0rc1-py3-none-any.whl";
+    const char *b = "1.0-py3-none-any.whl";
+    STASIS_ASSERT(pkgversion_cmp_len(a, strlen("1.0rc1"), b, strlen("1.0")) < 0, "only the given length should be compared");
+    STASIS_ASSERT(pkgversion_cmp_len(a, strlen("1.0"), b, strlen("1.0")) == 0, "only the given length should be compared");
+}
+
+void test_pkgversion_cmp_invalid() {
+    // Build tags and other non-PEP 440 strings compare by runs of digits
+    STASIS_ASSERT(pkgversion_cmp("2abc", "10abc") < 0, "digits should be compared by value");
+    STASIS_ASSERT(pkgversion_cmp("1abc", "1abd") < 0, "letters should be compared");
+    STASIS_ASSERT(pkgversion_cmp("", "1") < 0, "missing build tag should be older");
+    STASIS_ASSERT(pkgversion_cmp("1.0+", "1.0+") == 0, "equal strings should be equal");
+}
+
+int main(int argc, char *argv[]) {
+    STASIS_TEST_BEGIN_MAIN();
+    STASIS_TEST_FUNC *tests[] = {
+        test_pkgversion_cmp_order,
+        test_pkgversion_cmp_equal,
+        test_pkgversion_cmp_len,
+        test_pkgversion_cmp_invalid,
+    };
+    STASIS_TEST_RUN(tests);
+    STASIS_TEST_END_MAIN();
+}
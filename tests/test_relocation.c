@@ -25,6 +25,23 @@ void test_replace_text() {
 
 }
 
+void test_replace_text_n() {
+    char input[16] = "a-b-c";
+    STASIS_ASSERT(replace_text_n(input, sizeof(input), "-", "::", 0) == 0, "string replacement failed");
+    STASIS_ASSERT(strcmp(input, "a::b::c") == 0, "unexpected replacement");
+
+    // "a:::b:::c" needs 10 bytes
+    char small[10] = "a-b-c";
+    STASIS_ASSERT(replace_text_n(small, sizeof(small), "-", ":::", 0) == 0, "result that fits exactly should be accepted");
+    STASIS_ASSERT(strcmp(small, "a:::b:::c") == 0, "unexpected replacement");
+
+    char tiny[8] = "a-b-c";
+    errno = 0;
+    STASIS_ASSERT(replace_text_n(tiny, sizeof(tiny), "-", ":::", 0) < 0, "result larger than the buffer should be an error");
+    STASIS_ASSERT(errno == ENOBUFS, "errno should be ENOBUFS");
+    STASIS_ASSERT(strcmp(tiny, "a-b-c") == 0, "buffer should be unchanged on error");
+}
+
 void test_file_replace_text() {
     for (size_t i = 0; i < sizeof(targets) / sizeof(*targets); i += 2) {
         const char *filename = "test_file_replace_text.txt";
@@ -54,11 +71,99 @@ void test_file_replace_text() {
     }
 }
 
+void test_replace_text_batch() {
+    const char *data = "name: @NAME@\nversion: 0.0.0 # old\nurl: @URL@/@NAME@\nsha256: 1234\n";
+    const struct ReplaceRule rules[] = {
+        {.target = "@NAME@", .replacement = "stasis"},
+        {.target = "@URL@", .replacement = "https://example.com"},
+        {.target = "version:", .replacement = "version: 1.0.0", .flags = REPLACE_TRUNCATE_AFTER_MATCH},
+        {.target = "sha256:", .replacement = "", .flags = REPLACE_TRUNCATE_AFTER_MATCH},
+        // Replacements are never rescanned
+        {.target = "stasis", .replacement = "never"},
+    };
+    char *result = NULL;
+    size_t result_len = 0;
+
+    STASIS_ASSERT(replace_text_batch(data, strlen(data), rules, sizeof(rules) / sizeof(*rules), &result, &result_len) == 5, "every target should be replaced");
+    STASIS_ASSERT_FATAL(result != NULL, "result should be returned");
+    STASIS_ASSERT(strcmp(result, "name: stasis\nversion: 1.0.0\nurl: https://example.com/stasis\n\n") == 0, "unexpected replacement");
+    STASIS_ASSERT(result_len == strlen(result), "result length should be returned");
+    guard_free(result);
+
+    // Overlapping targets: the match ending first wins, then the longest
+    const struct ReplaceRule overlap[] = {
+        {.target = "abcd", .replacement = "1"},
+        {.target = "bc", .replacement = "2"},
+        {.target = "c", .replacement = "3"},
+    };
+    STASIS_ASSERT(replace_text_batch("xabcdx", 6, overlap, 3, &result, NULL) == 1, "one target should be replaced");
+    STASIS_ASSERT(result && strcmp(result, "xa2dx") == 0, "unexpected replacement of overlapping targets");
+    guard_free(result);
+
+    STASIS_ASSERT(replace_text_batch("nothing here", 12, rules, 2, &result, NULL) == 0, "nothing should be replaced");
+    STASIS_ASSERT(result == NULL, "result should not be allocated when nothing is replaced");
+    const struct ReplaceRule empty = {.target = "", .replacement = "x"};
+    STASIS_ASSERT(replace_text_batch("data", 4, &empty, 1, &result, NULL) < 0, "empty target should be an error");
+}
+
+void test_file_replace_text_batch() {
+    const char *filename = "test_file_replace_text_batch.txt";
+    const size_t long_len = STASIS_BUFSIZ * 4;
+    char *long_line = malloc(long_len + 1);
+    STASIS_ASSERT_FATAL(long_line != NULL, "unable to allocate long line");
+    memset(long_line, 'x', long_len);
+    long_line[long_len] = '\0';
+
+    FILE *fp = fopen(filename, "w");
+    STASIS_ASSERT_FATAL(fp != NULL, "unable to create file");
+    fprintf(fp, "%s@A@%s\n@B@\n", long_line, long_line);
+    fclose(fp);
+    chmod(filename, 0750);
+
+    struct stat before;
+    stat(filename, &before);
+    const struct ReplaceRule rules[] = {
+        {.target = "@A@", .replacement = "a"},
+        {.target = "@B@", .replacement = "b"},
+    };
+    STASIS_ASSERT(file_replace_text_batch(filename, rules, 2) == 0, "replacement should succeed");
+
+    struct stat after;
+    stat(filename, &after);
+    STASIS_ASSERT(before.st_ino != after.st_ino, "file should be replaced by rename");
+    STASIS_ASSERT((after.st_mode & 0777) == 0750, "permissions should be preserved");
+    STASIS_ASSERT((size_t) after.st_size == long_len * 2 + 4, "file should have the expected size");
+
+    char *expected = NULL;
+    STASIS_ASSERT_FATAL(asprintf(&expected, "%sa%s\nb\n", long_line, long_line) > 0, "unable to allocate expected result");
+    char *contents = calloc(after.st_size + 1, sizeof(*contents));
+    fp = fopen(filename, "r");
+    STASIS_ASSERT_FATAL(fp && contents, "unable to read file");
+    fread(contents, 1, after.st_size, fp);
+    fclose(fp);
+    STASIS_ASSERT(strcmp(contents, expected) == 0, "long lines should be replaced in full");
+    guard_free(contents);
+    guard_free(expected);
+
+    // Files without matches are left alone
+    stat(filename, &before);
+    STASIS_ASSERT(file_replace_text_batch(filename, rules, 2) == 0, "no replacement should succeed");
+    stat(filename, &after);
+    STASIS_ASSERT(before.st_ino == after.st_ino, "unchanged file should not be rewritten");
+
+    STASIS_ASSERT(file_replace_text_batch("test_file_replace_text_missing.txt", rules, 2) < 0, "missing file should be an error");
+    remove(filename);
+    guard_free(long_line);
+}
+
 int main(int argc, char *argv[]) {
     STASIS_TEST_BEGIN_MAIN();
     STASIS_TEST_FUNC *tests[] = {
         test_replace_text,
+        test_replace_text_n,
         test_file_replace_text,
+        test_replace_text_batch,
+        test_file_replace_text_batch,
     };
     STASIS_TEST_RUN(tests);
     STASIS_TEST_END_MAIN();
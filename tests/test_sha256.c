@@ -0,0 +1,83 @@
+#include "testing.h"
+#include "sha256.h"
+
+static void digest_hex(const void *data, size_t len, size_t chunk, char *result) {
+    struct SHA256 ctx;
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    const unsigned char *input = data;
+
+    sha256_init(&ctx);
+    for (size_t i = 0; i < len; i += chunk) {
+        sha256_update(&ctx, input + i, len - i < chunk ? len - i : chunk);
+    }
+    sha256_final(&ctx, digest);
+    sha256_hex(digest, result);
+}
+
+void test_sha256_vectors() {
+    struct testcase {
+        const char *data;
+        const char *expected;
+    };
+    // FIPS 180-2, appendix B
+    const struct testcase tc[] = {
+        {.data = "", .expected = "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+        {.data = "abc", .expected = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+        {.data = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", .expected = "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+    };
+    for (size_t i = 0; i < sizeof(tc) / sizeof(*tc); i++) {
+        char hex[SHA256_HEX_SIZE];
+        digest_hex(tc[i].data, strlen(tc[i].data), 64, hex);
+        STASIS_ASSERT(!strcmp(hex, tc[i].expected), tc[i].data);
+    }
+}
+
+void test_sha256_base64() {
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char encoded[SHA256_BASE64_SIZE];
+    struct SHA256 ctx;
+
+    sha256_init(&ctx);
+    sha256_final(&ctx, digest);
+    sha256_base64(digest, encoded);
+    STASIS_ASSERT(!strcmp(encoded, "47DEQpj8HBSa-_TImW-5JCeuQeRkm5NMpJWZG3hSuFU"), "digest should be URL-safe and unpadded");
+}
+
+void test_sha256_streaming() {
+    const char *expected = "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0";
+    const size_t len = 1000000;
+    const size_t chunks[] = {1, 3, 55, 63, 64, 65, 4096, len};
+    char *data = malloc(len);
+    STASIS_ASSERT_FATAL(data != NULL, "unable to allocate input");
+    memset(data, 'a', len);
+
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(*chunks); i++) {
+        char hex[SHA256_HEX_SIZE];
+        digest_hex(data, len, chunks[i], hex);
+        STASIS_ASSERT(!strcmp(hex, expected), "digest should not depend on update sizes");
+    }
+
+    FILE *fp = fopen("million.txt", "w");
+    STASIS_ASSERT_FATAL(fp != NULL, "unable to write input file");
+    fwrite(data, 1, len, fp);
+    fclose(fp);
+    guard_free(data);
+
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char hex[SHA256_HEX_SIZE];
+    STASIS_ASSERT(sha256_file("million.txt", digest) == 0, "file should be readable");
+    sha256_hex(digest, hex);
+    STASIS_ASSERT(!strcmp(hex, expected), "file digest should match");
+    STASIS_ASSERT(sha256_file("missing.txt", digest) < 0, "missing file should be an error");
+}
+
+int main(int argc, char *argv[]) {
+    STASIS_TEST_BEGIN_MAIN();
+    STASIS_TEST_FUNC *tests[] = {
+        test_sha256_vectors,
+        test_sha256_base64,
+        test_sha256_streaming,
+    };
+    STASIS_TEST_RUN(tests);
+    STASIS_TEST_END_MAIN();
+}
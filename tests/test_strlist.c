@@ -48,7 +48,8 @@ void test_strlist_append() {
     for (size_t i = 0; i < sizeof(tc) / sizeof(*tc); i++) {
         strlist_append(&list, (char *) tc[i].data);
         STASIS_ASSERT(list->num_inuse == tc[i].expected_in_use, "incorrect number of records in use");
-        STASIS_ASSERT(list->num_alloc == tc[i].expected_in_use + 1, "incorrect number of records allocated");
+        STASIS_ASSERT(list->num_alloc >= tc[i].expected_in_use + 1, "incorrect number of records allocated");
+        STASIS_ASSERT(list->data[list->num_inuse] == NULL, "list should be NULL terminated");
         STASIS_ASSERT(strcmp(strlist_item(list, i), tc[i].data) == 0, "value was appended incorrectly. data mismatch.");
     }
     guard_strlist_free(&list);
@@ -66,6 +67,37 @@ void test_strlist_append_many_records() {
     guard_strlist_free(&list);
 }
 
+void test_strlist_reserve() {
+    struct StrList *list = strlist_init();
+    STASIS_ASSERT(strlist_reserve(list, 100) == 0, "reserve should succeed");
+    STASIS_ASSERT(list->num_alloc >= 101, "reserve should allocate records and a terminator");
+    STASIS_ASSERT(strlist_count(list) == 0, "reserve should not add records");
+
+    char **data = list->data;
+    for (size_t i = 0; i < 100; i++) {
+        strlist_appendf(&list, "record %zu", i);
+    }
+    STASIS_ASSERT(list->data == data, "appending reserved records should not reallocate");
+    STASIS_ASSERT(strcmp(strlist_item(list, 99), "record 99") == 0, "last record should be appended");
+
+    const size_t num_alloc = list->num_alloc;
+    STASIS_ASSERT(strlist_reserve(list, 10) == 0, "smaller reserve should succeed");
+    STASIS_ASSERT(list->num_alloc == num_alloc, "reserve should never shrink the list");
+    STASIS_ASSERT(strlist_reserve(NULL, 10) < 0, "NULL list should be an error");
+    guard_strlist_free(&list);
+}
+
+void test_strlist_append_owned() {
+    struct StrList *list = strlist_init();
+    char *data = strdup("owned by the list");
+    strlist_append_owned(&list, data);
+    STASIS_ASSERT(strlist_item(list, 0) == data, "record should not be copied");
+    STASIS_ASSERT(strlist_count(list) == 1, "record should be counted");
+    STASIS_ASSERT(list->data[1] == NULL, "list should be NULL terminated");
+    // data is released here
+    guard_strlist_free(&list);
+}
+
 void test_strlist_set() {
     struct StrList *list;
     list = strlist_init();
@@ -197,6 +229,14 @@ void test_strlist_append_tokenize() {
     STASIS_ASSERT(line_count + 1 == strlist_count(list), "unexpected number of lines in array");
     int trailing_item_is_empty = isempty(strlist_item(list, strlist_count(list) - 1));
     STASIS_ASSERT(trailing_item_is_empty, "trailing record should be an empty string");
+    STASIS_ASSERT(strcmp(strlist_item(list, 1), "We will split this string") == 0, "record should match line");
+
+    // Any character in the delimiter splits the string. Leading whitespace is removed.
+    strlist_append_tokenize(list, "  a, b,c", ",");
+    STASIS_ASSERT(strlist_count(list) == line_count + 4, "tokens should be appended to the existing list");
+    STASIS_ASSERT(strcmp(strlist_item(list, line_count + 2), "b") == 0, "leading whitespace should be removed");
+    strlist_append_tokenize_raw(list, " x; y", ";");
+    STASIS_ASSERT(strcmp(strlist_item(list, line_count + 5), " y") == 0, "raw tokens should not be modified");
     guard_strlist_free(&list);
 }
 
@@ -646,6 +686,8 @@ int main(int argc, char *argv[]) {
         test_strlist_init,
         test_strlist_free,
         test_strlist_append,
+        test_strlist_reserve,
+        test_strlist_append_owned,
         test_strlist_append_many_records,
         test_strlist_set,
         test_strlist_append_file,
@@ -133,12 +133,60 @@ void test_tpl_register_func() {
     guard_free(result);
 }
 
+void test_tpl_compile() {
+    char *data = strdup("one");
+    tpl_reset();
+    tpl_register("value", &data);
+    tpl_register_func("add", &adder, 2, NULL);
+
+    struct Template *tpl = tpl_compile("{{ value }}-{{value}}{{ value }} = {{ func:add(1, 2) }}");
+    STASIS_ASSERT_FATAL(tpl != NULL, "template should compile");
+    STASIS_ASSERT(tpl->num_used == 6, "unexpected number of tokens");
+
+    char *result = tpl_render_compiled(tpl);
+    STASIS_ASSERT(result != NULL && strcmp(result, "one-oneone = 3") == 0, "adjacent keys should be rendered");
+    guard_free(result);
+
+    // Values are read at render time
+    guard_free(data);
+    data = strdup("two");
+    result = tpl_render_compiled(tpl);
+    STASIS_ASSERT(result != NULL && strcmp(result, "two-twotwo = 3") == 0, "compiled template should use the current value");
+    guard_free(result);
+
+    STASIS_ASSERT(tpl_render_compiled_to_file(tpl, "compiled.txt") == 0, "failed to write rendered template to file");
+    char *contents = stasis_testing_read_ascii("compiled.txt");
+    STASIS_ASSERT(contents != NULL && strcmp(contents, "two-twotwo = 3") == 0, "file contents do not match rendered template");
+    guard_free(contents);
+    remove("compiled.txt");
+    tpl_compiled_free(&tpl);
+    STASIS_ASSERT(tpl == NULL, "template should be NULL after free");
+
+    STASIS_ASSERT(tpl_compile("unbalanced {{ value") == NULL, "unbalanced brace should be an error");
+    STASIS_ASSERT(tpl_compile("{{ func:add }}") == NULL, "function without arguments should be an error");
+
+    // Large inputs render in one pass
+    const size_t count = 100000;
+    const char *item = "{{ value }} ";
+    char *big = calloc(count * strlen(item) + 1, sizeof(*big));
+    STASIS_ASSERT_FATAL(big != NULL, "unable to allocate template");
+    for (size_t i = 0; i < count; i++) {
+        memcpy(big + i * strlen(item), item, strlen(item));
+    }
+    result = tpl_render(big);
+    STASIS_ASSERT(result != NULL && strlen(result) == count * strlen("two "), "large template rendered incorrectly");
+    guard_free(result);
+    guard_free(big);
+    guard_free(data);
+}
+
 int main(int argc, char *argv[]) {
     STASIS_TEST_BEGIN_MAIN();
     STASIS_TEST_FUNC *tests[] = {
         test_tpl_workflow,
         test_tpl_register_func,
         test_tpl_register,
+        test_tpl_compile,
     };
     STASIS_TEST_RUN(tests);
     STASIS_TEST_END_MAIN();
@@ -42,10 +42,102 @@ void test_tests() {
     tests_free(&tests);
 }
 
+void test_tests_find() {
+    struct Tests *tests = tests_init(TEST_NUM_ALLOC_INITIAL);
+    STASIS_ASSERT_FATAL(tests != NULL, "tests structure allocation failed");
+    const char *names[] = {"Foo_Bar", "numpy", "foo-bar"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++) {
+        struct Test *test = test_init();
+        test->name = strdup(names[i]);
+        tests_add(tests, test);
+    }
+
+    STASIS_ASSERT(tests_find(tests, "foo.bar[extra]>=1.0") == tests->test[0], "first matching test should be found");
+    STASIS_ASSERT(tests_find(tests, "NumPy==2.0") == tests->test[1], "test should be found by spec");
+    STASIS_ASSERT(tests_find(tests, "scipy") == NULL, "unknown package should not be found");
+
+    // Tests added after a lookup are indexed too
+    struct Test *test = test_init();
+    test->name = strdup("scipy");
+    tests_add(tests, test);
+    STASIS_ASSERT(tests_find(tests, "scipy") == test, "new test should be found");
+    tests_free(&tests);
+}
+
+static int mock_repository(const char *path, const char *tag) {
+    char cmd[PATH_MAX * 2] = {0};
+    snprintf(cmd, sizeof(cmd),
+             "git init -q '%s'"
+             " && cd '%s'"
+             " && echo data > README"
+             " && git add README"
+             " && git -c user.name=stasis -c user.email=stasis@localhost commit -q -m 'initial commit'"
+             " && git tag %s",
+             path, path, tag);
+    return system(cmd);
+}
+
+void test_delivery_fetch_sources() {
+    struct Delivery ctx = {0};
+    char cwd[PATH_MAX] = {0};
+    char repo[3][PATH_MAX] = {0};
+    const char *names[] = {"fetch_a", "fetch_b", "fetch_missing"};
+
+    STASIS_ASSERT_FATAL(getcwd(cwd, sizeof(cwd)) != NULL, "unable to determine current directory");
+    ctx.storage.tmpdir = cwd;
+    ctx.storage.build_sources_dir = cwd;
+    ctx.tests = tests_init(3);
+    STASIS_ASSERT_FATAL(ctx.tests != NULL, "tests structure allocation failed");
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++) {
+        struct Test *test = test_init();
+        STASIS_ASSERT_FATAL(test != NULL, "test allocation failed");
+        snprintf(repo[i], sizeof(repo[i]), "%s/upstream_%s", cwd, names[i]);
+        test->name = strdup(names[i]);
+        test->repository = strdup(repo[i]);
+        test->version = strdup("1.0.0");
+        tests_add(ctx.tests, test);
+        if (i < 2) {
+            STASIS_ASSERT_FATAL(mock_repository(repo[i], test->version) == 0, "unable to create mock repository");
+        }
+    }
+
+    // One repository does not exist
+    STASIS_ASSERT(delivery_fetch_sources(&ctx) == 1, "expected exactly one repository to fail");
+    for (size_t i = 0; i < 2; i++) {
+        const struct Test *test = ctx.tests->test[i];
+        STASIS_ASSERT(test->repository_dir != NULL, "checkout path should be recorded");
+        if (test->repository_dir) {
+            char path[PATH_MAX] = {0};
+            snprintf(path, sizeof(path), "%s/README", test->repository_dir);
+            STASIS_ASSERT(access(path, F_OK) == 0, "checkout should contain the repository's files");
+        }
+        STASIS_ASSERT(test->repository_info_tag && startswith(test->repository_info_tag, "1.0.0"), "tag should be described");
+        STASIS_ASSERT(test->repository_info_ref && strlen(test->repository_info_ref) == 40, "commit hash should be recorded");
+    }
+    STASIS_ASSERT(ctx.tests->test[2]->repository_dir == NULL, "failed checkout should not be recorded");
+
+    // Fetch again through the git cache
+    char cache[PATH_MAX + 10] = {0};
+    snprintf(cache, sizeof(cache), "%s/git-cache", cwd);
+    globals.git_cache_dir = strdup(cache);
+    STASIS_ASSERT(delivery_fetch_sources(&ctx) == 1, "expected exactly one repository to fail");
+    for (size_t i = 0; i < 2; i++) {
+        const struct Test *test = ctx.tests->test[i];
+        STASIS_ASSERT(test->repository_dir != NULL, "checkout path should be recorded");
+        STASIS_ASSERT(test->repository_info_tag && startswith(test->repository_info_tag, "1.0.0"), "tag should be described");
+    }
+    guard_free(globals.git_cache_dir);
+
+    tests_free(&ctx.tests);
+}
+
 int main(int argc, char *argv[]) {
     STASIS_TEST_BEGIN_MAIN();
     STASIS_TEST_FUNC *tests[] = {
         test_tests,
+        test_tests_find,
+        test_delivery_fetch_sources,
     };
     STASIS_TEST_RUN(tests);
     STASIS_TEST_END_MAIN();
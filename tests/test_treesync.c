@@ -0,0 +1,210 @@
+#include "testing.h"
+#include "treesync.h"
+
+static int file_equals(const char *filename, const char *data) {
+    char *content = stasis_testing_read_ascii(filename);
+    const int result = content && !strcmp(content, data);
+    guard_free(content);
+    return result;
+}
+
+static void set_mtime(const char *filename, time_t when) {
+    const struct timespec times[2] = {{.tv_sec = when}, {.tv_sec = when}};
+    utimensat(AT_FDCWD, filename, times, AT_SYMLINK_NOFOLLOW);
+}
+
+static void mock_tree(const char *root) {
+    char path[PATH_MAX] = {0};
+    const char *files[] = {"a.txt", "sub/b.txt", "sub/deep/c.txt", "tmp/ignored.txt", "build.log"};
+
+    for (size_t i = 0; i < sizeof(files) / sizeof(*files); i++) {
+        snprintf(path, sizeof(path), "%s/%s", root, files[i]);
+        char *dir = path_dirname(strdup(path));
+        mkdirs(dir, 0755);
+        guard_free(dir);
+        stasis_testing_write_ascii(path, files[i]);
+        set_mtime(path, 1000000000);
+    }
+    snprintf(path, sizeof(path), "%s/link", root);
+    symlink("a.txt", path);
+}
+
+void test_tree_sync() {
+    struct TreeSyncOptions opts = {.exclude = strlist_init()};
+    struct TreeSyncStats stats = {0};
+    struct stat st;
+    char target[PATH_MAX] = {0};
+
+    strlist_append(&opts.exclude, "tmp/");
+    mock_tree("sync_src");
+    chmod("sync_src/sub/b.txt", 0600);
+
+    STASIS_ASSERT(tree_sync((char *[]) {"sync_src", NULL}, "sync_dest", &opts, &stats) == 0, "tree should be synchronized");
+    STASIS_ASSERT(stats.files == 5 && stats.copied == 5 && stats.skipped == 0, "every file should be copied");
+    STASIS_ASSERT(stats.bytes == strlen("a.txt") + strlen("sub/b.txt") + strlen("sub/deep/c.txt") + strlen("build.log"), "bytes should be counted");
+    STASIS_ASSERT(file_equals("sync_dest/a.txt", "a.txt"), "file should be copied");
+    STASIS_ASSERT(file_equals("sync_dest/sub/deep/c.txt", "sub/deep/c.txt"), "nested file should be copied");
+    STASIS_ASSERT(access("sync_dest/tmp", F_OK) != 0, "excluded directory should not be copied");
+    STASIS_ASSERT(readlink("sync_dest/link", target, sizeof(target) - 1) > 0 && !strcmp(target, "a.txt"), "symbolic link should be copied");
+    STASIS_ASSERT(stat("sync_dest/sub/b.txt", &st) == 0 && (st.st_mode & 0777) == 0600, "permissions should be preserved");
+    STASIS_ASSERT(st.st_mtime == 1000000000, "modification time should be preserved");
+
+    // Nothing changed
+    STASIS_ASSERT(tree_sync((char *[]) {"sync_src", NULL}, "sync_dest", &opts, &stats) == 0, "tree should be synchronized");
+    STASIS_ASSERT(stats.copied == 0 && stats.skipped == 5, "unchanged files should be skipped");
+
+    // Same size and modification time. Only a strict comparison notices.
+    stasis_testing_write_ascii("sync_src/a.txt", "A.TXT");
+    set_mtime("sync_src/a.txt", 1000000000);
+    STASIS_ASSERT(tree_sync((char *[]) {"sync_src", NULL}, "sync_dest", &opts, &stats) == 0, "tree should be synchronized");
+    STASIS_ASSERT(stats.copied == 0 && file_equals("sync_dest/a.txt", "a.txt"), "size and modification time should be trusted");
+    opts.strict = true;
+    STASIS_ASSERT(tree_sync((char *[]) {"sync_src", NULL}, "sync_dest", &opts, &stats) == 0, "tree should be synchronized");
+    STASIS_ASSERT(stats.copied == 1 && file_equals("sync_dest/a.txt", "A.TXT"), "strict mode should compare contents");
+    opts.strict = false;
+
+    stasis_testing_write_ascii("sync_src/build.log", "more data");
+    STASIS_ASSERT(tree_sync((char *[]) {"sync_src", NULL}, "sync_dest", &opts, &stats) == 0, "tree should be synchronized");
+    STASIS_ASSERT(stats.copied == 1 && file_equals("sync_dest/build.log", "more data"), "modified file should be copied");
+
+    STASIS_ASSERT(tree_sync((char *[]) {"sync_src_missing", NULL}, "sync_dest", &opts, &stats) < 0, "missing source should be an error");
+    guard_strlist_free(&opts.exclude);
+}
+
+void test_tree_sync_delete() {
+    struct TreeSyncOptions opts = {.exclude = strlist_init()};
+    struct TreeSyncStats stats = {0};
+
+    strlist_append(&opts.exclude, "tmp/");
+    mock_tree("delete_src");
+    mkdirs("delete_dest/stale/dir", 0755);
+    mkdirs("delete_dest/sub", 0755);
+    mkdirs("delete_dest/tmp", 0755);
+    mkdirs("delete_dest/a.txt", 0755);
+    stasis_testing_write_ascii("delete_dest/stale.txt", "stale");
+    stasis_testing_write_ascii("delete_dest/stale/dir/file.txt", "stale");
+    stasis_testing_write_ascii("delete_dest/sub/stale.txt", "stale");
+    stasis_testing_write_ascii("delete_dest/tmp/keep.txt", "keep");
+
+    STASIS_ASSERT(tree_sync((char *[]) {"delete_src", NULL}, "delete_dest", &opts, &stats) == 0, "tree should be synchronized");
+    STASIS_ASSERT(stats.deleted == 0 && access("delete_dest/stale.txt", F_OK) == 0, "nothing should be deleted by default");
+    STASIS_ASSERT(file_equals("delete_dest/a.txt", "a.txt"), "directory should be replaced by a file");
+
+    opts.delete = true;
+    STASIS_ASSERT(tree_sync((char *[]) {"delete_src", NULL}, "delete_dest", &opts, &stats) == 0, "tree should be synchronized");
+    STASIS_ASSERT(stats.deleted == 3, "extra entries should be deleted");
+    STASIS_ASSERT(access("delete_dest/stale.txt", F_OK) != 0, "extra file should be deleted");
+    STASIS_ASSERT(access("delete_dest/stale", F_OK) != 0, "extra directory should be deleted");
+    STASIS_ASSERT(access("delete_dest/sub/stale.txt", F_OK) != 0, "extra nested file should be deleted");
+    STASIS_ASSERT(access("delete_dest/tmp/keep.txt", F_OK) == 0, "excluded entries should never be deleted");
+    STASIS_ASSERT(file_equals("delete_dest/sub/b.txt", "sub/b.txt"), "source files should be kept");
+    guard_strlist_free(&opts.exclude);
+}
+
+void test_tree_sync_include() {
+    struct TreeSyncOptions opts = {.include = strlist_init(), .exclude = strlist_init()};
+    struct TreeSyncStats stats = {0};
+
+    strlist_append(&opts.include, "*.txt");
+    strlist_append(&opts.exclude, "sub/deep");
+    mock_tree("include_src");
+
+    STASIS_ASSERT(tree_sync((char *[]) {"include_src", NULL}, "include_dest", &opts, &stats) == 0, "tree should be synchronized");
+    STASIS_ASSERT(access("include_dest/a.txt", F_OK) == 0, "included file should be copied");
+    STASIS_ASSERT(access("include_dest/tmp/ignored.txt", F_OK) == 0, "included file should be copied");
+    STASIS_ASSERT(access("include_dest/sub/b.txt", F_OK) == 0, "included file should be copied");
+    STASIS_ASSERT(access("include_dest/build.log", F_OK) != 0, "file should not be copied unless included");
+    STASIS_ASSERT(access("include_dest/sub/deep", F_OK) != 0, "path pattern should exclude directory");
+    guard_strlist_free(&opts.include);
+    guard_strlist_free(&opts.exclude);
+}
+
+void test_tree_sync_merge() {
+    struct TreeSyncStats stats = {0};
+
+    mkdirs("merge_a/shared", 0755);
+    mkdirs("merge_b/shared", 0755);
+    mkdirs("merge_b/conflict", 0755);
+    stasis_testing_write_ascii("merge_a/shared/file.txt", "a");
+    stasis_testing_write_ascii("merge_b/shared/file.txt", "b");
+    stasis_testing_write_ascii("merge_b/shared/only_b.txt", "b");
+    stasis_testing_write_ascii("merge_a/conflict", "a");
+    stasis_testing_write_ascii("merge_b/conflict/file.txt", "b");
+
+    STASIS_ASSERT(tree_sync((char *[]) {"merge_a", "merge_b", NULL}, "merge_dest", NULL, &stats) == 0, "trees should be merged");
+    STASIS_ASSERT(file_equals("merge_dest/shared/file.txt", "a"), "first source should win");
+    STASIS_ASSERT(file_equals("merge_dest/shared/only_b.txt", "b"), "directories should be merged");
+    STASIS_ASSERT(file_equals("merge_dest/conflict", "a"), "first source should win a type conflict");
+
+    // Like "rsync dir file dest/"
+    STASIS_ASSERT(tree_sync_files((char *[]) {"merge_a/shared", "merge_b/shared/only_b.txt", NULL}, "merge_files", NULL, &stats) == 0, "files should be copied");
+    STASIS_ASSERT(file_equals("merge_files/shared/file.txt", "a"), "directory should be copied by name");
+    STASIS_ASSERT(file_equals("merge_files/only_b.txt", "b"), "file should be copied by name");
+    STASIS_ASSERT(stats.copied == 2, "files should be counted");
+}
+
+void test_tree_sync_hardlinks() {
+    struct TreeSyncStats stats = {0};
+    struct stat st_src, st_dest;
+
+    mkdirs("links_src", 0755);
+    stasis_testing_write_ascii("links_src/file.txt", "original");
+    chmod("links_src/file.txt", 0644);
+    link("links_src/file.txt", "links_src/file_1.txt");
+    link("links_src/file.txt", "links_src/file_2.txt");
+    STASIS_ASSERT_FATAL(stat("links_src/file.txt", &st_src) == 0 && st_src.st_nlink > 2, "source should have several links");
+
+    STASIS_ASSERT(tree_sync((char *[]) {"links_src", NULL}, "links_dest", NULL, &stats) == 0, "tree should be synchronized");
+    STASIS_ASSERT(stat("links_dest/file.txt", &st_dest) == 0 && st_dest.st_ino != st_src.st_ino, "destination should not share an inode with the source");
+
+    // Editing the destination must not edit the source
+    stasis_testing_write_ascii("links_dest/file.txt", "modified");
+    STASIS_ASSERT(file_equals("links_src/file.txt", "original"), "source should be unchanged");
+
+    // A hard link left in the destination by an earlier sync is replaced with a copy
+    unlink("links_dest/file_1.txt");
+    link("links_src/file_1.txt", "links_dest/file_1.txt");
+    STASIS_ASSERT(tree_sync((char *[]) {"links_src", NULL}, "links_dest", NULL, &stats) == 0, "tree should be synchronized");
+    STASIS_ASSERT(stat("links_dest/file_1.txt", &st_dest) == 0 && st_dest.st_ino != st_src.st_ino, "hard link should be replaced with a copy");
+}
+
+void test_tree_sync_jobs() {
+    struct TreeSyncOptions opts = {.jobs = 4};
+    struct TreeSyncStats stats = {0};
+    const size_t count = 200;
+
+    for (size_t i = 0; i < count; i++) {
+        char path[PATH_MAX] = {0};
+        snprintf(path, sizeof(path), "jobs_src/%zu", i % 10);
+        mkdirs(path, 0755);
+        snprintf(path, sizeof(path), "jobs_src/%zu/%zu.txt", i % 10, i);
+        stasis_testing_write_ascii(path, path);
+    }
+
+    STASIS_ASSERT(tree_sync((char *[]) {"jobs_src", NULL}, "jobs_dest", &opts, &stats) == 0, "tree should be synchronized");
+    STASIS_ASSERT(stats.files == count && stats.copied == count, "workers should copy every file");
+    STASIS_ASSERT(stats.dirs == 10, "directories should be created");
+    for (size_t i = 0; i < count; i++) {
+        char src[PATH_MAX] = {0};
+        char dest[PATH_MAX] = {0};
+        snprintf(src, sizeof(src), "jobs_src/%zu/%zu.txt", i % 10, i);
+        snprintf(dest, sizeof(dest), "jobs_dest/%zu/%zu.txt", i % 10, i);
+        STASIS_ASSERT(file_equals(dest, src), "file should be copied");
+    }
+    STASIS_ASSERT(tree_sync((char *[]) {"jobs_src", NULL}, "jobs_dest", &opts, &stats) == 0, "tree should be synchronized");
+    STASIS_ASSERT(stats.skipped == count && stats.copied == 0, "workers should skip every file");
+}
+
+int main(int argc, char *argv[]) {
+    STASIS_TEST_BEGIN_MAIN();
+    STASIS_TEST_FUNC *tests[] = {
+        test_tree_sync,
+        test_tree_sync_delete,
+        test_tree_sync_include,
+        test_tree_sync_merge,
+        test_tree_sync_hardlinks,
+        test_tree_sync_jobs,
+    };
+    STASIS_TEST_RUN(tests);
+    STASIS_TEST_END_MAIN();
+}
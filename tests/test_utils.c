@@ -28,6 +28,7 @@ void test_redact_sensitive() {
             "100 dollars!",
             "bananas apples pears",
             "have a safe trip",
+            "token=bananas&retry=bananas",
     };
     const char *to_redact[] = {
             "dollars",
@@ -39,6 +40,7 @@ void test_redact_sensitive() {
             "100 ***REDACTED***!",
             "***REDACTED*** apples pears",
             "***REDACTED***",
+            "token=***REDACTED***&retry=***REDACTED***",
     };
 
     for (size_t i = 0; i < sizeof(data) / sizeof(*data); i++) {
@@ -301,6 +303,98 @@ void test_file_readlines() {
     remove(filename);
 }
 
+static int file_foreach_line_collect(size_t line, const char *data, size_t len, void *arg) {
+    struct StrList **lines = arg;
+    STASIS_ASSERT(line == strlist_count(*lines), "lines should be visited in order");
+    strlist_append_owned(lines, strndup(data, len));
+    return strlist_count(*lines) < 3 ? 0 : -1;
+}
+
+void test_file_foreach_line() {
+    const char *filename = "file_foreach_line.txt";
+    const size_t long_len = STASIS_BUFSIZ * 3;
+    char *long_line = malloc(long_len + 1);
+    STASIS_ASSERT_FATAL(long_line != NULL, "unable to allocate long line");
+    memset(long_line, 'x', long_len);
+    long_line[long_len] = '\0';
+
+    FILE *fp = fopen(filename, "w");
+    STASIS_ASSERT_FATAL(fp != NULL, "unable to create file");
+    fprintf(fp, "first\n%s\nno line ending", long_line);
+    fclose(fp);
+
+    // Regular files are mapped
+    struct StrList *lines = strlist_init();
+    STASIS_ASSERT(file_foreach_line(filename, file_foreach_line_collect, &lines) == 0, "file should be read");
+    STASIS_ASSERT(strlist_count(lines) == 3, "every line should be visited");
+    STASIS_ASSERT(strcmp(strlist_item(lines, 0), "first\n") == 0, "line ending should be included");
+    STASIS_ASSERT(strlen(strlist_item(lines, 1)) == long_len + 1, "long lines should not be split");
+    STASIS_ASSERT(strcmp(strlist_item(lines, 2), "no line ending") == 0, "last line should not require a line ending");
+    guard_strlist_free(&lines);
+
+    // Pipes are streamed
+    lines = strlist_init();
+    STASIS_ASSERT_FATAL(mkfifo("file_foreach_line.fifo", 0600) == 0, "unable to create fifo");
+    pid_t pid = fork();
+    if (pid == 0) {
+        FILE *writer = fopen("file_foreach_line.fifo", "w");
+        if (!writer) {
+            _exit(1);
+        }
+        fprintf(writer, "first\n%s\nno line ending", long_line);
+        fclose(writer);
+        _exit(0);
+    }
+    STASIS_ASSERT(file_foreach_line("file_foreach_line.fifo", file_foreach_line_collect, &lines) == 0, "fifo should be read");
+    waitpid(pid, NULL, 0);
+    STASIS_ASSERT(strlist_count(lines) == 3, "every line should be visited");
+    STASIS_ASSERT(strlen(strlist_item(lines, 1)) == long_len + 1, "long lines should not be split");
+    STASIS_ASSERT(strcmp(strlist_item(lines, 2), "no line ending") == 0, "last line should not require a line ending");
+    guard_strlist_free(&lines);
+    remove("file_foreach_line.fifo");
+
+    // The visitor can stop early
+    fp = fopen(filename, "w");
+    STASIS_ASSERT_FATAL(fp != NULL, "unable to create file");
+    fprintf(fp, "1\n2\n3\n4\n5\n");
+    fclose(fp);
+    lines = strlist_init();
+    STASIS_ASSERT(file_foreach_line(filename, file_foreach_line_collect, &lines) == 0, "file should be read");
+    STASIS_ASSERT(strlist_count(lines) == 3, "visitor should stop after three lines");
+    guard_strlist_free(&lines);
+
+    char **result = file_readlines(filename, 1, 2, NULL);
+    STASIS_ASSERT_FATAL(result != NULL, "lines should be read");
+    STASIS_ASSERT(strcmp(result[0], "2\n") == 0 && strcmp(result[1], "3\n") == 0 && result[2] == NULL, "start and limit should select lines 2 and 3");
+    guard_array_free(result);
+
+    STASIS_ASSERT(file_foreach_line("file_foreach_line_missing.txt", file_foreach_line_collect, &lines) < 0, "missing file should be an error");
+    remove(filename);
+    guard_free(long_line);
+}
+
+void test_check_python_package_dependencies() {
+    mkdir("vcs_project", 0755);
+    FILE *fp = fopen("vcs_project/setup.cfg", "w");
+    STASIS_ASSERT_FATAL(fp != NULL, "unable to create setup.cfg");
+    fprintf(fp, "[options]\ninstall_requires =\n    numpy\n");
+    fclose(fp);
+    STASIS_ASSERT(check_python_package_dependencies("vcs_project") == 0, "plain requirements should be accepted");
+
+    fp = fopen("vcs_project/setup.cfg", "a");
+    STASIS_ASSERT_FATAL(fp != NULL, "unable to update setup.cfg");
+    fprintf(fp, "    # example @ git+https://example.com/example\n");
+    fclose(fp);
+    STASIS_ASSERT(check_python_package_dependencies("vcs_project") == 0, "commented requirements should be ignored");
+
+    fp = fopen("vcs_project/setup.cfg", "a");
+    STASIS_ASSERT_FATAL(fp != NULL, "unable to update setup.cfg");
+    fprintf(fp, "    example @ git+https://example.com/example\n");
+    fclose(fp);
+    STASIS_ASSERT(check_python_package_dependencies("vcs_project") == 1, "VCS requirements should be detected");
+    rmtree("vcs_project");
+}
+
 void test_path_dirname() {
     const char *data[] = {
             "a/b/c", "a/b",
@@ -380,6 +474,60 @@ void test_rmtree() {
     STASIS_ASSERT(access(root, F_OK) < 0, "the directory is still present");
 }
 
+void test_rmtree_parallel() {
+    const size_t jobs[] = {1, 4};
+    chdir(cwd_workspace);
+
+    mkdir("rmtree_keep", 0755);
+    touch("rmtree_keep/file.txt");
+    for (size_t j = 0; j < sizeof(jobs) / sizeof(*jobs); j++) {
+        struct StrList *failed = NULL;
+        char path[PATH_MAX];
+        for (size_t i = 0; i < 50; i++) {
+            snprintf(path, sizeof(path), "rmtree_parallel/%zu/%zu/%zu", i % 5, i % 3, i);
+            mkdirs(path, 0755);
+            snprintf(path, sizeof(path), "rmtree_parallel/%zu/%zu/%zu/file.txt", i % 5, i % 3, i);
+            touch(path);
+        }
+        touch("rmtree_parallel/top.txt");
+        // Links must be removed, not followed
+        symlink("../rmtree_keep", "rmtree_parallel/link");
+        symlink("../../rmtree_keep", "rmtree_parallel/0/link");
+        mkdirs("rmtree_parallel/readonly/dir", 0755);
+        touch("rmtree_parallel/readonly/dir/file.txt");
+        chmod("rmtree_parallel/readonly/dir", 0555);
+
+        STASIS_ASSERT(rmtree_parallel("rmtree_parallel", jobs[j], &failed) == 0, "tree should be removed");
+        STASIS_ASSERT(strlist_count(failed) == 0, "nothing should fail");
+        STASIS_ASSERT(access("rmtree_parallel", F_OK) < 0, "the directory is still present");
+        STASIS_ASSERT(access("rmtree_keep/file.txt", F_OK) == 0, "symbolic link was followed");
+        guard_strlist_free(&failed);
+    }
+    STASIS_ASSERT(rmtree_parallel("rmtree_parallel_missing", 4, NULL) < 0, "missing directory should be an error");
+}
+
+void test_rmtree_background() {
+    chdir(cwd_workspace);
+
+    mkdirs("rmtree_background/a/b/c", 0755);
+    touch("rmtree_background/a/b/c/file.txt");
+    STASIS_ASSERT(rmtree_background("rmtree_background", 2) == 0, "tree should be removed in the background");
+    STASIS_ASSERT(access("rmtree_background", F_OK) < 0, "the directory should be moved out of the way");
+    STASIS_ASSERT(mkdir("rmtree_background", 0755) == 0, "the directory should be usable immediately");
+    STASIS_ASSERT(rmtree_wait() == 0, "background removal should succeed");
+
+    struct StrList *hidden = listdir(".");
+    size_t leftovers = 0;
+    for (size_t i = 0; i < strlist_count(hidden); i++) {
+        if (strstr(strlist_item(hidden, i), ".stasis-rm-")) {
+            leftovers++;
+        }
+    }
+    STASIS_ASSERT(leftovers == 0, "background removal should remove the renamed tree");
+    guard_strlist_free(&hidden);
+    rmtree("rmtree_background");
+}
+
 void test_dirstack() {
     const char *data[] = {
         "testdir",
@@ -469,10 +617,14 @@ int main(int argc, char *argv[]) {
             test_touch,
             test_find_program,
             test_file_readlines,
+            test_file_foreach_line,
+            test_check_python_package_dependencies,
             test_path_dirname,
             test_path_basename,
             test_expandpath,
             test_rmtree,
+            test_rmtree_parallel,
+            test_rmtree_background,
             test_dirstack,
             test_pushd_popd,
             test_pushd_popd_suggested_workflow,
@@ -2,6 +2,7 @@
 #include "testing.h"
 #include "str.h"
 #include "wheel.h"
+#include "sha256.h"
 
 char cwd_start[PATH_MAX];
 char cwd_workspace[PATH_MAX];
@@ -53,6 +54,91 @@ static void test_wheel_package() {
     STASIS_ASSERT(wheel == NULL, "wheel struct should be NULL after free");
 }
 
+static void test_wheel_archive() {
+    struct WheelArchive *archive = wheel_archive_open(testpkg_filename);
+    STASIS_ASSERT_FATAL(archive != NULL, "wheel archive should open");
+    STASIS_ASSERT(archive->member[WHEEL_ARCHIVE_WHEEL] >= 0, "WHEEL should be indexed");
+    STASIS_ASSERT(archive->member[WHEEL_ARCHIVE_METADATA] >= 0, "METADATA should be indexed");
+    STASIS_ASSERT(archive->member[WHEEL_ARCHIVE_RECORD] >= 0, "RECORD should be indexed");
+    STASIS_ASSERT(archive->member[WHEEL_ARCHIVE_ZIP_SAFE] < 0, "zip-safe marker should not be indexed");
+
+    char *data = NULL;
+    char *expected = NULL;
+    STASIS_ASSERT(wheel_archive_read(archive, WHEEL_ARCHIVE_METADATA, &data) == 0, "METADATA should be readable");
+    STASIS_ASSERT(wheel_get_file_contents(testpkg_filename, "*.dist-info/METADATA", &expected) == 0, "METADATA should be readable");
+    STASIS_ASSERT(data && expected && !strcmp(data, expected), "handle and path should read the same data");
+    guard_free(data);
+    guard_free(expected);
+
+    STASIS_ASSERT(wheel_archive_read(archive, WHEEL_ARCHIVE_ZIP_SAFE, &data) == 1 && data == NULL, "missing file should not be read");
+    STASIS_ASSERT(wheel_archive_read(archive, WHEEL_ARCHIVE_END_ENUM, &data) < 0, "invalid member should be an error");
+    wheel_archive_close(&archive);
+    STASIS_ASSERT(archive == NULL, "archive should be NULL after close");
+    STASIS_ASSERT(wheel_archive_open("testpkg/dist/missing.whl") == NULL, "missing wheel should not open");
+}
+
+static void record_line(char *dest, size_t maxlen, const char *name, const char *data) {
+    struct SHA256 sha;
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char encoded[SHA256_BASE64_SIZE];
+    sha256_init(&sha);
+    sha256_update(&sha, data, strlen(data));
+    sha256_final(&sha, digest);
+    sha256_base64(digest, encoded);
+    snprintf(dest + strlen(dest), maxlen - strlen(dest), "%s,sha256=%s,%zu\n", name, encoded, strlen(data));
+}
+
+static void test_wheel_verify_records() {
+    STASIS_ASSERT(wheel_verify_records(testpkg_filename) == 0, "wheel built by setuptools should match its RECORD");
+
+    const char *init = "print('hello')\n";
+    const char *metadata = "Metadata-Version: 2.1\nName: mock\nVersion: 1.0\n";
+    char record[1024] = {0};
+    record_line(record, sizeof(record), "mock/__init__.py", init);
+    record_line(record, sizeof(record), "mock-1.0.dist-info/METADATA", metadata);
+    strcat(record, "mock-1.0.dist-info/RECORD,,\n");
+
+    stasis_testing_write_zip("verify_good.whl", (const char *[]) {
+        "mock/", "",
+        "mock/__init__.py", init,
+        "mock-1.0.dist-info/METADATA", metadata,
+        "mock-1.0.dist-info/RECORD", record,
+        NULL,
+    });
+    STASIS_ASSERT(wheel_verify_records("verify_good.whl") == 0, "matching wheel should verify");
+
+    stasis_testing_write_zip("verify_modified.whl", (const char *[]) {
+        "mock/__init__.py", "print('HELLO')\n",
+        "mock-1.0.dist-info/METADATA", metadata,
+        "mock-1.0.dist-info/RECORD", record,
+        NULL,
+    });
+    STASIS_ASSERT(wheel_verify_records("verify_modified.whl") == 1, "modified member should be reported");
+
+    stasis_testing_write_zip("verify_extra.whl", (const char *[]) {
+        "mock/__init__.py", init,
+        "mock/extra.py", "",
+        "mock-1.0.dist-info/METADATA", metadata,
+        "mock-1.0.dist-info/RECORD", record,
+        NULL,
+    });
+    STASIS_ASSERT(wheel_verify_records("verify_extra.whl") == 1, "unlisted member should be reported");
+
+    stasis_testing_write_zip("verify_missing.whl", (const char *[]) {
+        "mock-1.0.dist-info/METADATA", metadata,
+        "mock-1.0.dist-info/RECORD", record,
+        NULL,
+    });
+    STASIS_ASSERT(wheel_verify_records("verify_missing.whl") == 1, "missing member should be reported");
+
+    stasis_testing_write_zip("verify_no_record.whl", (const char *[]) {
+        "mock-1.0.dist-info/METADATA", metadata,
+        NULL,
+    });
+    STASIS_ASSERT(wheel_verify_records("verify_no_record.whl") < 0, "wheel without RECORD should be an error");
+    STASIS_ASSERT(wheel_verify_records("verify_not_found.whl") < 0, "missing wheel should be an error");
+}
+
 static void mock_python_package() {
     const char *pyproject_toml_data = "[build-system]\n"
         "requires = [\"setuptools >= 77.0.3\"]\n"
@@ -108,6 +194,8 @@ int main(int argc, char *argv[]) {
     STASIS_TEST_BEGIN_MAIN();
     STASIS_TEST_FUNC *tests[] = {
         test_wheel_package,
+        test_wheel_archive,
+        test_wheel_verify_records,
     };
 
     char ws[] = "workspace_XXXXXX";
@@ -0,0 +1,138 @@
+#include "testing.h"
+#include "wheelcatalog.h"
+#include "sha256.h"
+
+static void mock_wheel(const char *filename, const char *name, const char *version, const char *requires) {
+    char dist_info[255] = {0};
+    char wheel_path[255] = {0};
+    char metadata_path[255] = {0};
+    char metadata[1024] = {0};
+
+    snprintf(dist_info, sizeof(dist_info), "%s-%s.dist-info", name, version);
+    snprintf(wheel_path, sizeof(wheel_path), "%s/WHEEL", dist_info);
+    snprintf(metadata_path, sizeof(metadata_path), "%s/METADATA", dist_info);
+    snprintf(metadata, sizeof(metadata),
+             "Metadata-Version: 2.1\n"
+             "Name: %s\n"
+             "Version: %s\n"
+             "Requires-Python: >=3.10\n"
+             "%s"
+             "\n"
+             "Requires-Dist: not a header\n", name, version, requires);
+
+    char *dir = path_dirname(strdup(filename));
+    mkdirs(dir, 0755);
+    guard_free(dir);
+    stasis_testing_write_zip(filename, (const char *[]) {
+        "mypkg/__init__.py", "",
+        wheel_path, "Wheel-Version: 1.0\nGenerator: test\nRoot-Is-Purelib: true\nTag: py3-none-any\nTag: py2-none-any\n",
+        metadata_path, metadata,
+        NULL,
+    });
+}
+
+static void set_mtime(const char *filename, time_t when) {
+    const struct timespec times[2] = {{.tv_sec = when}, {.tv_sec = when}};
+    utimensat(AT_FDCWD, filename, times, 0);
+}
+
+void test_wheel_catalog_build() {
+    const char *catalog_file = "wheels/" WHEEL_CATALOG_FILENAME;
+    size_t count = 0;
+
+    mock_wheel("wheels/my-pkg/My_Pkg-1.0-py3-none-any.whl", "My_Pkg", "1.0", "Requires-Dist: numpy>=1.26\nRequires-Dist: pytest; extra == \"test\"\n");
+    mock_wheel("wheels/my-pkg/My_Pkg-1.10-py3-none-any.whl", "My_Pkg", "1.10", "");
+    mock_wheel("wheels/my-pkg/My_Pkg-1.9-py3-none-any.whl", "My_Pkg", "1.9", "");
+    mock_wheel("wheels/other/other-2.0-py3-none-any.whl", "other", "2.0", "");
+    stasis_testing_write_ascii("wheels/other/broken-1.0-py3-none-any.whl", "not a zip file");
+    stasis_testing_write_ascii("wheels/other/index.html", "");
+
+    STASIS_ASSERT(wheel_catalog_build("wheels", catalog_file, 4) == 1, "unreadable wheel should be reported");
+    struct WheelCatalog *catalog = wheel_catalog_load(catalog_file);
+    STASIS_ASSERT_FATAL(catalog != NULL, "catalog should be readable");
+    STASIS_ASSERT(catalog->num_used == 4, "every readable wheel should be recorded");
+
+    const struct WheelCatalogEntry *entry = wheel_catalog_find(catalog, "my.pkg", &count);
+    STASIS_ASSERT_FATAL(entry != NULL && count == 3, "project should be found by normalized name");
+    STASIS_ASSERT(!strcmp(entry[0].version, "1.0") && !strcmp(entry[1].version, "1.9") && !strcmp(entry[2].version, "1.10"), "versions should be sorted");
+    STASIS_ASSERT(!strcmp(entry[0].name, "my-pkg"), "name should be normalized");
+    STASIS_ASSERT(!strcmp(entry[0].path, "my-pkg/My_Pkg-1.0-py3-none-any.whl"), "path should be relative");
+    STASIS_ASSERT(entry[0].requires_python && !strcmp(entry[0].requires_python, ">=3.10"), "Requires-Python should be recorded");
+    STASIS_ASSERT(strlist_count(entry[0].tag) == 2 && !strcmp(strlist_item(entry[0].tag, 1), "py2-none-any"), "tags should be recorded");
+    STASIS_ASSERT(strlist_count(entry[0].requires_dist) == 2, "Requires-Dist should be recorded");
+    STASIS_ASSERT(!strcmp(strlist_item(entry[0].requires_dist, 1), "pytest; extra == \"test\""), "markers should be kept");
+    STASIS_ASSERT(strlist_count(entry[1].requires_dist) == 0, "message body should be ignored");
+
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char hex[SHA256_HEX_SIZE];
+    sha256_file("wheels/my-pkg/My_Pkg-1.0-py3-none-any.whl", digest);
+    sha256_hex(digest, hex);
+    STASIS_ASSERT(entry[0].sha256 && !strcmp(entry[0].sha256, hex), "wheel digest should be recorded");
+    STASIS_ASSERT(entry[0].metadata_sha256 && strlen(entry[0].metadata_sha256) == SHA256_HEX_SIZE - 1, "METADATA digest should be recorded");
+    STASIS_ASSERT(strcmp(entry[0].metadata_sha256, entry[1].metadata_sha256) != 0, "METADATA digests should differ");
+    STASIS_ASSERT(wheel_catalog_find(catalog, "missing", &count) == NULL && count == 0, "missing project should not be found");
+    wheel_catalog_free(&catalog);
+    STASIS_ASSERT(catalog == NULL, "catalog should be NULL after free");
+
+    // Same size and modification time. The previous entry is reused.
+    struct stat st;
+    stat("wheels/other/other-2.0-py3-none-any.whl", &st);
+    mock_wheel("wheels/other/other-2.0-py3-none-any.whl", "other", "2.1", "");
+    set_mtime("wheels/other/other-2.0-py3-none-any.whl", st.st_mtime);
+    remove("wheels/other/broken-1.0-py3-none-any.whl");
+    remove("wheels/my-pkg/My_Pkg-1.9-py3-none-any.whl");
+
+    STASIS_ASSERT(wheel_catalog_build("wheels", catalog_file, 1) == 0, "catalog should be updated");
+    catalog = wheel_catalog_load(catalog_file);
+    STASIS_ASSERT_FATAL(catalog != NULL, "catalog should be readable");
+    STASIS_ASSERT(catalog->num_used == 3, "removed wheels should be dropped");
+    entry = wheel_catalog_find(catalog, "other", &count);
+    STASIS_ASSERT(entry && !strcmp(entry->version, "2.0"), "unchanged wheel should not be read again");
+    wheel_catalog_free(&catalog);
+
+    set_mtime("wheels/other/other-2.0-py3-none-any.whl", st.st_mtime + 10);
+    STASIS_ASSERT(wheel_catalog_build("wheels", catalog_file, 1) == 0, "catalog should be updated");
+    catalog = wheel_catalog_load(catalog_file);
+    STASIS_ASSERT_FATAL(catalog != NULL, "catalog should be readable");
+    entry = wheel_catalog_find(catalog, "other", &count);
+    STASIS_ASSERT(entry && !strcmp(entry->version, "2.1"), "modified wheel should be read again");
+    wheel_catalog_free(&catalog);
+
+    STASIS_ASSERT(wheel_catalog_build("wheels_missing", "catalog_missing.txt", 1) < 0, "missing directory should be an error");
+    STASIS_ASSERT(access("catalog_missing.txt", F_OK) != 0, "catalog should not be written on error");
+}
+
+void test_wheel_catalog_jobs() {
+    const size_t total = 100;
+    for (size_t i = 0; i < total; i++) {
+        char filename[PATH_MAX] = {0};
+        char version[32] = {0};
+        snprintf(version, sizeof(version), "1.%zu", i);
+        snprintf(filename, sizeof(filename), "jobs/pkg/pkg-%s-py3-none-any.whl", version);
+        mock_wheel(filename, "pkg", version, "Requires-Dist: numpy\n");
+    }
+
+    STASIS_ASSERT(wheel_catalog_build("jobs", "jobs.catalog", 4) == 0, "catalog should be written");
+    struct WheelCatalog *catalog = wheel_catalog_load("jobs.catalog");
+    STASIS_ASSERT_FATAL(catalog != NULL, "catalog should be readable");
+    size_t count = 0;
+    const struct WheelCatalogEntry *entry = wheel_catalog_find(catalog, "pkg", &count);
+    STASIS_ASSERT_FATAL(entry != NULL && count == total, "every wheel should be recorded once");
+    for (size_t i = 0; i < count; i++) {
+        char version[32] = {0};
+        snprintf(version, sizeof(version), "1.%zu", i);
+        STASIS_ASSERT(!strcmp(entry[i].version, version), "entries should be complete and sorted");
+        STASIS_ASSERT(strlist_count(entry[i].requires_dist) == 1, "entries should not interleave");
+    }
+    wheel_catalog_free(&catalog);
+}
+
+int main(int argc, char *argv[]) {
+    STASIS_TEST_BEGIN_MAIN();
+    STASIS_TEST_FUNC *tests[] = {
+        test_wheel_catalog_build,
+        test_wheel_catalog_jobs,
+    };
+    STASIS_TEST_RUN(tests);
+    STASIS_TEST_END_MAIN();
+}
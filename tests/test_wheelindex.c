@@ -0,0 +1,132 @@
+#include "testing.h"
+#include "wheelindex.h"
+#include "sha256.h"
+
+static void mock_wheel(const char *filename, const char *name, const char *version, const char *requires_python) {
+    char wheel_path[255] = {0};
+    char metadata_path[255] = {0};
+    char metadata[1024] = {0};
+
+    snprintf(wheel_path, sizeof(wheel_path), "%s-%s.dist-info/WHEEL", name, version);
+    snprintf(metadata_path, sizeof(metadata_path), "%s-%s.dist-info/METADATA", name, version);
+    snprintf(metadata, sizeof(metadata),
+             "Metadata-Version: 2.1\n"
+             "Name: %s\n"
+             "Version: %s\n"
+             "Requires-Python: %s\n"
+             "\n", name, version, requires_python);
+
+    char *dir = path_dirname(strdup(filename));
+    mkdirs(dir, 0755);
+    guard_free(dir);
+    stasis_testing_write_zip(filename, (const char *[]) {
+        wheel_path, "Wheel-Version: 1.0\nTag: py3-none-any\n",
+        metadata_path, metadata,
+        NULL,
+    });
+}
+
+static void set_mtime(const char *filename, time_t when) {
+    const struct timespec times[2] = {{.tv_sec = when}, {.tv_sec = when}};
+    utimensat(AT_FDCWD, filename, times, 0);
+}
+
+static void file_digest(const char *filename, char *result) {
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    sha256_file(filename, digest);
+    sha256_hex(digest, result);
+}
+
+void test_wheel_index_build() {
+    char wheel_sha256[SHA256_HEX_SIZE];
+    char metadata_sha256[SHA256_HEX_SIZE];
+    char expected[1024];
+
+    mock_wheel("index/my_pkg/My_Pkg-1.0-py3-none-any.whl", "My_Pkg", "1.0", "<4,>=3.10");
+    mock_wheel("index/my_pkg/My_Pkg-1.1-py3-none-any.whl", "My_Pkg", "1.1", ">=3.10");
+    mock_wheel("index/other/other-2.0+local-py3-none-any.whl", "other", "2.0+local", ">=3.11");
+    stasis_testing_write_ascii("index/other/broken-1.0-py3-none-any.whl", "not a zip file");
+
+    STASIS_ASSERT(wheel_index_build("index", 2) == 1, "unreadable wheel should be reported");
+    file_digest("index/my_pkg/My_Pkg-1.0-py3-none-any.whl", wheel_sha256);
+    file_digest("index/my_pkg/My_Pkg-1.0-py3-none-any.whl.metadata", metadata_sha256);
+
+    char *metadata = stasis_testing_read_ascii("index/my_pkg/My_Pkg-1.0-py3-none-any.whl.metadata");
+    STASIS_ASSERT(metadata && startswith(metadata, "Metadata-Version: 2.1\nName: My_Pkg\n"), "metadata file should hold METADATA");
+    guard_free(metadata);
+
+    char *top = stasis_testing_read_ascii("index/index.html");
+    STASIS_ASSERT_FATAL(top != NULL, "top-level index should be written");
+    STASIS_ASSERT(strstr(top, "<a href=\"my-pkg/\">my-pkg</a><br/>\n<a href=\"other/\">other</a><br/>\n") != NULL, "projects should be listed once by normalized name");
+    STASIS_ASSERT(strstr(top, "<meta name=\"pypi:repository-version\" content=\"" WHEEL_INDEX_API_VERSION "\">") != NULL, "repository version should be declared");
+    guard_free(top);
+
+    char *page = stasis_testing_read_ascii("index/my-pkg/index.html");
+    STASIS_ASSERT_FATAL(page != NULL, "project index should be written");
+    snprintf(expected, sizeof(expected),
+             "<a href=\"../my_pkg/My_Pkg-1.0-py3-none-any.whl#sha256=%s\""
+             " data-requires-python=\"&lt;4,&gt;=3.10\""
+             " data-dist-info-metadata=\"sha256=%s\""
+             " data-core-metadata=\"sha256=%s\">My_Pkg-1.0-py3-none-any.whl</a><br/>\n",
+             wheel_sha256, metadata_sha256, metadata_sha256);
+    STASIS_ASSERT(strstr(page, expected) != NULL, "link should carry hashes and Requires-Python");
+    STASIS_ASSERT(strstr(page, "My_Pkg-1.1-py3-none-any.whl</a>") != NULL, "every version should be listed");
+    guard_free(page);
+
+    page = stasis_testing_read_ascii("index/other/index.html");
+    STASIS_ASSERT_FATAL(page != NULL, "project index should be written");
+    STASIS_ASSERT(strstr(page, "href=\"../other/other-2.0%2Blocal-py3-none-any.whl#sha256=") == NULL, "'+' should not be encoded");
+    STASIS_ASSERT(strstr(page, "href=\"../other/other-2.0+local-py3-none-any.whl#sha256=") != NULL, "link should be relative");
+    STASIS_ASSERT(strstr(page, "broken") == NULL, "unreadable wheel should not be listed");
+    guard_free(page);
+
+    char *json = stasis_testing_read_ascii("index/my-pkg/index.json");
+    STASIS_ASSERT_FATAL(json != NULL, "project JSON should be written");
+    snprintf(expected, sizeof(expected),
+             "{\"filename\": \"My_Pkg-1.0-py3-none-any.whl\", \"url\": \"../my_pkg/My_Pkg-1.0-py3-none-any.whl\","
+             " \"hashes\": {\"sha256\": \"%s\"}, \"requires-python\": \"<4,>=3.10\","
+             " \"core-metadata\": {\"sha256\": \"%s\"}, \"dist-info-metadata\": {\"sha256\": \"%s\"}",
+             wheel_sha256, metadata_sha256, metadata_sha256);
+    STASIS_ASSERT(startswith(json, "{\"meta\": {\"api-version\": \"" WHEEL_INDEX_API_VERSION "\"}, \"name\": \"my-pkg\""), "JSON should declare the API version");
+    STASIS_ASSERT(strstr(json, expected) != NULL, "JSON file entry should carry hashes and Requires-Python");
+    STASIS_ASSERT(strstr(json, "\"versions\": [\"1.0\", \"1.1\"]}") != NULL, "JSON should list versions");
+    guard_free(json);
+
+    json = stasis_testing_read_ascii("index/index.json");
+    STASIS_ASSERT(json && strstr(json, "\"projects\": [{\"name\": \"my-pkg\"}, {\"name\": \"other\"}]}") != NULL, "top-level JSON should list projects");
+    guard_free(json);
+
+    // A replaced wheel gets a new metadata file, even when it is older
+    struct stat st;
+    stat("index/my_pkg/My_Pkg-1.0-py3-none-any.whl.metadata", &st);
+    mock_wheel("index/my_pkg/My_Pkg-1.0-py3-none-any.whl", "My_Pkg", "1.0", ">=3.12");
+    set_mtime("index/my_pkg/My_Pkg-1.0-py3-none-any.whl", st.st_mtime - 100);
+    remove("index/other/broken-1.0-py3-none-any.whl");
+    STASIS_ASSERT(wheel_index_build("index", 1) == 0, "index should be updated");
+    metadata = stasis_testing_read_ascii("index/my_pkg/My_Pkg-1.0-py3-none-any.whl.metadata");
+    STASIS_ASSERT(metadata && strstr(metadata, "Requires-Python: >=3.12\n") != NULL, "metadata file should be replaced");
+    guard_free(metadata);
+    page = stasis_testing_read_ascii("index/my-pkg/index.html");
+    STASIS_ASSERT(page && strstr(page, "data-requires-python=\"&gt;=3.12\"") != NULL, "project index should be updated");
+    guard_free(page);
+
+    // ...and when it keeps the same modification time
+    stat("index/my_pkg/My_Pkg-1.0-py3-none-any.whl", &st);
+    mock_wheel("index/my_pkg/My_Pkg-1.0-py3-none-any.whl", "My_Pkg", "1.0", ">=3.12.1");
+    set_mtime("index/my_pkg/My_Pkg-1.0-py3-none-any.whl", st.st_mtime);
+    STASIS_ASSERT(wheel_index_build("index", 1) == 0, "index should be updated");
+    metadata = stasis_testing_read_ascii("index/my_pkg/My_Pkg-1.0-py3-none-any.whl.metadata");
+    STASIS_ASSERT(metadata && strstr(metadata, "Requires-Python: >=3.12.1\n") != NULL, "metadata file with the same modification time should be replaced");
+    guard_free(metadata);
+
+    STASIS_ASSERT(wheel_index_build("index_missing", 1) < 0, "missing directory should be an error");
+}
+
+int main(int argc, char *argv[]) {
+    STASIS_TEST_BEGIN_MAIN();
+    STASIS_TEST_FUNC *tests[] = {
+        test_wheel_index_build,
+    };
+    STASIS_TEST_RUN(tests);
+    STASIS_TEST_END_MAIN();
+}
@@ -1,5 +1,6 @@
 #include "testing.h"
 #include "wheelinfo.h"
+#include "wheelcatalog.h"
 
 void test_wheelinfo_get() {
     struct testcase {
@@ -72,10 +73,99 @@ void test_wheelinfo_get() {
     }
 }
 
+void test_wheelinfo_tokenize() {
+    struct WheelName name;
+    const char *filename = "btpackage-1.2.3-mytag-py2.py3-none-any.whl";
+    STASIS_ASSERT_FATAL(wheelinfo_tokenize(filename, &name) == 0, "wheel file name should be accepted");
+    STASIS_ASSERT(name.distribution.data == filename && name.distribution.len == strlen("btpackage"), "token should point into the file name");
+    STASIS_ASSERT(!strncmp(name.version.data, "1.2.3", name.version.len) && name.version.len == 5, "mismatched version");
+    STASIS_ASSERT(!strncmp(name.build_tag.data, "mytag", name.build_tag.len) && name.build_tag.len == 5, "mismatched build tag");
+    STASIS_ASSERT(!strncmp(name.python_tag.data, "py2.py3", name.python_tag.len) && name.python_tag.len == 7, "mismatched python tag");
+    STASIS_ASSERT(!strncmp(name.abi_tag.data, "none", name.abi_tag.len) && name.abi_tag.len == 4, "mismatched abi tag");
+    STASIS_ASSERT(!strncmp(name.platform_tag.data, "any", name.platform_tag.len) && name.platform_tag.len == 3, "platform tag should stop at the extension");
+
+    STASIS_ASSERT(wheelinfo_tokenize("anypackage-1.2.3-py3-none-any.whl", &name) == 0 && name.build_tag.len == 0, "build tag should be optional");
+
+    const char *invalid[] = {
+        "anypackage-1.2.3-py3-none-any.tar.gz",
+        "anypackage-1.2.3-none-any.whl",
+        "a-b-c-d-e-f-g.whl",
+        "anypackage--py3-none-any.whl",
+        "anypackage-1.2.3-py3-none-.whl",
+        ".whl",
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); i++) {
+        STASIS_ASSERT(wheelinfo_tokenize(invalid[i], &name) < 0, invalid[i]);
+    }
+}
+
+void test_wheelinfo_get_best() {
+    mkdir("multi-pkg", 0755);
+    touch("multi-pkg/Multi_Pkg-1.9-py3-none-any.whl");
+    touch("multi-pkg/Multi_Pkg-1.10-py3-none-any.whl");
+    touch("multi-pkg/Multi_Pkg-1.10rc1-py3-none-any.whl");
+    touch("multi-pkg/Multi_Pkg-1.10.dev3-py3-none-any.whl");
+    touch("multi-pkg/Multi_Pkg-1.10-cp311-cp311-linux_x86_64.whl");
+    touch("multi-pkg/Multi_Pkg-1.11-cp310-cp310-linux_x86_64.whl");
+    touch("multi-pkg/multi_pkg_extra-9.0-py3-none-any.whl");
+    touch("multi-pkg/Multi_Pkg-broken.whl");
+
+    struct WheelInfo *wheel = wheelinfo_get(".", "multi-pkg", (char *[]) {"none", "any", NULL}, WHEEL_MATCH_ANY);
+    STASIS_ASSERT_FATAL(wheel != NULL, "result should not be NULL!");
+    STASIS_ASSERT(!strcmp(wheel->file_name, "Multi_Pkg-1.10-py3-none-any.whl"), "highest final release should win, and the name should be normalized");
+    wheelinfo_free(&wheel);
+
+    wheel = wheelinfo_get(".", "multi-pkg", (char *[]) {"311", "x86_64", "none", "any", NULL}, WHEEL_MATCH_ANY);
+    STASIS_ASSERT_FATAL(wheel != NULL, "result should not be NULL!");
+    STASIS_ASSERT(!strcmp(wheel->file_name, "Multi_Pkg-1.10-cp311-cp311-linux_x86_64.whl"), "matching python tag should win over version");
+    wheelinfo_free(&wheel);
+
+    wheel = wheelinfo_get(".", "multi-pkg", (char *[]) {"312", "x86_64", NULL}, WHEEL_MATCH_EXACT);
+    STASIS_ASSERT(wheel == NULL, "incompatible wheels should not match");
+
+    // The listing is read again after the directory changes
+    touch("multi-pkg/Multi_Pkg-1.10-cp312-cp312-linux_x86_64.whl");
+    wheel = wheelinfo_get(".", "multi-pkg", (char *[]) {"312", "x86_64", NULL}, WHEEL_MATCH_EXACT);
+    STASIS_ASSERT(wheel && !strcmp(wheel->file_name, "Multi_Pkg-1.10-cp312-cp312-linux_x86_64.whl"), "new wheel should be found");
+    wheelinfo_free(&wheel);
+    wheelinfo_cache_clear();
+}
+
+void test_wheelinfo_get_cataloged() {
+    // Only the catalog is read. The wheels it lists do not need to exist.
+    mkdirs("catalog/cat-pkg", 0755);
+    stasis_testing_write_ascii("catalog/" WHEEL_CATALOG_FILENAME,
+                               "wheel cat-pkg/Cat_Pkg-1.9-py3-none-any.whl\nname cat-pkg\nversion 1.9\n"
+                               "wheel cat-pkg/Cat_Pkg-1.10-py3-none-any.whl\nname cat-pkg\nversion 1.10\n"
+                               "wheel cat-pkg/Cat_Pkg-1.10rc1-py3-none-any.whl\nname cat-pkg\nversion 1.10rc1\n"
+                               "wheel cat-pkg/Cat_Pkg-1.10-cp311-cp311-linux_x86_64.whl\nname cat-pkg\nversion 1.10\n"
+                               "wheel other/other-2.0-py3-none-any.whl\nname other\nversion 2.0\n");
+    struct WheelCatalog *catalog = wheel_catalog_load("catalog/" WHEEL_CATALOG_FILENAME);
+    STASIS_ASSERT_FATAL(catalog != NULL, "catalog should be readable");
+
+    struct WheelInfo *wheel = wheelinfo_get_cataloged(catalog, "catalog", "Cat.Pkg", (char *[]) {"none", "any", NULL}, WHEEL_MATCH_ANY);
+    STASIS_ASSERT_FATAL(wheel != NULL, "result should not be NULL!");
+    STASIS_ASSERT(!strcmp(wheel->file_name, "Cat_Pkg-1.10-py3-none-any.whl"), "highest final release should win, and the name should be normalized");
+    STASIS_ASSERT(!strcmp(wheel->version, "1.10"), "version should be parsed from the file name");
+    STASIS_ASSERT(endswith(wheel->path_name, "/catalog/cat-pkg"), "path should be the wheel's directory");
+    wheelinfo_free(&wheel);
+
+    wheel = wheelinfo_get_cataloged(catalog, "catalog", "cat-pkg", (char *[]) {"311", "x86_64", "none", "any", NULL}, WHEEL_MATCH_ANY);
+    STASIS_ASSERT(wheel && !strcmp(wheel->file_name, "Cat_Pkg-1.10-cp311-cp311-linux_x86_64.whl"), "matching python tag should win over version");
+    wheelinfo_free(&wheel);
+
+    STASIS_ASSERT(wheelinfo_get_cataloged(catalog, "catalog", "cat-pkg", (char *[]) {"312", NULL}, WHEEL_MATCH_EXACT) == NULL, "incompatible wheels should not match");
+    STASIS_ASSERT(wheelinfo_get_cataloged(catalog, "catalog", "missing", (char *[]) {"any", NULL}, WHEEL_MATCH_ANY) == NULL, "unknown project should not match");
+    wheel_catalog_free(&catalog);
+}
+
 int main(int argc, char *argv[]) {
     STASIS_TEST_BEGIN_MAIN();
     STASIS_TEST_FUNC *tests[] = {
         test_wheelinfo_get,
+        test_wheelinfo_tokenize,
+        test_wheelinfo_get_best,
+        test_wheelinfo_get_cataloged,
     };
 
     // Create mock package directories, and files